@@ -6,3 +6,19 @@ set(SANITIZING_FLAGS -fno-sanitize-recover=all -fsanitize=undefined -fsanitize=a
 # ask for more warnings from the compiler
 set (CMAKE_BASE_CXX_FLAGS "${CMAKE_CXX_FLAGS}")
 set (CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -Wall -Wpedantic -Wextra -Weffc++ -Werror -Wshadow -Wpointer-arith -Wcast-qual -Wformat=2 -Wno-unqualified-std-cast-call")
+
+# record hot-path events in per-thread trace rings (see src/packet_trace.hh); off, they compile to nothing
+option (ROUTER_TRACE "Record packet trace events" OFF)
+if (ROUTER_TRACE)
+  add_compile_definitions (ROUTER_TRACE)
+endif ()
+
+# least severe log level compiled in (Debug, Info, Warning, Error or Off; see util/logger.hh)
+set (ROUTER_LOG_LEVEL "Debug" CACHE STRING "Least severe log level compiled in")
+add_compile_definitions (ROUTER_LOG_LEVEL=${ROUTER_LOG_LEVEL})
+
+# attribute perf counter (or TSC) deltas to forwarding stages (see src/forwarding_profile.hh)
+option (ROUTER_PROFILE "Profile forwarding stages" OFF)
+if (ROUTER_PROFILE)
+  add_compile_definitions (ROUTER_PROFILE)
+endif ()
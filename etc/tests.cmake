@@ -11,9 +11,25 @@ macro (ttest name)
   set_property(TEST ${name} PROPERTY FIXTURES_REQUIRED compile)
 endmacro (ttest)
 
+# for tests that count allocations, which AddressSanitizer's allocator keeps them from doing
+macro (ttest_unsanitized name)
+  add_test(NAME ${name} COMMAND "${name}")
+  set_property(TEST ${name} PROPERTY FIXTURES_REQUIRED compile)
+endmacro (ttest_unsanitized)
+
 set_property(TEST ${compile_name} PROPERTY TIMEOUT -1)
 set_tests_properties(${compile_name} PROPERTIES FIXTURES_SETUP compile)
 
+set(compile_opt_name "compile with optimization")
+add_test(NAME ${compile_opt_name} COMMAND "${CMAKE_COMMAND}" --build "${CMAKE_BINARY_DIR}" -t speed_testing)
+set_property(TEST ${compile_opt_name} PROPERTY TIMEOUT -1)
+set_tests_properties(${compile_opt_name} PROPERTIES FIXTURES_SETUP compile_opt)
+
+macro (stest name)
+  add_test(NAME ${name} COMMAND "${name}")
+  set_property(TEST ${name} PROPERTY FIXTURES_REQUIRED compile_opt)
+endmacro (stest)
+
 add_test(NAME t_webget COMMAND "${PROJECT_SOURCE_DIR}/tests/webget_t.sh" "${PROJECT_BINARY_DIR}")
 set_property(TEST t_webget PROPERTY FIXTURES_REQUIRED compile)
 
@@ -25,6 +41,22 @@ ttest(net_interface_test_learn)
 ttest(net_interface_test_pending)
 ttest(net_interface_test_expiry)
 ttest(net_interface_test_independence)
+ttest(net_interface_test_memory)
+ttest(net_interface_test_counters)
+ttest(net_interface_clock)
+ttest(net_interface_packet_socket)
+ttest(net_interface_packet_ring)
+ttest(net_interface_udp_link)
+ttest(net_interface_shared_memory)
+ttest(io_uring_loopback)
+ttest(event_loop)
+ttest(udp_batch)
+ttest(udp_segments)
+ttest(tcp_zerocopy)
+ttest(fd_transfer)
+ttest(read_buffer)
+ttest(try_io)
+ttest(fd_stats)
 
 ttest(router_2hosts_1)
 ttest(router_2hosts_2)
@@ -32,8 +64,29 @@ ttest(router_internet)
 ttest(router_hs_network)
 ttest(router_same_network)
 ttest(router_ttl)
+ttest(router_memory)
+ttest(router_counters)
+ttest(router_latency)
+ttest(router_trace)
+ttest(router_logging)
+ttest_unsanitized(router_allocations)
+ttest(router_metrics)
+ttest(router_flows)
+ttest(router_heavy_hitters)
+ttest(router_capture)
+ttest(router_replay)
+ttest(router_daemon)
+
+stest(router_speed_test)
+stest(packet_driver_speed_test)
+stest(shared_memory_speed_test)
+stest(udp_speed_test)
+stest(zerocopy_speed_test)
+stest(read_speed_test)
 
 
 add_custom_target (pa1 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --continue-on-failure --timeout 12 -R '^net_interface')
 
 add_custom_target (pa2 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --continue-on-failure --timeout 12 -R '^router')
+
+add_custom_target (speed COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --timeout 60 -R 'speed_test')
@@ -0,0 +1,220 @@
+#include "flow_sampler.hh"
+
+#include "exception.hh"
+#include "histogram.hh"
+
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+
+using namespace std;
+
+void FlowRecord::parse( Parser& parser )
+{
+  parser.integer( src );
+  parser.integer( dst );
+  parser.integer( src_port );
+  parser.integer( dst_port );
+  parser.integer( protocol );
+  parser.integer( outcome );
+  parser.integer( ingress );
+  parser.integer( egress );
+  parser.integer( samples );
+  parser.integer( packets );
+  parser.integer( bytes );
+}
+
+void FlowRecord::serialize( Serializer& serializer ) const
+{
+  serializer.integer( src );
+  serializer.integer( dst );
+  serializer.integer( src_port );
+  serializer.integer( dst_port );
+  serializer.integer( protocol );
+  serializer.integer( outcome );
+  serializer.integer( ingress );
+  serializer.integer( egress );
+  serializer.integer( samples );
+  serializer.integer( packets );
+  serializer.integer( bytes );
+}
+
+void FlowExport::parse( Parser& parser )
+{
+  uint16_t count {};
+  parser.integer( version );
+  parser.integer( count );
+  parser.integer( sampling_rate );
+  parser.integer( sequence );
+  parser.integer( dropped );
+  if ( version != VERSION ) {
+    parser.set_error();
+    return;
+  }
+
+  records.resize( count );
+  for ( auto& record : records ) {
+    record.parse( parser );
+  }
+}
+
+void FlowExport::serialize( Serializer& serializer ) const
+{
+  serializer.integer( version );
+  serializer.integer( static_cast<uint16_t>( records.size() ) );
+  serializer.integer( sampling_rate );
+  serializer.integer( sequence );
+  serializer.integer( dropped );
+  for ( const auto& record : records ) {
+    record.serialize( serializer );
+  }
+}
+
+FlowSampler::FlowSampler( const uint32_t rate )
+  : rate_( rate ), random_state_( random_device()() | 1 ), countdown_( 0 )
+{
+  if ( rate_ == 0 ) {
+    throw runtime_error( "FlowSampler: sampling rate must be at least 1" );
+  }
+  countdown_ = next_gap();
+}
+
+FlowSampler::~FlowSampler()
+{
+  stopping_ = true;
+  if ( exporter_.joinable() ) {
+    exporter_.join();
+  }
+}
+
+// A gap uniformly distributed over [1, 2 * rate - 1], so that one datagram in `rate` is sampled on average
+// but the sampled ones do not fall into step with periodic traffic
+uint32_t FlowSampler::next_gap()
+{
+  if ( rate_ == 1 ) {
+    return 1;
+  }
+  // xorshift64: a few instructions, and only once per sample
+  random_state_ ^= random_state_ << 13;
+  random_state_ ^= random_state_ >> 7;
+  random_state_ ^= random_state_ << 17;
+  return 1 + static_cast<uint32_t>( random_state_ % ( 2 * static_cast<uint64_t>( rate_ ) - 1 ) );
+}
+
+void FlowSampler::sample( const InternetDatagram& dgram,
+                          const size_t ingress,
+                          const optional<size_t> egress,
+                          const uint8_t prefix_length,
+                          const FlowOutcome outcome )
+{
+  FlowSample sample { monotonic_ns(),
+                      dgram.header.src,
+                      dgram.header.dst,
+                      0,
+                      0,
+                      dgram.header.len,
+                      dgram.header.proto,
+                      prefix_length,
+                      static_cast<uint16_t>( ingress ),
+                      egress.has_value() ? static_cast<uint16_t>( *egress ) : NO_INTERFACE,
+                      outcome };
+
+  // TCP and UDP both begin with the source and destination ports, carried only by a datagram's first fragment
+  constexpr uint8_t PROTO_UDP = 17;
+  const bool has_ports = ( sample.protocol == IPv4Header::PROTO_TCP or sample.protocol == PROTO_UDP )
+                         and dgram.header.offset == 0;
+  if ( has_ports and not dgram.payload.empty() ) {
+    const string_view transport = dgram.payload.front();
+    if ( transport.size() >= 4 ) {
+      const auto byte = [&]( size_t i ) { return static_cast<uint8_t>( transport[i] ); };
+      sample.src_port = static_cast<uint16_t>( byte( 0 ) << 8 | byte( 1 ) );
+      sample.dst_port = static_cast<uint16_t>( byte( 2 ) << 8 | byte( 3 ) );
+    }
+  }
+
+  if ( ring_.try_push( sample ) ) {
+    sampled_.fetch_add( 1, memory_order_relaxed );
+  } else {
+    dropped_.fetch_add( 1, memory_order_relaxed );
+  }
+}
+
+void FlowSampler::start_export( UDPSocket socket, const Address& collector, const chrono::milliseconds interval )
+{
+  if ( exporter_.joinable() ) {
+    throw runtime_error( "FlowSampler is already exporting" );
+  }
+  exporter_ = thread( [this, socket = std::move( socket ), collector, interval]() mutable {
+    run( std::move( socket ), collector, interval );
+  } );
+}
+
+void FlowSampler::run( UDPSocket socket, const Address collector, const chrono::milliseconds interval )
+{
+  using FlowKey = tuple<uint32_t, uint32_t, uint16_t, uint16_t, uint8_t, uint8_t, uint16_t, uint16_t>;
+  map<FlowKey, FlowRecord> flows;
+  uint64_t sequence = 0;
+
+  const auto aggregate = [&] {
+    while ( const auto sample = ring_.try_pop() ) {
+      const uint8_t outcome = static_cast<uint8_t>( sample->outcome );
+      FlowRecord& flow = flows[{ sample->src,
+                                 sample->dst,
+                                 sample->src_port,
+                                 sample->dst_port,
+                                 sample->protocol,
+                                 outcome,
+                                 sample->ingress,
+                                 sample->egress }];
+      if ( flow.samples == 0 ) {
+        flow.src = sample->src;
+        flow.dst = sample->dst;
+        flow.src_port = sample->src_port;
+        flow.dst_port = sample->dst_port;
+        flow.protocol = sample->protocol;
+        flow.outcome = outcome;
+        flow.ingress = sample->ingress;
+        flow.egress = sample->egress;
+      }
+      flow.samples++;
+      flow.packets += rate_;
+      flow.bytes += uint64_t { sample->length } * rate_;
+    }
+  };
+
+  const auto export_flows = [&] {
+    FlowExport message;
+    message.sampling_rate = rate_;
+    for ( auto it = flows.begin(); it != flows.end(); ) {
+      message.records.push_back( it->second );
+      it = flows.erase( it );
+      if ( message.records.size() == FlowExport::MAX_RECORDS or it == flows.end() ) {
+        message.sequence = sequence++;
+        message.dropped = dropped();
+        string datagram;
+        for ( const auto& buffer : serialize( message ) ) {
+          datagram += string_view { buffer };
+        }
+        try {
+          socket.sendto( collector, datagram );
+        } catch ( const unix_error& ) { // thrown out of this thread, it would end the process
+          export_errors_.fetch_add( 1, memory_order_relaxed );
+        }
+        message.records.clear();
+      }
+    }
+  };
+
+  auto next_export = chrono::steady_clock::now() + interval;
+  while ( not stopping_ ) {
+    aggregate();
+    if ( chrono::steady_clock::now() >= next_export ) {
+      export_flows();
+      next_export += interval;
+    }
+    this_thread::sleep_for( min( interval, chrono::milliseconds( 10 ) ) );
+  }
+  aggregate();
+  export_flows();
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "ipv4_datagram.hh"
+#include "parser.hh"
+#include "socket.hh"
+#include "spsc_ring.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// What the router did with a sampled datagram
+enum class FlowOutcome : uint8_t
+{
+  Forwarded,
+  NoRoute,
+  TtlExpired
+};
+
+// One sampled datagram: the header fields that identify its flow, and the routing decision
+struct FlowSample
+{
+  uint64_t timestamp_ns {}; // see monotonic_ns()
+  uint32_t src {};
+  uint32_t dst {};
+  uint16_t src_port {}; // TCP and UDP only
+  uint16_t dst_port {};
+  uint16_t length {}; // IPv4 total length
+  uint8_t protocol {};
+  uint8_t prefix_length {}; // of the matching route
+  uint16_t ingress {};      // interface numbers
+  uint16_t egress {};
+  FlowOutcome outcome {};
+};
+
+// Samples of one flow aggregated over an export interval, as exported
+struct FlowRecord
+{
+  static constexpr size_t LENGTH = 42; // serialized length in bytes
+
+  uint32_t src {};
+  uint32_t dst {};
+  uint16_t src_port {};
+  uint16_t dst_port {};
+  uint8_t protocol {};
+  uint8_t outcome {}; // FlowOutcome
+  uint16_t ingress {};
+  uint16_t egress {};
+  uint64_t samples {}; // datagrams actually sampled
+  uint64_t packets {}; // estimated datagrams (samples scaled by the sampling rate)
+  uint64_t bytes {};   // estimated bytes
+
+  void parse( Parser& parser );
+  void serialize( Serializer& serializer ) const;
+};
+
+// One export datagram: a header, then `count` FlowRecords
+struct FlowExport
+{
+  static constexpr uint16_t VERSION = 1;
+  static constexpr size_t HEADER_LENGTH = 24;
+  static constexpr size_t MAX_RECORDS = ( 1400 - HEADER_LENGTH ) / FlowRecord::LENGTH; // fits a 1500-byte MTU
+
+  uint16_t version = VERSION;
+  uint32_t sampling_rate {}; // 1 in this many datagrams was sampled
+  uint64_t sequence {};      // export datagrams sent before this one
+  uint64_t dropped {};       // samples lost because the ring was full, so far
+  std::vector<FlowRecord> records {};
+
+  void parse( Parser& parser );
+  void serialize( Serializer& serializer ) const;
+};
+
+// Random 1-in-N sampling of routed datagrams, sFlow-style.
+//
+// The forwarding thread calls should_sample() for every datagram (a decrement and a branch) and
+// sample() for the chosen ones, which copies the header fields into a lock-free ring. A background
+// thread aggregates samples into flows and periodically exports them as FlowExport datagrams over UDP.
+class FlowSampler
+{
+public:
+  static constexpr uint16_t NO_INTERFACE = 0xffff;
+  static constexpr size_t ring_capacity = 4096;
+
+  // Sample one in `rate` datagrams on average (the gaps between samples are random)
+  explicit FlowSampler( uint32_t rate );
+
+  // Stops the exporter, after exporting what has been sampled
+  ~FlowSampler();
+
+  uint32_t rate() const { return rate_; }
+
+  // Forwarding thread: should this datagram be sampled?
+  bool should_sample()
+  {
+    if ( --countdown_ > 0 ) {
+      return false;
+    }
+    countdown_ = next_gap();
+    return true;
+  }
+
+  // Forwarding thread: record a sampled datagram and what was done with it
+  void sample( const InternetDatagram& dgram,
+               size_t ingress,
+               std::optional<size_t> egress,
+               uint8_t prefix_length,
+               FlowOutcome outcome );
+
+  // Export to `collector` every `interval`, from a background thread
+  void start_export( UDPSocket socket, const Address& collector, std::chrono::milliseconds interval );
+
+  uint64_t sampled() const { return sampled_.load( std::memory_order_relaxed ); }
+  uint64_t dropped() const { return dropped_.load( std::memory_order_relaxed ); }
+  // Export datagrams lost because sending failed (e.g. ECONNREFUSED or ENOBUFS); exporting carries on
+  uint64_t export_errors() const { return export_errors_.load( std::memory_order_relaxed ); }
+
+  FlowSampler( const FlowSampler& other ) = delete;
+  FlowSampler& operator=( const FlowSampler& other ) = delete;
+  FlowSampler( FlowSampler&& other ) = delete;
+  FlowSampler& operator=( FlowSampler&& other ) = delete;
+
+private:
+  uint32_t next_gap();
+  void run( UDPSocket socket, Address collector, std::chrono::milliseconds interval );
+
+  uint32_t rate_;
+  uint64_t random_state_;
+  uint32_t countdown_;
+
+  SpscRing<FlowSample, ring_capacity> ring_ {};
+  std::atomic<uint64_t> sampled_ { 0 };
+  std::atomic<uint64_t> dropped_ { 0 };
+  std::atomic<uint64_t> export_errors_ { 0 };
+
+  std::atomic<bool> stopping_ { false };
+  std::thread exporter_ {};
+};
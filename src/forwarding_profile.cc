@@ -0,0 +1,55 @@
+#include "forwarding_profile.hh"
+
+#include <array>
+#include <iomanip>
+#include <string>
+
+using namespace std;
+
+string_view to_string( const ForwardingStage stage )
+{
+  static constexpr array<string_view, static_cast<size_t>( ForwardingStage::COUNT )> names {
+    "parse", "lookup", "arp", "serialize", "enqueue" };
+  return names.at( static_cast<size_t>( stage ) );
+}
+
+ForwardingProfile& this_thread_forwarding_profile()
+{
+  thread_local ForwardingProfile profile;
+  return profile;
+}
+
+void print_forwarding_profile( ostream& out, const ForwardingProfile& profile, const uint64_t packets )
+{
+  const PerfCounters& counters = profile.counters();
+  const auto per = []( uint64_t total, uint64_t n ) { return n ? static_cast<double>( total ) / n : 0.0; };
+
+  // without perf events, "cycles" are time-stamp counter ticks
+  const string_view cycles = counters.hardware() ? "cycles" : "tsc_ticks";
+  out << left << setw( 10 ) << "stage" << right << setw( 10 ) << "calls" << setw( 18 ) << string( cycles ) + "/call"
+      << setw( 20 ) << "instructions/call" << setw( 20 ) << "cache_misses/call";
+  if ( packets ) {
+    out << setw( 18 ) << string( cycles ) + "/packet";
+  }
+  out << "\n" << fixed << setprecision( 1 );
+
+  for ( size_t i = 0; i < static_cast<size_t>( ForwardingStage::COUNT ); i++ ) {
+    const auto& totals = profile.totals( i );
+    out << left << setw( 10 ) << to_string( static_cast<ForwardingStage>( i ) ) << right << setw( 10 )
+        << totals.calls << setw( 18 ) << per( totals.counts.cycles, totals.calls );
+    if ( counters.counts_instructions() ) {
+      out << setw( 20 ) << per( totals.counts.instructions, totals.calls );
+    } else {
+      out << setw( 20 ) << "n/a";
+    }
+    if ( counters.counts_cache_misses() ) {
+      out << setw( 20 ) << per( totals.counts.cache_misses, totals.calls );
+    } else {
+      out << setw( 20 ) << "n/a";
+    }
+    if ( packets ) {
+      out << setw( 18 ) << per( totals.counts.cycles, packets );
+    }
+    out << "\n";
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "perf_counters.hh"
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+// Stages of the forwarding path, as profiled in NetworkInterface and Router
+enum class ForwardingStage : uint8_t
+{
+  Parse,     // recv_frame(): parsing an IPv4 datagram out of a frame
+  Lookup,    // route_single_dgram(): longest-prefix match
+  Arp,       // recv_frame() handling ARP, and send_datagram() resolving (or failing to resolve) the next hop
+  Serialize, // rewriting the TTL and checksum, and serializing the datagram into a frame
+  Enqueue,   // queueing the frame for maybe_send()
+  COUNT
+};
+
+std::string_view to_string( ForwardingStage stage );
+
+using ForwardingProfile = StageProfile<static_cast<size_t>( ForwardingStage::COUNT )>;
+
+// The calling thread's profile (profiles are per thread because perf counters are)
+ForwardingProfile& this_thread_forwarding_profile();
+
+// Print calls and per-call (and per-packet, if `packets` is non-zero) counts for each stage
+void print_forwarding_profile( std::ostream& out, const ForwardingProfile& profile, uint64_t packets = 0 );
+
+// Stage profiling is compiled in only when building with -DROUTER_PROFILE=ON (every lap costs a
+// perf counter read, i.e. a system call); otherwise these expand to nothing.
+#ifdef ROUTER_PROFILE
+#define PROFILE_START( timer ) StageTimer<ForwardingProfile> timer { this_thread_forwarding_profile() }
+#define PROFILE_LAP( timer, stage ) timer.lap( static_cast<size_t>( ForwardingStage::stage ) )
+#else
+#define PROFILE_START( timer ) static_cast<void>( 0 )
+#define PROFILE_LAP( timer, stage ) static_cast<void>( 0 )
+#endif
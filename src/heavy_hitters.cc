@@ -0,0 +1,47 @@
+#include "heavy_hitters.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+vector<HeavyHitter> HeavyHitters::top_sources() const
+{
+  const lock_guard lock { published_mutex_ };
+  return published_sources_;
+}
+
+vector<HeavyHitter> HeavyHitters::top_destinations() const
+{
+  const lock_guard lock { published_mutex_ };
+  return published_destinations_;
+}
+
+void HeavyHitters::publish()
+{
+  auto sources = top_sources_.top();
+  auto destinations = top_destinations_.top();
+
+  const lock_guard lock { published_mutex_ };
+  published_sources_ = std::move( sources );
+  published_destinations_ = std::move( destinations );
+}
+
+void HeavyHitters::end_window( uint64_t now_ns )
+{
+  if ( window_end_ns_ == 0 ) {
+    window_end_ns_ = now_ns + window_ns_;
+    return;
+  }
+
+  publish();
+
+  // decay once for every window that has ended, including any that passed with no traffic
+  const uint64_t windows = 1 + ( now_ns - window_end_ns_ ) / window_ns_;
+  for ( uint64_t i = 0; i < min<uint64_t>( windows, 64 ); i++ ) {
+    source_counts_.decay();
+    destination_counts_.decay();
+    top_sources_.decay();
+    top_destinations_.decay();
+  }
+  window_end_ns_ = now_ns + window_ns_;
+}
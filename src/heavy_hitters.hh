@@ -0,0 +1,58 @@
+#pragma once
+
+#include "sketch.hh"
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// The sources and destinations that dominate a router's traffic right now.
+//
+// The forwarding thread calls record() for every routed datagram: a Count-Min sketch and a SpaceSaving
+// summary per direction, in fixed memory. Counts are in datagrams and decay by half at the end of every
+// window, so each one weighs the last window fully, the one before by half, and so on. At each window's
+// end the top keys are published for other threads, which may also query the sketches at any time.
+class HeavyHitters
+{
+public:
+  static constexpr uint64_t default_window_ns = 1'000'000'000;
+
+  // Forwarding thread: count one datagram, at `now_ns` (see monotonic_ns())
+  void record( uint32_t src, uint32_t dst, uint64_t now_ns )
+  {
+    if ( now_ns >= window_end_ns_ ) {
+      end_window( now_ns );
+    }
+    top_sources_.add( src, 1, source_counts_.add( src ) );
+    top_destinations_.add( dst, 1, destination_counts_.add( dst ) );
+  }
+
+  // Length of the decay window (the default is one second); takes effect at the next window
+  void set_window( uint64_t window_ns ) { window_ns_ = window_ns; }
+
+  // Any thread: the heaviest sources and destinations as of the end of the last window, largest first
+  std::vector<HeavyHitter> top_sources() const;
+  std::vector<HeavyHitter> top_destinations() const;
+
+  // Any thread: upper bounds on the decayed counts of one address, as of now
+  uint64_t source_estimate( uint32_t address ) const { return source_counts_.estimate( address ); }
+  uint64_t destination_estimate( uint32_t address ) const { return destination_counts_.estimate( address ); }
+
+  // Forwarding thread: publish the top keys now, without decaying (e.g. for a test, or an idle router)
+  void publish();
+
+private:
+  void end_window( uint64_t now_ns );
+
+  CountMinSketch<> source_counts_ {};
+  CountMinSketch<> destination_counts_ {};
+  SpaceSaving<> top_sources_ {};
+  SpaceSaving<> top_destinations_ {};
+
+  uint64_t window_ns_ = default_window_ns;
+  uint64_t window_end_ns_ {}; // 0: the first datagram starts the first window
+
+  mutable std::mutex published_mutex_ {};
+  std::vector<HeavyHitter> published_sources_ {};
+  std::vector<HeavyHitter> published_destinations_ {};
+};
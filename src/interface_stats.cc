@@ -0,0 +1,28 @@
+#include "interface_stats.hh"
+
+#include <array>
+
+using namespace std;
+
+string_view to_string( const InterfaceCounter counter )
+{
+  static constexpr array<string_view, static_cast<size_t>( InterfaceCounter::COUNT )> names {
+    "rx_packets",
+    "rx_bytes",
+    "tx_packets",
+    "tx_bytes",
+    "arp_requests_sent",
+    "arp_requests_received",
+    "arp_replies_sent",
+    "arp_replies_received",
+    "forwarded",
+  };
+  return names.at( static_cast<size_t>( counter ) );
+}
+
+string_view to_string( const DropReason reason )
+{
+  static constexpr array<string_view, static_cast<size_t>( DropReason::COUNT )> names {
+    "no_route", "ttl_expired", "bad_checksum", "not_for_us", "queue_full", "arp_timeout" };
+  return names.at( static_cast<size_t>( reason ) );
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "counters.hh"
+#include "histogram.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+
+// Events counted by every NetworkInterface
+enum class InterfaceCounter : uint8_t
+{
+  RxPackets,           // frames arriving at recv_frame()
+  RxBytes,             // bytes in those frames (header included)
+  TxPackets,           // frames released by maybe_send()
+  TxBytes,             // bytes in those frames (header included)
+  ArpRequestsSent,     // ARP requests queued for transmission
+  ArpRequestsReceived, // ARP requests arriving (for any target)
+  ArpRepliesSent,      // ARP replies queued for transmission
+  ArpRepliesReceived,  // ARP replies arriving (for any target)
+  Forwarded,           // datagrams a Router sent out on this interface
+  COUNT
+};
+
+// Why a packet was dropped
+enum class DropReason : uint8_t
+{
+  NoRoute,     // router: no route matched the destination (counted on the ingress interface)
+  TtlExpired,  // router: TTL reached zero (counted on the ingress interface)
+  BadChecksum, // frame payload failed to parse, e.g. an IPv4 header with a bad checksum
+  NotForUs,    // frame addressed to another Ethernet address, or of an unhandled type
+  QueueFull,   // refused or evicted because a memory budget was exhausted
+  ArpTimeout,  // next hop's Ethernet address never resolved
+  COUNT
+};
+
+std::string_view to_string( InterfaceCounter counter );
+std::string_view to_string( DropReason reason );
+
+// A NetworkInterface's counters. Writers are the threads driving the interface; any other thread
+// may read at any time (e.g. a metrics exporter) without locking.
+class InterfaceStats
+{
+  static constexpr size_t counters = static_cast<size_t>( InterfaceCounter::COUNT );
+  static constexpr size_t reasons = static_cast<size_t>( DropReason::COUNT );
+
+  ShardedCounters<counters + reasons> counts_ {};
+
+public:
+  // Latency distributions, recorded by the thread driving the interface
+  LatencyHistogram forwarding_ns {}; // from arrival at a Router (recv_frame) to departure here (maybe_send)
+  LatencyHistogram arp_wait_ms {};   // time datagrams spent waiting for ARP, on the interface's tick() clock
+  LatencyHistogram tick_ns {};       // cost of each call to tick()
+
+  // Sizes, published by the thread driving the interface
+  std::atomic<uint64_t> arp_entries {};  // learned IP-to-Ethernet mappings
+  std::atomic<uint64_t> memory_bytes {}; // bytes held in queues and tables (see NetworkInterface::memory_usage())
+
+  void count( InterfaceCounter counter, uint64_t n = 1 ) { counts_.add( static_cast<size_t>( counter ), n ); }
+  void count_drop( DropReason reason ) { counts_.add( counters + static_cast<size_t>( reason ) ); }
+
+  uint64_t get( InterfaceCounter counter ) const { return counts_.get( static_cast<size_t>( counter ) ); }
+  uint64_t drops( DropReason reason ) const { return counts_.get( counters + static_cast<size_t>( reason ) ); }
+
+  // Drops for all reasons
+  uint64_t drops() const
+  {
+    uint64_t total = 0;
+    for ( size_t i = 0; i < reasons; i++ ) {
+      total += drops( static_cast<DropReason>( i ) );
+    }
+    return total;
+  }
+};
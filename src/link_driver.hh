@@ -0,0 +1,46 @@
+#pragma once
+
+#include "file_descriptor.hh"
+#include "router.hh"
+
+#include <cstddef>
+#include <cstdint>
+
+// Counters kept by a link driver
+struct DriverStats
+{
+  uint64_t frames_received {};
+  uint64_t frames_sent {};
+  uint64_t bytes_received {};
+  uint64_t bytes_sent {};
+  uint64_t truncated {};     // received frames larger than the driver's buffers, dropped
+  uint64_t malformed {};     // received frames too short to be Ethernet, dropped
+  uint64_t send_errors {};   // frames the kernel refused, dropped
+  uint64_t receive_calls {}; // system calls made, to see how well they batch
+  uint64_t send_calls {};
+};
+
+// Moves Ethernet frames between a NetworkInterface and some real link, a batch at a time, without blocking.
+// An event loop waits for socket() to become readable, then calls receive().
+class LinkDriver
+{
+public:
+  LinkDriver() = default;
+  virtual ~LinkDriver() = default;
+
+  // Receive up to one batch of waiting frames into `interface`; returns the number of frames received
+  virtual size_t receive( AsyncNetworkInterface& interface ) = 0;
+
+  // Send up to one batch of frames from `interface.maybe_send()`; returns the number sent
+  virtual size_t send( NetworkInterface& interface ) = 0;
+
+  // Readable when frames are waiting
+  virtual const FileDescriptor& socket() const = 0;
+
+  virtual const DriverStats& stats() const = 0;
+
+  LinkDriver( const LinkDriver& other ) = delete;
+  LinkDriver& operator=( const LinkDriver& other ) = delete;
+  LinkDriver( LinkDriver&& other ) = delete;
+  LinkDriver& operator=( LinkDriver&& other ) = delete;
+};
@@ -0,0 +1,203 @@
+#include "metrics_exporter.hh"
+
+#include "exception.hh"
+#include "logger.hh"
+#include "router.hh"
+
+#include <array>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+
+using namespace std;
+
+namespace {
+
+constexpr int poll_interval_ms = 100;  // how often the server checks whether to stop
+constexpr int request_timeout_ms = 1000; // how long a client may take to send its request
+
+// A metric family's HELP and TYPE lines
+void describe( ostream& out, string_view name, string_view type, string_view help )
+{
+  out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+}
+
+// A LatencyHistogram as the samples of a Prometheus summary
+void summarize( ostream& out, string_view name, string_view labels, const LatencyHistogram& histogram )
+{
+  const string separator = labels.empty() ? "" : ",";
+  for ( const auto& [quantile, value] : { pair { "0.5", histogram.p50() },
+                                          pair { "0.99", histogram.p99() },
+                                          pair { "0.999", histogram.p999() } } ) {
+    out << name << "{" << labels << separator << "quantile=\"" << quantile << "\"} " << value << "\n";
+  }
+  const string braces = labels.empty() ? "" : "{" + string( labels ) + "}";
+  out << name << "_sum" << braces << " " << histogram.sum() << "\n";
+  out << name << "_count" << braces << " " << histogram.count() << "\n";
+}
+
+// Write all of `text` to a (blocking) socket, giving up if the peer goes away
+void send_all( int fd, string_view text )
+{
+  while ( not text.empty() ) {
+    const ssize_t sent = ::send( fd, text.data(), text.size(), MSG_NOSIGNAL );
+    if ( sent <= 0 ) {
+      return;
+    }
+    text.remove_prefix( sent );
+  }
+}
+
+} // namespace
+
+MetricsExporter::MetricsExporter( const Router& router ) : router_( router.stats_handle() )
+{
+  for ( size_t i = 0; i < router.interface_count(); i++ ) {
+    interfaces_.push_back( router.interface( i ).stats_handle() );
+  }
+}
+
+MetricsExporter::~MetricsExporter()
+{
+  stopping_ = true;
+  if ( server_.joinable() ) {
+    server_.join();
+  }
+}
+
+void MetricsExporter::serve( FileDescriptor listener )
+{
+  if ( server_.joinable() ) {
+    throw runtime_error( "MetricsExporter is already serving" );
+  }
+  server_ = thread( [this, listener = std::move( listener )]() mutable { run( std::move( listener ) ); } );
+}
+
+void MetricsExporter::run( FileDescriptor listener )
+{
+  while ( not stopping_ ) {
+    pollfd ready { listener.fd_num(), POLLIN, 0 };
+    if ( ::poll( &ready, 1, poll_interval_ms ) <= 0 ) {
+      continue;
+    }
+    serve_one( listener );
+  }
+}
+
+void MetricsExporter::serve_one( const FileDescriptor& listener ) const
+{
+  const int client = ::accept4( listener.fd_num(), nullptr, nullptr, SOCK_CLOEXEC );
+  if ( client < 0 ) {
+    return;
+  }
+  const FileDescriptor connection { client }; // closes the connection when done
+  respond( client );
+}
+
+void MetricsExporter::respond( const int client ) const
+{
+  // Read the request (up to the blank line that ends its headers) but do not interpret it
+  string request;
+  array<char, 1024> chunk {};
+  while ( not request_complete( request ) ) {
+    pollfd ready { client, POLLIN, 0 };
+    if ( ::poll( &ready, 1, request_timeout_ms ) <= 0 ) {
+      return;
+    }
+    const ssize_t received = ::recv( client, chunk.data(), chunk.size(), 0 );
+    if ( received <= 0 ) {
+      return;
+    }
+    request.append( chunk.data(), received );
+  }
+
+  send_all( client, response() );
+}
+
+bool MetricsExporter::request_complete( const string_view request )
+{
+  return request.find( "\r\n\r\n" ) != string_view::npos or request.size() >= max_request;
+}
+
+string MetricsExporter::response() const
+{
+  const string body = render();
+  return "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+         + to_string( body.size() ) + "\r\nConnection: close\r\n\r\n" + body;
+}
+
+string MetricsExporter::render() const
+{
+  ostringstream out;
+
+  describe( out, "router_routes", "gauge", "Entries in the routing table." );
+  out << "router_routes " << router_->routes.load( memory_order_relaxed ) << "\n";
+
+  describe( out, "router_route_duration_ns", "summary", "Time spent in each call to Router::route()." );
+  summarize( out, "router_route_duration_ns", "", router_->route_ns );
+
+  describe( out,
+            "router_heavy_hitter_packets",
+            "gauge",
+            "Decayed datagram counts (upper bounds) of the busiest addresses, as of the last window." );
+  for ( const auto& [direction, hitters] : { pair { "source", router_->heavy_hitters.top_sources() },
+                                             pair { "destination", router_->heavy_hitters.top_destinations() } } ) {
+    for ( const auto& hitter : hitters ) {
+      out << "router_heavy_hitter_packets{direction=\"" << direction << "\",address=\"";
+      log_print( out, LogIpv4 { hitter.key } ); // a dotted quad, without Address's getnameinfo()
+      out << "\"} " << hitter.count << "\n";
+    }
+  }
+
+  const auto label = []( size_t interface ) { return "interface=\"" + to_string( interface ) + "\""; };
+
+  for ( size_t c = 0; c < static_cast<size_t>( InterfaceCounter::COUNT ); c++ ) {
+    const auto counter = static_cast<InterfaceCounter>( c );
+    const string name = "router_interface_" + string( to_string( counter ) ) + "_total";
+    describe( out, name, "counter", "Interface counter " + string( to_string( counter ) ) + "." );
+    for ( size_t i = 0; i < interfaces_.size(); i++ ) {
+      out << name << "{" << label( i ) << "} " << interfaces_[i]->get( counter ) << "\n";
+    }
+  }
+
+  describe( out, "router_interface_drops_total", "counter", "Packets dropped, by reason." );
+  for ( size_t i = 0; i < interfaces_.size(); i++ ) {
+    for ( size_t r = 0; r < static_cast<size_t>( DropReason::COUNT ); r++ ) {
+      const auto reason = static_cast<DropReason>( r );
+      out << "router_interface_drops_total{" << label( i ) << ",reason=\"" << to_string( reason ) << "\"} "
+          << interfaces_[i]->drops( reason ) << "\n";
+    }
+  }
+
+  describe( out, "router_interface_arp_entries", "gauge", "Entries in the interface's ARP table." );
+  for ( size_t i = 0; i < interfaces_.size(); i++ ) {
+    out << "router_interface_arp_entries{" << label( i ) << "} "
+        << interfaces_[i]->arp_entries.load( memory_order_relaxed ) << "\n";
+  }
+
+  describe( out, "router_interface_memory_bytes", "gauge", "Bytes held in the interface's queues and tables." );
+  for ( size_t i = 0; i < interfaces_.size(); i++ ) {
+    out << "router_interface_memory_bytes{" << label( i ) << "} "
+        << interfaces_[i]->memory_bytes.load( memory_order_relaxed ) << "\n";
+  }
+
+  describe( out,
+            "router_interface_forwarding_latency_ns",
+            "summary",
+            "Time from a datagram's arrival at the router to its departure on this interface." );
+  for ( size_t i = 0; i < interfaces_.size(); i++ ) {
+    summarize( out, "router_interface_forwarding_latency_ns", label( i ), interfaces_[i]->forwarding_ns );
+  }
+
+  describe( out, "router_interface_arp_wait_ms", "summary", "Time datagrams spent waiting for ARP." );
+  for ( size_t i = 0; i < interfaces_.size(); i++ ) {
+    summarize( out, "router_interface_arp_wait_ms", label( i ), interfaces_[i]->arp_wait_ms );
+  }
+
+  describe( out, "router_interface_tick_duration_ns", "summary", "Time spent in each call to tick()." );
+  for ( size_t i = 0; i < interfaces_.size(); i++ ) {
+    summarize( out, "router_interface_tick_duration_ns", label( i ), interfaces_[i]->tick_ns );
+  }
+
+  return out.str();
+}
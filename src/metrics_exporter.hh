@@ -0,0 +1,61 @@
+#pragma once
+
+#include "file_descriptor.hh"
+#include "interface_stats.hh"
+#include "router_stats.hh"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+class Router;
+
+// Serves a Router's counters, latency summaries and table sizes in the Prometheus text exposition
+// format, to anyone who connects to a listening TCPSocket or LocalStreamSocket (any HTTP request
+// path is answered with the metrics).
+//
+// The exporter holds shared handles on the router's and its interfaces' stats, so its thread reads
+// them without locking (or otherwise slowing) the threads that forward packets.
+class MetricsExporter
+{
+public:
+  // Capture handles on the stats of `router` and of its current interfaces
+  explicit MetricsExporter( const Router& router );
+
+  // Stops serving
+  ~MetricsExporter();
+
+  // Serve from a background thread, on a socket that is already bound and listening
+  void serve( FileDescriptor listener );
+
+  // Answer one connection waiting on `listener`, blocking (for up to a second) on the client: for serve()'s
+  // own thread, not an event loop that has other work
+  void serve_one( const FileDescriptor& listener ) const;
+
+  // Or, from the caller's own event loop (which does its own non-blocking I/O): whether `request`, as read
+  // so far, is complete (or as long as the exporter will read), and then the whole HTTP response to send
+  static constexpr size_t max_request = 65536;
+  static bool request_complete( std::string_view request );
+  std::string response() const;
+
+  // The current metrics, as served
+  std::string render() const;
+
+  MetricsExporter( const MetricsExporter& other ) = delete;
+  MetricsExporter& operator=( const MetricsExporter& other ) = delete;
+  MetricsExporter( MetricsExporter&& other ) = delete;
+  MetricsExporter& operator=( MetricsExporter&& other ) = delete;
+
+private:
+  void run( FileDescriptor listener );
+  void respond( int client ) const;
+
+  std::shared_ptr<const RouterStats> router_ {};
+  std::vector<std::shared_ptr<const InterfaceStats>> interfaces_ {};
+
+  std::atomic<bool> stopping_ { false };
+  std::thread server_ {};
+};
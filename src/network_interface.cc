@@ -2,18 +2,30 @@
 
 #include "arp_message.hh"
 #include "ethernet_frame.hh"
+#include "forwarding_profile.hh"
+#include "logger.hh"
+#include "packet_trace.hh"
 
 using namespace std;
 
-size_t curr_time = 0;
+// Bytes a frame occupies on the wire (header included)
+static size_t wire_length( const EthernetFrame& frame )
+{
+  size_t length = EthernetHeader::LENGTH;
+  for ( const auto& buffer : frame.payload ) {
+    length += buffer.size();
+  }
+  return length;
+}
 
 // ethernet_address: Ethernet (what ARP calls "hardware") address of the interface
 // ip_address: IP (what ARP calls "protocol") address of the interface
 NetworkInterface::NetworkInterface( const EthernetAddress& ethernet_address, const Address& ip_address )
   : ethernet_address_( ethernet_address ), ip_address_( ip_address )
 {
-  cerr << "DEBUG: Network interface has Ethernet address " << to_string( ethernet_address_ ) << " and IP address "
-       << ip_address.ip() << "\n";
+  LOG_DEBUG( "Network interface has Ethernet address {} and IP address {}",
+             ethernet_address_,
+             LogIpv4 { ip_address.ipv4_numeric() } );
 }
 
 // Helper: return a ARP message according to 5 parameters
@@ -53,10 +65,17 @@ EthernetFrame NetworkInterface::make_ethernet_frame(const EthernetAddress& dst,
 // Address::ipv4_numeric() method.
 void NetworkInterface::send_datagram( const InternetDatagram& dgram, const Address& next_hop )
 {
+  send_datagram( dgram, next_hop, 0 );
+}
+
+bool NetworkInterface::send_datagram( const InternetDatagram& dgram, const Address& next_hop, const uint64_t origin_ns )
+{
+  PROFILE_START(timer);
   const uint32_t next_hop_ip = next_hop.ipv4_numeric();
 
   // Check if we know the MAC address in the ARP Table
   bool found_ip = (ARP_table.find(next_hop_ip) != ARP_table.end());
+  PROFILE_LAP(timer, Arp);
   
   if (found_ip) {
     // MAC address is found
@@ -65,11 +84,15 @@ void NetworkInterface::send_datagram( const InternetDatagram& dgram, const Addre
     const EthernetAddress target_mac_addr = target->second.MAC_addr;
     EthernetFrame ether_frame = make_ethernet_frame(target_mac_addr, ethernet_address_, 
                                                     EthernetHeader::TYPE_IPv4, serialize(dgram));
+    PROFILE_LAP(timer, Serialize);
 
     // put it in the ready-to-be-sent queue
-    ready2_sent_q.push(ether_frame); 
+    const bool queued = enqueue_ready(std::move(ether_frame), origin_ns);
+    PROFILE_LAP(timer, Enqueue);
+    return queued;
   } else {
     // MAC address is NOT found
+    PACKET_TRACE(ArpMiss, trace_id_, 0, next_hop_ip);
     // Check if the ARP request is sent before
     bool found_request = (request_history.find(next_hop_ip) != request_history.end());
 
@@ -87,23 +110,28 @@ void NetworkInterface::send_datagram( const InternetDatagram& dgram, const Addre
 
     if (!found_request) {
       // if the request is NOT sent before
-      request_history[next_hop.ipv4_numeric()] = curr_time; 
-      ready2_sent_q.push(ARP_request_frame);
-    } else if (found_request && (curr_time - request_history[next_hop.ipv4_numeric()] < NetworkInterface::MAX_WAITING_TIME)) {
+      note_request(next_hop_ip);
+      if (enqueue_ready(std::move(ARP_request_frame))) {
+        stats_->count(InterfaceCounter::ArpRequestsSent);
+      }
+    } else if (found_request && (curr_time_ - request_history[next_hop.ipv4_numeric()] < NetworkInterface::MAX_WAITING_TIME)) {
       // if the request is sent in the last 5 seconds
-      Waiting_Packet request_waiting_packet = Waiting_Packet{next_hop.ipv4_numeric(), ARP_request_frame, SIZE_MAX};
-      waiting_q.push(request_waiting_packet);
+      Waiting_Packet request_waiting_packet = Waiting_Packet{next_hop.ipv4_numeric(), ARP_request_frame, SIZE_MAX, 0};
+      enqueue_waiting(std::move(request_waiting_packet));
     } else {
       // if the request is sent, but not in the last 5 seconds
-      request_history[next_hop.ipv4_numeric()] = curr_time;
-      ready2_sent_q.push(ARP_request_frame);
+      note_request(next_hop_ip);
+      if (enqueue_ready(std::move(ARP_request_frame))) {
+        stats_->count(InterfaceCounter::ArpRequestsSent);
+      }
     }
     
     //Push the thernet frame without MAC addr in the waiting queue
-    Waiting_Packet packet_no_MAC = Waiting_Packet{next_hop.ipv4_numeric(), ether_frame_no_MAC, curr_time};
-    waiting_q.push(packet_no_MAC);
+    Waiting_Packet packet_no_MAC = Waiting_Packet{next_hop.ipv4_numeric(), ether_frame_no_MAC, curr_time_, origin_ns};
+    const bool queued = enqueue_waiting(std::move(packet_no_MAC));
+    PROFILE_LAP(timer, Arp);
+    return queued;
   }
-
 }
 
 
@@ -111,22 +139,35 @@ void NetworkInterface::send_datagram( const InternetDatagram& dgram, const Addre
 optional<InternetDatagram> NetworkInterface::recv_frame( const EthernetFrame& frame )
 {
   optional<InternetDatagram> res = nullopt;
+  stats_->count(InterfaceCounter::RxPackets);
+  stats_->count(InterfaceCounter::RxBytes, wire_length(frame));
+  PACKET_TRACE(Rx, trace_id_, 0, wire_length(frame));
+  if (capturing_) [[unlikely]] {
+    capture_->capture(frame, CaptureDirection::Inbound);
+  }
+  PROFILE_START(timer);
   // If this packet is destined to this machine and its payload an IPv4 packet
   if (frame.header.dst == ethernet_address_ && frame.header.type == EthernetHeader::TYPE_IPv4) {
     InternetDatagram dgram;
     if (parse(dgram, frame.payload)) {
-      res = dgram;
+      res = std::move(dgram);
+    } else {
+      count_drop(DropReason::BadChecksum, wire_length(frame));
     }
+    PROFILE_LAP(timer, Parse);
   } else if ((frame.header.dst == ethernet_address_ && frame.header.type == EthernetHeader::TYPE_ARP) || 
               (frame.header.dst == ETHERNET_BROADCAST && frame.header.type == EthernetHeader::TYPE_ARP)){
     // If this packet is destined to this machine and its payload an ARP packet
     ARPMessage arp_message;
-    if (parse(arp_message, frame.payload)) {
+    if (!parse(arp_message, frame.payload)) {
+      count_drop(DropReason::BadChecksum, wire_length(frame));
+    } else {
+      stats_->count(arp_message.opcode == ARPMessage::OPCODE_REQUEST ? InterfaceCounter::ArpRequestsReceived
+                                                                     : InterfaceCounter::ArpRepliesReceived);
       // learn the mapping between the packet’s Sender IP address and its MAC address and cache this in the ARP cache table
       uint32_t sender_ip = arp_message.sender_ip_address;
       const EthernetAddress sender_mac_addr = arp_message.sender_ethernet_address;
-      Ether_Addr_Entry sender_ether_addr_entry = Ether_Addr_Entry{arp_message.sender_ethernet_address, curr_time};
-      ARP_table[sender_ip] = sender_ether_addr_entry;
+      learn_mapping(sender_ip, sender_mac_addr);
 
       // if it is an ARP request that asks for our IP address, reply back to it.
       if (arp_message.opcode == ARPMessage::OPCODE_REQUEST && ip_address_.ipv4_numeric() == arp_message.target_ip_address) {
@@ -139,7 +180,9 @@ optional<InternetDatagram> NetworkInterface::recv_frame( const EthernetFrame& fr
                                                             EthernetHeader::TYPE_ARP, serialize(ARP_reply_message));
 
         // put it in the ready-to-be-sent queue
-        ready2_sent_q.push(ARP_reply_frame); 
+        if (enqueue_ready(std::move(ARP_reply_frame))) {
+          stats_->count(InterfaceCounter::ArpRepliesSent);
+        }
       } else if (arp_message.opcode == ARPMessage::OPCODE_REPLY && ip_address_.ipv4_numeric() == arp_message.target_ip_address) {
         // if it is an ARP reply message, then update the waiting queue according to the ARP reply message
         //  Idea to remove element from queue is from ChatGPT
@@ -153,15 +196,27 @@ optional<InternetDatagram> NetworkInterface::recv_frame( const EthernetFrame& fr
             // Update the Ipv4 packet and move it from waiting queue to the ready-to-be-sent queue
             EthernetFrame curr_frame = curr_first.waiting_frame;
             curr_frame.header.dst = sender_mac_addr;
-            ready2_sent_q.push(curr_frame);
+            release_memory(MemoryPool::WaitingQueue, footprint(curr_first));
+            charge_memory(MemoryPool::ReadyQueue, footprint(curr_frame));
+            stats_->arp_wait_ms.record(curr_time_ - curr_first.time);
+            ready2_sent_q.push(Ready_Frame{curr_frame, curr_first.origin_ns});
+          } else {
+            // the pending ARP request has been answered
+            release_memory(MemoryPool::WaitingQueue, footprint(curr_first));
           }
           waiting_q.pop();
         }
         // update the waiting queue
         waiting_q = temp_q;
+        // the request is no longer outstanding
+        forget_request(sender_ip);
       }
     }
+    PROFILE_LAP(timer, Arp);
     return res;
+  } else {
+    // addressed to someone else, or a type we do not handle
+    count_drop(DropReason::NotForUs, wire_length(frame));
   }
   return res;
 }
@@ -170,46 +225,66 @@ optional<InternetDatagram> NetworkInterface::recv_frame( const EthernetFrame& fr
 // ms_since_last_tick: the number of milliseconds since the last call to this method
 void NetworkInterface::tick( const size_t ms_since_last_tick )
 {
+  const uint64_t start_ns = monotonic_ns();
+
   // Update current time
-  curr_time += ms_since_last_tick;
-  std::queue<uint32_t> expired_ip = queue<uint32_t>();
+  curr_time_ += ms_since_last_tick;
   // Expire any entry in ARP cache table that was learnt more than 30 seconds ago
-  for(auto it = ARP_table.begin(); it != ARP_table.end(); it++) {
-    if (curr_time - it->second.caching_time > NetworkInterface::MAX_CACHE_TIME) {
-      uint32_t this_ip = it->first;
-      expired_ip.push(this_ip);
+  for(auto it = ARP_table.begin(); it != ARP_table.end();) {
+    if (curr_time_ - it->second.caching_time > NetworkInterface::MAX_CACHE_TIME) {
+      it = ARP_table.erase(it);
+      release_memory(MemoryPool::ArpTable, map_node_footprint<uint32_t, Ether_Addr_Entry>());
+    } else {
+      ++it;
     }
   }
-  // Update ARP_table accordingly
-  while(!expired_ip.empty()) {
-    uint32_t discard_ip = expired_ip.front();
-    ARP_table.erase(discard_ip);
-    expired_ip.pop();
-  }
+  stats_->arp_entries.store(ARP_table.size(), memory_order_relaxed);
 
-  // update the waiting queue
-  std::queue<Waiting_Packet> temp_q = std::queue<Waiting_Packet>();
-  while(!waiting_q.empty()) {
-    Waiting_Packet curr_first = waiting_q.front();
+  // update the waiting queue: visit each packet once, moving those we keep to the back
+  for (size_t remaining = waiting_q.size(); remaining > 0; remaining--) {
+    Waiting_Packet curr_first = std::move(waiting_q.front());
+    waiting_q.pop();
     uint16_t first_frame_type = curr_first.waiting_frame.header.type;
     uint32_t first_ip = curr_first.dst_ip;
-    size_t ARP_caching_time = request_history[first_ip];
-    if (curr_time - ARP_caching_time >= NetworkInterface::MAX_WAITING_TIME && 
+    auto request = request_history.find(first_ip);
+    size_t ARP_caching_time = (request != request_history.end()) ? request->second : 0;
+    if (curr_time_ - ARP_caching_time >= NetworkInterface::MAX_WAITING_TIME && 
         first_frame_type == EthernetHeader::TYPE_ARP &&
         curr_first.waiting_frame.header.dst == ETHERNET_BROADCAST) {
       // update request time to the new current calue
-      request_history[first_ip] = curr_time;
+      note_request(first_ip);
+      stats_->count(InterfaceCounter::ArpRequestsSent);
       // Move the ARP request to the ready-to-be-sent queue; otherwise, there will be no ARP request to get the MAC addr
       EthernetFrame resend_ARP_request_packet = curr_first.waiting_frame;
-      ready2_sent_q.push(resend_ARP_request_packet);
+      release_memory(MemoryPool::WaitingQueue, footprint(curr_first));
+      charge_memory(MemoryPool::ReadyQueue, footprint(resend_ARP_request_packet));
+      ready2_sent_q.push(Ready_Frame{resend_ARP_request_packet, 0});
+    } else if (first_frame_type == EthernetHeader::TYPE_IPv4 &&
+               curr_time_ - curr_first.time >= NetworkInterface::MAX_PENDING_TIME) {
+      // the next hop never answered; give up on the datagram
+      release_memory(MemoryPool::WaitingQueue, footprint(curr_first));
+      count_drop(DropReason::ArpTimeout, first_ip);
     } else if ((curr_first.waiting_frame.header.type == EthernetHeader::TYPE_IPv4) || 
-              (curr_time - curr_first.time < NetworkInterface::MAX_WAITING_TIME)) {
-      temp_q.push(curr_first);
+              (curr_time_ - curr_first.time < NetworkInterface::MAX_WAITING_TIME)) {
+      // Only keep the Waiting_Packet without MAC address and the Waiting_Packet with valid ARP message
+      waiting_q.push(std::move(curr_first));
+    } else {
+      release_memory(MemoryPool::WaitingQueue, footprint(curr_first));
+    }
+  }
+
+  // With nothing pending, requests older than the waiting time behave exactly like requests never sent
+  if (waiting_q.empty()) {
+    for (auto it = request_history.begin(); it != request_history.end();) {
+      if (curr_time_ - it->second >= NetworkInterface::MAX_WAITING_TIME) {
+        it = forget_request(it);
+      } else {
+        ++it;
+      }
     }
-    waiting_q.pop();
   }
-  // Only keep the Waiting_Packet without MAC address and the Waiting_Packet with valid ARP message
-  waiting_q = temp_q;
+
+  stats_->tick_ns.record(monotonic_ns() - start_ns);
 }
 
 
@@ -218,10 +293,186 @@ optional<EthernetFrame> NetworkInterface::maybe_send()
   // Check if ready-to-be-sent queue is empty
   if (!ready2_sent_q.empty()) {
     // send out the first element in the ready-to-be-sent queue
-    EthernetFrame first_frame = ready2_sent_q.front();
+    EthernetFrame first_frame = std::move(ready2_sent_q.front().frame);
+    const uint64_t origin_ns = ready2_sent_q.front().origin_ns;
+    release_memory(MemoryPool::ReadyQueue, footprint(first_frame));
     ready2_sent_q.pop();
+    stats_->count(InterfaceCounter::TxPackets);
+    stats_->count(InterfaceCounter::TxBytes, wire_length(first_frame));
+    PACKET_TRACE(Tx, trace_id_, 0, wire_length(first_frame));
+    if (origin_ns) {
+      stats_->forwarding_ns.record(monotonic_ns() - origin_ns);
+    }
+    if (capturing_) [[unlikely]] {
+      capture_->capture(first_frame, CaptureDirection::Outbound);
+    }
     return first_frame;
   } else {
     return nullopt;
   }
 }
+
+void NetworkInterface::start_capture( CaptureFilter filter, const size_t frames, const size_t snaplen )
+{
+  capture_ = make_shared<PacketCapture>( filter, frames, snaplen );
+  capturing_ = true;
+}
+
+void NetworkInterface::count_drop( const DropReason reason, [[maybe_unused]] const uint32_t value )
+{
+  stats_->count_drop( reason );
+  PACKET_TRACE( Drop, trace_id_, reason, value );
+}
+
+void NetworkInterface::set_memory_budget( const size_t bytes, const DropPolicy policy )
+{
+  memory_.set_limit( bytes );
+  drop_policy_ = policy;
+}
+
+void NetworkInterface::attach_memory_budget( shared_ptr<MemoryBudget> shared )
+{
+  if ( shared_memory_ ) {
+    shared_memory_->release( memory_.usage().current );
+  }
+  shared_memory_ = std::move( shared );
+  if ( shared_memory_ ) {
+    shared_memory_->charge( memory_.usage().current );
+  }
+}
+
+size_t NetworkInterface::footprint( const EthernetFrame& frame )
+{
+  return sizeof( Ready_Frame ) + memory_footprint( frame.payload );
+}
+
+size_t NetworkInterface::footprint( const Waiting_Packet& packet )
+{
+  return sizeof( Waiting_Packet ) + memory_footprint( packet.waiting_frame.payload );
+}
+
+size_t NetworkInterface::footprint( const InternetDatagram& dgram )
+{
+  return sizeof( InternetDatagram ) + memory_footprint( dgram.payload );
+}
+
+bool NetworkInterface::fits_memory( const size_t bytes ) const
+{
+  return memory_.fits( bytes ) and ( not shared_memory_ or shared_memory_->fits( bytes ) );
+}
+
+bool NetworkInterface::make_room( const size_t bytes )
+{
+  // Oldest first: frames stuck behind ARP have waited longest, then frames not yet handed to maybe_send()
+  while ( not fits_memory( bytes ) and drop_policy_ == DropPolicy::DropOldest ) {
+    if ( not waiting_q.empty() ) {
+      release_memory( MemoryPool::WaitingQueue, footprint( waiting_q.front() ) );
+      waiting_q.pop();
+    } else if ( not ready2_sent_q.empty() ) {
+      release_memory( MemoryPool::ReadyQueue, footprint( ready2_sent_q.front().frame ) );
+      ready2_sent_q.pop();
+    } else {
+      break;
+    }
+    count_drop( DropReason::QueueFull );
+  }
+  return fits_memory( bytes );
+}
+
+void NetworkInterface::charge_memory( const MemoryPool pool, const size_t bytes )
+{
+  memory_.charge( bytes );
+  if ( shared_memory_ ) {
+    shared_memory_->charge( bytes );
+  }
+  auto& usage = pool_usage_.at( static_cast<size_t>( pool ) );
+  usage.current += bytes;
+  usage.peak = max( usage.peak, usage.current );
+  stats_->memory_bytes.store( memory_.usage().current, memory_order_relaxed );
+}
+
+bool NetworkInterface::reserve_memory( const MemoryPool pool, const size_t bytes )
+{
+  if ( not make_room( bytes ) ) {
+    count_drop( DropReason::QueueFull, bytes );
+    return false;
+  }
+  charge_memory( pool, bytes );
+  return true;
+}
+
+void NetworkInterface::release_memory( const MemoryPool pool, const size_t bytes )
+{
+  memory_.release( bytes );
+  if ( shared_memory_ ) {
+    shared_memory_->release( bytes );
+  }
+  auto& usage = pool_usage_.at( static_cast<size_t>( pool ) );
+  usage.current -= min( bytes, usage.current );
+  stats_->memory_bytes.store( memory_.usage().current, memory_order_relaxed );
+}
+
+bool NetworkInterface::enqueue_ready( EthernetFrame frame, const uint64_t origin_ns )
+{
+  if ( not reserve_memory( MemoryPool::ReadyQueue, footprint( frame ) ) ) {
+    return false;
+  }
+  PACKET_TRACE( Enqueue, trace_id_, MemoryPool::ReadyQueue, wire_length( frame ) );
+  ready2_sent_q.push( Ready_Frame { std::move( frame ), origin_ns } );
+  return true;
+}
+
+bool NetworkInterface::enqueue_waiting( Waiting_Packet packet )
+{
+  if ( not reserve_memory( MemoryPool::WaitingQueue, footprint( packet ) ) ) {
+    return false;
+  }
+  PACKET_TRACE( Enqueue, trace_id_, MemoryPool::WaitingQueue, wire_length( packet.waiting_frame ) );
+  waiting_q.push( std::move( packet ) );
+  return true;
+}
+
+void NetworkInterface::learn_mapping( const uint32_t ip, const EthernetAddress& mac )
+{
+  auto entry = ARP_table.find( ip );
+  if ( entry != ARP_table.end() ) {
+    entry->second = Ether_Addr_Entry { mac, curr_time_ };
+    return;
+  }
+
+  // A fresh mapping is worth more than the stalest one, which is also the cheapest to re-learn. Only if
+  // there is none left to evict does the mapping cost queued frames (under DropOldest): the datagrams waiting
+  // for this very mapping are among them.
+  constexpr size_t entry_bytes = map_node_footprint<uint32_t, Ether_Addr_Entry>();
+  while ( not fits_memory( entry_bytes ) and not ARP_table.empty() ) {
+    ARP_table.erase( ranges::min_element(
+      ARP_table, {}, []( const auto& mapping ) { return mapping.second.caching_time; } ) );
+    release_memory( MemoryPool::ArpTable, entry_bytes );
+  }
+  if ( not reserve_memory( MemoryPool::ArpTable, entry_bytes ) ) {
+    stats_->arp_entries.store( ARP_table.size(), memory_order_relaxed );
+    return;
+  }
+  ARP_table.emplace( ip, Ether_Addr_Entry { mac, curr_time_ } );
+  stats_->arp_entries.store( ARP_table.size(), memory_order_relaxed );
+}
+
+void NetworkInterface::note_request( const uint32_t ip )
+{
+  if ( request_history.insert_or_assign( ip, curr_time_ ).second ) {
+    charge_memory( MemoryPool::RequestHistory, map_node_footprint<uint32_t, size_t>() );
+  }
+}
+
+void NetworkInterface::forget_request( const uint32_t ip )
+{
+  if ( request_history.erase( ip ) ) {
+    release_memory( MemoryPool::RequestHistory, map_node_footprint<uint32_t, size_t>() );
+  }
+}
+
+map<uint32_t, size_t>::iterator NetworkInterface::forget_request( map<uint32_t, size_t>::iterator request )
+{
+  release_memory( MemoryPool::RequestHistory, map_node_footprint<uint32_t, size_t>() );
+  return request_history.erase( request );
+}
@@ -2,9 +2,13 @@
 
 #include "address.hh"
 #include "ethernet_frame.hh"
+#include "interface_stats.hh"
 #include "ipv4_datagram.hh"
 #include "arp_message.hh"
+#include "memory_budget.hh"
+#include "packet_capture.hh"
 
+#include <array>
 #include <iostream>
 #include <list>
 #include <optional>
@@ -12,9 +16,21 @@
 #include <unordered_map>
 #include <utility>
 #include <map>
+#include <memory>
 
 using namespace std;
 
+// The queues and tables whose memory a NetworkInterface accounts for
+enum class MemoryPool : uint8_t
+{
+  ReadyQueue,     // frames waiting for maybe_send()
+  WaitingQueue,   // frames waiting for an ARP reply
+  ReceiveQueue,   // received datagrams waiting for the owner (AsyncNetworkInterface)
+  ArpTable,       // learned IP-to-Ethernet mappings
+  RequestHistory, // outstanding ARP requests
+  COUNT
+};
+
 // A "network interface" that connects IP (the internet layer, or network layer)
 // with Ethernet (the network access layer, or link layer).
 
@@ -45,6 +61,12 @@ private:
   // The maximum time that the pending ARP reply wait for any next hop IP that was sent
   size_t MAX_WAITING_TIME = 5000;
 
+  // The maximum time that a datagram waits for its next hop's Ethernet address before it is dropped
+  size_t MAX_PENDING_TIME = 15000;
+
+  // Milliseconds passed to tick() so far: this interface's own clock
+  size_t curr_time_ = 0;
+
   // Ethernet (known as hardware, network-access, or link-layer) address of the interface
   EthernetAddress ethernet_address_;
 
@@ -59,13 +81,19 @@ private:
   // The ARP Table that stores IP address and corresponding MAC address (<IP, Ether_Addr_Entry>)
   std::map<uint32_t, Ether_Addr_Entry> ARP_table = std::map<uint32_t, Ether_Addr_Entry>();
 
+  struct Ready_Frame {
+      EthernetFrame frame;
+      uint64_t origin_ns;  // when a forwarded datagram arrived at the router (0 if not forwarded)
+  };
+
   // ready-to-be-sent queue
-  std::queue<EthernetFrame> ready2_sent_q = std::queue<EthernetFrame>();
+  std::queue<Ready_Frame> ready2_sent_q = std::queue<Ready_Frame>();
 
   struct Waiting_Packet {
       uint32_t dst_ip;  // next_hop_ip that currently dont have MAC addr
       EthernetFrame waiting_frame;  // the EthernetFrame
       size_t time;  // the time that this waiting packet is created
+      uint64_t origin_ns;  // when a forwarded datagram arrived at the router (0 if not forwarded)
   };
 
   // waiting queue
@@ -74,6 +102,47 @@ private:
   // ARP Request Map that used to check if and when an APR request is sent
   std::map<uint32_t, size_t> request_history = std::map<uint32_t, size_t>();
 
+  // Per-pool byte usage, this interface's own budget, and (once added to a Router) the router-wide budget
+  std::array<MemoryUsage, static_cast<size_t>( MemoryPool::COUNT )> pool_usage_ {};
+  MemoryBudget memory_ {};
+  DropPolicy drop_policy_ = DropPolicy::DropNewest;
+  std::shared_ptr<MemoryBudget> shared_memory_ {};
+
+  // Packet, byte, ARP and drop counters (shared so that other threads can keep reading them)
+  std::shared_ptr<InterfaceStats> stats_ = std::make_shared<InterfaceStats>();
+
+  // Identifies this interface in packet trace events (see packet_trace.hh)
+  uint16_t trace_id_ {};
+
+  // Frames copied from recv_frame() and maybe_send() while capturing (the ring outlives stop_capture())
+  std::shared_ptr<PacketCapture> capture_ {};
+  bool capturing_ = false;
+
+  static size_t footprint( const EthernetFrame& frame );
+  static size_t footprint( const Waiting_Packet& packet );
+
+  // Would `bytes` more fit within this interface's budget and the shared budget?
+  bool fits_memory( size_t bytes ) const;
+
+  // Shed load according to drop_policy_ until `bytes` more fit; returns false if they still do not
+  bool make_room( size_t bytes );
+
+  // Charge bytes to a pool without checking the budgets (for memory that is moved, not admitted)
+  void charge_memory( MemoryPool pool, size_t bytes );
+
+  // Queue a frame (or a frame waiting on ARP) if the budget allows; otherwise count a drop. Both return
+  // whether the frame was queued.
+  bool enqueue_ready( EthernetFrame frame, uint64_t origin_ns = 0 );
+  bool enqueue_waiting( Waiting_Packet packet );
+
+  // Insert or refresh an ARP table entry, evicting the stalest entries if the budget requires
+  void learn_mapping( uint32_t ip, const EthernetAddress& mac );
+
+  // Record (or refresh) an outstanding ARP request, or remove one that has been answered or gone stale
+  void note_request( uint32_t ip );
+  void forget_request( uint32_t ip );
+  std::map<uint32_t, size_t>::iterator forget_request( std::map<uint32_t, size_t>::iterator request );
+
   // return a ARP message according to 5 parameters
   ARPMessage make_arp_message(const EthernetAddress sender_ethernet_address, const uint32_t& sender_ip_address, 
                               const EthernetAddress target_ethernet_address, const uint32_t& target_ip_address, 
@@ -100,6 +169,11 @@ public:
   // but please consider the frame sent as soon as it is generated.)
   void send_datagram( const InternetDatagram& dgram, const Address& next_hop );
 
+  // Same, for a datagram being forwarded that arrived at `origin_ns` (see monotonic_ns()); its forwarding
+  // latency is recorded when the frame carrying it leaves maybe_send(). Returns whether the memory budget let
+  // the datagram be queued (to leave, or to wait for ARP).
+  bool send_datagram( const InternetDatagram& dgram, const Address& next_hop, uint64_t origin_ns );
+
   // Receives an Ethernet frame and responds appropriately.
   // If type is IPv4, returns the datagram.
   // If type is ARP request, learn a mapping from the "sender" fields, and send an ARP reply.
@@ -108,4 +182,56 @@ public:
 
   // Called periodically when time elapses
   void tick( size_t ms_since_last_tick );
+
+  // Limit the bytes this interface may hold in its queues and tables (0 = unlimited).
+  // When a new packet would exceed the limit, `policy` decides which packet is dropped.
+  void set_memory_budget( size_t bytes, DropPolicy policy = DropPolicy::DropNewest );
+
+  // Charge this interface's memory against a budget shared with other interfaces (e.g. router-wide)
+  void attach_memory_budget( std::shared_ptr<MemoryBudget> shared );
+
+  // Current and peak bytes held, in total or by one pool
+  MemoryUsage memory_usage() const { return memory_.usage(); }
+  MemoryUsage memory_usage( MemoryPool pool ) const { return pool_usage_.at( static_cast<size_t>( pool ) ); }
+
+  // Number of packets refused or evicted, or new ARP mappings refused, because a memory budget was exhausted
+  // (a stale mapping evicted to make room for a new one is not counted)
+  uint64_t memory_drops() const { return stats_->drops( DropReason::QueueFull ); }
+
+  // Counters for this interface; a Router also counts its forwarding decisions here
+  InterfaceStats& stats() { return *stats_; }
+  const InterfaceStats& stats() const { return *stats_; }
+
+  // A handle on the counters that stays valid (and readable from any thread) even if the interface goes away
+  std::shared_ptr<const InterfaceStats> stats_handle() const { return stats_; }
+
+  // Count (and trace) a dropped packet; `value` is recorded in the trace event
+  void count_drop( DropReason reason, uint32_t value = 0 );
+
+  // Set the interface number recorded in packet trace events (a Router uses the interface's index)
+  void set_trace_id( uint16_t id ) { trace_id_ = id; }
+  uint16_t trace_id() const { return trace_id_; }
+
+  // Copy frames arriving at recv_frame() and leaving maybe_send() that match `filter` into a new ring of
+  // `frames` frames of up to `snaplen` bytes each. Until then, and after stop_capture(), the tap costs one
+  // branch per frame.
+  void start_capture( CaptureFilter filter = {},
+                      size_t frames = PacketCapture::default_frames,
+                      size_t snaplen = PacketCapture::default_snaplen );
+  void stop_capture() { capturing_ = false; }
+  bool capturing() const { return capturing_; }
+
+  // The most recent capture (null if none was started), e.g. to write it out with write_pcap()
+  std::shared_ptr<const PacketCapture> packet_capture() const { return capture_; }
+
+protected:
+  // Bytes held by a received datagram
+  static size_t footprint( const InternetDatagram& dgram );
+
+  // Charge `bytes` to `pool` if they fit within the budgets (making room per the drop policy);
+  // returns false, and counts a drop, if they do not
+  bool reserve_memory( MemoryPool pool, size_t bytes );
+
+  // Return bytes previously charged to `pool`
+  void release_memory( MemoryPool pool, size_t bytes );
 };
@@ -0,0 +1,273 @@
+#include "packet_capture.hh"
+
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "histogram.hh"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t pcap_magic_ns = 0xa1b23c4d; // pcap with nanosecond timestamps
+constexpr uint32_t pcap_magic_us = 0xa1b2c3d4; // ...and with microsecond timestamps
+constexpr size_t pcap_file_header_length = 24;
+constexpr size_t pcap_record_header_length = 16;
+constexpr uint32_t linktype_ethernet = 1;
+
+constexpr uint32_t pcapng_section_header = 0x0a0d0d0a;
+constexpr uint32_t pcapng_interface_description = 1;
+constexpr uint32_t pcapng_enhanced_packet = 6;
+constexpr uint32_t pcapng_byte_order_magic = 0x1a2b3c4d;
+constexpr uint16_t pcapng_if_tsresol = 9;
+constexpr uint16_t pcapng_epb_flags = 2;
+
+uint32_t read_be32( const char* bytes )
+{
+  uint32_t value = 0;
+  for ( size_t i = 0; i < 4; i++ ) {
+    value = value << 8 | static_cast<uint8_t>( bytes[i] );
+  }
+  return value;
+}
+
+// Capture files are written in host byte order (their magic numbers let readers tell which)
+template<class T>
+void put( ostream& out, T value )
+{
+  out.write( reinterpret_cast<const char*>( &value ), sizeof( value ) ); // NOLINT(*-reinterpret-cast)
+}
+
+void pad_to_word( ostream& out, size_t length )
+{
+  static constexpr array<char, 4> zeros {};
+  out.write( zeros.data(), static_cast<streamsize>( ( 4 - length % 4 ) % 4 ) );
+}
+
+// A 32-bit field of a capture file, in the file's byte order
+uint32_t read_u32( const char* bytes, bool swapped )
+{
+  uint32_t value = 0;
+  memcpy( &value, bytes, sizeof( value ) );
+  return swapped ? __builtin_bswap32( value ) : value;
+}
+
+size_t padded( size_t length )
+{
+  return ( length + 3 ) & ~size_t { 3 };
+}
+
+} // namespace
+
+bool CaptureFilter::matches( const EthernetFrame& frame ) const
+{
+  if ( ethertype.has_value() and frame.header.type != *ethertype ) {
+    return false;
+  }
+  if ( not ip_prefix.has_value() ) {
+    return true;
+  }
+
+  // The addresses' offsets in an IPv4 header (source, destination) and an ARP message (sender, target)
+  size_t first = 0;
+  size_t second = 0;
+  if ( frame.header.type == EthernetHeader::TYPE_IPv4 ) {
+    first = 12;
+    second = 16;
+  } else if ( frame.header.type == EthernetHeader::TYPE_ARP ) {
+    first = 14;
+    second = 24;
+  } else {
+    return false;
+  }
+  if ( frame.payload.empty() or frame.payload.front().size() < second + 4 ) {
+    return false; // addresses not in the first buffer: a payload this router did not build or parse
+  }
+
+  const uint32_t mask = prefix_length == 0 ? 0 : ~uint32_t { 0 } << ( 32 - min<uint8_t>( prefix_length, 32 ) );
+  const char* header = string_view { frame.payload.front() }.data();
+  return ( ( read_be32( header + first ) ^ *ip_prefix ) & mask ) == 0
+         or ( ( read_be32( header + second ) ^ *ip_prefix ) & mask ) == 0;
+}
+
+PacketCapture::PacketCapture( CaptureFilter filter, size_t frames, size_t snaplen )
+  : filter_( filter )
+  , frames_( frames )
+  , snaplen_( snaplen )
+  , slots_( frames )
+  , data_( frames * snaplen )
+  , realtime_offset_ns_( chrono::duration_cast<chrono::nanoseconds>(
+                           chrono::system_clock::now().time_since_epoch() )
+                           .count()
+                         - static_cast<int64_t>( monotonic_ns() ) )
+{
+  if ( frames_ == 0 or snaplen_ < EthernetHeader::LENGTH ) {
+    throw runtime_error( "PacketCapture needs at least one frame of at least an Ethernet header" );
+  }
+}
+
+void PacketCapture::capture( const EthernetFrame& frame, CaptureDirection direction )
+{
+  if ( not filter_.matches( frame ) ) {
+    return;
+  }
+
+  Slot& slot = slots_[next_ % frames_];
+  char* out = &data_[( next_ % frames_ ) * snaplen_];
+  next_++;
+
+  // the header, as it goes on the wire...
+  memcpy( out, frame.header.dst.data(), frame.header.dst.size() );
+  memcpy( out + 6, frame.header.src.data(), frame.header.src.size() );
+  out[12] = static_cast<char>( frame.header.type >> 8 );
+  out[13] = static_cast<char>( frame.header.type & 0xff );
+  size_t length = EthernetHeader::LENGTH;
+  size_t copied = EthernetHeader::LENGTH;
+
+  // ...then as much of the payload as fits
+  for ( const auto& buffer : frame.payload ) {
+    const size_t n = min( buffer.size(), snaplen_ - copied );
+    memcpy( out + copied, string_view { buffer }.data(), n );
+    copied += n;
+    length += buffer.size();
+  }
+
+  slot = { monotonic_ns(), static_cast<uint32_t>( length ), static_cast<uint32_t>( copied ), direction };
+}
+
+template<class Visitor>
+void PacketCapture::for_each( Visitor&& visit ) const
+{
+  const uint64_t count = min<uint64_t>( next_, frames_ );
+  for ( uint64_t i = next_ - count; i < next_; i++ ) {
+    visit( slots_[i % frames_], &data_[( i % frames_ ) * snaplen_] );
+  }
+}
+
+void PacketCapture::write_pcap( ostream& out ) const
+{
+  put<uint32_t>( out, pcap_magic_ns );
+  put<uint16_t>( out, 2 ); // version 2.4
+  put<uint16_t>( out, 4 );
+  put<int32_t>( out, 0 );  // timestamps are UTC
+  put<uint32_t>( out, 0 ); // accuracy
+  put<uint32_t>( out, snaplen_ );
+  put<uint32_t>( out, linktype_ethernet );
+
+  for_each( [&]( const Slot& slot, const char* bytes ) {
+    const uint64_t time = slot.timestamp_ns + realtime_offset_ns_;
+    put<uint32_t>( out, time / 1'000'000'000 );
+    put<uint32_t>( out, time % 1'000'000'000 );
+    put<uint32_t>( out, slot.captured_length );
+    put<uint32_t>( out, slot.original_length );
+    out.write( bytes, slot.captured_length );
+  } );
+}
+
+void PacketCapture::write_pcapng( ostream& out ) const
+{
+  // Section Header Block: no options, section length unknown
+  constexpr uint32_t shb_length = 28;
+  put<uint32_t>( out, pcapng_section_header );
+  put<uint32_t>( out, shb_length );
+  put<uint32_t>( out, pcapng_byte_order_magic );
+  put<uint16_t>( out, 1 ); // version 1.0
+  put<uint16_t>( out, 0 );
+  put<int64_t>( out, -1 );
+  put<uint32_t>( out, shb_length );
+
+  // Interface Description Block, with nanosecond timestamps (if_tsresol = 9)
+  constexpr uint32_t idb_length = 32;
+  put<uint32_t>( out, pcapng_interface_description );
+  put<uint32_t>( out, idb_length );
+  put<uint16_t>( out, linktype_ethernet );
+  put<uint16_t>( out, 0 ); // reserved
+  put<uint32_t>( out, snaplen_ );
+  put<uint16_t>( out, pcapng_if_tsresol );
+  put<uint16_t>( out, 1 );
+  put<uint8_t>( out, 9 ); // the option's one byte, then padding
+  pad_to_word( out, 1 );
+  put<uint32_t>( out, 0 ); // opt_endofopt
+  put<uint32_t>( out, idb_length );
+
+  // One Enhanced Packet Block per frame, with its direction in epb_flags (1 = inbound, 2 = outbound)
+  for_each( [&]( const Slot& slot, const char* bytes ) {
+    const uint32_t length = 32 + padded( slot.captured_length ) + 12;
+    const uint64_t time = slot.timestamp_ns + realtime_offset_ns_;
+    put<uint32_t>( out, pcapng_enhanced_packet );
+    put<uint32_t>( out, length );
+    put<uint32_t>( out, 0 ); // interface
+    put<uint32_t>( out, time >> 32 );
+    put<uint32_t>( out, time & 0xffffffff );
+    put<uint32_t>( out, slot.captured_length );
+    put<uint32_t>( out, slot.original_length );
+    out.write( bytes, slot.captured_length );
+    pad_to_word( out, slot.captured_length );
+    put<uint16_t>( out, pcapng_epb_flags );
+    put<uint16_t>( out, 4 );
+    put<uint32_t>( out, slot.direction == CaptureDirection::Inbound ? 1 : 2 );
+    put<uint32_t>( out, 0 ); // opt_endofopt
+    put<uint32_t>( out, length );
+  } );
+}
+
+PcapFile::PcapFile( const string& path )
+{
+  FileDescriptor file { CheckSystemCall( "open " + path, ::open( path.c_str(), O_RDONLY | O_CLOEXEC ) ) }; // NOLINT
+  length_ = static_cast<size_t>( CheckSystemCall( "lseek", ::lseek( file.fd_num(), 0, SEEK_END ) ) );
+  if ( length_ < pcap_file_header_length ) {
+    throw runtime_error( path + ": too short for a pcap file" );
+  }
+  void* mapping = ::mmap( nullptr, length_, PROT_READ, MAP_PRIVATE, file.fd_num(), 0 );
+  if ( mapping == MAP_FAILED ) {
+    throw unix_error( "mmap " + path );
+  }
+  data_ = static_cast<const char*>( mapping );
+  ::madvise( mapping, length_, MADV_SEQUENTIAL );
+
+  try {
+    const uint32_t magic = read_u32( data_, false );
+    const bool swapped = magic == __builtin_bswap32( pcap_magic_ns ) or magic == __builtin_bswap32( pcap_magic_us );
+    const uint32_t native_magic = swapped ? __builtin_bswap32( magic ) : magic;
+    if ( native_magic != pcap_magic_ns and native_magic != pcap_magic_us ) {
+      throw runtime_error( path + ": not a pcap file (pcapng is not supported)" );
+    }
+    const uint64_t ns_per_unit = native_magic == pcap_magic_ns ? 1 : 1000;
+    snaplen_ = read_u32( data_ + 16, swapped );
+    if ( ( read_u32( data_ + 20, swapped ) & 0xffff ) != linktype_ethernet ) {
+      throw runtime_error( path + ": link type is not Ethernet" );
+    }
+
+    for ( size_t offset = pcap_file_header_length; offset < length_; ) {
+      if ( length_ - offset < pcap_record_header_length ) {
+        throw runtime_error( path + ": truncated record header" );
+      }
+      const char* header = data_ + offset;
+      const uint32_t captured = read_u32( header + 8, swapped );
+      offset += pcap_record_header_length;
+      if ( length_ - offset < captured ) {
+        throw runtime_error( path + ": truncated frame" );
+      }
+      frames_.push_back( { uint64_t { read_u32( header, swapped ) } * 1'000'000'000
+                             + uint64_t { read_u32( header + 4, swapped ) } * ns_per_unit,
+                           read_u32( header + 12, swapped ),
+                           { data_ + offset, captured } } );
+      offset += captured;
+    }
+  } catch ( ... ) {
+    ::munmap( const_cast<char*>( data_ ), length_ ); // NOLINT(*-const-cast)
+    throw;
+  }
+}
+
+PcapFile::~PcapFile()
+{
+  ::munmap( const_cast<char*>( data_ ), length_ ); // NOLINT(*-const-cast)
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "ethernet_frame.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Which way a captured frame was going
+enum class CaptureDirection : uint8_t
+{
+  Inbound,  // arriving at recv_frame()
+  Outbound, // leaving maybe_send()
+};
+
+// Which frames a capture keeps. An empty filter keeps everything.
+struct CaptureFilter
+{
+  std::optional<uint16_t> ethertype {}; // e.g. EthernetHeader::TYPE_ARP
+
+  // Keep only IPv4 datagrams whose source or destination (or ARP messages whose sender or target)
+  // is within ip_prefix/prefix_length
+  std::optional<uint32_t> ip_prefix {};
+  uint8_t prefix_length {};
+
+  bool matches( const EthernetFrame& frame ) const;
+};
+
+// A fixed ring of the most recent frames matching a filter, each truncated to `snaplen` bytes, that can be
+// written out as a pcap or pcapng file. All memory is allocated up front: capturing a frame only copies it.
+//
+// Not thread-safe: capture and write from the thread that drives the interface (or after it stops).
+class PacketCapture
+{
+public:
+  static constexpr size_t default_frames = 4096;
+  static constexpr size_t default_snaplen = 256;
+
+  explicit PacketCapture( CaptureFilter filter = {},
+                          size_t frames = default_frames,
+                          size_t snaplen = default_snaplen );
+
+  // Copy `frame` into the ring if it matches the filter, overwriting the oldest frame if the ring is full
+  void capture( const EthernetFrame& frame, CaptureDirection direction );
+
+  // Frames ever captured (the ring holds the last min(captured(), frames()))
+  uint64_t captured() const { return next_; }
+  size_t frames() const { return frames_; }
+  size_t snaplen() const { return snaplen_; }
+
+  // Write the frames in the ring, oldest first, as a pcap file (nanosecond timestamps, Ethernet link type)...
+  void write_pcap( std::ostream& out ) const;
+
+  // ...or as a pcapng file, which also records each frame's direction
+  void write_pcapng( std::ostream& out ) const;
+
+  // Forget every captured frame
+  void clear() { next_ = 0; }
+
+private:
+  struct Slot
+  {
+    uint64_t timestamp_ns; // see monotonic_ns()
+    uint32_t original_length;
+    uint32_t captured_length;
+    CaptureDirection direction;
+  };
+
+  // Visit (slot, bytes) for each frame in the ring, oldest first
+  template<class Visitor>
+  void for_each( Visitor&& visit ) const;
+
+  CaptureFilter filter_;
+  size_t frames_;
+  size_t snaplen_;
+  std::vector<Slot> slots_;
+  std::vector<char> data_; // frames_ * snaplen_ bytes
+  uint64_t next_ {};
+
+  // Converts monotonic timestamps to wall-clock time for the file (fixed when the capture is created)
+  int64_t realtime_offset_ns_;
+};
+
+// One frame in a capture file
+struct CapturedFrame
+{
+  uint64_t timestamp_ns {}; // as recorded (wall-clock time, for files written by PacketCapture)
+  uint32_t original_length {};
+  std::string_view bytes {}; // as captured: the whole frame unless original_length is larger
+};
+
+// A pcap file (as written by PacketCapture::write_pcap(), tcpdump, etc.), mapped into memory read-only.
+// Microsecond and nanosecond timestamps and either byte order are understood; the link type must be Ethernet.
+// Throws std::runtime_error if the file is not such a pcap file or is truncated.
+class PcapFile
+{
+public:
+  explicit PcapFile( const std::string& path );
+  ~PcapFile();
+
+  // Every frame in the file, in order; the bytes point into the mapping and live as long as this object
+  const std::vector<CapturedFrame>& frames() const { return frames_; }
+  uint32_t snaplen() const { return snaplen_; }
+
+  PcapFile( const PcapFile& other ) = delete;
+  PcapFile& operator=( const PcapFile& other ) = delete;
+  PcapFile( PcapFile&& other ) = delete;
+  PcapFile& operator=( PcapFile&& other ) = delete;
+
+private:
+  const char* data_ {};
+  size_t length_ {};
+  uint32_t snaplen_ {};
+  std::vector<CapturedFrame> frames_ {};
+};
@@ -0,0 +1,235 @@
+#include "packet_ring_driver.hh"
+
+#include "exception.hh"
+
+#include <atomic>
+#include <cstring>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Where a transmitted frame starts within its slot (the kernel's default for TPACKET_V3)
+constexpr size_t tx_data_offset = TPACKET3_HDRLEN - sizeof( sockaddr_ll );
+
+// Ring headers are shared with the kernel: read their status with acquire, and hand them back with release
+uint32_t load_status( uint32_t& status )
+{
+  return atomic_ref<uint32_t>( status ).load( memory_order_acquire );
+}
+
+void store_status( uint32_t& status, uint32_t value )
+{
+  atomic_ref<uint32_t>( status ).store( value, memory_order_release );
+}
+
+tpacket_block_desc* block_at( char* ring, size_t index, size_t block_size )
+{
+  return reinterpret_cast<tpacket_block_desc*>( ring + index * block_size ); // NOLINT(*-reinterpret-cast)
+}
+
+} // namespace
+
+PacketRingDriver::PacketRingDriver( const string& device, const PacketRingOptions& options )
+  : socket_( SOCK_RAW, htons( ETH_P_ALL ) ), options_( options )
+{
+  const auto page_size = static_cast<uint32_t>( ::sysconf( _SC_PAGESIZE ) );
+  if ( options_.block_size == 0 or options_.block_size % page_size or options_.rx_blocks == 0
+       or options_.tx_blocks == 0 or options_.batch == 0 or options_.tx_frame_size % TPACKET_ALIGNMENT
+       or options_.tx_frame_size <= tx_data_offset + EthernetHeader::LENGTH
+       or options_.block_size % options_.tx_frame_size ) {
+    throw runtime_error( "PacketRingDriver: blocks must be whole pages, cut into aligned slots of at least an "
+                         "Ethernet header" );
+  }
+
+  socket_.set_packet_version( TPACKET_V3 );
+
+  // the kernel lays out received frames at any offset within a block; the frame size here only sizes the ring
+  const uint32_t frames_per_block = options_.block_size / options_.tx_frame_size;
+  tpacket_req3 rx_request {};
+  rx_request.tp_block_size = options_.block_size;
+  rx_request.tp_block_nr = options_.rx_blocks;
+  rx_request.tp_frame_size = options_.tx_frame_size;
+  rx_request.tp_frame_nr = frames_per_block * options_.rx_blocks;
+  rx_request.tp_retire_blk_tov = options_.block_timeout_ms;
+  socket_.set_rx_ring( rx_request );
+
+  tpacket_req3 tx_request {};
+  tx_request.tp_block_size = options_.block_size;
+  tx_request.tp_block_nr = options_.tx_blocks;
+  tx_request.tp_frame_size = options_.tx_frame_size;
+  tx_request.tp_frame_nr = frames_per_block * options_.tx_blocks;
+  socket_.set_tx_ring( tx_request );
+
+  ring_length_ = static_cast<size_t>( options_.block_size ) * ( options_.rx_blocks + options_.tx_blocks );
+  void* mapping
+    = ::mmap( nullptr, ring_length_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, socket_.fd_num(), 0 );
+  if ( mapping == MAP_FAILED ) {
+    throw unix_error( "mmap packet ring" );
+  }
+  ring_ = static_cast<char*>( mapping );
+  tx_ring_ = ring_ + static_cast<size_t>( options_.block_size ) * options_.rx_blocks;
+  tx_slots_ = tx_request.tp_frame_nr;
+
+  try {
+    socket_.bind( Address::from_packet_interface( device, ETH_P_ALL ) );
+  } catch ( ... ) {
+    ::munmap( ring_, ring_length_ );
+    throw;
+  }
+}
+
+PacketRingDriver::~PacketRingDriver()
+{
+  ::munmap( ring_, ring_length_ );
+}
+
+void PacketRingDriver::release_rx_block()
+{
+  store_status( block_at( ring_, rx_block_, options_.block_size )->hdr.bh1.block_status, TP_STATUS_KERNEL );
+  rx_block_ = ( rx_block_ + 1 ) % options_.rx_blocks;
+  rx_block_open_ = false;
+}
+
+template<class Handler>
+size_t PacketRingDriver::receive_batch( Handler&& handle )
+{
+  size_t received = 0;
+  while ( received < options_.batch ) {
+    char* block = ring_ + rx_block_ * options_.block_size;
+    if ( not rx_block_open_ ) {
+      tpacket_hdr_v1& header = block_at( ring_, rx_block_, options_.block_size )->hdr.bh1;
+      if ( not( load_status( header.block_status ) & TP_STATUS_USER ) ) {
+        break; // the kernel is still filling it
+      }
+      rx_block_open_ = true;
+      rx_remaining_ = header.num_pkts;
+      rx_offset_ = header.offset_to_first_pkt;
+    }
+    if ( rx_remaining_ == 0 ) {
+      release_rx_block();
+      continue;
+    }
+
+    const char* start = block + rx_offset_;
+    const auto* packet = reinterpret_cast<const tpacket3_hdr*>( start ); // NOLINT(*-reinterpret-cast)
+    const auto* address = reinterpret_cast<const sockaddr_ll*>( // NOLINT(*-reinterpret-cast)
+      start + TPACKET_ALIGN( sizeof( tpacket3_hdr ) ) );
+    const char* bytes = start + packet->tp_mac;
+    const uint32_t length = packet->tp_snaplen;
+    rx_offset_ += packet->tp_next_offset;
+    rx_remaining_--;
+
+    if ( address->sll_pkttype == PACKET_OUTGOING ) {
+      continue; // our own (or another local socket's) transmission, seen on its way out
+    }
+    if ( packet->tp_snaplen < packet->tp_len ) {
+      stats_.truncated++;
+      continue;
+    }
+    if ( length < EthernetHeader::LENGTH ) {
+      stats_.malformed++;
+      continue;
+    }
+
+    // parse the header in place, and copy the payload out once
+    EthernetFrame frame;
+    memcpy( frame.header.dst.data(), bytes, frame.header.dst.size() );
+    memcpy( frame.header.src.data(), bytes + 6, frame.header.src.size() );
+    frame.header.type
+      = static_cast<uint16_t>( static_cast<uint8_t>( bytes[12] ) << 8 | static_cast<uint8_t>( bytes[13] ) );
+    frame.payload.emplace_back( string( bytes + EthernetHeader::LENGTH, length - EthernetHeader::LENGTH ) );
+
+    stats_.frames_received++;
+    stats_.bytes_received += length;
+    received++;
+    handle( frame );
+  }
+
+  // don't sit on a finished block until the next call
+  if ( rx_block_open_ and rx_remaining_ == 0 ) {
+    release_rx_block();
+  }
+  return received;
+}
+
+size_t PacketRingDriver::receive( AsyncNetworkInterface& interface )
+{
+  return receive_batch( [&]( const EthernetFrame& frame ) { interface.recv_frame( frame ); } );
+}
+
+size_t PacketRingDriver::receive( NetworkInterface& interface, const function<void( InternetDatagram&& )>& deliver )
+{
+  return receive_batch( [&]( const EthernetFrame& frame ) {
+    auto dgram = interface.recv_frame( frame );
+    if ( dgram.has_value() ) {
+      deliver( std::move( *dgram ) );
+    }
+  } );
+}
+
+size_t PacketRingDriver::send( NetworkInterface& interface )
+{
+  const size_t capacity = options_.tx_frame_size - tx_data_offset;
+  size_t queued = 0;
+  while ( queued < options_.batch ) {
+    char* slot = tx_ring_ + tx_slot_ * options_.tx_frame_size;
+    auto* header = reinterpret_cast<tpacket3_hdr*>( slot ); // NOLINT(*-reinterpret-cast)
+    const uint32_t status = load_status( header->tp_status );
+    if ( status & TP_STATUS_WRONG_FORMAT ) {
+      stats_.send_errors++; // the kernel rejected this slot's frame and stopped: reclaim the slot
+      store_status( header->tp_status, TP_STATUS_AVAILABLE );
+    } else if ( status != TP_STATUS_AVAILABLE ) {
+      break; // the ring is full of frames the kernel has yet to send
+    }
+
+    auto frame = interface.maybe_send();
+    if ( not frame.has_value() ) {
+      break;
+    }
+
+    size_t length = EthernetHeader::LENGTH;
+    for ( const auto& buffer : frame->payload ) {
+      length += buffer.size();
+    }
+    if ( length > capacity ) {
+      stats_.send_errors++;
+      continue;
+    }
+
+    char* bytes = slot + tx_data_offset;
+    memcpy( bytes, frame->header.dst.data(), frame->header.dst.size() );
+    memcpy( bytes + 6, frame->header.src.data(), frame->header.src.size() );
+    bytes[12] = static_cast<char>( frame->header.type >> 8 );
+    bytes[13] = static_cast<char>( frame->header.type & 0xff );
+    char* next = bytes + EthernetHeader::LENGTH;
+    for ( const auto& buffer : frame->payload ) {
+      const string_view fragment = buffer;
+      memcpy( next, fragment.data(), fragment.size() );
+      next += fragment.size();
+    }
+
+    header->tp_len = length;
+    header->tp_snaplen = length;
+    header->tp_next_offset = 0;
+    store_status( header->tp_status, TP_STATUS_SEND_REQUEST );
+    tx_slot_ = ( tx_slot_ + 1 ) % tx_slots_;
+
+    stats_.frames_sent++;
+    stats_.bytes_sent += length;
+    queued++;
+  }
+
+  if ( queued > 0 ) {
+    stats_.send_calls++;
+    if ( ::sendto( socket_.fd_num(), nullptr, 0, MSG_DONTWAIT, nullptr, 0 ) < 0 and errno != EAGAIN
+         and errno != ENOBUFS ) {
+      throw unix_error( "sendto (packet ring)" );
+    }
+  }
+  return queued;
+}
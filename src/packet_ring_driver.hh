@@ -0,0 +1,82 @@
+#pragma once
+
+#include "packet_socket_driver.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Sizes of a PacketRingDriver's rings
+struct PacketRingOptions
+{
+  uint32_t block_size = 1 << 18; // bytes per ring block; a multiple of the page size
+  uint32_t rx_blocks = 16;       // receive ring: blocks, each filled with many variable-length frames
+  uint32_t tx_blocks = 4;        // transmit ring: blocks, each cut into fixed slots of `tx_frame_size`
+  uint32_t tx_frame_size = 2048; // larger outgoing frames are counted as send errors and dropped
+  uint32_t block_timeout_ms = 1; // how long the kernel holds a partly filled receive block
+  size_t batch = 64;             // frames per receive() or send() call
+};
+
+// Connects a NetworkInterface to a Linux network device through an AF_PACKET socket with TPACKET_V3
+// memory-mapped rings, shared with the kernel:
+//
+// - Receiving reads frames where the kernel wrote them, block by block, with no system call at all. The
+//   Ethernet header is parsed in place, and outgoing, truncated or malformed frames never leave the ring.
+//   Every other frame's payload is still copied, once, into a new std::string for the Buffer that the
+//   interface keeps, because a block goes back to the kernel once its frames are read. Compared with
+//   PacketSocketDriver, the ring saves system calls, not copies.
+// - Sending writes each frame's header and payload Buffers straight into a free transmit slot, then makes
+//   one sendto() per batch to tell the kernel that slots are ready.
+//
+// Like PacketSocketDriver, it never blocks: poll socket() for readability to wait for a filled block.
+// DriverStats::receive_calls stays zero. Opening a packet socket needs CAP_NET_RAW.
+class PacketRingDriver : public LinkDriver
+{
+public:
+  explicit PacketRingDriver( const std::string& device, const PacketRingOptions& options = {} );
+  ~PacketRingDriver() override;
+
+  // Receive up to one batch of waiting frames into `interface`; returns the number of frames received
+  size_t receive( AsyncNetworkInterface& interface ) override;
+
+  // Same for a plain NetworkInterface, handing each datagram it returns to `deliver`
+  size_t receive( NetworkInterface& interface, const std::function<void( InternetDatagram&& )>& deliver );
+
+  // Move up to one batch of frames from `interface.maybe_send()` into the transmit ring and have the kernel
+  // send them; returns the number queued. Frames stay in the interface while the ring is full.
+  size_t send( NetworkInterface& interface ) override;
+
+  const PacketSocket& socket() const override { return socket_; }
+  const DriverStats& stats() const override { return stats_; }
+
+  PacketRingDriver( const PacketRingDriver& other ) = delete;
+  PacketRingDriver& operator=( const PacketRingDriver& other ) = delete;
+  PacketRingDriver( PacketRingDriver&& other ) = delete;
+  PacketRingDriver& operator=( PacketRingDriver&& other ) = delete;
+
+private:
+  // Receive from the ring, passing each frame to `handle`
+  template<class Handler>
+  size_t receive_batch( Handler&& handle );
+
+  // Hand the current receive block back to the kernel and move on to the next
+  void release_rx_block();
+
+  PacketSocket socket_;
+  PacketRingOptions options_;
+  DriverStats stats_ {};
+
+  char* ring_ {}; // the receive ring's blocks, followed by the transmit ring's
+  size_t ring_length_ {};
+
+  // receive position: the block being read, and the next frame in it (once the kernel has handed it over)
+  size_t rx_block_ {};
+  bool rx_block_open_ {};
+  uint32_t rx_remaining_ {};
+  size_t rx_offset_ {};
+
+  // transmit position: the next slot to fill
+  char* tx_ring_ {};
+  size_t tx_slots_ {};
+  size_t tx_slot_ {};
+};
@@ -0,0 +1,158 @@
+#include "packet_socket_driver.hh"
+
+#include "exception.hh"
+
+#include <cstring>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+
+using namespace std;
+
+PacketSocketDriver::PacketSocketDriver( const string& device, const size_t batch, const size_t max_frame )
+  : socket_( SOCK_RAW, htons( ETH_P_ALL ) )
+  , batch_( batch )
+  , max_frame_( max_frame )
+  , rx_buffers_( batch * max_frame )
+  , rx_iovecs_( batch )
+  , rx_addresses_( batch )
+  , rx_messages_( batch )
+  , tx_headers_( batch )
+  , tx_messages_( batch )
+{
+  if ( batch_ == 0 or max_frame_ < EthernetHeader::LENGTH ) {
+    throw runtime_error( "PacketSocketDriver needs a batch of at least one frame of at least an Ethernet header" );
+  }
+  socket_.bind( Address::from_packet_interface( device, ETH_P_ALL ) );
+  tx_frames_.reserve( batch_ );
+
+  for ( size_t i = 0; i < batch_; i++ ) {
+    rx_iovecs_[i] = { &rx_buffers_[i * max_frame_], max_frame_ };
+  }
+}
+
+template<class Handler>
+size_t PacketSocketDriver::receive_batch( Handler&& handle )
+{
+  for ( size_t i = 0; i < batch_; i++ ) {
+    rx_messages_[i] = {};
+    rx_messages_[i].msg_hdr.msg_name = &rx_addresses_[i];
+    rx_messages_[i].msg_hdr.msg_namelen = sizeof( sockaddr_ll );
+    rx_messages_[i].msg_hdr.msg_iov = &rx_iovecs_[i];
+    rx_messages_[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  stats_.receive_calls++;
+  const int count = ::recvmmsg( socket_.fd_num(), rx_messages_.data(), batch_, MSG_DONTWAIT, nullptr );
+  if ( count < 0 ) {
+    if ( errno == EAGAIN or errno == EWOULDBLOCK ) {
+      return 0;
+    }
+    throw unix_error( "recvmmsg" );
+  }
+
+  size_t received = 0;
+  for ( size_t i = 0; i < static_cast<size_t>( count ); i++ ) {
+    const mmsghdr& message = rx_messages_[i];
+    if ( rx_addresses_[i].sll_pkttype == PACKET_OUTGOING ) {
+      continue; // our own (or another local socket's) transmission, seen on its way out
+    }
+    if ( message.msg_hdr.msg_flags & MSG_TRUNC ) {
+      stats_.truncated++;
+      continue;
+    }
+
+    EthernetFrame frame;
+    if ( not parse( frame, { Buffer { string( &rx_buffers_[i * max_frame_], message.msg_len ) } } ) ) {
+      stats_.malformed++;
+      continue;
+    }
+    stats_.frames_received++;
+    stats_.bytes_received += message.msg_len;
+    received++;
+    handle( frame );
+  }
+  return received;
+}
+
+size_t PacketSocketDriver::receive( AsyncNetworkInterface& interface )
+{
+  return receive_batch( [&]( const EthernetFrame& frame ) { interface.recv_frame( frame ); } );
+}
+
+size_t PacketSocketDriver::receive( NetworkInterface& interface,
+                                    const function<void( InternetDatagram&& )>& deliver )
+{
+  return receive_batch( [&]( const EthernetFrame& frame ) {
+    auto dgram = interface.recv_frame( frame );
+    if ( dgram.has_value() ) {
+      deliver( std::move( *dgram ) );
+    }
+  } );
+}
+
+size_t PacketSocketDriver::send( NetworkInterface& interface )
+{
+  tx_frames_.clear();
+  while ( tx_frames_.size() < batch_ ) {
+    auto frame = interface.maybe_send();
+    if ( not frame.has_value() ) {
+      break;
+    }
+    tx_frames_.push_back( std::move( *frame ) );
+  }
+  if ( tx_frames_.empty() ) {
+    return 0;
+  }
+
+  // one iovec for each frame's header, then one per payload Buffer
+  size_t iovecs = 0;
+  for ( const auto& frame : tx_frames_ ) {
+    iovecs += 1 + frame.payload.size();
+  }
+  tx_iovecs_.resize( iovecs );
+
+  iovec* next = tx_iovecs_.data();
+  for ( size_t i = 0; i < tx_frames_.size(); i++ ) {
+    const EthernetHeader& header = tx_frames_[i].header;
+    auto& bytes = tx_headers_[i];
+    memcpy( bytes.data(), header.dst.data(), header.dst.size() );
+    memcpy( bytes.data() + 6, header.src.data(), header.src.size() );
+    bytes[12] = static_cast<char>( header.type >> 8 );
+    bytes[13] = static_cast<char>( header.type & 0xff );
+
+    tx_messages_[i] = {};
+    tx_messages_[i].msg_hdr.msg_iov = next;
+    *next++ = { bytes.data(), bytes.size() };
+    for ( const auto& buffer : tx_frames_[i].payload ) {
+      const string_view fragment = buffer;
+      *next++ = { const_cast<char*>( fragment.data() ), fragment.size() }; // NOLINT(*-const-cast)
+    }
+    tx_messages_[i].msg_hdr.msg_iovlen = next - tx_messages_[i].msg_hdr.msg_iov;
+  }
+
+  // sendmmsg() stops at the first frame the kernel refuses: count it and carry on after it, unless the
+  // device has no room, in which case the rest of the batch is dropped rather than waited on
+  size_t done = 0;
+  size_t delivered = 0;
+  while ( done < tx_frames_.size() ) {
+    stats_.send_calls++;
+    const int sent = ::sendmmsg( socket_.fd_num(), &tx_messages_[done], tx_frames_.size() - done, MSG_DONTWAIT );
+    if ( sent > 0 ) {
+      for ( size_t i = done; i < done + sent; i++ ) {
+        stats_.bytes_sent += tx_messages_[i].msg_len;
+      }
+      stats_.frames_sent += sent;
+      delivered += sent;
+      done += sent;
+    } else if ( sent < 0 and ( errno == EAGAIN or errno == EWOULDBLOCK or errno == ENOBUFS ) ) {
+      stats_.send_errors += tx_frames_.size() - done;
+      break;
+    } else if ( sent < 0 and errno != EINTR ) {
+      stats_.send_errors++;
+      done++;
+    }
+  }
+
+  tx_frames_.clear();
+  return delivered;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "link_driver.hh"
+#include "socket.hh"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <linux/if_packet.h>
+#include <sys/socket.h>
+#include <vector>
+
+// Connects a NetworkInterface to a Linux network device (e.g. "lo", or one end of a veth pair) through an
+// AF_PACKET socket. Frames are received with recvmmsg() and sent with sendmmsg(), a batch per system call;
+// each outgoing frame is gathered straight from its Buffers, without copying it into one piece.
+//
+// The driver never blocks: poll socket() for readability to wait for frames, and frames that find the device
+// queue full are dropped (and counted as send errors) rather than waited on.
+// Opening a packet socket needs CAP_NET_RAW.
+class PacketSocketDriver : public LinkDriver
+{
+public:
+  static constexpr size_t default_batch = 32;
+  static constexpr size_t default_max_frame = 16384; // larger frames are counted as truncated and dropped
+
+  explicit PacketSocketDriver( const std::string& device,
+                               size_t batch = default_batch,
+                               size_t max_frame = default_max_frame );
+
+  // Receive up to one batch of waiting frames into `interface` (its recv_frame() queues the datagrams);
+  // returns the number of frames received
+  size_t receive( AsyncNetworkInterface& interface ) override;
+
+  // Same for a plain NetworkInterface, handing each datagram it returns to `deliver`
+  size_t receive( NetworkInterface& interface, const std::function<void( InternetDatagram&& )>& deliver );
+
+  // Send up to one batch of frames from `interface.maybe_send()`; returns the number sent
+  size_t send( NetworkInterface& interface ) override;
+
+  const PacketSocket& socket() const override { return socket_; }
+  const DriverStats& stats() const override { return stats_; }
+
+private:
+  // Receive a batch, passing each frame to `handle`
+  template<class Handler>
+  size_t receive_batch( Handler&& handle );
+
+  PacketSocket socket_;
+  size_t batch_;
+  size_t max_frame_;
+  DriverStats stats_ {};
+
+  // receive side: one buffer, address and message per batch slot, set up once
+  std::vector<char> rx_buffers_;
+  std::vector<iovec> rx_iovecs_;
+  std::vector<sockaddr_ll> rx_addresses_;
+  std::vector<mmsghdr> rx_messages_;
+
+  // send side: the frames in flight, their serialized headers, and one iovec per header or payload Buffer
+  std::vector<EthernetFrame> tx_frames_ {};
+  std::vector<std::array<char, EthernetHeader::LENGTH>> tx_headers_;
+  std::vector<iovec> tx_iovecs_ {};
+  std::vector<mmsghdr> tx_messages_;
+};
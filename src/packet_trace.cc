@@ -0,0 +1,88 @@
+#include "packet_trace.hh"
+
+#include "interface_stats.hh"
+
+#include <array>
+#include <iomanip>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+string_view event_name( const uint8_t type )
+{
+  static constexpr array<string_view, static_cast<size_t>( PacketTraceEvent::COUNT )> names {
+    "rx", "lookup", "arp_miss", "enqueue", "drop", "tx" };
+  return type < names.size() ? names.at( type ) : "unknown";
+}
+
+string dotted_quad( const uint32_t address )
+{
+  return to_string( ( address >> 24 ) & 0xff ) + "." + to_string( ( address >> 16 ) & 0xff ) + "."
+         + to_string( ( address >> 8 ) & 0xff ) + "." + to_string( address & 0xff );
+}
+
+void print_event( ostream& out, const TraceEvent& event )
+{
+  out << event_name( event.type );
+  switch ( static_cast<PacketTraceEvent>( event.type ) ) {
+    case PacketTraceEvent::Lookup:
+      out << " dst=" << dotted_quad( event.value ) << " prefix=";
+      if ( event.detail == PACKET_TRACE_NO_MATCH ) {
+        out << "none";
+      } else {
+        out << "/" << static_cast<unsigned>( event.detail );
+      }
+      break;
+    case PacketTraceEvent::ArpMiss:
+      out << " next_hop=" << dotted_quad( event.value );
+      break;
+    case PacketTraceEvent::Enqueue:
+      out << " pool=" << static_cast<unsigned>( event.detail ) << " bytes=" << event.value;
+      break;
+    case PacketTraceEvent::Drop:
+      if ( event.detail < static_cast<uint8_t>( DropReason::COUNT ) ) {
+        out << " reason=" << to_string( static_cast<DropReason>( event.detail ) );
+      } else {
+        out << " reason=" << static_cast<unsigned>( event.detail );
+      }
+      out << " value=" << event.value;
+      break;
+    case PacketTraceEvent::Rx:
+    case PacketTraceEvent::Tx:
+      out << " bytes=" << event.value;
+      break;
+    default:
+      out << " detail=" << static_cast<unsigned>( event.detail ) << " value=" << event.value;
+  }
+}
+
+} // namespace
+
+void print_trace( ostream& out, const TraceSection& section, size_t n )
+{
+  const size_t first = section.events.size() > n ? section.events.size() - n : 0;
+  if ( first == section.events.size() ) {
+    return;
+  }
+
+  // times are printed relative to the newest event shown
+  const uint64_t newest = section.events.back().timestamp;
+  const double ticks_per_ns = section.ticks_per_ns > 0 ? section.ticks_per_ns : 1.0;
+  for ( size_t i = first; i < section.events.size(); i++ ) {
+    const TraceEvent& event = section.events[i];
+    const double ago_ns = static_cast<double>( newest - event.timestamp ) / ticks_per_ns;
+    out << "thread " << section.thread << " " << fixed << setprecision( 0 ) << setw( 10 ) << -ago_ns << " ns  if"
+        << event.source << " ";
+    print_event( out, event );
+    out << "\n";
+  }
+}
+
+void print_recent_trace( ostream& out, size_t n )
+{
+  for ( const auto& section : collect_trace( n ) ) {
+    print_trace( out, section, n );
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "trace_ring.hh"
+
+#include <cstdint>
+#include <ostream>
+
+// Hot-path events that NetworkInterface and Router record in the calling thread's TraceRing.
+// Tracing is compiled in only when building with -DROUTER_TRACE=ON; otherwise PACKET_TRACE expands to
+// nothing and its arguments are never evaluated.
+//
+// TraceEvent::source is the interface's index in its Router; `detail` and `value` depend on the event.
+enum class PacketTraceEvent : uint8_t
+{
+  Rx,      // frame arrived at recv_frame(); value = bytes
+  Lookup,  // route lookup; detail = matched prefix length (NoMatch if none), value = destination address
+  ArpMiss, // next hop's Ethernet address unknown; value = next hop address
+  Enqueue, // frame queued; detail = MemoryPool, value = bytes
+  Drop,    // packet dropped; detail = DropReason, value = bytes or address when known
+  Tx,      // frame left maybe_send(); value = bytes
+  COUNT
+};
+
+// `detail` of a Lookup event that found no route
+constexpr uint8_t PACKET_TRACE_NO_MATCH = 0xff;
+
+#ifdef ROUTER_TRACE
+#define PACKET_TRACE( event, source, detail, value )                                                              \
+  this_thread_trace_ring().record( static_cast<uint8_t>( PacketTraceEvent::event ),                               \
+                                   static_cast<uint16_t>( source ),                                               \
+                                   static_cast<uint8_t>( detail ),                                                \
+                                   static_cast<uint32_t>( value ) )
+#else
+#define PACKET_TRACE( event, source, detail, value ) static_cast<void>( 0 )
+#endif
+
+// Print a section's last `n` events, oldest first, one per line
+void print_trace( std::ostream& out, const TraceSection& section, size_t n );
+
+// Print the last `n` events recorded by every live thread
+void print_recent_trace( std::ostream& out, size_t n );
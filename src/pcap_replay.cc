@@ -0,0 +1,95 @@
+#include "replay.hh"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+void usage( const char* program )
+{
+  cerr << "Usage: " << program << " CONFIG TRACE.pcap [--speed FACTOR] [--loops N] [--batch N]\n";
+  cerr << "\tReplays TRACE through a router configured by CONFIG (see router_config.hh for its format),\n";
+  cerr << "\tas fast as possible or (with --speed) at the trace's own timing sped up by FACTOR.\n";
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
+    }
+
+    auto args = span( argv, argc );
+    if ( argc < 3 ) {
+      usage( args.front() );
+      return EXIT_FAILURE;
+    }
+
+    ReplayOptions options;
+    for ( size_t i = 3; i < args.size(); i += 2 ) {
+      const string flag = args[i];
+      if ( i + 1 == args.size() ) {
+        usage( args.front() );
+        return EXIT_FAILURE;
+      }
+      if ( flag == "--speed" ) {
+        options.speed = stod( args[i + 1] );
+      } else if ( flag == "--loops" ) {
+        options.loops = stoul( args[i + 1] );
+      } else if ( flag == "--batch" ) {
+        options.batch = stoul( args[i + 1] );
+      } else {
+        usage( args.front() );
+        return EXIT_FAILURE;
+      }
+    }
+
+    ifstream config_file { args[1] };
+    if ( not config_file ) {
+      cerr << args.front() << ": cannot open " << args[1] << "\n";
+      return EXIT_FAILURE;
+    }
+    const RouterConfig config = RouterConfig::parse( config_file );
+    const PcapFile trace { args[2] };
+    Replay replay { config, trace };
+
+    cout << "Loaded " << replay.frames() << " frames";
+    if ( replay.skipped() ) {
+      cout << " (skipped " << replay.skipped() << " truncated or unparseable)";
+    }
+    cout << "; replaying " << options.loops << " time(s) ";
+    if ( options.speed > 0 ) {
+      cout << "at " << options.speed << "x the trace's timing.\n";
+    } else {
+      cout << "at full speed.\n";
+    }
+
+    const ReplayResult result = replay.run( options );
+    cout << fixed << setprecision( 3 );
+    cout << "Injected " << result.frames << " frames (" << result.bytes << " bytes) in " << result.seconds
+         << " s: " << result.mpps() << " Mpps, " << result.gbps() << " Gbit/s.\n";
+    cout << "Sent " << result.sent_frames << " frames (" << result.sent_bytes << " bytes).\n";
+    cout << "Dropped " << result.total_drops() << " frames";
+    const char* separator = ": ";
+    for ( size_t reason = 0; reason < result.drops.size(); reason++ ) {
+      if ( result.drops[reason] ) {
+        cout << separator << to_string( static_cast<DropReason>( reason ) ) << " " << result.drops[reason];
+        separator = ", ";
+      }
+    }
+    cout << ".\n";
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
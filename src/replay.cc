@@ -0,0 +1,136 @@
+#include "replay.hh"
+
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+uint64_t ReplayResult::total_drops() const
+{
+  uint64_t total = 0;
+  for ( const auto n : drops ) {
+    total += n;
+  }
+  return total;
+}
+
+Replay::Replay( const RouterConfig& config, const PcapFile& trace )
+{
+  config.configure( router_ );
+
+  const auto ingress = [&]( const EthernetAddress& source ) {
+    for ( const auto& port : config.ports ) {
+      if ( port.source == source ) {
+        return port.interface;
+      }
+    }
+    return size_t { 0 };
+  };
+
+  const uint64_t start_ns = trace.frames().empty() ? 0 : trace.frames().front().timestamp_ns;
+  for ( const auto& captured : trace.frames() ) {
+    EthernetFrame frame;
+    if ( captured.bytes.size() < captured.original_length
+         or not ::parse( frame, { Buffer { string( captured.bytes ) } } ) ) {
+      skipped_++;
+      continue;
+    }
+
+    const size_t interface = ingress( frame.header.src );
+    if ( frame.header.dst != ETHERNET_BROADCAST ) {
+      frame.header.dst = config.interfaces[interface].ethernet_address;
+    }
+    const uint64_t offset_ns = captured.timestamp_ns >= start_ns ? captured.timestamp_ns - start_ns : 0;
+    duration_ns_ = max( duration_ns_, offset_ns );
+    injections_.push_back( { interface, offset_ns, std::move( frame ), captured.bytes.size() } );
+  }
+}
+
+void Replay::drain( ReplayResult& result )
+{
+  router_.route();
+  for ( size_t i = 0; i < router_.interface_count(); i++ ) {
+    auto& interface = router_.interface( i );
+    for ( auto frame = interface.maybe_send(); frame.has_value(); frame = interface.maybe_send() ) {
+      result.sent_frames++;
+      result.sent_bytes += EthernetHeader::LENGTH;
+      for ( const auto& buffer : frame->payload ) {
+        result.sent_bytes += buffer.size();
+      }
+    }
+  }
+}
+
+ReplayResult Replay::run( const ReplayOptions& options )
+{
+  ReplayResult result;
+  const auto drops_now = [&] {
+    decltype( result.drops ) drops {};
+    for ( size_t i = 0; i < router_.interface_count(); i++ ) {
+      for ( size_t reason = 0; reason < drops.size(); reason++ ) {
+        drops[reason] += router_.interface( i ).stats().drops( static_cast<DropReason>( reason ) );
+      }
+    }
+    return drops;
+  };
+  const auto drops_before = drops_now();
+
+  // Interfaces' timers follow the real clock, so that ARP and its timeouts behave as they would live. Each
+  // interface has its own clock, so each is ticked by the full elapsed time.
+  uint64_t last_tick_ns = monotonic_ns();
+  const auto tick = [&] {
+    const uint64_t now = monotonic_ns();
+    const uint64_t ms = ( now - last_tick_ns ) / 1'000'000;
+    if ( ms > 0 ) {
+      for ( size_t i = 0; i < router_.interface_count(); i++ ) {
+        router_.interface( i ).tick( ms );
+      }
+      last_tick_ns += ms * 1'000'000;
+    }
+  };
+
+  const auto inject = [&]( const Injection& injection ) {
+    router_.interface( injection.interface ).recv_frame( injection.frame );
+    result.frames++;
+    result.bytes += injection.length;
+  };
+
+  const size_t batch = max<size_t>( options.batch, 1 );
+  const uint64_t start_ns = monotonic_ns();
+  for ( size_t loop = 0; loop < options.loops; loop++ ) {
+    if ( options.speed <= 0 ) {
+      for ( size_t i = 0; i < injections_.size(); i++ ) {
+        inject( injections_[i] );
+        if ( ( i + 1 ) % batch == 0 or i + 1 == injections_.size() ) {
+          drain( result );
+          tick();
+        }
+      }
+      continue;
+    }
+
+    // Each loop replays the trace's timing again, one average gap after the last loop's final frame
+    const uint64_t gap_ns = injections_.size() > 1 ? duration_ns_ / ( injections_.size() - 1 ) : 0;
+    const uint64_t loop_ns = loop * ( duration_ns_ + gap_ns );
+    for ( const auto& injection : injections_ ) {
+      const auto due_ns = start_ns + static_cast<uint64_t>( ( loop_ns + injection.offset_ns ) / options.speed );
+      if ( monotonic_ns() < due_ns ) {
+        drain( result );
+        tick();
+        while ( monotonic_ns() + 1'000'000 < due_ns ) {
+          this_thread::sleep_for( chrono::microseconds( 500 ) );
+        }
+        while ( monotonic_ns() < due_ns ) {}
+      }
+      inject( injection );
+    }
+    drain( result );
+  }
+  result.seconds = static_cast<double>( monotonic_ns() - start_ns ) / 1e9;
+
+  const auto drops_after = drops_now();
+  for ( size_t reason = 0; reason < result.drops.size(); reason++ ) {
+    result.drops[reason] = drops_after[reason] - drops_before[reason];
+  }
+  return result;
+}
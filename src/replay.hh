@@ -0,0 +1,66 @@
+#pragma once
+
+#include "packet_capture.hh"
+#include "router.hh"
+#include "router_config.hh"
+
+#include <array>
+#include <string>
+#include <vector>
+
+// How to replay a trace
+struct ReplayOptions
+{
+  double speed = 0; // 0: as fast as possible; otherwise the trace's own timing, sped up by this factor
+  size_t loops = 1; // times through the trace
+  size_t batch = 64; // at full speed, frames received before each call to Router::route()
+};
+
+// What a replay did
+struct ReplayResult
+{
+  uint64_t frames {}; // injected into the router
+  uint64_t bytes {};  // in those frames (Ethernet header included)
+  uint64_t sent_frames {};
+  uint64_t sent_bytes {};
+  double seconds {};
+  std::array<uint64_t, static_cast<size_t>( DropReason::COUNT )> drops {};
+
+  double mpps() const { return seconds > 0 ? static_cast<double>( frames ) / seconds / 1e6 : 0; }
+  double gbps() const { return seconds > 0 ? static_cast<double>( bytes ) * 8 / seconds / 1e9 : 0; }
+  uint64_t total_drops() const;
+};
+
+// Replays captured frames through a Router built from a RouterConfig. Frames are parsed (and their Ethernet
+// destination rewritten to the ingress interface, so the router accepts them) before the clock starts.
+// Frames captured short of their original length are skipped.
+class Replay
+{
+public:
+  Replay( const RouterConfig& config, const PcapFile& trace );
+
+  ReplayResult run( const ReplayOptions& options );
+
+  Router& router() { return router_; }
+
+  // Frames that will be injected, and frames of the trace that will not (truncated or unparseable)
+  size_t frames() const { return injections_.size(); }
+  size_t skipped() const { return skipped_; }
+
+private:
+  struct Injection
+  {
+    size_t interface;
+    uint64_t offset_ns; // since the trace's first frame
+    EthernetFrame frame;
+    size_t length;
+  };
+
+  // Hand every frame waiting in the router's interfaces to nobody, counting them
+  void drain( ReplayResult& result );
+
+  Router router_ {};
+  std::vector<Injection> injections_ {};
+  size_t skipped_ {};
+  uint64_t duration_ns_ {}; // from the trace's first frame to its last
+};
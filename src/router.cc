@@ -1,6 +1,9 @@
 #include "router.hh"
 
-#include <iostream>
+#include "forwarding_profile.hh"
+#include "logger.hh"
+#include "packet_trace.hh"
+
 #include <limits>
 
 using namespace std;
@@ -16,25 +19,55 @@ void Router::add_route( const uint32_t route_prefix,
                         const optional<Address> next_hop,
                         const size_t interface_num )
 {
-  cerr << "DEBUG: adding route " << Address::from_ipv4_numeric( route_prefix ).ip() << "/"
-       << static_cast<int>( prefix_length ) << " => " << ( next_hop.has_value() ? next_hop->ip() : "(direct)" )
-       << " on interface " << interface_num << "\n";
+  if ( next_hop.has_value() ) {
+    LOG_DEBUG( "adding route {}/{} => {} on interface {}",
+               LogIpv4 { route_prefix },
+               prefix_length,
+               LogIpv4 { next_hop->ipv4_numeric() },
+               interface_num );
+  } else {
+    LOG_DEBUG( "adding route {}/{} => (direct) on interface {}",
+               LogIpv4 { route_prefix },
+               prefix_length,
+               interface_num );
+  }
 
   // Construct a routing tabke element
   RoutingTableElement r_element(route_prefix, prefix_length, next_hop, interface_num);
   
   // Add the element into the routing table
+  const size_t old_capacity = routing_table_.capacity();
   routing_table_.push_back(r_element);
+  memory_->release( old_capacity * sizeof( RoutingTableElement ) );
+  memory_->charge( routing_table_.capacity() * sizeof( RoutingTableElement ) );
+  stats_->routes.store( routing_table_.size(), memory_order_relaxed );
 }
 
 
-void Router::route_single_dgram(InternetDatagram &dgram){
+void Router::route_single_dgram(InternetDatagram &dgram, const size_t ingress_interface, const uint64_t arrival_ns){
+  PROFILE_START(timer);
   int target_index = -1;
   int longest_prefix_len = -1;
+
+  // Heavy hitters: every datagram the router is asked to route, including those it drops
+  if ( track_heavy_hitters_ ) {
+    stats_->heavy_hitters.record( dgram.header.src, dgram.header.dst, arrival_ns );
+  }
+
+  // Flow sampling: one decrement per datagram, and a copy of its header for the chosen few
+  const bool sampled = flow_sampler_ and flow_sampler_->should_sample();
+  const auto sample = [&]( optional<size_t> egress, FlowOutcome outcome ) {
+    if ( sampled ) {
+      flow_sampler_->sample( dgram, ingress_interface, egress, max( longest_prefix_len, 0 ), outcome );
+    }
+  };
   
   // Check TTL field, if <= 0, then drop the packet
-  if ( dgram.header.ttl <= 0 )
+  if ( dgram.header.ttl <= 0 ) {
+    interfaces_[ingress_interface].count_drop( DropReason::TtlExpired, dgram.header.dst );
+    sample( nullopt, FlowOutcome::TtlExpired );
     return;
+  }
 
   // Find the best route
   uint32_t dest = dgram.header.dst;
@@ -53,35 +86,51 @@ void Router::route_single_dgram(InternetDatagram &dgram){
     }
   }
 
+  PROFILE_LAP( timer, Lookup );
+  PACKET_TRACE( Lookup,
+                ingress_interface,
+                target_index == -1 ? PACKET_TRACE_NO_MATCH : longest_prefix_len,
+                dest );
+
   // If there is no matching route for a packet, drop the packet 
-  if ( target_index == -1 )
+  if ( target_index == -1 ) {
+    interfaces_[ingress_interface].count_drop( DropReason::NoRoute, dest );
+    sample( nullopt, FlowOutcome::NoRoute );
     return;
+  }
 
   // Decrementing the TTL field, and check if TTL becomes to 0.
   dgram.header.ttl -= 1;
   if (dgram.header.ttl <= 0) {
+    interfaces_[ingress_interface].count_drop( DropReason::TtlExpired, dgram.header.dst );
+    sample( nullopt, FlowOutcome::TtlExpired );
     return;
   }
   dgram.header.compute_checksum();
+  PROFILE_LAP( timer, Serialize );
 
   // The packet should be sent out on the interface that is specified in the route.
   size_t target_interface = routing_table_[target_index].interface_num_;
   optional<Address> next_hop = routing_table_[target_index].next_hop_;
+  sample( target_interface, FlowOutcome::Forwarded );
   
   // Check if the packet needs to be sent to another router
-  if (next_hop.has_value()) {
-    interfaces_[target_interface].send_datagram( dgram, next_hop.value() );
-  } else {
-    interfaces_[target_interface].send_datagram( dgram, Address::from_ipv4_numeric(dest) );
+  const Address target = next_hop.has_value() ? next_hop.value() : Address::from_ipv4_numeric( dest );
+  // a datagram the interface's memory budget refuses is counted as a QueueFull drop instead
+  if ( interfaces_[target_interface].send_datagram( dgram, target, arrival_ns ) ) {
+    interfaces_[target_interface].stats().count( InterfaceCounter::Forwarded );
   }
 }
 
 void Router::route() {
-  for (auto& this_interface : interfaces_ ) {
-    optional<InternetDatagram> this_datagram = this_interface.maybe_receive();
+  const uint64_t start_ns = monotonic_ns();
+  uint64_t arrival_ns {};
+  for ( size_t i = 0; i < interfaces_.size(); i++ ) {
+    optional<InternetDatagram> this_datagram = interfaces_[i].maybe_receive( arrival_ns );
     while (this_datagram.has_value()) {
-      route_single_dgram(this_datagram.value());
-      this_datagram = this_interface.maybe_receive();
+      route_single_dgram(this_datagram.value(), i, arrival_ns);
+      this_datagram = interfaces_[i].maybe_receive( arrival_ns );
     }
   }
+  stats_->route_ns.record( monotonic_ns() - start_ns );
 }
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "flow_sampler.hh"
 #include "network_interface.hh"
+#include "router_stats.hh"
 
 #include <optional>
 #include <queue>
@@ -12,13 +14,19 @@
 // implementation of NetworkInterface.
 class AsyncNetworkInterface : public NetworkInterface
 {
-  std::queue<InternetDatagram> datagrams_in_ {};
+  struct Received_Datagram
+  {
+    InternetDatagram dgram;
+    uint64_t arrival_ns; // when recv_frame() accepted it (see monotonic_ns())
+  };
+
+  std::queue<Received_Datagram> datagrams_in_ {};
 
 public:
   using NetworkInterface::NetworkInterface;
 
   // Construct from a NetworkInterface
-  explicit AsyncNetworkInterface( NetworkInterface&& interface ) : NetworkInterface( interface ) {}
+  explicit AsyncNetworkInterface( NetworkInterface&& interface ) : NetworkInterface( std::move( interface ) ) {}
 
   // \brief Receives and Ethernet frame and responds appropriately.
 
@@ -29,20 +37,30 @@ public:
   // \param[in] frame the incoming Ethernet frame
   void recv_frame( const EthernetFrame& frame )
   {
+    const uint64_t arrival_ns = monotonic_ns();
     auto optional_dgram = NetworkInterface::recv_frame( frame );
-    if ( optional_dgram.has_value() ) {
-      datagrams_in_.push( std::move( optional_dgram.value() ) );
+    if ( optional_dgram.has_value() and reserve_memory( MemoryPool::ReceiveQueue, footprint( *optional_dgram ) ) ) {
+      datagrams_in_.push( { std::move( optional_dgram.value() ), arrival_ns } );
     }
   };
 
   // Access queue of Internet datagrams that have been received
   std::optional<InternetDatagram> maybe_receive()
+  {
+    uint64_t arrival_ns {};
+    return maybe_receive( arrival_ns );
+  }
+
+  // Same, also reporting when the datagram arrived
+  std::optional<InternetDatagram> maybe_receive( uint64_t& arrival_ns )
   {
     if ( datagrams_in_.empty() ) {
       return {};
     }
 
-    InternetDatagram datagram = std::move( datagrams_in_.front() );
+    release_memory( MemoryPool::ReceiveQueue, footprint( datagrams_in_.front().dgram ) );
+    InternetDatagram datagram = std::move( datagrams_in_.front().dgram );
+    arrival_ns = datagrams_in_.front().arrival_ns;
     datagrams_in_.pop();
     return datagram;
   }
@@ -70,7 +88,19 @@ class Router
 
   std::vector<RoutingTableElement> routing_table_ {};
 
-  void route_single_dgram(InternetDatagram &dgram);
+  // Bytes held by every interface's queues and tables plus the routing table, against an optional limit
+  std::shared_ptr<MemoryBudget> memory_ = std::make_shared<MemoryBudget>();
+
+  // Router-wide measurements (shared so that other threads can keep reading them)
+  std::shared_ptr<RouterStats> stats_ = std::make_shared<RouterStats>();
+
+  // Samples routed datagrams for flow export, if set
+  std::shared_ptr<FlowSampler> flow_sampler_ {};
+
+  // Whether route() feeds stats().heavy_hitters
+  bool track_heavy_hitters_ = false;
+
+  void route_single_dgram(InternetDatagram &dgram, size_t ingress_interface, uint64_t arrival_ns);
   
 
 public:
@@ -79,12 +109,18 @@ public:
   // returns the index of the interface after it has been added to the router
   size_t add_interface( AsyncNetworkInterface&& interface )
   {
+    interface.attach_memory_budget( memory_ );
+    interface.set_trace_id( static_cast<uint16_t>( interfaces_.size() ) );
     interfaces_.push_back( std::move( interface ) );
     return interfaces_.size() - 1;
   }
 
   // Access an interface by index
   AsyncNetworkInterface& interface( size_t N ) { return interfaces_.at( N ); }
+  const AsyncNetworkInterface& interface( size_t N ) const { return interfaces_.at( N ); }
+
+  // Number of interfaces added so far
+  size_t interface_count() const { return interfaces_.size(); }
 
   // Add a route (a forwarding rule)
   void add_route( uint32_t route_prefix,
@@ -99,4 +135,30 @@ public:
   // route with the longest prefix_length that matches the datagram's
   // destination address.
   void route();
+
+  // Limit the bytes held router-wide (0 = unlimited). Each interface drops packets according to its
+  // own DropPolicy when admitting one would exceed this limit.
+  void set_memory_budget( size_t bytes ) { memory_->set_limit( bytes ); }
+
+  // Current and peak bytes held router-wide
+  MemoryUsage memory_usage() const { return memory_->usage(); }
+
+  // Router-wide measurements, and a handle on them that other threads may keep
+  const RouterStats& stats() const { return *stats_; }
+  std::shared_ptr<const RouterStats> stats_handle() const { return stats_; }
+
+  // Sample routed datagrams (and what was done with them) into `sampler`, or stop sampling if null.
+  // The sampler must only be fed by this router's thread.
+  void set_flow_sampler( std::shared_ptr<FlowSampler> sampler ) { flow_sampler_ = std::move( sampler ); }
+
+  // Count every routed datagram's source and destination in stats().heavy_hitters, decaying by half
+  // every `window_ns`
+  void track_heavy_hitters( bool enable, uint64_t window_ns = HeavyHitters::default_window_ns )
+  {
+    stats_->heavy_hitters.set_window( window_ns );
+    track_heavy_hitters_ = enable;
+  }
+
+  // Publish stats().heavy_hitters' top keys now, before the window ends (e.g. for a test, or an idle router)
+  void publish_heavy_hitters() { stats_->heavy_hitters.publish(); }
 };
@@ -0,0 +1,146 @@
+#include "router_config.hh"
+
+#include "arp_message.hh"
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+EthernetAddress parse_ethernet_address( const string& text )
+{
+  EthernetAddress address {};
+  istringstream in { text };
+  for ( size_t i = 0; i < address.size(); i++ ) {
+    unsigned byte = 0;
+    char separator = ':';
+    if ( ( i > 0 and not( in >> separator ) ) or separator != ':' or not( in >> hex >> byte ) or byte > 0xff ) {
+      throw runtime_error( "bad Ethernet address: " + text );
+    }
+    address[i] = static_cast<uint8_t>( byte );
+  }
+  if ( in.peek() != EOF ) {
+    throw runtime_error( "bad Ethernet address: " + text );
+  }
+  return address;
+}
+
+RouterConfig RouterConfig::parse( istream& in )
+{
+  RouterConfig config;
+  string line;
+  for ( size_t number = 1; getline( in, line ); number++ ) {
+    line = line.substr( 0, line.find( '#' ) );
+    istringstream words { line };
+    string directive;
+    if ( not( words >> directive ) ) {
+      continue;
+    }
+
+    const auto fail = [&]( const string& why ) {
+      throw runtime_error( "line " + to_string( number ) + ": " + why + ": " + line );
+    };
+    const auto interface_number = [&]( size_t n ) {
+      if ( n >= config.interfaces.size() ) {
+        fail( "no such interface" );
+      }
+      return n;
+    };
+
+    string a;
+    string b;
+    string c;
+    if ( directive == "interface" and words >> a >> b ) {
+      config.interfaces.push_back( { parse_ethernet_address( a ), Address( b ).ip(), {} } );
+      if ( words >> c ) {
+        config.interfaces.back().device = c;
+      }
+    } else if ( directive == "route" ) {
+      string rest;
+      getline( words, rest );
+      try {
+        config.routes.push_back( parse_route( rest, config.interfaces.size() ) );
+      } catch ( const runtime_error& e ) {
+        fail( e.what() );
+      }
+    } else if ( directive == "neighbor" and words >> a >> b >> c ) {
+      config.neighbors.push_back(
+        { interface_number( stoul( a ) ), Address( b ).ip(), parse_ethernet_address( c ) } );
+    } else if ( directive == "port" and words >> a >> b ) {
+      config.ports.push_back( { parse_ethernet_address( a ), interface_number( stoul( b ) ) } );
+    } else {
+      fail( "unknown or incomplete directive" );
+    }
+    if ( words >> c ) {
+      fail( "trailing words" );
+    }
+  }
+
+  if ( config.interfaces.empty() ) {
+    throw runtime_error( "router configuration has no interfaces" );
+  }
+  return config;
+}
+
+RouterConfig::Route RouterConfig::parse_route( const string& words, const size_t interfaces )
+{
+  istringstream in { words };
+  string prefix;
+  string interface;
+  string next_hop;
+  if ( not( in >> prefix >> interface ) ) {
+    throw runtime_error( "incomplete route" );
+  }
+  const size_t slash = prefix.find( '/' );
+  if ( slash == string::npos ) {
+    throw runtime_error( "route needs a prefix length" );
+  }
+  const unsigned length = stoul( prefix.substr( slash + 1 ) );
+  if ( length > 32 ) {
+    throw runtime_error( "bad prefix length" );
+  }
+  const size_t number = stoul( interface );
+  if ( number >= interfaces ) {
+    throw runtime_error( "no such interface" );
+  }
+
+  Route route { Address( prefix.substr( 0, slash ) ).ipv4_numeric(), static_cast<uint8_t>( length ), number, {} };
+  if ( in >> next_hop ) {
+    route.next_hop = Address( next_hop ).ip();
+  }
+  if ( in >> next_hop ) {
+    throw runtime_error( "trailing words" );
+  }
+  return route;
+}
+
+void RouterConfig::configure( Router& router ) const
+{
+  for ( const auto& interface : interfaces ) {
+    router.add_interface( AsyncNetworkInterface { interface.ethernet_address, Address( interface.ip ) } );
+  }
+  for ( const auto& route : routes ) {
+    router.add_route( route.prefix,
+                      route.prefix_length,
+                      route.next_hop.has_value() ? optional { Address( *route.next_hop ) } : nullopt,
+                      route.interface );
+  }
+
+  // Teach each interface its neighbors, as an ARP request from each would
+  for ( const auto& neighbor : neighbors ) {
+    ARPMessage request;
+    request.opcode = ARPMessage::OPCODE_REQUEST;
+    request.sender_ethernet_address = neighbor.ethernet_address;
+    request.sender_ip_address = Address( neighbor.ip ).ipv4_numeric();
+    request.target_ip_address = Address( interfaces[neighbor.interface].ip ).ipv4_numeric();
+
+    EthernetFrame frame;
+    frame.header.dst = ETHERNET_BROADCAST;
+    frame.header.src = neighbor.ethernet_address;
+    frame.header.type = EthernetHeader::TYPE_ARP;
+    frame.payload = serialize( request );
+    router.interface( neighbor.interface ).recv_frame( frame );
+    while ( router.interface( neighbor.interface ).maybe_send().has_value() ) {}
+  }
+}
+
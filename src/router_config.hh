@@ -0,0 +1,68 @@
+#pragma once
+
+#include "router.hh"
+
+#include <istream>
+#include <optional>
+#include <string>
+#include <vector>
+
+// A router's interfaces, routes and neighbors, and which interface each captured frame enters by.
+// The text form has one directive per line ('#' starts a comment); interfaces are numbered in order:
+//
+//   interface 02:00:00:00:00:01 10.0.0.1 eth0   # Ethernet and IP address, optional Linux device
+//   route 172.16.0.0/12 1 192.168.0.2           # prefix, interface, optional next hop
+//   neighbor 1 192.168.0.2 02:00:00:00:00:20    # a next hop whose Ethernet address is known in advance
+//   port 02:00:00:00:00:10 0                    # frames from this Ethernet source enter interface 0
+//
+// Frames from sources without a port directive enter interface 0. Devices matter to a running router (see
+// RouterDaemon); ports only to a replayed trace (see Replay).
+struct RouterConfig
+{
+  struct Interface
+  {
+    EthernetAddress ethernet_address {};
+    std::string ip {};
+    std::string device {};
+  };
+
+  struct Route
+  {
+    uint32_t prefix {};
+    uint8_t prefix_length {};
+    size_t interface {};
+    std::optional<std::string> next_hop {};
+  };
+
+  struct Neighbor
+  {
+    size_t interface {};
+    std::string ip {};
+    EthernetAddress ethernet_address {};
+  };
+
+  struct Port
+  {
+    EthernetAddress source {};
+    size_t interface {};
+  };
+
+  std::vector<Interface> interfaces {};
+  std::vector<Route> routes {};
+  std::vector<Neighbor> neighbors {};
+  std::vector<Port> ports {};
+
+  // Throws std::runtime_error, naming the line, on a malformed or inconsistent directive
+  static RouterConfig parse( std::istream& in );
+
+  // Parse the words of a route directive ("172.16.0.0/12 1 192.168.0.2") for a router with `interfaces`
+  // interfaces; throws std::runtime_error if malformed
+  static Route parse_route( const std::string& words, size_t interfaces );
+
+  // Add the interfaces and routes to `router` (which should have none yet), and teach each interface its
+  // neighbors, as an ARP request from each would
+  void configure( Router& router ) const;
+};
+
+// Parse "02:00:00:00:00:01"; throws std::runtime_error if malformed
+EthernetAddress parse_ethernet_address( const std::string& text );
@@ -0,0 +1,240 @@
+#include "router_daemon.hh"
+
+#include "exception.hh"
+#include "packet_ring_driver.hh"
+#include "packet_socket_driver.hh"
+#include "udp_link_driver.hh"
+
+#include <array>
+#include <cerrno>
+#include <sstream>
+#include <sys/socket.h>
+
+using namespace std;
+
+namespace {
+
+constexpr uint64_t client_timeout_ns = 1'000'000'000; // how long a client has to send its request and
+                                                       // take the reply
+constexpr size_t max_command = 4096;
+
+// A driver for a device named in the configuration
+unique_ptr<LinkDriver> make_driver( const string& device, const DaemonOptions& options )
+{
+  if ( device.starts_with( "udp:" ) ) {
+    const size_t colon = device.find( ':', 4 );
+    if ( colon == string::npos ) {
+      throw runtime_error( "UDP link needs a local and a peer port: " + device );
+    }
+    return make_unique<UdpLinkDriver>( static_cast<uint16_t>( stoul( device.substr( 4, colon - 4 ) ) ),
+                                       static_cast<uint16_t>( stoul( device.substr( colon + 1 ) ) ) );
+  }
+  if ( options.rings ) {
+    return make_unique<PacketRingDriver>( device );
+  }
+  return make_unique<PacketSocketDriver>( device );
+}
+
+} // namespace
+
+RouterDaemon::RouterDaemon( const RouterConfig& config, const DaemonOptions& options )
+{
+  config.configure( router_ );
+
+  for ( size_t i = 0; i < config.interfaces.size(); i++ ) {
+    const string& device = config.interfaces[i].device;
+    if ( device.empty() ) {
+      throw runtime_error( "interface " + to_string( i ) + " names no device" );
+    }
+    drivers_.push_back( make_driver( device, options ) );
+    loop_.add_reader( drivers_.back()->socket(), [this, i] { drivers_[i]->receive( router_.interface( i ) ); } );
+  }
+
+  loop_.after_events( [this] {
+    router_.route();
+    send_all();
+  } );
+  loop_.add_timer( options.tick_interval, [this]( uint64_t elapsed_ns ) { tick( elapsed_ns ); } );
+}
+
+void RouterDaemon::tick( const uint64_t elapsed_ns )
+{
+  const uint64_t now = monotonic_ns();
+  vector<Connection*> expired;
+  for ( const auto& [id, connection] : connections_ ) {
+    if ( connection->deadline_ns <= now ) {
+      expired.push_back( connection.get() );
+    }
+  }
+  for ( Connection* connection : expired ) {
+    close( *connection );
+  }
+
+  unticked_ns_ += elapsed_ns;
+  const uint64_t ms = unticked_ns_ / 1'000'000;
+  unticked_ns_ %= 1'000'000;
+  if ( ms == 0 ) {
+    return;
+  }
+  for ( size_t i = 0; i < router_.interface_count(); i++ ) {
+    router_.interface( i ).tick( ms ); // each interface keeps its own clock, so each advances by `ms`
+  }
+  // the hook sends whatever the ticks queued (e.g. ARP retries)
+}
+
+void RouterDaemon::send_all()
+{
+  for ( size_t i = 0; i < drivers_.size(); i++ ) {
+    while ( drivers_[i]->send( router_.interface( i ) ) > 0 ) {}
+  }
+}
+
+void RouterDaemon::serve_metrics( FileDescriptor listener )
+{
+  if ( not metrics_ ) {
+    metrics_ = make_unique<MetricsExporter>( router_ );
+  }
+  listen( std::move( listener ), true );
+}
+
+void RouterDaemon::serve_control( FileDescriptor listener )
+{
+  listen( std::move( listener ), false );
+}
+
+void RouterDaemon::listen( FileDescriptor listener, const bool metrics )
+{
+  listener.set_blocking( false );
+  listeners_.push_back( make_unique<FileDescriptor>( std::move( listener ) ) );
+  const FileDescriptor& socket = *listeners_.back();
+  loop_.add_reader( socket, [this, &socket, metrics] { accept_all( socket, metrics ); } );
+}
+
+void RouterDaemon::accept_all( const FileDescriptor& listener, const bool metrics )
+{
+  while ( true ) {
+    const int client = ::accept4( listener.fd_num(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC );
+    if ( client < 0 ) {
+      return; // EAGAIN once the backlog is empty; anything else is the client's problem
+    }
+    auto connection
+      = make_unique<Connection>( FileDescriptor { client }, metrics, monotonic_ns() + client_timeout_ns );
+    Connection& added = *connection;
+    added.id = loop_.add_reader( added.socket, [this, &added] { serve( added ); } );
+    connections_.emplace( added.id, std::move( connection ) );
+  }
+}
+
+// Read what the client has sent until the request is complete, then send the reply as the socket takes it
+void RouterDaemon::serve( Connection& connection )
+{
+  const int fd = connection.socket.fd_num();
+  if ( connection.reply.empty() ) {
+    bool eof = false;
+    array<char, 1024> chunk {};
+    const size_t limit = connection.metrics ? MetricsExporter::max_request : max_command;
+    while ( connection.request.size() < limit ) {
+      const ssize_t received = ::recv( fd, chunk.data(), chunk.size(), 0 );
+      if ( received < 0 and errno != EAGAIN ) {
+        close( connection );
+        return;
+      }
+      if ( received <= 0 ) {
+        eof = received == 0;
+        break;
+      }
+      connection.request.append( chunk.data(), received );
+    }
+
+    if ( connection.metrics ) {
+      if ( not MetricsExporter::request_complete( connection.request ) ) {
+        if ( eof ) {
+          close( connection );
+        }
+        return;
+      }
+      connection.reply = metrics_->response();
+    } else {
+      const size_t newline = connection.request.find( '\n' );
+      if ( newline == string::npos and connection.request.size() < max_command and not eof ) {
+        return;
+      }
+      connection.reply = control( connection.request.substr( 0, newline ) ) + "\n"; // no newline is fine at EOF
+    }
+  }
+
+  while ( connection.sent < connection.reply.size() ) {
+    const ssize_t sent = ::send(
+      fd, connection.reply.data() + connection.sent, connection.reply.size() - connection.sent, MSG_NOSIGNAL );
+    if ( sent < 0 and errno == EAGAIN ) {
+      loop_.set_writable( connection.id, true ); // called again when the socket takes more
+      return;
+    }
+    if ( sent <= 0 ) {
+      break;
+    }
+    connection.sent += sent;
+  }
+  close( connection );
+}
+
+void RouterDaemon::close( Connection& connection )
+{
+  loop_.remove( connection.id );
+  connections_.erase( connection.id ); // closes the socket (the loop's duplicate goes at the end of the turn)
+}
+
+string RouterDaemon::control( const string& command )
+{
+  istringstream words { command };
+  string verb;
+  words >> verb;
+
+  if ( verb == "route" ) {
+    string rest;
+    getline( words, rest );
+    try {
+      const auto route = RouterConfig::parse_route( rest, router_.interface_count() );
+      router_.add_route( route.prefix,
+                         route.prefix_length,
+                         route.next_hop.has_value() ? optional { Address( *route.next_hop ) } : nullopt,
+                         route.interface );
+    } catch ( const exception& e ) {
+      return string( "error: " ) + e.what();
+    }
+    return "ok";
+  }
+
+  if ( verb == "stats" ) {
+    ostringstream out;
+    out << "routes " << router_.stats().routes.load( memory_order_relaxed );
+    for ( size_t i = 0; i < router_.interface_count(); i++ ) {
+      const InterfaceStats& stats = router_.interface( i ).stats();
+      const DriverStats& link = drivers_[i]->stats();
+      out << "\ninterface " << i << " rx " << stats.get( InterfaceCounter::RxPackets ) << " tx "
+          << stats.get( InterfaceCounter::TxPackets ) << " forwarded " << stats.get( InterfaceCounter::Forwarded )
+          << " drops " << stats.drops() << " link_errors " << link.truncated + link.malformed + link.send_errors;
+    }
+    return out.str();
+  }
+
+  if ( verb == "fds" ) {
+    if ( not FDStats::enabled() ) {
+      return "error: descriptor statistics are off";
+    }
+    ostringstream out;
+    FDStats::dump( out );
+    string dump = out.str();
+    if ( not dump.empty() ) {
+      dump.pop_back(); // the reply's own newline ends the last line
+    }
+    return dump;
+  }
+
+  if ( verb == "stop" ) {
+    stop();
+    return "ok";
+  }
+
+  return "error: unknown command: " + command;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "event_loop.hh"
+#include "link_driver.hh"
+#include "metrics_exporter.hh"
+#include "router_config.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// How a RouterDaemon drives its links
+struct DaemonOptions
+{
+  bool rings = false;                             // PacketRingDriver (TPACKET_V3), not PacketSocketDriver
+  std::chrono::milliseconds tick_interval { 10 }; // how often to tick() the interfaces (ARP timers, expiry)
+};
+
+// Runs a Router against real Linux devices, on one thread, in real time.
+//
+// Every interface in the configuration must name a device; each gets a LinkDriver on it, registered with an
+// EventLoop. A device named "udp:LOCAL_PORT:PEER_PORT" is a UdpLinkDriver to a peer on 127.0.0.1; any
+// other name is a Linux network device. Each turn of the loop receives from the devices that are readable,
+// routes everything received, and sends what the interfaces queued. A timer ticks every interface with the
+// real elapsed time on the monotonic clock.
+//
+// Optionally, the loop also answers metrics scrapes (see MetricsExporter) and control commands, one line
+// per connection. Those connections are non-blocking and driven by the loop like the links, so a slow or
+// stalled client never holds up forwarding; one that has not finished within a second is closed.
+//
+//   route 172.16.0.0/12 1 192.168.0.2   add a route (as in the configuration file)
+//   stats                               per-interface packet counts
+//   fds                                 I/O statistics of every tracked descriptor (see FDStats)
+//   stop                                stop the daemon
+class RouterDaemon
+{
+public:
+  explicit RouterDaemon( const RouterConfig& config, const DaemonOptions& options = {} );
+
+  // Answer metrics scrapes, or control commands, on a socket that is already bound and listening
+  void serve_metrics( FileDescriptor listener );
+  void serve_control( FileDescriptor listener );
+
+  // Run until stop() (or a "stop" command)
+  void run() { loop_.run(); }
+
+  // Safe from any thread, and from a signal handler
+  void stop() { loop_.stop(); }
+
+  // Carry out one control command, returning the reply
+  std::string control( const std::string& command );
+
+  Router& router() { return router_; }
+  EventLoop& loop() { return loop_; }
+  const LinkDriver& driver( size_t interface ) const { return *drivers_.at( interface ); }
+
+private:
+  // A metrics or control client: its request as read so far, then the reply as sent so far
+  struct Connection
+  {
+    FileDescriptor socket;
+    bool metrics;
+    uint64_t deadline_ns;
+    EventLoop::Id id {};
+    std::string request {};
+    std::string reply {};
+    size_t sent {};
+  };
+
+  void tick( uint64_t elapsed_ns );
+  void send_all();
+  void listen( FileDescriptor listener, bool metrics );
+  void accept_all( const FileDescriptor& listener, bool metrics );
+  void serve( Connection& connection );
+  void close( Connection& connection );
+
+  Router router_ {};
+  EventLoop loop_ {};
+  std::vector<std::unique_ptr<LinkDriver>> drivers_ {}; // one per interface, in order
+  std::unique_ptr<MetricsExporter> metrics_ {};
+  std::vector<std::unique_ptr<FileDescriptor>> listeners_ {}; // metrics and control
+  std::unordered_map<EventLoop::Id, std::unique_ptr<Connection>> connections_ {};
+  uint64_t unticked_ns_ {}; // elapsed time not yet passed to tick(), which counts whole milliseconds
+};
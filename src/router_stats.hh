@@ -0,0 +1,17 @@
+#pragma once
+
+#include "heavy_hitters.hh"
+#include "histogram.hh"
+
+#include <atomic>
+#include <cstdint>
+
+// Router-wide measurements (per-interface ones live in each interface's InterfaceStats)
+struct RouterStats
+{
+  LatencyHistogram route_ns {}; // cost of each call to Router::route()
+
+  std::atomic<uint64_t> routes {}; // routing table entries, published by add_route()
+
+  HeavyHitters heavy_hitters {}; // busiest sources and destinations, if Router::track_heavy_hitters() is on
+};
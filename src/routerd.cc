@@ -0,0 +1,130 @@
+#include "exception.hh"
+#include "router_daemon.hh"
+#include "socket.hh"
+
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <string>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+void usage( const char* program )
+{
+  cerr << "Usage: " << program << " CONFIG [--rings] [--fd-stats] [--tick MS] [--metrics PORT] [--control PATH]\n";
+  cerr << "\tRuns a router configured by CONFIG (see router_config.hh for its format) on the Linux\n";
+  cerr << "\tdevices its interfaces name, until SIGINT, SIGTERM or a \"stop\" control command.\n";
+  cerr << "\t--rings uses TPACKET_V3 rings instead of batched packet sockets; --fd-stats tracks I/O\n";
+  cerr << "\ton every descriptor, for the \"fds\" control command; --metrics serves Prometheus metrics\n";
+  cerr << "\ton localhost:PORT; --control accepts commands on a Unix socket at PATH.\n";
+}
+
+// Block SIGINT and SIGTERM, and return a descriptor that becomes readable when either arrives
+FileDescriptor signals()
+{
+  sigset_t mask;
+  sigemptyset( &mask );
+  sigaddset( &mask, SIGINT );
+  sigaddset( &mask, SIGTERM );
+  CheckSystemCall( "sigprocmask", ::sigprocmask( SIG_BLOCK, &mask, nullptr ) );
+  return FileDescriptor { CheckSystemCall( "signalfd", ::signalfd( -1, &mask, SFD_NONBLOCK | SFD_CLOEXEC ) ) };
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
+    }
+
+    auto args = span( argv, argc );
+    if ( argc < 2 ) {
+      usage( args.front() );
+      return EXIT_FAILURE;
+    }
+
+    DaemonOptions options;
+    optional<uint16_t> metrics_port;
+    string control_path;
+    for ( size_t i = 2; i < args.size(); i++ ) {
+      const string flag = args[i];
+      if ( flag == "--rings" ) {
+        options.rings = true;
+        continue;
+      }
+      if ( flag == "--fd-stats" ) {
+        FDStats::enable( true ); // before any descriptor the daemon opens
+        continue;
+      }
+      if ( i + 1 == args.size() ) {
+        usage( args.front() );
+        return EXIT_FAILURE;
+      }
+      const string value = args[++i];
+      if ( flag == "--tick" ) {
+        options.tick_interval = chrono::milliseconds( stoul( value ) );
+        if ( options.tick_interval.count() == 0 ) {
+          cerr << args.front() << ": --tick needs at least 1 ms\n";
+          return EXIT_FAILURE;
+        }
+      } else if ( flag == "--metrics" ) {
+        metrics_port = static_cast<uint16_t>( stoul( value ) );
+      } else if ( flag == "--control" ) {
+        control_path = value;
+      } else {
+        usage( args.front() );
+        return EXIT_FAILURE;
+      }
+    }
+
+    ifstream config_file { args[1] };
+    if ( not config_file ) {
+      cerr << args.front() << ": cannot open " << args[1] << "\n";
+      return EXIT_FAILURE;
+    }
+    RouterDaemon daemon { RouterConfig::parse( config_file ), options };
+
+    if ( metrics_port.has_value() ) {
+      TCPSocket listener;
+      listener.set_reuseaddr();
+      listener.bind( Address( "127.0.0.1", *metrics_port ) );
+      listener.listen();
+      daemon.serve_metrics( std::move( listener ) );
+    }
+    if ( not control_path.empty() ) {
+      ::unlink( control_path.c_str() ); // left by an earlier run
+      LocalStreamSocket listener;
+      listener.bind( Address::from_unix_path( control_path ) );
+      listener.listen();
+      daemon.serve_control( std::move( listener ) );
+    }
+
+    const FileDescriptor signal_fd = signals();
+    daemon.loop().add_reader( signal_fd, [&] {
+      signalfd_siginfo info {};
+      static_cast<void>( ::read( signal_fd.fd_num(), &info, sizeof( info ) ) );
+      daemon.stop();
+    } );
+
+    cerr << args.front() << ": routing between " << daemon.router().interface_count() << " interfaces\n";
+    daemon.run();
+    cerr << daemon.control( "stats" ) << "\n";
+
+    if ( not control_path.empty() ) {
+      ::unlink( control_path.c_str() );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
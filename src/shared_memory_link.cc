@@ -0,0 +1,424 @@
+#include "shared_memory_link.hh"
+
+#include "exception.hh"
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// The region's layout: a header, then each direction's ring control block, then each direction's descriptors,
+// then (from a page boundary) each direction's buffers. Offsets within the region fit in 32 bits.
+namespace {
+
+constexpr uint64_t region_magic = 0x314b4e494c4d4853; // "SHMLINK1"
+constexpr size_t rings_at = 64;
+constexpr size_t ring_stride = 192;
+constexpr size_t descriptors_at = rings_at + 2 * ring_stride;
+constexpr size_t descriptor_size = 8;
+
+struct RegionHeader
+{
+  uint64_t magic;
+  uint32_t slots;
+  uint32_t buffer_size;
+  uint32_t notify;
+};
+
+size_t buffers_at( const SharedMemoryLinkOptions& options )
+{
+  const size_t end = descriptors_at + 2 * options.slots * descriptor_size;
+  return ( end + 4095 ) / 4096 * 4096;
+}
+
+size_t region_length( const SharedMemoryLinkOptions& options )
+{
+  return buffers_at( options ) + 2 * static_cast<size_t>( options.slots ) * options.buffer_size;
+}
+
+void check_options( const SharedMemoryLinkOptions& options )
+{
+  if ( options.slots == 0 or ( options.slots & ( options.slots - 1 ) ) != 0 or options.buffer_size == 0
+       or region_length( options ) > UINT32_MAX ) {
+    throw runtime_error( "SharedMemoryLink needs a power-of-two number of slots, and under 4 GiB in all" );
+  }
+}
+
+} // namespace
+
+struct SharedMemoryLink::Region
+{
+  SharedMemoryLinkOptions options;
+  FileDescriptor memory;
+  array<FileDescriptor, 2> wakeups; // eventfd `i` is written when ring `i` has frames for an idle receiver
+  char* base;
+  size_t length;
+
+  Region( const SharedMemoryLinkOptions& shape, FileDescriptor&& region, array<FileDescriptor, 2>&& eventfds )
+    : options( shape )
+    , memory( std::move( region ) )
+    , wakeups( std::move( eventfds ) )
+    , base( nullptr )
+    , length( region_length( shape ) )
+  {
+    void* mapping
+      = ::mmap( nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, memory.fd_num(), 0 );
+    if ( mapping == MAP_FAILED ) {
+      throw unix_error( "mmap shared memory link" );
+    }
+    base = static_cast<char*>( mapping );
+  }
+
+  ~Region() { ::munmap( base, length ); }
+
+  Region( const Region& other ) = delete;
+  Region& operator=( const Region& other ) = delete;
+  Region( Region&& other ) = delete;
+  Region& operator=( Region&& other ) = delete;
+};
+
+shared_ptr<SharedMemoryLink::Region> SharedMemoryLink::create( const SharedMemoryLinkOptions& options )
+{
+  check_options( options );
+  FileDescriptor memory { CheckSystemCall( "memfd_create",
+                                           ::memfd_create( "shared-memory-link", MFD_CLOEXEC ) ) };
+  CheckSystemCall( "ftruncate", ::ftruncate( memory.fd_num(), static_cast<off_t>( region_length( options ) ) ) );
+  array<FileDescriptor, 2> wakeups {
+    FileDescriptor { CheckSystemCall( "eventfd", ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) },
+    FileDescriptor { CheckSystemCall( "eventfd", ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) } };
+  auto region = make_shared<Region>( options, std::move( memory ), std::move( wakeups ) );
+
+  // a new memfd reads as zeros: the rings start empty
+  const RegionHeader header { region_magic, options.slots, options.buffer_size, options.notify };
+  memcpy( region->base, &header, sizeof( header ) );
+  return region;
+}
+
+SharedMemoryLink::SharedMemoryLink( const SharedMemoryLinkOptions& options ) : region_( create( options ) ) {}
+
+const SharedMemoryLinkOptions& SharedMemoryLink::options() const
+{
+  return region_->options;
+}
+
+void SharedMemoryLink::send_over( const FileDescriptor& socket ) const
+{
+  const array<int, 3> fds {
+    region_->memory.fd_num(), region_->wakeups[0].fd_num(), region_->wakeups[1].fd_num() };
+  alignas( cmsghdr ) array<char, CMSG_SPACE( sizeof( fds ) )> control {};
+  char byte = 0;
+  iovec data { &byte, 1 };
+
+  msghdr message {};
+  message.msg_iov = &data;
+  message.msg_iovlen = 1;
+  message.msg_control = control.data();
+  message.msg_controllen = control.size();
+  cmsghdr* rights = CMSG_FIRSTHDR( &message );
+  rights->cmsg_level = SOL_SOCKET;
+  rights->cmsg_type = SCM_RIGHTS;
+  rights->cmsg_len = CMSG_LEN( sizeof( fds ) );
+  memcpy( CMSG_DATA( rights ), fds.data(), sizeof( fds ) );
+
+  CheckSystemCall( "sendmsg (shared memory link)", ::sendmsg( socket.fd_num(), &message, MSG_NOSIGNAL ) );
+}
+
+SharedMemoryLink SharedMemoryLink::receive_over( const FileDescriptor& socket )
+{
+  array<int, 3> fds {};
+  alignas( cmsghdr ) array<char, CMSG_SPACE( sizeof( fds ) )> control {};
+  char byte = 0;
+  iovec data { &byte, 1 };
+
+  msghdr message {};
+  message.msg_iov = &data;
+  message.msg_iovlen = 1;
+  message.msg_control = control.data();
+  message.msg_controllen = control.size();
+  CheckSystemCall( "recvmsg (shared memory link)", ::recvmsg( socket.fd_num(), &message, MSG_CMSG_CLOEXEC ) );
+
+  const cmsghdr* rights = CMSG_FIRSTHDR( &message );
+  if ( rights == nullptr or rights->cmsg_level != SOL_SOCKET or rights->cmsg_type != SCM_RIGHTS
+       or rights->cmsg_len != CMSG_LEN( sizeof( fds ) ) ) {
+    throw runtime_error( "SharedMemoryLink::receive_over: no link descriptors received" );
+  }
+  memcpy( fds.data(), CMSG_DATA( rights ), sizeof( fds ) );
+  FileDescriptor memory { fds[0] };
+  array<FileDescriptor, 2> wakeups { FileDescriptor { fds[1] }, FileDescriptor { fds[2] } };
+
+  RegionHeader header {};
+  if ( ::pread( memory.fd_num(), &header, sizeof( header ), 0 ) != sizeof( header )
+       or header.magic != region_magic ) {
+    throw runtime_error( "SharedMemoryLink::receive_over: not a shared memory link" );
+  }
+  const SharedMemoryLinkOptions options { header.slots, header.buffer_size, header.notify != 0 };
+  check_options( options );
+  struct stat status {};
+  CheckSystemCall( "fstat", ::fstat( memory.fd_num(), &status ) );
+  if ( status.st_size != static_cast<off_t>( region_length( options ) ) ) {
+    throw runtime_error( "SharedMemoryLink::receive_over: region has the wrong size" );
+  }
+  return SharedMemoryLink { make_shared<Region>( options, std::move( memory ), std::move( wakeups ) ) };
+}
+
+// A ring's control block: each index on its own cache line, so the two sides do not contend for one
+struct SharedMemoryDriver::Ring
+{
+  alignas( 64 ) atomic<uint32_t> head;        // slots published by the sender (free-running)
+  alignas( 64 ) atomic<uint32_t> tail;        // slots consumed by the receiver (free-running)
+  alignas( 64 ) atomic<uint32_t> need_wakeup; // the receiver is idle and waits on its eventfd
+};
+
+struct SharedMemoryDriver::Descriptor
+{
+  uint32_t offset; // of the frame's buffer, from the start of the region
+  uint32_t length;
+};
+
+SharedMemoryDriver::SharedMemoryDriver( SharedMemoryLink link, const End end, const size_t batch )
+  : link_( std::move( link ) )
+  , batch_( batch )
+  , base_( link_.region_->base )
+  , length_( link_.region_->length )
+  , mask_( link_.options().slots - 1 )
+  , buffer_size_( link_.options().buffer_size )
+  , notify_( link_.options().notify )
+  , tx_( nullptr )
+  , tx_descriptors_( nullptr )
+  , tx_buffers_( 0 )
+  , tx_wakeup_( nullptr )
+  , rx_( nullptr )
+  , rx_descriptors_( nullptr )
+  , rx_wakeup_( nullptr )
+{
+  static_assert( sizeof( Ring ) <= ring_stride );
+  static_assert( sizeof( Descriptor ) == descriptor_size );
+  static_assert( atomic<uint32_t>::is_always_lock_free ); // so it works between processes
+
+  if ( batch_ == 0 ) {
+    throw runtime_error( "SharedMemoryDriver needs a batch of at least one frame" );
+  }
+  const size_t tx = end == End::A ? 0 : 1;
+  const size_t rx = 1 - tx;
+  const size_t slots = mask_ + 1;
+  // NOLINTBEGIN(*-reinterpret-cast)
+  tx_ = reinterpret_cast<Ring*>( base_ + rings_at + tx * ring_stride );
+  rx_ = reinterpret_cast<Ring*>( base_ + rings_at + rx * ring_stride );
+  tx_descriptors_ = reinterpret_cast<Descriptor*>( base_ + descriptors_at + tx * slots * descriptor_size );
+  rx_descriptors_ = reinterpret_cast<Descriptor*>( base_ + descriptors_at + rx * slots * descriptor_size );
+  // NOLINTEND(*-reinterpret-cast)
+  tx_buffers_ = buffers_at( link_.options() ) + tx * slots * buffer_size_;
+  tx_wakeup_ = &link_.region_->wakeups[tx];
+  rx_wakeup_ = &link_.region_->wakeups[rx];
+
+  tx_head_ = tx_->head.load( memory_order_relaxed );
+  tx_tail_cache_ = tx_->tail.load( memory_order_acquire );
+  rx_tail_ = rx_->tail.load( memory_order_relaxed );
+  rx_head_cache_ = rx_tail_;
+  if ( notify_ ) {
+    rearm();
+  }
+}
+
+const FileDescriptor& SharedMemoryDriver::socket() const
+{
+  return *rx_wakeup_;
+}
+
+bool SharedMemoryDriver::slot_free()
+{
+  if ( tx_head_ - tx_tail_cache_ <= mask_ ) {
+    return true;
+  }
+  tx_tail_cache_ = tx_->tail.load( memory_order_acquire );
+  return tx_head_ - tx_tail_cache_ <= mask_;
+}
+
+template<class Filler>
+bool SharedMemoryDriver::fill_slot( const size_t length, Filler&& fill )
+{
+  if ( length > buffer_size_ ) {
+    stats_.send_errors++;
+    return false;
+  }
+  const uint32_t slot = tx_head_ & mask_;
+  const auto offset = static_cast<uint32_t>( tx_buffers_ + static_cast<size_t>( slot ) * buffer_size_ );
+  fill( base_ + offset );
+  tx_descriptors_[slot] = { offset, static_cast<uint32_t>( length ) };
+  tx_head_++;
+  stats_.frames_sent++;
+  stats_.bytes_sent += length;
+  return true;
+}
+
+void SharedMemoryDriver::publish()
+{
+  tx_->head.store( tx_head_, memory_order_release );
+  if ( notify_ ) {
+    // pairs with the fence in rearm(): either the receiver sees the new head, or we see its request
+    atomic_thread_fence( memory_order_seq_cst );
+    if ( tx_->need_wakeup.load( memory_order_relaxed ) and tx_->need_wakeup.exchange( 0 ) ) {
+      const uint64_t one = 1;
+      stats_.send_calls++;
+      static_cast<void>( ::write( tx_wakeup_->fd_num(), &one, sizeof( one ) ) );
+    }
+  }
+}
+
+void SharedMemoryDriver::rearm()
+{
+  if ( rx_tail_ != rx_head_cache_ or rx_->need_wakeup.load( memory_order_relaxed ) ) {
+    return; // frames still waiting (and the eventfd still readable), or already armed
+  }
+  uint64_t ignored = 0;
+  stats_.receive_calls++;
+  static_cast<void>( ::read( rx_wakeup_->fd_num(), &ignored, sizeof( ignored ) ) );
+  rx_->need_wakeup.store( 1, memory_order_relaxed );
+  atomic_thread_fence( memory_order_seq_cst );
+  if ( rx_->head.load( memory_order_acquire ) != rx_tail_ ) {
+    // a frame arrived before the sender could see the request: stay readable
+    rx_->need_wakeup.store( 0, memory_order_relaxed );
+    const uint64_t one = 1;
+    stats_.receive_calls++;
+    static_cast<void>( ::write( rx_wakeup_->fd_num(), &one, sizeof( one ) ) );
+  }
+}
+
+template<class Handler>
+size_t SharedMemoryDriver::receive_batch( const size_t max, Handler&& handle )
+{
+  const uint32_t start = rx_tail_;
+  size_t received = 0;
+  while ( received < max ) {
+    if ( rx_tail_ == rx_head_cache_ ) {
+      rx_head_cache_ = rx_->head.load( memory_order_acquire );
+      if ( rx_tail_ == rx_head_cache_ ) {
+        break;
+      }
+    }
+    // the descriptor comes from another process: check it before believing it
+    const Descriptor descriptor = rx_descriptors_[rx_tail_ & mask_];
+    rx_tail_++;
+    const bool in_bounds = descriptor.length <= buffer_size_ and descriptor.offset <= length_ - descriptor.length;
+    if ( not in_bounds or not handle( string_view { base_ + descriptor.offset, descriptor.length } ) ) {
+      stats_.malformed++;
+      continue;
+    }
+    stats_.frames_received++;
+    stats_.bytes_received += descriptor.length;
+    received++;
+  }
+
+  if ( rx_tail_ != start ) {
+    rx_->tail.store( rx_tail_, memory_order_release ); // hands the buffers back to the sender
+  }
+  if ( notify_ ) {
+    rearm();
+  }
+  return received;
+}
+
+size_t SharedMemoryDriver::receive_frames( const size_t max, const function<void( string_view )>& handle )
+{
+  return receive_batch( max, [&]( string_view frame ) {
+    handle( frame );
+    return true;
+  } );
+}
+
+size_t SharedMemoryDriver::send_frames( span<const string_view> frames )
+{
+  size_t consumed = 0;
+  while ( consumed < frames.size() and slot_free() ) {
+    const string_view frame = frames[consumed++];
+    fill_slot( frame.size(), [&]( char* bytes ) { memcpy( bytes, frame.data(), frame.size() ); } );
+  }
+  if ( consumed > 0 ) {
+    publish();
+  }
+  return consumed;
+}
+
+namespace {
+
+// Parse the header in place, and copy the payload out once
+bool parse_frame( string_view bytes, EthernetFrame& frame )
+{
+  if ( bytes.size() < EthernetHeader::LENGTH ) {
+    return false;
+  }
+  memcpy( frame.header.dst.data(), bytes.data(), frame.header.dst.size() );
+  memcpy( frame.header.src.data(), bytes.data() + 6, frame.header.src.size() );
+  frame.header.type
+    = static_cast<uint16_t>( static_cast<uint8_t>( bytes[12] ) << 8 | static_cast<uint8_t>( bytes[13] ) );
+  frame.payload.emplace_back( string( bytes.substr( EthernetHeader::LENGTH ) ) );
+  return true;
+}
+
+} // namespace
+
+size_t SharedMemoryDriver::receive( AsyncNetworkInterface& interface )
+{
+  return receive_batch( batch_, [&]( string_view bytes ) {
+    EthernetFrame frame;
+    if ( not parse_frame( bytes, frame ) ) {
+      return false;
+    }
+    interface.recv_frame( frame );
+    return true;
+  } );
+}
+
+size_t SharedMemoryDriver::receive( NetworkInterface& interface,
+                                    const function<void( InternetDatagram&& )>& deliver )
+{
+  return receive_batch( batch_, [&]( string_view bytes ) {
+    EthernetFrame frame;
+    if ( not parse_frame( bytes, frame ) ) {
+      return false;
+    }
+    auto dgram = interface.recv_frame( frame );
+    if ( dgram.has_value() ) {
+      deliver( std::move( *dgram ) );
+    }
+    return true;
+  } );
+}
+
+size_t SharedMemoryDriver::send( NetworkInterface& interface )
+{
+  size_t sent = 0;
+  while ( sent < batch_ and slot_free() ) {
+    auto frame = interface.maybe_send();
+    if ( not frame.has_value() ) {
+      break;
+    }
+    size_t length = EthernetHeader::LENGTH;
+    for ( const auto& buffer : frame->payload ) {
+      length += buffer.size();
+    }
+    const bool filled = fill_slot( length, [&]( char* bytes ) {
+      memcpy( bytes, frame->header.dst.data(), frame->header.dst.size() );
+      memcpy( bytes + 6, frame->header.src.data(), frame->header.src.size() );
+      bytes[12] = static_cast<char>( frame->header.type >> 8 );
+      bytes[13] = static_cast<char>( frame->header.type & 0xff );
+      char* next = bytes + EthernetHeader::LENGTH;
+      for ( const auto& buffer : frame->payload ) {
+        const string_view fragment = buffer;
+        memcpy( next, fragment.data(), fragment.size() );
+        next += fragment.size();
+      }
+    } );
+    sent += filled ? 1 : 0;
+  }
+  if ( sent > 0 ) {
+    publish();
+  }
+  return sent;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "link_driver.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string_view>
+
+// Shape of a SharedMemoryLink
+struct SharedMemoryLinkOptions
+{
+  uint32_t slots = 1024;       // frames each direction can hold; a power of two
+  uint32_t buffer_size = 2048; // bytes per frame buffer; larger outgoing frames are counted as send errors
+  bool notify = true;          // wake an idle receiver through an eventfd (otherwise receivers must poll)
+};
+
+// A point-to-point Ethernet link through shared memory, in the style of memif: one memfd region holds a
+// single-producer, single-consumer descriptor ring for each direction and the pool of frame buffers the
+// descriptors point into, one buffer per slot, recycled as the consumer passes it. Two SharedMemoryDrivers,
+// one at each End, move frames over it without any system call on the data path.
+//
+// The region and its eventfds pass to another process either by fork(), or over a Unix-domain socket
+// (send_over() and receive_over(), with SCM_RIGHTS).
+class SharedMemoryLink
+{
+  struct Region;
+  std::shared_ptr<Region> region_;
+
+  explicit SharedMemoryLink( std::shared_ptr<Region> region ) : region_( std::move( region ) ) {}
+  static std::shared_ptr<Region> create( const SharedMemoryLinkOptions& options );
+
+public:
+  // Create a new region
+  explicit SharedMemoryLink( const SharedMemoryLinkOptions& options = {} );
+
+  // Hand the region to the process at the other end of a connected Unix-domain socket, which calls
+  // receive_over(); throws unix_error
+  void send_over( const FileDescriptor& socket ) const;
+  static SharedMemoryLink receive_over( const FileDescriptor& socket );
+
+  // Another handle on the same region (e.g. for the other End, in the same process)
+  SharedMemoryLink duplicate() const { return SharedMemoryLink { region_ }; }
+
+  const SharedMemoryLinkOptions& options() const;
+
+  friend class SharedMemoryDriver;
+
+  ~SharedMemoryLink() = default;
+  SharedMemoryLink( const SharedMemoryLink& other ) = delete;
+  SharedMemoryLink& operator=( const SharedMemoryLink& other ) = delete;
+  SharedMemoryLink( SharedMemoryLink&& other ) = default;
+  SharedMemoryLink& operator=( SharedMemoryLink&& other ) = default;
+};
+
+// Connects a NetworkInterface to one End of a SharedMemoryLink. Sending writes each frame's header and
+// payload Buffers straight into a free buffer and publishes its descriptor; receiving parses the header in
+// place and copies only the payload out, once. Neither makes a system call, except that with
+// SharedMemoryLinkOptions::notify, a sender writes the peer's eventfd when the peer has gone idle.
+//
+// With notify, socket() becomes readable when frames are waiting; without it, call receive() in a loop.
+// Each End must be driven by one thread at a time.
+class SharedMemoryDriver : public LinkDriver
+{
+public:
+  enum class End : uint8_t
+  {
+    A, // sends on the first ring, receives on the second
+    B, // the reverse
+  };
+
+  static constexpr size_t default_batch = 64;
+
+  SharedMemoryDriver( SharedMemoryLink link, End end, size_t batch = default_batch );
+
+  size_t receive( AsyncNetworkInterface& interface ) override;
+  size_t receive( NetworkInterface& interface, const std::function<void( InternetDatagram&& )>& deliver );
+  size_t send( NetworkInterface& interface ) override;
+
+  // Raw frames, for benchmarks and for peers that are not NetworkInterfaces: send as many of `frames` as
+  // there is room for, and receive up to `max` waiting frames; each returns the number of frames
+  size_t send_frames( std::span<const std::string_view> frames );
+  size_t receive_frames( size_t max, const std::function<void( std::string_view )>& handle );
+
+  // The eventfd that the peer writes when this End has frames waiting
+  const FileDescriptor& socket() const override;
+  const DriverStats& stats() const override { return stats_; }
+
+  ~SharedMemoryDriver() override = default;
+  SharedMemoryDriver( const SharedMemoryDriver& other ) = delete;
+  SharedMemoryDriver& operator=( const SharedMemoryDriver& other ) = delete;
+  SharedMemoryDriver( SharedMemoryDriver&& other ) = delete;
+  SharedMemoryDriver& operator=( SharedMemoryDriver&& other ) = delete;
+
+private:
+  struct Ring;
+  struct Descriptor;
+
+  // Whether there is a free slot to send in
+  bool slot_free();
+  // Fill the next free slot with `length` bytes written by `fill( char* )` (false if it does not fit)
+  template<class Filler>
+  bool fill_slot( size_t length, Filler&& fill );
+  // Publish the filled slots to the receiver, waking it if it asked
+  void publish();
+
+  // Hand up to `max` waiting frames to `handle( std::string_view )`, which returns false for a frame it finds
+  // malformed; only the frames it takes count as received
+  template<class Handler>
+  size_t receive_batch( size_t max, Handler&& handle );
+  // After a receive: if the ring is empty, ask the sender for a wakeup (without missing one)
+  void rearm();
+
+  SharedMemoryLink link_;
+  size_t batch_;
+  char* base_;
+  size_t length_;
+  uint32_t mask_;
+  uint32_t buffer_size_;
+  bool notify_;
+
+  Ring* tx_;
+  Descriptor* tx_descriptors_;
+  size_t tx_buffers_;         // offset of the first buffer for the send ring
+  uint32_t tx_head_ {};       // next slot to fill (published up to the last publish())
+  uint32_t tx_tail_cache_ {}; // the receiver's tail, as last read
+  const FileDescriptor* tx_wakeup_;
+
+  Ring* rx_;
+  Descriptor* rx_descriptors_;
+  uint32_t rx_tail_ {};       // next slot to read
+  uint32_t rx_head_cache_ {}; // the sender's head, as last read
+  const FileDescriptor* rx_wakeup_;
+
+  DriverStats stats_ {};
+};
@@ -0,0 +1,44 @@
+#include "packet_trace.hh"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <string>
+
+using namespace std;
+
+// Print the events in a trace dump (see install_trace_crash_handler() and write_trace_dump())
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
+    }
+
+    auto args = span( argv, argc );
+
+    if ( argc != 2 and argc != 3 ) {
+      cerr << "Usage: " << args.front() << " DUMPFILE [EVENTS]\n";
+      cerr << "\tPrints the last EVENTS (default: all) events recorded by each thread.\n";
+      return EXIT_FAILURE;
+    }
+
+    ifstream dump { args[1], ios::binary };
+    if ( not dump ) {
+      cerr << args.front() << ": cannot open " << args[1] << "\n";
+      return EXIT_FAILURE;
+    }
+    const size_t events = argc == 3 ? stoul( args[2] ) : TraceRing::capacity;
+
+    for ( const auto& section : read_trace_dump( dump ) ) {
+      cout << "thread " << section.thread << ": " << section.events.size() << " events\n";
+      print_trace( cout, section, events );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
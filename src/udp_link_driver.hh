@@ -0,0 +1,65 @@
+#pragma once
+
+#include "link_driver.hh"
+#include "socket.hh"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <sys/socket.h>
+#include <vector>
+
+// Connects a NetworkInterface to a peer's through a UDP socket: each Ethernet frame travels whole, header and
+// all, as one datagram. Two drivers pointed at each other make a point-to-point link, so router processes on
+// one host can be wired into any topology without privileges or devices (see scripts/udp-topology).
+//
+// The socket is connected to the peer, so only the peer's datagrams arrive. Frames are received with
+// recvmmsg() and sent with sendmmsg(), a batch per system call, each gathered straight from its Buffers.
+// While the peer is not listening, the kernel refuses its datagrams; they are counted as send errors.
+class UdpLinkDriver : public LinkDriver
+{
+public:
+  static constexpr size_t default_batch = 32;
+  static constexpr size_t default_max_frame = 16384; // larger frames are counted as truncated and dropped
+  static constexpr int socket_buffer_bytes = 4 << 20;
+
+  UdpLinkDriver( const Address& local,
+                 const Address& peer,
+                 size_t batch = default_batch,
+                 size_t max_frame = default_max_frame );
+
+  // Both ends on 127.0.0.1, as used by RouterDaemon for a device named "udp:LOCAL_PORT:PEER_PORT"
+  UdpLinkDriver( uint16_t local_port, uint16_t peer_port );
+
+  // Receive up to one batch of waiting frames into `interface`; returns the number of frames received
+  size_t receive( AsyncNetworkInterface& interface ) override;
+
+  // Same for a plain NetworkInterface, handing each datagram it returns to `deliver`
+  size_t receive( NetworkInterface& interface, const std::function<void( InternetDatagram&& )>& deliver );
+
+  // Send up to one batch of frames from `interface.maybe_send()`; returns the number sent
+  size_t send( NetworkInterface& interface ) override;
+
+  const UDPSocket& socket() const override { return socket_; }
+  const DriverStats& stats() const override { return stats_; }
+
+private:
+  template<class Handler>
+  size_t receive_batch( Handler&& handle );
+
+  UDPSocket socket_ {};
+  size_t batch_;
+  size_t max_frame_;
+  DriverStats stats_ {};
+
+  // receive side: one buffer and message per batch slot
+  std::vector<char> rx_buffers_;
+  std::vector<iovec> rx_iovecs_;
+  std::vector<mmsghdr> rx_messages_;
+
+  // send side: the frames in flight, their serialized headers, and one iovec per header or payload Buffer
+  std::vector<EthernetFrame> tx_frames_ {};
+  std::vector<std::array<char, EthernetHeader::LENGTH>> tx_headers_;
+  std::vector<iovec> tx_iovecs_ {};
+  std::vector<mmsghdr> tx_messages_;
+};
@@ -2,6 +2,7 @@
 
 #include <iomanip>
 #include <iostream>
+#include <sys/mman.h>
 #include <unistd.h>
 
 using namespace std;
@@ -58,3 +59,29 @@ string Printer::with_color( int color_value, string_view str ) const
 
   return ret;
 }
+
+void check( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw ExpectationViolation { "check failed: " + what };
+  }
+}
+
+string pattern( size_t length )
+{
+  string data;
+  for ( size_t i = 0; i < length; i++ ) {
+    data.push_back( static_cast<char>( 'a' + i * 7 % 26 ) );
+  }
+  return data;
+}
+
+FileDescriptor make_file( const string& contents )
+{
+  FileDescriptor file { CheckSystemCall( "memfd_create", ::memfd_create( "test", MFD_CLOEXEC ) ) };
+  for ( size_t written = 0; written < contents.size(); ) {
+    written += file.write( string_view { contents }.substr( written ) );
+  }
+  CheckSystemCall( "lseek", ::lseek( file.fd_num(), 0, SEEK_SET ) );
+  return file;
+}
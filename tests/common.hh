@@ -2,6 +2,7 @@
 
 #include "conversions.hh"
 #include "exception.hh"
+#include "file_descriptor.hh"
 
 #include <memory>
 #include <stdexcept>
@@ -156,3 +157,14 @@ struct ExpectNumber : public Expectation<T>
     }
   }
 };
+
+// For tests written as a plain main() rather than with a TestHarness:
+
+// Throw an ExpectationViolation naming `what` unless `condition` holds
+void check( bool condition, const std::string& what );
+
+// `length` bytes of a repeating pattern of letters, so that a byte out of place shows
+std::string pattern( size_t length );
+
+// An anonymous in-memory file holding `contents`, positioned at its start
+FileDescriptor make_file( const std::string& contents = {} );
@@ -0,0 +1,124 @@
+#include "common.hh"
+#include "event_loop.hh"
+#include "socket.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+// Readers are called while data waits (level-triggered), and hooks run once per turn after them
+void test_readers_and_hooks()
+{
+  EventLoop loop;
+  UDPSocket receiver;
+  receiver.bind( Address( "127.0.0.1", 0 ) );
+  receiver.set_blocking( false );
+  UDPSocket sender;
+
+  vector<string> received;
+  string order;
+  loop.add_reader( receiver, [&] {
+    Address source { "0.0.0.0" };
+    string payload;
+    receiver.recv( source, payload );
+    received.push_back( payload );
+    order += "r";
+  } );
+  loop.after_events( [&] { order += "h"; } );
+
+  for ( int i = 0; i < 3; i++ ) {
+    sender.sendto( receiver.local_address(), "datagram " + to_string( i ) );
+  }
+  for ( int turn = 0; turn < 3; turn++ ) {
+    check( loop.run_once( milliseconds( 1000 ) ) == 1, "one ready descriptor per turn" );
+  }
+  check( received == vector<string> { "datagram 0", "datagram 1", "datagram 2" }, "datagrams in order" );
+  check( order == "rhrhrh", "hooks after the readers: " + order );
+
+  check( loop.run_once( milliseconds( 10 ) ) == 0, "an idle turn times out" );
+  check( order == "rhrhrhh", "hooks run on idle turns too" );
+  check( loop.turns() == 4 and loop.events() == 3, "turns and events counted" );
+}
+
+// A timer reports the time that really passed, and a removed registration (even its own) is never called again
+void test_timers_and_remove()
+{
+  EventLoop loop;
+  vector<uint64_t> elapsed;
+  EventLoop::Id timer = 0;
+  timer = loop.add_timer( milliseconds( 5 ), [&]( uint64_t ns ) {
+    elapsed.push_back( ns );
+    if ( elapsed.size() == 3 ) {
+      loop.remove( timer ); // from inside its own callback
+    }
+  } );
+
+  const auto deadline = steady_clock::now() + milliseconds( 100 );
+  while ( steady_clock::now() < deadline ) {
+    loop.run_once( milliseconds( 10 ) );
+  }
+  check( elapsed.size() == 3, "timer fired until removed: " + to_string( elapsed.size() ) );
+  // any one call can be short (on time after a late one), but together they cover three or more intervals
+  uint64_t total = 0;
+  for ( const uint64_t ns : elapsed ) {
+    total += ns;
+  }
+  check( total >= 15'000'000, "elapsed time at least the intervals that expired: " + to_string( total ) );
+
+  // a late loop still learns the whole elapsed time
+  vector<uint64_t> late;
+  loop.add_timer( milliseconds( 1 ), [&]( uint64_t ns ) { late.push_back( ns ); } );
+  this_thread::sleep_for( milliseconds( 30 ) );
+  loop.run_once( milliseconds( 10 ) );
+  check( late.size() == 1 and late.front() >= 30'000'000, "one call for many missed expirations" );
+
+  // a zero interval would never fire
+  bool threw = false;
+  try {
+    loop.add_timer( milliseconds( 0 ), []( uint64_t ) {} );
+  } catch ( const runtime_error& ) {
+    threw = true;
+  }
+  check( threw, "zero interval refused" );
+}
+
+// stop() from another thread ends run()
+void test_stop()
+{
+  EventLoop loop;
+  uint64_t ticks = 0;
+  loop.add_timer( milliseconds( 1 ), [&]( uint64_t ) { ticks++; } );
+  thread stopper { [&] {
+    this_thread::sleep_for( milliseconds( 30 ) );
+    loop.stop();
+  } };
+  loop.run();
+  stopper.join();
+  check( ticks > 0, "timer ran before the stop" );
+
+  // a stop() before run() is not lost
+  loop.stop();
+  loop.run();
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_readers_and_hooks();
+    test_timers_and_remove();
+    test_stop();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,166 @@
+#include "common.hh"
+#include "exception.hh"
+#include "socket.hh"
+
+#include <array>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+uint64_t load( const atomic<uint64_t>& counter )
+{
+  return counter.load( memory_order_relaxed );
+}
+
+pair<FileDescriptor, FileDescriptor> make_pipe()
+{
+  array<int, 2> ends {};
+  CheckSystemCall( "pipe2", ::pipe2( ends.data(), O_CLOEXEC | O_NONBLOCK ) );
+  return { FileDescriptor { ends[0] }, FileDescriptor { ends[1] } };
+}
+
+// Descriptors opened while statistics are off have none
+void test_disabled()
+{
+  check( not FDStats::enabled(), "off by default" );
+  auto [reader, writer] = make_pipe();
+  writer.write( "hello" );
+  string data;
+  reader.read( data );
+  check( reader.stats() == nullptr and writer.stats() == nullptr, "no statistics" );
+  check( FDStats::live() == 0, "nothing registered" );
+}
+
+// Bytes, short transfers, EAGAIN, errors and latencies, per direction
+void test_pipe()
+{
+  FDStats::enable( true );
+  auto [reader, writer] = make_pipe();
+  check( reader.stats() != nullptr and FDStats::live() == 2, "tracked and registered" );
+
+  string data;
+  reader.read( data ); // nothing there yet: EAGAIN
+  writer.write( "0123456789" );
+  reader.read( data ); // 10 of the 16 KiB asked for: short
+  writer.write( vector<string_view> { "abc", "def" } );
+  array<char, 6> exact {};
+  check( reader.try_read( exact ).bytes == 6, "exact read" );
+  check( writer.try_read( exact ).failed(), "reading the write end fails" );
+
+  const FDStats& reads = *reader.stats();
+  check( load( reads.reads.calls ) == 3, "read calls: " + to_string( load( reads.reads.calls ) ) );
+  check( load( reads.reads.bytes ) == 16, "bytes read" );
+  check( load( reads.reads.short_calls ) == 1, "one short read" );
+  check( load( reads.reads.would_block ) == 1, "one EAGAIN" );
+  check( reads.reads.latency_ns.count() == 3, "every call timed" );
+  check( load( reads.writes.calls ) == 0, "no writes on the read end" );
+
+  const FDStats& writes = *writer.stats();
+  check( load( writes.writes.calls ) == 2 and load( writes.writes.bytes ) == 16, "writes" );
+  check( load( writes.writes.short_calls ) == 0, "no short writes" );
+  check( load( writes.reads.errors ) == 1, "the failed read counted as an error" );
+
+  // filling the pipe: the last write is short, then one would block
+  const string big( 1 << 20, 'x' );
+  check( writer.try_write( big ).ok(), "partial write" );
+  check( writer.try_write( big ).would_block(), "full" );
+  check( load( writes.writes.short_calls ) == 1 and load( writes.writes.would_block ) == 1, "short and EAGAIN" );
+
+  ostringstream dump;
+  FDStats::dump( dump );
+  const string reader_line = "fd " + to_string( reader.fd_num() ) + " read calls 3 bytes 16 short 1 eagain 1";
+  check( dump.str().find( reader_line ) != string::npos, "dump: " + dump.str() );
+  FDStats::enable( false );
+}
+
+// Datagram batches count bytes, not messages; a descriptor leaves the registry when its last handle goes
+void test_datagrams()
+{
+  FDStats::enable( true );
+  {
+    UDPSocket receiver;
+    receiver.bind( Address( "127.0.0.1", 0 ) );
+    UDPSocket sender;
+    sender.connect( receiver.local_address() );
+    sender.send( "one" );
+    sender.send( "three" );
+
+    array<array<char, 64>, 4> buffers {};
+    array<DatagramSocket::Slot, 4> slots {};
+    for ( size_t i = 0; i < slots.size(); i++ ) {
+      slots[i].buffer = buffers[i];
+    }
+    check( receiver.recv_batch( slots ) == 2, "batch" );
+    const FDStats::Direction& reads = receiver.stats()->reads;
+    check( load( reads.calls ) == 1 and load( reads.bytes ) == 8, "batch bytes" );
+    check( load( reads.short_calls ) == 0, "a datagram is never short" );
+    check( FDStats::live() == 2, "two live" );
+  }
+  check( FDStats::live() == 0, "gone with their descriptors" );
+  FDStats::enable( false );
+}
+
+// A transfer that finds its source dry is one read for the source and no write for the destination
+void test_transfer()
+{
+  FDStats::enable( true );
+  auto [source, feeder] = make_pipe();
+  auto [output, destination] = make_pipe();
+  const FDStats::Direction& writes = destination.stats()->writes;
+  check( source.transfer_to( destination, 100 ) == 0, "nothing to move" );
+  check( load( source.stats()->reads.would_block ) == 1, "the source would block" );
+  check( load( writes.calls ) == 0, "no write recorded" );
+
+  feeder.write( "0123456789" );
+  check( source.transfer_to( destination, 100 ) == 10, "moved" );
+  check( load( writes.calls ) == 1 and load( writes.bytes ) == 10, "one write" );
+  FDStats::enable( false );
+}
+
+// Each accept counts as a read of no bytes on the listening socket, and EAGAIN when nobody is waiting
+void test_accept()
+{
+  FDStats::enable( true );
+  TCPSocket listener;
+  listener.set_blocking( false );
+  listener.bind( Address( "127.0.0.1", 0 ) );
+  listener.listen();
+
+  optional<TCPSocket> connection;
+  check( listener.try_accept( connection ).would_block(), "nobody waiting" );
+  TCPSocket client;
+  client.connect( listener.local_address() );
+  check( listener.try_accept( connection ).ok() and connection.has_value(), "accepted" );
+
+  const FDStats::Direction& reads = listener.stats()->reads;
+  check( load( reads.calls ) == 2 and load( reads.bytes ) == 0, "accept calls" );
+  check( load( reads.would_block ) == 1 and load( reads.errors ) == 0, "one EAGAIN" );
+  check( reads.latency_ns.count() == 2, "every accept timed" );
+  FDStats::enable( false );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_disabled();
+    test_pipe();
+    test_datagrams();
+    test_transfer();
+    test_accept();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,181 @@
+#include "common.hh"
+#include "exception.hh"
+#include "socket.hh"
+
+#include <array>
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+string read_all( FileDescriptor& fd )
+{
+  string all;
+  string chunk;
+  while ( not fd.eof() ) {
+    fd.read( chunk );
+    all.append( chunk );
+  }
+  return all;
+}
+
+pair<FileDescriptor, FileDescriptor> make_pipe()
+{
+  array<int, 2> ends {};
+  CheckSystemCall( "pipe2", ::pipe2( ends.data(), O_CLOEXEC ) );
+  return { FileDescriptor { ends[0] }, FileDescriptor { ends[1] } };
+}
+
+// A file copied to another file, in a few large steps
+void test_file_to_file()
+{
+  const string contents = pattern( 3'000'000 );
+  FileDescriptor source = make_file( contents );
+  FileDescriptor destination = make_file();
+
+  check( source.transfer_to( destination, 1000 ) == 1000, "a prefix" );
+  check( source.transfer_to( destination, 10'000'000 ) == contents.size() - 1000, "the rest, stopping at EOF" );
+  check( source.eof(), "EOF noticed" );
+  check( source.read_count() <= 6, "few system calls: " + to_string( source.read_count() ) );
+
+  CheckSystemCall( "lseek", ::lseek( destination.fd_num(), 0, SEEK_SET ) );
+  check( read_all( destination ) == contents, "file contents" );
+}
+
+// A file through a pipe (drained by another thread) into another file
+void test_pipes()
+{
+  const string contents = pattern( 1'000'000 );
+  FileDescriptor source = make_file( contents );
+  FileDescriptor destination = make_file();
+  auto [pipe_out, pipe_in] = make_pipe();
+
+  thread consumer { [&] {
+    while ( not pipe_out.eof() ) {
+      pipe_out.transfer_to( destination, 1 << 20 );
+    }
+  } };
+  check( source.transfer_to( pipe_in, contents.size() ) == contents.size(), "file to pipe" );
+  pipe_in.close();
+  consumer.join();
+
+  CheckSystemCall( "lseek", ::lseek( destination.fd_num(), 0, SEEK_SET ) );
+  check( read_all( destination ) == contents, "contents after the pipe" );
+}
+
+// A file sent over TCP, relayed from one connection to another (socket to socket, through the internal pipe)
+void test_tcp_relay()
+{
+  TCPSocket listener;
+  listener.bind( Address( "127.0.0.1", 0 ) );
+  listener.listen();
+  TCPSocket sender;
+  sender.connect( listener.local_address() );
+  TCPSocket relay_in = listener.accept();
+  TCPSocket relay_out;
+  relay_out.connect( listener.local_address() );
+  TCPSocket receiver = listener.accept();
+
+  const string contents = pattern( 2'000'000 );
+  FileDescriptor file = make_file( contents );
+  thread send_file { [&] {
+    check( file.transfer_to( sender, contents.size() ) == contents.size(), "file to socket" );
+    sender.shutdown( SHUT_WR );
+  } };
+  thread relay { [&] {
+    while ( not relay_in.eof() ) {
+      relay_in.transfer_to( relay_out, 1 << 20 );
+    }
+    relay_out.shutdown( SHUT_WR );
+  } };
+  const string received = read_all( receiver );
+  send_file.join();
+  relay.join();
+  check( received == contents, "contents after the relay" );
+}
+
+// A relay whose destination fails mid-transfer leaves nothing behind for the next relay on the thread (the
+// socket-to-socket pipe is shared)
+void test_failed_relay()
+{
+  static_cast<void>( signal( SIGPIPE, SIG_IGN ) );
+  TCPSocket listener;
+  listener.bind( Address( "127.0.0.1", 0 ) );
+  listener.listen();
+  const auto connect = [&]( TCPSocket& near ) {
+    near.connect( listener.local_address() );
+    return listener.accept();
+  };
+
+  TCPSocket writer_one;
+  TCPSocket source_one = connect( writer_one );
+  TCPSocket destination_one;
+  TCPSocket peer_one = connect( destination_one );
+  destination_one.shutdown( SHUT_WR ); // so splicing into it fails with EPIPE
+  writer_one.write( "SECRET-FROM-ONE-24bytes!" );
+
+  bool failed = false;
+  try {
+    source_one.transfer_to( destination_one, 24 );
+  } catch ( const unix_error& e ) {
+    failed = e.code().value() == EPIPE;
+  }
+  check( failed, "relay into a shut-down socket fails with EPIPE" );
+
+  TCPSocket writer_two;
+  TCPSocket source_two = connect( writer_two );
+  TCPSocket destination_two;
+  TCPSocket peer_two = connect( destination_two );
+  writer_two.write( "hello-twelve" );
+  check( source_two.transfer_to( destination_two, 12 ) == 12, "second relay" );
+  destination_two.shutdown( SHUT_WR );
+  const string received = read_all( peer_two );
+  check( received == "hello-twelve", "second relay carried only its own bytes, not: " + received );
+}
+
+// A non-blocking source with nothing waiting moves nothing, and is not at EOF
+void test_non_blocking()
+{
+  auto [pipe_out, pipe_in] = make_pipe();
+  pipe_out.set_blocking( false );
+  FileDescriptor destination = make_file();
+  check( pipe_out.transfer_to( destination, 100 ) == 0 and not pipe_out.eof(), "nothing yet" );
+  pipe_in.write( "hello" );
+  check( pipe_out.transfer_to( destination, 100 ) == 5, "what was there" );
+}
+
+// A character device is neither a file nor a pipe nor a socket: read() and write() it is
+void test_fallback()
+{
+  FileDescriptor zeros { CheckSystemCall( "open", ::open( "/dev/zero", O_RDONLY | O_CLOEXEC ) ) };
+  FileDescriptor destination = make_file();
+  check( zeros.transfer_to( destination, 100'000 ) == 100'000, "copied" );
+  CheckSystemCall( "lseek", ::lseek( destination.fd_num(), 0, SEEK_SET ) );
+  check( read_all( destination ) == string( 100'000, 0 ), "zeros" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_file_to_file();
+    test_pipes();
+    test_tcp_relay();
+    test_failed_relay();
+    test_non_blocking();
+    test_fallback();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,217 @@
+#include "common.hh"
+#include "exception.hh"
+#include "io_uring_loop.hh"
+#include "packet_socket_driver.hh"
+#include "socket.hh"
+#include "veth_pair.hh"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <poll.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+// Run the loop until `done` (or give up after a few seconds)
+template<class Predicate>
+void run_until( IOUringLoop& loop, Predicate&& done, const string& what )
+{
+  const auto deadline = steady_clock::now() + seconds( 5 );
+  while ( not done() ) {
+    check( steady_clock::now() < deadline, "timed out waiting for " + what );
+    loop.wait( milliseconds( 10 ) );
+  }
+}
+
+// Many writes of several Buffers each, queued at once, arrive whole and in order through a multishot receive
+void test_tcp_stream()
+{
+  TCPSocket listener;
+  listener.set_reuseaddr();
+  listener.bind( Address( "127.0.0.1", 0 ) );
+  listener.listen();
+  TCPSocket client;
+  client.connect( listener.local_address() );
+  TCPSocket server = listener.accept();
+
+  IOUringLoop loop;
+  loop.add_buffer_ring( 1, 16, 4096 );
+
+  string received;
+  optional<int> closed;
+  loop.recv_multishot(
+    server, 1, [&]( string_view data ) { received.append( data ); }, [&]( int result ) { closed = result; } );
+
+  constexpr size_t writes = 500;
+  string expected;
+  size_t completed = 0;
+  size_t reported_bytes = 0;
+  for ( size_t i = 0; i < writes; i++ ) {
+    vector<Buffer> buffers;
+    for ( size_t part = 0; part < 3; part++ ) {
+      const size_t length = 100 + ( i * 37 + part * 11 ) % 900;
+      buffers.emplace_back( string( length, static_cast<char>( 'a' + ( i + part ) % 26 ) ) );
+      expected.append( string_view { buffers.back() } );
+    }
+    loop.write( client, std::move( buffers ), [&]( int result ) {
+      check( result > 0, "write result" );
+      completed++;
+      reported_bytes += result;
+    } );
+  }
+
+  run_until( loop, [&] { return completed == writes and received.size() == expected.size(); }, "the stream" );
+  check( received == expected, "stream contents" );
+  check( reported_bytes == expected.size(), "bytes reported by the writes" );
+  check( loop.enter_calls() < writes / 4, "writes batched: " + to_string( loop.enter_calls() ) + " enters" );
+
+  client.shutdown( SHUT_WR );
+  run_until( loop, [&] { return closed.has_value(); }, "EOF" );
+  check( *closed == 0, "EOF reported as 0" );
+  check( loop.pending() == 0, "nothing left pending" );
+}
+
+// Datagrams keep their boundaries, and a receive that runs out of buffers starts again
+void test_udp_datagrams()
+{
+  UDPSocket receiver;
+  receiver.bind( Address( "127.0.0.1", 0 ) );
+  UDPSocket sender;
+
+  IOUringLoop loop;
+  loop.add_buffer_ring( 7, 2, 2048 ); // fewer buffers than datagrams in flight
+
+  vector<string> received;
+  loop.recv_multishot( receiver, 7, [&]( string_view data ) { received.emplace_back( data ); } );
+
+  constexpr size_t datagrams = 64;
+  for ( size_t i = 0; i < datagrams; i++ ) {
+    sender.sendto( receiver.local_address(), "datagram " + to_string( i ) );
+  }
+
+  run_until( loop, [&] { return received.size() == datagrams; }, "the datagrams" );
+  for ( size_t i = 0; i < datagrams; i++ ) {
+    check( received[i] == "datagram " + to_string( i ), "datagram " + to_string( i ) );
+  }
+}
+
+// A timeout fires after its delay; a cancelled one never does
+void test_timeouts()
+{
+  IOUringLoop loop;
+  bool fired = false;
+  bool cancelled_fired = false;
+  const auto start = steady_clock::now();
+  loop.add_timeout( milliseconds( 20 ), [&]( int result ) {
+    check( result == 0, "timeout result" );
+    fired = true;
+  } );
+  const auto cancelled = loop.add_timeout( milliseconds( 5 ), [&]( int ) { cancelled_fired = true; } );
+  loop.cancel( cancelled );
+
+  run_until( loop, [&] { return fired; }, "the timeout" );
+  check( steady_clock::now() - start >= milliseconds( 20 ), "timeout waited" );
+  check( not cancelled_fired, "cancelled timeout stayed quiet" );
+  while ( loop.pending() > 0 ) {
+    loop.wait( milliseconds( 10 ) );
+  }
+
+  // waiting with nothing to complete returns
+  check( loop.wait( milliseconds( 1 ) ) == 0, "an idle wait" );
+}
+
+// A PacketSocketDriver pair on either end of a veth pair, woken by the loop's polls
+void test_packet_driver()
+{
+  const VethPair veth { "csuring0", "csuring1" };
+  if ( not veth.created() ) {
+    cerr << "skipping the packet driver: could not create a veth pair (needs CAP_NET_ADMIN and the ip command)\n";
+    return;
+  }
+
+  unique_ptr<PacketSocketDriver> driver_a;
+  unique_ptr<PacketSocketDriver> driver_b;
+  try {
+    driver_a = make_unique<PacketSocketDriver>( veth.a() );
+    driver_b = make_unique<PacketSocketDriver>( veth.b() );
+  } catch ( const unix_error& e ) {
+    if ( e.code().value() == EPERM or e.code().value() == EACCES ) {
+      cerr << "skipping the packet driver: packet sockets need CAP_NET_RAW\n";
+      return;
+    }
+    throw;
+  }
+
+  const Address ip_a { "10.48.0.1" };
+  const Address ip_b { "10.48.0.2" };
+  NetworkInterface host_a { { 0x02, 0, 0, 0, 0x48, 0x0a }, ip_a };
+  AsyncNetworkInterface host_b { { 0x02, 0, 0, 0, 0x48, 0x0b }, ip_b };
+
+  IOUringLoop loop;
+  loop.poll( driver_a->socket(), POLLIN, [&]( int ) { driver_a->receive( host_a, []( InternetDatagram&& ) {} ); } );
+  loop.poll( driver_b->socket(), POLLIN, [&]( int ) { driver_b->receive( host_b ); } );
+
+  constexpr uint16_t datagrams = 20;
+  for ( uint16_t i = 0; i < datagrams; i++ ) {
+    InternetDatagram dgram;
+    dgram.header.src = ip_a.ipv4_numeric();
+    dgram.header.dst = ip_b.ipv4_numeric();
+    dgram.header.id = i;
+    dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4;
+    dgram.header.compute_checksum();
+    host_a.send_datagram( dgram, ip_b );
+  }
+
+  size_t delivered = 0;
+  run_until(
+    loop,
+    [&] {
+      driver_a->send( host_a );
+      driver_b->send( host_b );
+      while ( host_b.maybe_receive().has_value() ) {
+        delivered++;
+      }
+      return delivered == datagrams;
+    },
+    "datagrams over the packet driver" );
+}
+
+// Whether this kernel lets us set up an io_uring: it may be too old, or have io_uring turned off (by the
+// kernel.io_uring_disabled sysctl, or a container's seccomp filter)
+bool io_uring_available()
+{
+  try {
+    const IOUringLoop probe { 1 };
+  } catch ( const unix_error& e ) {
+    if ( e.code().value() == ENOSYS or e.code().value() == EPERM ) {
+      cerr << "skipping: io_uring is unavailable (" << e.what() << ")\n";
+      return false;
+    }
+    throw;
+  }
+  return true;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    if ( not io_uring_available() ) {
+      return EXIT_SUCCESS;
+    }
+    test_tcp_stream();
+    test_udp_datagrams();
+    test_timeouts();
+    test_packet_driver();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+#include "arp_message.hh"
+#include "common.hh"
+#include "network_interface.hh"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress local_eth { 0x02, 0, 0, 0, 0x70, 0x01 };
+const EthernetAddress remote_eth { 0x02, 0, 0, 0, 0x70, 0x05 };
+
+InternetDatagram make_datagram()
+{
+  InternetDatagram dgram;
+  dgram.header.src = Address( "10.0.0.1" ).ipv4_numeric();
+  dgram.header.dst = Address( "10.0.0.5" ).ipv4_numeric();
+  dgram.payload.emplace_back( "hello" );
+  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + dgram.payload.back().size();
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+// The type of the frame `interface` sends for a datagram to 10.0.0.5: IPv4 if it knows the Ethernet address,
+// ARP if it has to ask
+uint16_t send_to_remote( NetworkInterface& interface )
+{
+  interface.send_datagram( make_datagram(), Address( "10.0.0.5" ) );
+  const auto frame = interface.maybe_send();
+  check( frame.has_value(), "a frame sent" );
+  while ( interface.maybe_send().has_value() ) {}
+  return frame->header.type;
+}
+
+// Tick both interfaces, as a router does every interval, for `ms` in all
+void tick_both( NetworkInterface& a, NetworkInterface& b, size_t ms )
+{
+  for ( size_t elapsed = 0; elapsed < ms; elapsed += 1000 ) {
+    a.tick( 1000 );
+    b.tick( 1000 );
+  }
+}
+
+} // namespace
+
+// Each interface keeps its own time: ticking a router's interfaces one after another for an interval
+// advances each by that interval, not by the interval times the number of interfaces
+int main()
+{
+  try {
+    NetworkInterface a { local_eth, Address( "10.0.0.1" ) };
+    NetworkInterface b { { 0x02, 0, 0, 0, 0x70, 0x02 }, Address( "10.1.0.1" ) };
+
+    ARPMessage request;
+    request.opcode = ARPMessage::OPCODE_REQUEST;
+    request.sender_ethernet_address = remote_eth;
+    request.sender_ip_address = Address( "10.0.0.5" ).ipv4_numeric();
+    request.target_ip_address = Address( "10.0.0.1" ).ipv4_numeric();
+    EthernetFrame frame;
+    frame.header = { ETHERNET_BROADCAST, remote_eth, EthernetHeader::TYPE_ARP };
+    frame.payload = serialize( request );
+    a.recv_frame( frame );
+    while ( a.maybe_send().has_value() ) {} // the ARP reply
+
+    // 20 s on each interface: the 30 s mapping is still fresh
+    tick_both( a, b, 20'000 );
+    check( send_to_remote( a ) == EthernetHeader::TYPE_IPv4, "mapping kept for 20 s" );
+
+    // 31 s: now it has expired
+    tick_both( a, b, 11'000 );
+    check( send_to_remote( a ) == EthernetHeader::TYPE_ARP, "mapping expired after 30 s" );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,125 @@
+#include "common.hh"
+#include "exception.hh"
+#include "packet_ring_driver.hh"
+#include "veth_pair.hh"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress host_a_eth { 0x02, 0, 0, 0, 0x46, 0x0a };
+const EthernetAddress host_b_eth { 0x02, 0, 0, 0, 0x46, 0x0b };
+const Address host_a_ip { "10.46.0.1" };
+const Address host_b_ip { "10.46.0.2" };
+
+InternetDatagram make_datagram( uint32_t sequence, size_t payload )
+{
+  InternetDatagram dgram;
+  dgram.header.src = host_a_ip.ipv4_numeric();
+  dgram.header.dst = host_b_ip.ipv4_numeric();
+  dgram.header.ttl = 64;
+  dgram.header.id = static_cast<uint16_t>( sequence );
+  // a payload in several Buffers, to be gathered into one transmit slot
+  dgram.payload.emplace_back( string( payload / 2, 'a' ) );
+  dgram.payload.emplace_back( string( payload - payload / 2, 'b' ) );
+  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + payload;
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+} // namespace
+
+// Two interfaces on either end of a veth pair, each with its own pair of rings, resolving each other with ARP
+// and exchanging datagrams
+int main()
+{
+  try {
+    PacketRingOptions options;
+    options.block_size = 1 << 16;
+    options.rx_blocks = 4;
+    options.tx_blocks = 1;
+    options.batch = 8;
+
+    const VethPair veth { "csring0", "csring1" };
+    if ( not veth.created() ) {
+      cerr << "skipping: could not create a veth pair (needs CAP_NET_ADMIN and the ip command)\n";
+      return EXIT_SUCCESS;
+    }
+
+    unique_ptr<PacketRingDriver> driver_a;
+    unique_ptr<PacketRingDriver> driver_b;
+    try {
+      driver_a = make_unique<PacketRingDriver>( veth.a(), options );
+      driver_b = make_unique<PacketRingDriver>( veth.b(), options );
+    } catch ( const unix_error& e ) {
+      if ( e.code().value() == EPERM or e.code().value() == EACCES ) {
+        cerr << "skipping: packet sockets need CAP_NET_RAW (" << e.what() << ")\n";
+        return EXIT_SUCCESS;
+      }
+      throw;
+    }
+
+    NetworkInterface host_a { host_a_eth, host_a_ip };
+    AsyncNetworkInterface host_b { host_b_eth, host_b_ip };
+    vector<InternetDatagram> delivered_to_a;
+    vector<InternetDatagram> delivered_to_b;
+
+    constexpr uint32_t datagrams = 100;
+    for ( uint32_t i = 0; i < datagrams; i++ ) {
+      host_a.send_datagram( make_datagram( i, 100 + i ), host_b_ip );
+    }
+
+    // Shuttle frames until everything arrives: ARP request, reply, then the datagrams in batches of 8
+    const auto deadline = chrono::steady_clock::now() + chrono::seconds( 5 );
+    while ( delivered_to_b.size() < datagrams and chrono::steady_clock::now() < deadline ) {
+      driver_a->send( host_a );
+      driver_b->receive( host_b );
+      driver_b->send( host_b );
+      driver_a->receive( host_a,
+                         [&]( InternetDatagram&& dgram ) { delivered_to_a.push_back( std::move( dgram ) ); } );
+      while ( auto dgram = host_b.maybe_receive() ) {
+        delivered_to_b.push_back( std::move( *dgram ) );
+      }
+      this_thread::sleep_for( chrono::microseconds( 100 ) );
+    }
+
+    check( delivered_to_b.size() == datagrams, "delivered " + to_string( delivered_to_b.size() ) + " datagrams" );
+    for ( uint32_t i = 0; i < datagrams; i++ ) {
+      const InternetDatagram& dgram = delivered_to_b[i];
+      check( dgram.header.id == i, "in order" );
+      check( dgram.header.src == host_a_ip.ipv4_numeric(), "source address" );
+      size_t length = 0;
+      for ( const auto& buffer : dgram.payload ) {
+        length += buffer.size();
+      }
+      check( length == 100 + i, "payload length" );
+    }
+    check( delivered_to_a.empty(), "nothing for host A" );
+
+    // batching: the 100 datagrams (plus ARP) went out in far fewer system calls than frames
+    const DriverStats& stats = driver_a->stats();
+    check( stats.frames_sent == datagrams + 1, "frames sent: " + to_string( stats.frames_sent ) );
+    check( stats.send_calls < stats.frames_sent / 4, "sends batched: " + to_string( stats.send_calls ) );
+    check( stats.send_errors == 0, "no send errors" );
+    check( driver_b->stats().frames_received >= datagrams + 1, "frames received" );
+    check( driver_b->stats().receive_calls == 0, "no system calls to receive" );
+    check( host_b.stats().get( InterfaceCounter::ArpRequestsReceived ) >= 1, "ARP request arrived" );
+    check( host_a.stats().get( InterfaceCounter::ArpRepliesReceived ) >= 1, "ARP reply arrived" );
+
+    // a frame larger than a transmit slot is dropped, not sent in pieces
+    host_a.send_datagram( make_datagram( datagrams, options.tx_frame_size ), host_b_ip );
+    check( driver_a->send( host_a ) == 0, "oversized frame not queued" );
+    check( driver_a->stats().send_errors == 1, "oversized frame counted" );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
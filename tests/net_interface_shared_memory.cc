@@ -0,0 +1,234 @@
+#include "common.hh"
+#include "exception.hh"
+#include "shared_memory_link.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <poll.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+const EthernetAddress host_a_eth { 0x02, 0, 0, 0, 0x68, 0x0a };
+const EthernetAddress host_b_eth { 0x02, 0, 0, 0, 0x68, 0x0b };
+const Address host_a_ip { "10.68.0.1" };
+const Address host_b_ip { "10.68.0.2" };
+
+bool readable( const FileDescriptor& fd )
+{
+  pollfd ready { fd.fd_num(), POLLIN, 0 };
+  return ::poll( &ready, 1, 0 ) == 1;
+}
+
+InternetDatagram make_datagram( uint16_t id, size_t payload )
+{
+  InternetDatagram dgram;
+  dgram.header.src = host_a_ip.ipv4_numeric();
+  dgram.header.dst = host_b_ip.ipv4_numeric();
+  dgram.header.ttl = 64;
+  dgram.header.id = id;
+  dgram.payload.emplace_back( string( payload / 2, 'a' ) );
+  dgram.payload.emplace_back( string( payload - payload / 2, 'b' ) );
+  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + payload;
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+// Two interfaces in one process resolve each other by ARP and exchange more datagrams than the ring holds
+void test_interfaces()
+{
+  SharedMemoryLink link { { .slots = 64, .buffer_size = 2048, .notify = true } };
+  SharedMemoryDriver end_a { link.duplicate(), SharedMemoryDriver::End::A };
+  SharedMemoryDriver end_b { std::move( link ), SharedMemoryDriver::End::B };
+  NetworkInterface a { host_a_eth, host_a_ip };
+  AsyncNetworkInterface b { host_b_eth, host_b_ip };
+
+  constexpr uint16_t datagrams = 1000;
+  for ( uint16_t i = 0; i < datagrams; i++ ) {
+    a.send_datagram( make_datagram( i, 20 + i % 1400 ), host_b_ip );
+  }
+  // an oversized frame is refused, not truncated
+  a.send_datagram( make_datagram( datagrams, 4000 ), host_b_ip );
+
+  vector<InternetDatagram> received;
+  for ( int step = 0; step < 10000 and received.size() < datagrams; step++ ) {
+    end_a.send( a );
+    end_a.receive( a, []( InternetDatagram&& ) {} );
+    end_b.receive( b );
+    end_b.send( b );
+    while ( auto dgram = b.maybe_receive() ) {
+      received.push_back( std::move( *dgram ) );
+    }
+  }
+  check( received.size() == datagrams, "all delivered: " + to_string( received.size() ) );
+  for ( uint16_t i = 0; i < datagrams; i++ ) {
+    check( received[i].header.id == i and received[i].header.len == 20 + 20 + i % 1400,
+           "datagram " + to_string( i ) + " whole and in order" );
+  }
+  end_a.send( a );
+  check( end_a.stats().send_errors == 1, "oversized frame counted" );
+  check( end_b.stats().malformed == 0, "nothing malformed" );
+}
+
+// An idle receiver's eventfd becomes readable when a frame arrives, and not before
+void test_wakeups()
+{
+  SharedMemoryLink link;
+  SharedMemoryDriver sender { link.duplicate(), SharedMemoryDriver::End::A };
+  SharedMemoryDriver receiver { std::move( link ), SharedMemoryDriver::End::B };
+
+  check( not readable( receiver.socket() ), "idle receiver not woken" );
+  const string frame( 60, 'x' );
+  const array<string_view, 3> frames { frame, frame, frame };
+  check( sender.send_frames( frames ) == 3, "frames sent" );
+  check( readable( receiver.socket() ), "receiver woken" );
+  check( sender.stats().send_calls == 1, "one wakeup" );
+
+  // more frames while the receiver is awake cost the sender nothing
+  check( sender.send_frames( frames ) == 3, "more frames sent" );
+  check( sender.stats().send_calls == 1, "no wakeup for a receiver that is awake" );
+
+  size_t count = 0;
+  check( receiver.receive_frames( 4, [&]( string_view data ) { count += data == frame; } ) == 4, "first batch" );
+  check( readable( receiver.socket() ), "still readable with frames left" );
+  check( receiver.receive_frames( 4, [&]( string_view data ) { count += data == frame; } ) == 2, "the rest" );
+  check( count == 6, "frames intact" );
+  check( not readable( receiver.socket() ), "quiet again once drained" );
+
+  check( sender.send_frames( frames ) == 3, "after the drain" );
+  check( readable( receiver.socket() ), "woken again" );
+}
+
+// A ring full of unconsumed frames refuses more, and takes them once the receiver catches up
+void test_full_ring()
+{
+  SharedMemoryLink link { { .slots = 8, .buffer_size = 128, .notify = false } };
+  SharedMemoryDriver sender { link.duplicate(), SharedMemoryDriver::End::A };
+  SharedMemoryDriver receiver { std::move( link ), SharedMemoryDriver::End::B };
+
+  vector<string> payloads;
+  for ( int i = 0; i < 12; i++ ) {
+    payloads.push_back( "frame " + to_string( i ) );
+  }
+  const vector<string_view> frames { payloads.begin(), payloads.end() };
+  check( sender.send_frames( frames ) == 8, "ring holds eight" );
+  check( sender.send_frames( span { frames }.subspan( 8 ) ) == 0, "full ring refuses" );
+
+  vector<string> received;
+  receiver.receive_frames( 5, [&]( string_view data ) { received.emplace_back( data ); } );
+  check( sender.send_frames( span { frames }.subspan( 8 ) ) == 4, "room again" );
+  receiver.receive_frames( 100, [&]( string_view data ) { received.emplace_back( data ); } );
+  check( received == payloads, "all twelve in order" );
+  check( sender.stats().send_calls == 0 and receiver.stats().receive_calls == 0, "no system calls at all" );
+}
+
+// A frame too short to be Ethernet counts as malformed, not as received
+void test_short_frame()
+{
+  SharedMemoryLink link { { .slots = 8, .buffer_size = 128, .notify = false } };
+  SharedMemoryDriver sender { link.duplicate(), SharedMemoryDriver::End::A };
+  SharedMemoryDriver receiver { std::move( link ), SharedMemoryDriver::End::B };
+  AsyncNetworkInterface b { host_b_eth, host_b_ip };
+
+  const string runt( EthernetHeader::LENGTH - 1, 'x' );
+  const array<string_view, 1> frames { runt };
+  check( sender.send_frames( frames ) == 1, "sent" );
+  check( receiver.receive( b ) == 0, "nothing received" );
+  check( receiver.stats().malformed == 1, "counted as malformed" );
+  check( receiver.stats().frames_received == 0 and receiver.stats().bytes_received == 0, "not as received" );
+}
+
+// The link handed to a forked process over a Unix-domain socket: the child echoes every frame back
+void test_between_processes()
+{
+  array<int, 2> pair {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair.data() ) );
+  FileDescriptor parent_end { pair[0] };
+  FileDescriptor child_end { pair[1] };
+  constexpr size_t frames = 100000;
+
+  const pid_t child = CheckSystemCall( "fork", ::fork() );
+  if ( child == 0 ) {
+    try {
+      SharedMemoryDriver echo { SharedMemoryLink::receive_over( child_end ), SharedMemoryDriver::End::B };
+      size_t echoed = 0;
+      vector<string> pending;
+      while ( echoed < frames ) {
+        pollfd ready { echo.socket().fd_num(), POLLIN, 0 };
+        ::poll( &ready, 1, 100 );
+        pending.clear();
+        echo.receive_frames( 256, [&]( string_view data ) { pending.emplace_back( data ); } );
+        const vector<string_view> replies { pending.begin(), pending.end() };
+        for ( size_t sent = 0; sent < replies.size(); ) {
+          const size_t more = echo.send_frames( span { replies }.subspan( sent ) );
+          if ( more == 0 ) {
+            ::sched_yield(); // the parent's ring is full: let it run
+          }
+          sent += more;
+        }
+        echoed += pending.size();
+      }
+    } catch ( const exception& e ) {
+      cerr << "child: " << e.what() << "\n";
+      ::_exit( EXIT_FAILURE );
+    }
+    ::_exit( EXIT_SUCCESS );
+  }
+
+  SharedMemoryLink link { { .slots = 256, .buffer_size = 256, .notify = true } };
+  link.send_over( parent_end );
+  SharedMemoryDriver driver { std::move( link ), SharedMemoryDriver::End::A };
+
+  size_t sent = 0;
+  size_t received = 0;
+  size_t mismatched = 0;
+  const auto deadline = steady_clock::now() + seconds( 20 );
+  array<string, 32> payloads;
+  while ( received < frames and steady_clock::now() < deadline ) {
+    if ( sent < frames ) {
+      vector<string_view> batch;
+      for ( size_t i = 0; i < payloads.size() and sent + i < frames; i++ ) {
+        payloads[i] = "frame " + to_string( sent + i );
+        batch.emplace_back( payloads[i] );
+      }
+      sent += driver.send_frames( batch );
+    }
+    pollfd ready { driver.socket().fd_num(), POLLIN, 0 };
+    ::poll( &ready, 1, sent < frames ? 0 : 100 );
+    driver.receive_frames( 256, [&]( string_view data ) {
+      mismatched += data != "frame " + to_string( received );
+      received++;
+    } );
+  }
+
+  int status = 0;
+  ::waitpid( child, &status, 0 );
+  check( WIFEXITED( status ) and WEXITSTATUS( status ) == EXIT_SUCCESS, "child succeeded" );
+  check( received == frames, "all echoed: " + to_string( received ) );
+  check( mismatched == 0, "echoes intact and in order" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_interfaces();
+    test_wakeups();
+    test_full_ring();
+    test_short_frame();
+    test_between_processes();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
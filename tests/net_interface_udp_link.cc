@@ -0,0 +1,146 @@
+#include "common.hh"
+#include "router_daemon.hh"
+#include "udp_link_driver.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+const EthernetAddress host_a_eth { 0x02, 0, 0, 0, 0x67, 0x0a };
+const EthernetAddress host_b_eth { 0x02, 0, 0, 0, 0x67, 0x0b };
+
+// Ports for this run's links, away from other runs'
+const uint16_t base_port = 30000 + static_cast<uint16_t>( getpid() % 10000 ) * 3;
+
+InternetDatagram make_datagram( uint16_t id, const Address& src, const Address& dst, size_t payload )
+{
+  InternetDatagram dgram;
+  dgram.header.src = src.ipv4_numeric();
+  dgram.header.dst = dst.ipv4_numeric();
+  dgram.header.ttl = 64;
+  dgram.header.id = id;
+  // a payload in several Buffers, to be gathered by sendmmsg()
+  dgram.payload.emplace_back( string( payload / 2, 'a' ) );
+  dgram.payload.emplace_back( string( payload - payload / 2, 'b' ) );
+  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + payload;
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+// Step both ends until `count` datagrams have arrived at B (or give up after a few seconds)
+vector<InternetDatagram> exchange( NetworkInterface& a,
+                                   UdpLinkDriver& link_a,
+                                   AsyncNetworkInterface& b,
+                                   UdpLinkDriver& link_b,
+                                   size_t count )
+{
+  vector<InternetDatagram> received;
+  const auto deadline = steady_clock::now() + seconds( 5 );
+  while ( received.size() < count ) {
+    check( steady_clock::now() < deadline, "timed out with " + to_string( received.size() ) + " delivered" );
+    link_a.send( a );
+    link_a.receive( a, []( InternetDatagram&& ) {} );
+    link_b.receive( b );
+    link_b.send( b );
+    while ( auto dgram = b.maybe_receive() ) {
+      received.push_back( std::move( *dgram ) );
+    }
+  }
+  return received;
+}
+
+// Two hosts on a point-to-point link resolve each other by ARP and exchange datagrams in batches
+void test_point_to_point()
+{
+  const Address ip_a { "10.67.0.1" };
+  const Address ip_b { "10.67.0.2" };
+  NetworkInterface a { host_a_eth, ip_a };
+  AsyncNetworkInterface b { host_b_eth, ip_b };
+  UdpLinkDriver link_a { base_port, static_cast<uint16_t>( base_port + 1 ) };
+  UdpLinkDriver link_b { static_cast<uint16_t>( base_port + 1 ), base_port };
+
+  constexpr uint16_t datagrams = 500;
+  for ( uint16_t i = 0; i < datagrams; i++ ) {
+    a.send_datagram( make_datagram( i, ip_a, ip_b, 100 + i % 1200 ), ip_b );
+  }
+  const auto received = exchange( a, link_a, b, link_b, datagrams );
+  for ( uint16_t i = 0; i < datagrams; i++ ) {
+    check( received[i].header.id == i, "datagram " + to_string( i ) + " in order" );
+    check( received[i].header.len == 20 + 100 + i % 1200, "datagram " + to_string( i ) + " whole" );
+  }
+
+  check( link_a.stats().frames_sent == datagrams + 1, "frames sent (and one ARP request)" );
+  check( link_a.stats().send_calls < datagrams / 4, "sends batched: " + to_string( link_a.stats().send_calls ) );
+  check( link_b.stats().frames_received == datagrams + 1, "frames received" );
+  check( link_b.stats().malformed == 0 and link_b.stats().truncated == 0, "no bad frames" );
+}
+
+// A frame to a peer that is not (yet) listening is counted, not thrown
+void test_absent_peer()
+{
+  NetworkInterface a { host_a_eth, Address( "10.67.1.1" ) };
+  UdpLinkDriver link { static_cast<uint16_t>( base_port + 2 ), static_cast<uint16_t>( base_port + 3 ) };
+  a.send_datagram( make_datagram( 0, Address( "10.67.1.1" ), Address( "10.67.1.2" ), 10 ),
+                   Address( "10.67.1.2" ) );
+  link.send( a );
+  this_thread::sleep_for( milliseconds( 10 ) );
+  link.receive( a, []( InternetDatagram&& ) {} );
+  link.send( a ); // nothing left to send
+  check( link.stats().send_errors >= 1, "refused datagram counted" );
+}
+
+// Host A and host B, on either side of a RouterDaemon, all linked over UDP: no privileges needed
+void test_through_router()
+{
+  const auto port = [&]( int offset ) { return to_string( base_port + 10 + offset ); };
+  istringstream config_in { "interface 02:00:00:00:67:01 10.68.0.1 udp:" + port( 0 ) + ":" + port( 1 )
+                            + "\ninterface 02:00:00:00:67:02 10.69.0.1 udp:" + port( 2 ) + ":" + port( 3 )
+                            + "\nroute 10.68.0.0/16 0\nroute 10.69.0.0/16 1\n" };
+  RouterDaemon daemon { RouterConfig::parse( config_in ), DaemonOptions { .tick_interval = milliseconds( 5 ) } };
+  thread runner { [&] { daemon.run(); } };
+
+  const Address ip_a { "10.68.0.2" };
+  const Address ip_b { "10.69.0.2" };
+  NetworkInterface a { host_a_eth, ip_a };
+  AsyncNetworkInterface b { host_b_eth, ip_b };
+  UdpLinkDriver link_a { static_cast<uint16_t>( base_port + 11 ), static_cast<uint16_t>( base_port + 10 ) };
+  UdpLinkDriver link_b { static_cast<uint16_t>( base_port + 13 ), static_cast<uint16_t>( base_port + 12 ) };
+
+  constexpr uint16_t datagrams = 200;
+  for ( uint16_t i = 0; i < datagrams; i++ ) {
+    a.send_datagram( make_datagram( i, ip_a, ip_b, 500 ), Address( "10.68.0.1" ) );
+  }
+  const auto received = exchange( a, link_a, b, link_b, datagrams );
+  daemon.stop();
+  runner.join();
+
+  for ( uint16_t i = 0; i < datagrams; i++ ) {
+    check( received[i].header.id == i and received[i].header.ttl == 63, "routed datagram " + to_string( i ) );
+  }
+  check( daemon.router().interface( 1 ).stats().get( InterfaceCounter::Forwarded ) == datagrams,
+         "forwarded by the router" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_point_to_point();
+    test_absent_peer();
+    test_through_router();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <compare>
 #include <optional>
 #include <utility>
@@ -135,6 +136,83 @@ struct Tick : public Action<NetworkInterface>
   explicit Tick( const size_t ms ) : _ms( ms ) {}
 };
 
+inline std::string to_string( DropPolicy policy )
+{
+  return policy == DropPolicy::DropNewest ? "drop newest" : "drop oldest";
+}
+
+inline std::string to_string( MemoryPool pool )
+{
+  static constexpr std::array names { "ready queue", "waiting queue", "receive queue", "ARP table", "request history" };
+  return names.at( static_cast<size_t>( pool ) );
+}
+
+struct SetMemoryBudgetToCurrent : public Action<NetworkInterface>
+{
+  size_t slack;
+  DropPolicy policy;
+
+  std::string description() const override
+  {
+    return "memory budget set to current usage + " + to_string( slack ) + " bytes (" + to_string( policy ) + ")";
+  }
+
+  void execute( NetworkInterface& interface ) const override
+  {
+    interface.set_memory_budget( interface.memory_usage().current + slack, policy );
+  }
+
+  SetMemoryBudgetToCurrent( size_t s, DropPolicy p ) : slack( s ), policy( p ) {}
+};
+
+struct ExpectMemoryDrops : public ExpectNumber<NetworkInterface, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "memory_drops"; }
+  uint64_t value( NetworkInterface& interface ) const override { return interface.memory_drops(); }
+};
+
+struct ExpectMemoryHeld : public ExpectBool<NetworkInterface>
+{
+  MemoryPool pool;
+
+  std::string name() const override { return "memory held by " + to_string( pool ); }
+
+  bool value( NetworkInterface& interface ) const override
+  {
+    size_t pools_total = 0;
+    for ( size_t i = 0; i < static_cast<size_t>( MemoryPool::COUNT ); i++ ) {
+      pools_total += interface.memory_usage( static_cast<MemoryPool>( i ) ).current;
+    }
+    if ( pools_total != interface.memory_usage().current ) {
+      throw ExpectationViolation( "memory_usage()", pools_total, interface.memory_usage().current );
+    }
+    return interface.memory_usage( pool ).current > 0;
+  }
+
+  ExpectMemoryHeld( MemoryPool p, bool held ) : ExpectBool( held ), pool( p ) {}
+};
+
+struct ExpectCounter : public ExpectNumber<NetworkInterface, uint64_t>
+{
+  InterfaceCounter counter;
+
+  std::string name() const override { return std::string { to_string( counter ) }; }
+  uint64_t value( NetworkInterface& interface ) const override { return interface.stats().get( counter ); }
+
+  ExpectCounter( InterfaceCounter c, uint64_t n ) : ExpectNumber( n ), counter( c ) {}
+};
+
+struct ExpectDrops : public ExpectNumber<NetworkInterface, uint64_t>
+{
+  DropReason reason;
+
+  std::string name() const override { return "drops (" + std::string { to_string( reason ) } + ")"; }
+  uint64_t value( NetworkInterface& interface ) const override { return interface.stats().drops( reason ); }
+
+  ExpectDrops( DropReason r, uint64_t n ) : ExpectNumber( n ), reason( r ) {}
+};
+
 inline std::string concat( std::vector<Buffer>& buffers )
 {
   return std::accumulate(
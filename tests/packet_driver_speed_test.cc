@@ -0,0 +1,118 @@
+#include "exception.hh"
+#include "packet_ring_driver.hh"
+#include "packet_socket_driver.hh"
+#include "veth_pair.hh"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+constexpr size_t packets = 200'000;
+constexpr size_t batch = 64;
+constexpr size_t payload = 64; // bytes of payload per datagram: small, so per-frame costs dominate
+
+const EthernetAddress host_a_eth { 0x02, 0, 0, 0, 0x47, 0x0a };
+const EthernetAddress host_b_eth { 0x02, 0, 0, 0, 0x47, 0x0b };
+const Address host_a_ip { "10.47.0.1" };
+const Address host_b_ip { "10.47.0.2" };
+
+InternetDatagram make_datagram()
+{
+  InternetDatagram dgram;
+  dgram.header.src = host_a_ip.ipv4_numeric();
+  dgram.header.dst = host_b_ip.ipv4_numeric();
+  dgram.header.ttl = 64;
+  dgram.payload.emplace_back( string( payload, 'x' ) );
+  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + payload;
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+// Send `packets` datagrams from host A across the veth pair to host B, a batch at a time, and return the
+// rate at which B received them
+template<class Driver>
+double speed_test( const string& name, Driver& driver_a, Driver& driver_b )
+{
+  NetworkInterface host_a { host_a_eth, host_a_ip };
+  AsyncNetworkInterface host_b { host_b_eth, host_b_ip };
+  const InternetDatagram dgram = make_datagram();
+  const auto ignore = []( InternetDatagram&& ) {};
+
+  size_t queued = 0;
+  size_t delivered = 0;
+  const auto start = steady_clock::now();
+  auto last_arrival = start;
+  while ( delivered < packets and steady_clock::now() - last_arrival < milliseconds( 200 ) ) {
+    for ( size_t i = 0; i < batch and queued < packets; i++, queued++ ) {
+      host_a.send_datagram( dgram, host_b_ip );
+    }
+    driver_a.send( host_a );
+    driver_b.receive( host_b );
+    driver_b.send( host_b ); // the ARP reply
+    driver_a.receive( host_a, ignore );
+    while ( host_b.maybe_receive().has_value() ) {
+      delivered++;
+      last_arrival = steady_clock::now();
+    }
+  }
+  const double seconds = duration<double>( last_arrival - start ).count();
+
+  const DriverStats& sent = driver_a.stats();
+  const DriverStats& received = driver_b.stats();
+  cout << fixed << setprecision( 2 );
+  cout << name << ": " << delivered << " of " << packets << " datagrams (" << payload << "-byte payloads) in "
+       << seconds << " s: " << delivered / seconds / 1e6 << " Mpps; "
+       << static_cast<double>( sent.frames_sent ) / static_cast<double>( max<uint64_t>( sent.send_calls, 1 ) )
+       << " frames per send call, " << received.receive_calls << " receive calls.\n";
+  return delivered / seconds / 1e6;
+}
+
+} // namespace
+
+// The plain AF_PACKET driver against the TPACKET_V3 ring driver, over a veth pair
+int main()
+{
+  try {
+    const VethPair veth { "csbench0", "csbench1" };
+    if ( not veth.created() ) {
+      cerr << "skipping: could not create a veth pair (needs CAP_NET_ADMIN and the ip command)\n";
+      return EXIT_SUCCESS;
+    }
+
+    double socket_mpps = 0;
+    double ring_mpps = 0;
+    try {
+      PacketSocketDriver socket_a { veth.a(), batch };
+      PacketSocketDriver socket_b { veth.b(), batch };
+      socket_mpps = speed_test( "PacketSocketDriver (recvmmsg/sendmmsg)", socket_a, socket_b );
+
+      PacketRingOptions options;
+      options.batch = batch;
+      PacketRingDriver ring_a { veth.a(), options };
+      PacketRingDriver ring_b { veth.b(), options };
+      ring_mpps = speed_test( "PacketRingDriver (TPACKET_V3 rings)", ring_a, ring_b );
+    } catch ( const unix_error& e ) {
+      if ( e.code().value() == EPERM or e.code().value() == EACCES ) {
+        cerr << "skipping: packet sockets need CAP_NET_RAW (" << e.what() << ")\n";
+        return EXIT_SUCCESS;
+      }
+      throw;
+    }
+
+    cout << "The rings changed the receive rate by " << ( ring_mpps - socket_mpps ) / socket_mpps * 100 << "%.\n";
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+#include "common.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+
+#include <array>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Reads that fill the buffer double the read size, up to the limit; consuming in odd-sized pieces
+// keeps every byte in order
+void test_growth()
+{
+  const string contents = pattern( 8'000'000 );
+  FileDescriptor file = make_file( contents );
+  ReadBuffer buffer;
+  check( buffer.read_size() == ReadBuffer::kInitialReadSize, "initial read size" );
+
+  string received;
+  size_t largest = 0;
+  while ( not file.eof() ) {
+    largest = max( largest, file.read( buffer ) );
+    const size_t take = min( buffer.size(), size_t { 12345 } );
+    received.append( buffer.readable().substr( 0, take ) );
+    buffer.consume( take );
+  }
+  while ( not buffer.empty() ) {
+    received.append( buffer.readable() );
+    buffer.consume( buffer.size() );
+  }
+  check( received == contents, "contents in order" );
+  check( largest == ReadBuffer::kMaxReadSize, "grew to the limit: " + to_string( largest ) );
+  check( buffer.read_size() == ReadBuffer::kMaxReadSize, "and no further" );
+  check( file.read_count() < 20, "few reads: " + to_string( file.read_count() ) );
+}
+
+// Short reads (a pipe, written a little at a time) leave the read size alone; a non-blocking read with
+// nothing waiting returns 0 without EOF
+void test_short_reads()
+{
+  array<int, 2> ends {};
+  CheckSystemCall( "pipe2", ::pipe2( ends.data(), O_CLOEXEC ) );
+  FileDescriptor reader { ends[0] };
+  FileDescriptor writer { ends[1] };
+  reader.set_blocking( false );
+
+  ReadBuffer buffer { 4096 };
+  check( reader.read( buffer ) == 0 and not reader.eof(), "nothing waiting" );
+  for ( int i = 0; i < 10; i++ ) {
+    writer.write( "0123456789" );
+    check( reader.read( buffer ) == 10, "a short read" );
+  }
+  check( buffer.read_size() == 4096, "read size unchanged" );
+  check( buffer.size() == 100 and buffer.readable().substr( 90 ) == "0123456789", "unconsumed bytes kept" );
+
+  buffer.consume( 95 );
+  check( buffer.readable() == "56789", "the tail" );
+  writer.close();
+  check( reader.read( buffer ) == 0 and reader.eof(), "EOF" );
+  check( buffer.readable() == "56789", "unconsumed bytes survive EOF" );
+
+  bool refused = false;
+  try {
+    buffer.consume( 6 );
+  } catch ( const runtime_error& ) {
+    refused = true;
+  }
+  check( refused, "consuming more than is readable" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_growth();
+    test_short_reads();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
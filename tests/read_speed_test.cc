@@ -0,0 +1,92 @@
+#include "exception.hh"
+#include "socket.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+constexpr size_t total_bytes = size_t { 2 } << 30;
+constexpr size_t write_size = 1 << 20;
+
+// Stream `total_bytes` over loopback TCP from a forked writer, read with `read_some` (which returns the
+// bytes it read and consumes them), and report the rate
+template<typename ReadSome>
+double receive( const string& name, ReadSome&& read_some )
+{
+  TCPSocket listener;
+  listener.bind( Address( "127.0.0.1", 0 ) );
+  listener.listen();
+
+  const pid_t child = CheckSystemCall( "fork", ::fork() );
+  if ( child == 0 ) {
+    TCPSocket writer;
+    writer.connect( listener.local_address() );
+    const string data( write_size, 'x' );
+    for ( size_t sent = 0; sent < total_bytes; ) {
+      sent += writer.write( data );
+    }
+    ::_exit( EXIT_SUCCESS );
+  }
+
+  TCPSocket reader = listener.accept();
+  size_t received = 0;
+  const auto start = steady_clock::now();
+  while ( not reader.eof() ) {
+    received += read_some( reader );
+  }
+  const double seconds = duration<double>( steady_clock::now() - start ).count();
+  ::waitpid( child, nullptr, 0 );
+  if ( received != total_bytes ) {
+    throw runtime_error( name + ": received " + to_string( received ) + " bytes" );
+  }
+
+  const double rate = static_cast<double>( total_bytes ) / seconds / 1e9;
+  cout << fixed << setprecision( 2 );
+  cout << name << ": " << rate << " GB/s; " << reader.read_count() << " reads ("
+       << static_cast<double>( total_bytes ) / reader.read_count() / 1024 << " KiB each).\n";
+  return rate;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    string chunk;
+    const double fixed_rate = receive( "read( string& ), 16 KiB", [&]( FileDescriptor& fd ) {
+      fd.read( chunk );
+      return chunk.size();
+    } );
+    ReadBuffer buffer;
+    const double adaptive_rate = receive( "read( ReadBuffer& ), adaptive", [&]( FileDescriptor& fd ) {
+      fd.read( buffer );
+      const size_t got = buffer.size();
+      buffer.consume( got );
+      return got;
+    } );
+    cout << "The reusable buffer changed the rate by " << ( adaptive_rate / fixed_rate - 1 ) * 100 << "%.\n";
+
+    FDStats::enable( true );
+    const double tracked_rate = receive( "read( string& ), 16 KiB, with FDStats", [&]( FileDescriptor& fd ) {
+      fd.read( chunk );
+      return chunk.size();
+    } );
+    FDStats::enable( false );
+    cout << "Tracking I/O statistics changed the 16 KiB rate by " << ( tracked_rate / fixed_rate - 1 ) * 100
+         << "%.\n";
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
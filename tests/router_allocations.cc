@@ -0,0 +1,156 @@
+#include "alloc_counter.hh"
+#include "common.hh"
+#include "router_common.hh"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t warmup_packets = 1000;
+constexpr size_t packets = 10000;
+constexpr size_t batch = 16;
+
+const EthernetAddress router_eth0 { 0x02, 0, 0, 0, 0, 0x01 };
+const EthernetAddress router_eth1 { 0x02, 0, 0, 0, 0, 0x02 };
+const EthernetAddress sender_eth { 0x02, 0, 0, 0, 0, 0x10 };
+const EthernetAddress gateway_eth { 0x02, 0, 0, 0, 0, 0x20 };
+
+// Whole-number ceilings on allocations in steady state, with a margin over what is measured now (in the
+// comments) so that small changes to Buffer or the parsers do not trip them, while a new allocation or two per
+// packet does. Parsing and serializing still allocate (every Buffer is a shared_ptr<string>), so only tick() is
+// allocation-free so far, and it must stay that way. Lower the ceilings as allocations are eliminated.
+constexpr double max_allocations_per_packet = 25;  // 23.2: recv_frame() + route() + maybe_send()
+constexpr double max_allocations_per_send = 9;     // 7.1: send_datagram() to a resolved next hop
+constexpr double max_allocations_per_receive = 11; // 10: recv_frame() of an IPv4 frame
+constexpr double max_allocations_per_tick = 0;     // 0: tick() with nothing queued
+
+InternetDatagram make_datagram( uint32_t dst_ip )
+{
+  InternetDatagram dgram;
+  dgram.header.src = Address( "10.0.0.2" ).ipv4_numeric();
+  dgram.header.dst = dst_ip;
+  dgram.header.ttl = 64;
+  dgram.payload.emplace_back( string( 500, 'x' ) );
+  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + dgram.payload.back().size();
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+EthernetFrame make_frame( const InternetDatagram& dgram )
+{
+  EthernetFrame frame;
+  frame.header.dst = router_eth0;
+  frame.header.src = sender_eth;
+  frame.header.type = EthernetHeader::TYPE_IPv4;
+  frame.payload = serialize( dgram );
+  return frame;
+}
+
+// Receive, route and transmit `n` packets
+void forward( Router& router, const vector<EthernetFrame>& frames, size_t n )
+{
+  for ( size_t sent = 0; sent < n; sent += frames.size() ) {
+    for ( const auto& frame : frames ) {
+      router.interface( 0 ).recv_frame( frame );
+    }
+    router.route();
+    while ( router.interface( 1 ).maybe_send().has_value() ) {}
+  }
+}
+
+double per( const AllocationCounts& counts, size_t n )
+{
+  return static_cast<double>( counts.allocations ) / static_cast<double>( n );
+}
+
+void report( const string& what, double allocations, double ceiling )
+{
+  cout << left << setw( 44 ) << what << right << fixed << setprecision( 2 ) << setw( 8 ) << allocations
+       << " allocations (ceiling " << ceiling << ")\n";
+  check( allocations <= ceiling, what + " allocates more than " + to_string( ceiling ) );
+}
+
+} // namespace
+
+int main()
+{
+  if ( not allocation_counting ) {
+    cerr << "skipping: allocations are not counted under AddressSanitizer\n";
+    return EXIT_SUCCESS;
+  }
+
+  try {
+    // the counter sees allocations at all
+    {
+      const AllocationScope scope;
+      const auto* value = new uint64_t { 1 };
+      delete value;
+      const AllocationCounts counts = scope.counts();
+      check( counts.allocations == 1 and counts.deallocations == 1, "new/delete counted" );
+      check( counts.bytes == sizeof( uint64_t ), "bytes counted" );
+    }
+
+    Router router;
+    router.add_interface( AsyncNetworkInterface { router_eth0, Address( "10.0.0.1" ) } );
+    router.add_interface( AsyncNetworkInterface { router_eth1, Address( "192.168.0.1" ) } );
+    const uint32_t gateway_ip = Address( "192.168.0.2" ).ipv4_numeric();
+    router.add_route( Address( "10.0.0.0" ).ipv4_numeric(), 8, {}, 0 );
+    router.add_route( Address( "172.16.0.0" ).ipv4_numeric(), 12, Address::from_ipv4_numeric( gateway_ip ), 1 );
+    learn_gateway( router, gateway_eth, gateway_ip );
+
+    const InternetDatagram dgram = make_datagram( Address( "172.16.0.1" ).ipv4_numeric() );
+    const vector<EthernetFrame> frames( batch, make_frame( dgram ) );
+
+    // steady-state forwarding, once queues and tables have reached their working size
+    forward( router, frames, warmup_packets );
+    AllocationCounts counts;
+    {
+      const AllocationScope scope;
+      forward( router, frames, packets );
+      counts = scope.counts();
+    }
+    report( "forwarding, per packet", per( counts, packets ), max_allocations_per_packet );
+
+    // the NetworkInterface entry points, per call
+    NetworkInterface& egress = router.interface( 1 );
+    const Address gateway = Address::from_ipv4_numeric( gateway_ip );
+    {
+      const AllocationScope scope;
+      for ( size_t i = 0; i < packets; i++ ) {
+        egress.send_datagram( dgram, gateway );
+        egress.maybe_send();
+      }
+      counts = scope.counts();
+    }
+    report( "NetworkInterface::send_datagram(), per call", per( counts, packets ), max_allocations_per_send );
+
+    NetworkInterface& ingress = router.interface( 0 );
+    {
+      const AllocationScope scope;
+      for ( size_t i = 0; i < packets; i++ ) {
+        ingress.recv_frame( frames.front() );
+      }
+      counts = scope.counts();
+    }
+    report( "NetworkInterface::recv_frame(), per call", per( counts, packets ), max_allocations_per_receive );
+
+    {
+      const AllocationScope scope;
+      for ( size_t i = 0; i < packets; i++ ) {
+        ingress.tick( 0 );
+      }
+      counts = scope.counts();
+    }
+    report( "NetworkInterface::tick(), per call", per( counts, packets ), max_allocations_per_tick );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,262 @@
+#include "alloc_counter.hh"
+#include "common.hh"
+#include "packet_capture.hh"
+#include "router_common.hh"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress router_eth0 { 0x02, 0, 0, 0, 0, 0x01 };
+const EthernetAddress router_eth1 { 0x02, 0, 0, 0, 0, 0x02 };
+const EthernetAddress gateway_eth { 0x02, 0, 0, 0, 0, 0x20 };
+
+const uint32_t host_ip = ip( "10.0.0.2" );
+
+EthernetFrame make_arp_request()
+{
+  ARPMessage request;
+  request.opcode = ARPMessage::OPCODE_REQUEST;
+  request.sender_ethernet_address = gateway_eth;
+  request.sender_ip_address = Address( "192.168.0.2" ).ipv4_numeric();
+  request.target_ip_address = Address( "192.168.0.1" ).ipv4_numeric();
+
+  EthernetFrame frame;
+  frame.header.dst = ETHERNET_BROADCAST;
+  frame.header.src = gateway_eth;
+  frame.header.type = EthernetHeader::TYPE_ARP;
+  frame.payload = serialize( request );
+  return frame;
+}
+
+// The bytes of a frame as they go on the wire
+string wire( const EthernetFrame& frame )
+{
+  string bytes;
+  for ( const auto& buffer : serialize( frame ) ) {
+    bytes += string_view { buffer };
+  }
+  return bytes;
+}
+
+template<class T>
+T take( string_view& in )
+{
+  check( in.size() >= sizeof( T ), "file truncated" );
+  T value {};
+  memcpy( &value, in.data(), sizeof( T ) );
+  in.remove_prefix( sizeof( T ) );
+  return value;
+}
+
+struct Record
+{
+  uint64_t timestamp_ns {};
+  uint32_t original_length {};
+  string bytes {};
+  uint32_t flags {}; // pcapng only
+};
+
+// Parse a (host byte order, nanosecond) pcap file
+vector<Record> read_pcap( const string& file, uint32_t snaplen )
+{
+  string_view in = file;
+  check( take<uint32_t>( in ) == 0xa1b23c4d, "pcap magic" );
+  check( take<uint16_t>( in ) == 2 and take<uint16_t>( in ) == 4, "pcap version" );
+  take<uint64_t>( in );
+  check( take<uint32_t>( in ) == snaplen, "pcap snaplen" );
+  check( take<uint32_t>( in ) == 1, "pcap link type" );
+
+  vector<Record> records;
+  while ( not in.empty() ) {
+    Record record;
+    record.timestamp_ns = take<uint32_t>( in ) * 1'000'000'000ULL;
+    record.timestamp_ns += take<uint32_t>( in );
+    const uint32_t captured = take<uint32_t>( in );
+    record.original_length = take<uint32_t>( in );
+    check( captured <= snaplen and captured <= in.size(), "pcap record length" );
+    record.bytes = in.substr( 0, captured );
+    in.remove_prefix( captured );
+    records.push_back( std::move( record ) );
+  }
+  return records;
+}
+
+// Parse a pcapng file of one section and one interface
+vector<Record> read_pcapng( const string& file )
+{
+  string_view in = file;
+  vector<Record> records;
+  bool seen_interface = false;
+  while ( not in.empty() ) {
+    const uint32_t type = take<uint32_t>( in );
+    const uint32_t length = take<uint32_t>( in );
+    check( length % 4 == 0 and length >= 12 and length - 8 <= in.size(), "pcapng block length" );
+    string_view body = in.substr( 0, length - 12 );
+    in.remove_prefix( length - 12 );
+    check( take<uint32_t>( in ) == length, "pcapng trailing length" );
+
+    if ( type == 0x0a0d0d0a ) {
+      check( records.empty() and not seen_interface, "section header first" );
+      check( take<uint32_t>( body ) == 0x1a2b3c4d, "pcapng byte-order magic" );
+    } else if ( type == 1 ) {
+      check( take<uint16_t>( body ) == 1, "pcapng link type" );
+      take<uint16_t>( body );
+      take<uint32_t>( body );
+      check( take<uint16_t>( body ) == 9 and take<uint16_t>( body ) == 1 and take<uint8_t>( body ) == 9,
+             "nanosecond timestamps" );
+      seen_interface = true;
+    } else if ( type == 6 ) {
+      check( seen_interface, "interface described before its packets" );
+      check( take<uint32_t>( body ) == 0, "interface id" );
+      Record record;
+      record.timestamp_ns = uint64_t { take<uint32_t>( body ) } << 32;
+      record.timestamp_ns |= take<uint32_t>( body );
+      const uint32_t captured = take<uint32_t>( body );
+      record.original_length = take<uint32_t>( body );
+      record.bytes = body.substr( 0, captured );
+      body.remove_prefix( ( captured + 3 ) / 4 * 4 );
+      check( take<uint16_t>( body ) == 2 and take<uint16_t>( body ) == 4, "epb_flags option" );
+      record.flags = take<uint32_t>( body );
+      records.push_back( std::move( record ) );
+    } else {
+      throw runtime_error( "unexpected pcapng block type " + to_string( type ) );
+    }
+  }
+  return records;
+}
+
+Router make_router()
+{
+  Router router;
+  router.add_interface( AsyncNetworkInterface { router_eth0, Address( "10.0.0.1" ) } );
+  router.add_interface( AsyncNetworkInterface { router_eth1, Address( "192.168.0.1" ) } );
+  router.add_route( Address( "172.16.0.0" ).ipv4_numeric(), 12, Address( "192.168.0.2" ), 1 );
+  router.add_route( Address( "8.0.0.0" ).ipv4_numeric(), 8, Address( "192.168.0.2" ), 1 );
+  router.interface( 1 ).recv_frame( make_arp_request() );
+  while ( router.interface( 1 ).maybe_send().has_value() ) {}
+  return router;
+}
+
+// Forward `frame` from interface 0 and return what left interface 1
+vector<EthernetFrame> forward( Router& router, const EthernetFrame& frame )
+{
+  router.interface( 0 ).recv_frame( frame );
+  router.route();
+  vector<EthernetFrame> sent;
+  while ( auto out = router.interface( 1 ).maybe_send() ) {
+    sent.push_back( std::move( *out ) );
+  }
+  return sent;
+}
+
+void test_capture_both_directions()
+{
+  Router router = make_router();
+  check( router.interface( 0 ).packet_capture() == nullptr, "no capture until started" );
+  forward( router, make_ipv4_frame( router_eth0, host_ip, ip( "172.16.0.1" ) ) );
+
+  const uint64_t before = monotonic_ns();
+  router.interface( 0 ).start_capture( {}, 16, 64 );
+  router.interface( 1 ).start_capture();
+  const EthernetFrame inbound = make_ipv4_frame( router_eth0, host_ip, ip( "172.16.0.1" ) );
+  const auto outbound = forward( router, inbound );
+  check( outbound.size() == 1, "forwarded" );
+
+  // interface 0 saw the frame come in, truncated to 64 bytes
+  ostringstream pcap;
+  router.interface( 0 ).packet_capture()->write_pcap( pcap );
+  const auto records = read_pcap( pcap.str(), 64 );
+  check( records.size() == 1, "one inbound frame" );
+  check( records[0].original_length == wire( inbound ).size(), "original length" );
+  check( records[0].bytes == wire( inbound ).substr( 0, 64 ), "truncated bytes" );
+
+  // interface 1 saw it go out, whole and with its new TTL; pcapng says which way it went
+  ostringstream pcapng;
+  router.interface( 1 ).packet_capture()->write_pcapng( pcapng );
+  const auto out_records = read_pcapng( pcapng.str() );
+  check( out_records.size() == 1, "one outbound frame" );
+  check( out_records[0].bytes == wire( outbound[0] ), "outbound bytes" );
+  check( out_records[0].flags == 2, "outbound direction" );
+
+  // timestamps are wall-clock nanoseconds
+  const auto wall_ns = [] {
+    return static_cast<uint64_t>(
+      chrono::duration_cast<chrono::nanoseconds>( chrono::system_clock::now().time_since_epoch() ).count() );
+  };
+  check( records[0].timestamp_ns + 1'000'000'000 > wall_ns() and records[0].timestamp_ns < wall_ns(),
+         "wall-clock timestamp" );
+  check( out_records[0].timestamp_ns >= records[0].timestamp_ns, "in order" );
+  check( monotonic_ns() >= before, "clock" );
+
+  // stopping keeps the ring but captures nothing more
+  router.interface( 0 ).stop_capture();
+  forward( router, inbound );
+  check( not router.interface( 0 ).capturing(), "stopped" );
+  check( router.interface( 0 ).packet_capture()->captured() == 1, "nothing captured after stopping" );
+  check( router.interface( 1 ).packet_capture()->captured() == 2, "other interface still capturing" );
+}
+
+void test_ring_and_filters()
+{
+  // the ring keeps the most recent frames
+  PacketCapture ring { {}, 4, 128 };
+  for ( uint32_t i = 0; i < 10; i++ ) {
+    ring.capture( make_ipv4_frame( router_eth0, host_ip, ip( "172.16.0.0" ) + i ), CaptureDirection::Inbound );
+  }
+  ostringstream pcap;
+  ring.write_pcap( pcap );
+  const auto records = read_pcap( pcap.str(), 128 );
+  check( ring.captured() == 10 and records.size() == 4, "ring holds the last four" );
+  for ( uint32_t i = 0; i < 4; i++ ) {
+    check( static_cast<uint8_t>( records[i].bytes[EthernetHeader::LENGTH + 19] ) == 6 + i, "oldest first" );
+  }
+
+  // by ethertype
+  PacketCapture arp_only { { .ethertype = EthernetHeader::TYPE_ARP } };
+  arp_only.capture( make_ipv4_frame( router_eth0, host_ip, ip( "172.16.0.1" ) ), CaptureDirection::Inbound );
+  arp_only.capture( make_arp_request(), CaptureDirection::Inbound );
+  check( arp_only.captured() == 1, "ethertype filter" );
+
+  // by address: an IPv4 source or destination, or an ARP sender or target
+  PacketCapture prefix { { .ip_prefix = Address( "172.16.0.0" ).ipv4_numeric(), .prefix_length = 12 } };
+  prefix.capture( make_ipv4_frame( router_eth0, host_ip, ip( "172.31.255.255" ) ), CaptureDirection::Inbound );
+  prefix.capture( make_ipv4_frame( router_eth0, host_ip, ip( "172.32.0.1" ) ), CaptureDirection::Inbound );
+  prefix.capture( make_ipv4_frame( router_eth0, host_ip, ip( "8.8.8.8" ) ), CaptureDirection::Inbound );
+  prefix.capture( make_arp_request(), CaptureDirection::Inbound );
+  check( prefix.captured() == 1, "prefix filter" );
+
+  PacketCapture arp_prefix { { .ip_prefix = Address( "192.168.0.0" ).ipv4_numeric(), .prefix_length = 24 } };
+  arp_prefix.capture( make_arp_request(), CaptureDirection::Inbound );
+  check( arp_prefix.captured() == 1, "prefix filter on ARP" );
+
+  // capturing never allocates
+  PacketCapture big { {}, 64, 1518 };
+  const EthernetFrame frame = make_ipv4_frame( router_eth0, host_ip, ip( "172.16.0.1" ), 64, 1400 );
+  const AllocationScope scope;
+  for ( int i = 0; i < 1000; i++ ) {
+    big.capture( frame, CaptureDirection::Outbound );
+  }
+  const uint64_t allocations = scope.counts().allocations;
+  check( allocations == 0, to_string( allocations ) + " allocations while capturing" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_capture_both_directions();
+    test_ring_and_filters();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -4,6 +4,7 @@
 
 #include <iostream>
 #include <list>
+#include <optional>
 #include <random>
 #include <unordered_map>
 #include <utility>
@@ -40,6 +41,49 @@ uint32_t ip( const string& str )
   return Address { str }.ipv4_numeric();
 }
 
+// A datagram with `payload_size` bytes of payload, in a frame to `dst` from `src` (by default a random host)
+EthernetFrame make_ipv4_frame( const EthernetAddress& dst,
+                               uint32_t src_ip,
+                               uint32_t dst_ip,
+                               uint8_t ttl = 64,
+                               size_t payload_size = 200,
+                               const optional<EthernetAddress>& src = {} )
+{
+  InternetDatagram dgram;
+  dgram.header.src = src_ip;
+  dgram.header.dst = dst_ip;
+  dgram.header.ttl = ttl;
+  dgram.payload.emplace_back( string( payload_size, 'x' ) );
+  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + dgram.payload.back().size();
+  dgram.header.compute_checksum();
+
+  EthernetFrame frame;
+  frame.header.src = src.value_or( random_host_ethernet_address() );
+  frame.header.dst = dst;
+  frame.header.type = EthernetHeader::TYPE_IPv4;
+  frame.payload = serialize( dgram );
+  return frame;
+}
+
+// Teach the router's interface 1 (at 192.168.0.1) the Ethernet address of the gateway at `gateway_ip`, as an
+// ARP request from it would
+void learn_gateway( Router& router, const EthernetAddress& gateway_eth, uint32_t gateway_ip )
+{
+  ARPMessage request;
+  request.opcode = ARPMessage::OPCODE_REQUEST;
+  request.sender_ethernet_address = gateway_eth;
+  request.sender_ip_address = gateway_ip;
+  request.target_ip_address = ip( "192.168.0.1" );
+
+  EthernetFrame frame;
+  frame.header.dst = ETHERNET_BROADCAST;
+  frame.header.src = gateway_eth;
+  frame.header.type = EthernetHeader::TYPE_ARP;
+  frame.payload = serialize( request );
+  router.interface( 1 ).recv_frame( frame );
+  while ( router.interface( 1 ).maybe_send().has_value() ) {}
+}
+
 class Host
 {
   string _name;
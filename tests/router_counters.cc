@@ -0,0 +1,70 @@
+#include "common.hh"
+#include "router_common.hh"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+int main()
+{
+  try {
+    const EthernetAddress eth0 = random_host_ethernet_address();
+    const EthernetAddress eth1 = random_host_ethernet_address();
+    const uint32_t source = Address( "10.0.0.2" ).ipv4_numeric();
+
+    Router router;
+    router.add_interface( AsyncNetworkInterface { eth0, Address( "10.0.0.1" ) } );
+    router.add_interface( AsyncNetworkInterface { eth1, Address( "192.168.0.1" ) } );
+    router.add_route( Address( "192.168.0.0" ).ipv4_numeric(), 24, {}, 1 );
+
+    // A reader on another thread watches the counters while the router forwards
+    const auto ingress = router.interface( 0 ).stats_handle();
+    const auto egress = router.interface( 1 ).stats_handle();
+    atomic<bool> done { false };
+    bool monotonic = true;
+    thread reader( [&] {
+      uint64_t last = 0;
+      while ( not done.load() ) {
+        const uint64_t now = egress->get( InterfaceCounter::Forwarded );
+        monotonic = monotonic and now >= last;
+        last = now;
+      }
+    } );
+
+    constexpr unsigned count = 1000;
+    for ( unsigned i = 0; i < count; i++ ) {
+      router.interface( 0 ).recv_frame( make_ipv4_frame( eth0, source, Address( "192.168.0.2" ).ipv4_numeric() ) );
+      router.route();
+    }
+    router.interface( 0 ).recv_frame( make_ipv4_frame( eth0, source, Address( "8.8.8.8" ).ipv4_numeric() ) );
+    router.interface( 0 ).recv_frame( make_ipv4_frame( eth0, source, Address( "192.168.0.2" ).ipv4_numeric(), 1 ) );
+    router.interface( 0 ).recv_frame( make_ipv4_frame( eth0, source, Address( "192.168.0.2" ).ipv4_numeric(), 0 ) );
+    router.route();
+
+    done = true;
+    reader.join();
+
+    check( monotonic, "a concurrent reader saw a counter go backwards" );
+    check( ingress->get( InterfaceCounter::RxPackets ) == count + 3, "rx_packets" );
+    check( egress->get( InterfaceCounter::Forwarded ) == count, "forwarded" );
+    check( ingress->drops( DropReason::NoRoute ) == 1, "no_route drops" );
+    check( ingress->drops( DropReason::TtlExpired ) == 2, "ttl_expired drops" );
+    check( egress->drops() == 0, "unexpected drops on the egress interface" );
+
+    // with its memory budget full, the egress interface refuses the next datagram: a drop, not a forward
+    learn_gateway( router, random_host_ethernet_address(), Address( "192.168.0.2" ).ipv4_numeric() );
+    router.interface( 1 ).set_memory_budget( router.interface( 1 ).memory_usage().current );
+    router.interface( 0 ).recv_frame( make_ipv4_frame( eth0, source, Address( "192.168.0.2" ).ipv4_numeric() ) );
+    router.route();
+    check( egress->drops( DropReason::QueueFull ) == 1, "queue_full drop" );
+    check( egress->get( InterfaceCounter::Forwarded ) == count, "a refused datagram is not forwarded" );
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+#include "common.hh"
+#include "exception.hh"
+#include "packet_socket_driver.hh"
+#include "router_daemon.hh"
+#include "socket.hh"
+#include "veth_pair.hh"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+// Each host reaches the router over its own veth pair, so other tests' traffic never reaches their sockets
+const EthernetAddress host_a_eth { 0x02, 0, 0, 0, 0x66, 0x0a };
+const EthernetAddress host_b_eth { 0x02, 0, 0, 0, 0x66, 0x0b };
+const Address host_a_ip { "10.66.0.2" };
+const Address host_b_ip { "10.67.0.2" };
+
+const string config_text = R"(
+interface 02:00:00:00:66:01 10.66.0.1 csdaemon0
+interface 02:00:00:00:66:02 10.67.0.1 csdaemon2
+route 10.66.0.0/16 0
+route 10.67.0.0/16 1
+)";
+
+// A host on the far end of one of the router's links, driven by the test
+struct Host
+{
+  AsyncNetworkInterface interface;
+  PacketSocketDriver driver;
+
+  Host( AsyncNetworkInterface&& iface, const string& device ) : interface( std::move( iface ) ), driver( device ) {}
+
+  // Move frames both ways, and tick
+  void step()
+  {
+    driver.receive( interface );
+    interface.tick( 1 );
+    driver.send( interface );
+  }
+};
+
+InternetDatagram make_datagram( uint16_t id, const Address& dst )
+{
+  InternetDatagram dgram;
+  dgram.header.src = host_a_ip.ipv4_numeric();
+  dgram.header.dst = dst.ipv4_numeric();
+  dgram.header.ttl = 64;
+  dgram.header.id = id;
+  dgram.payload.emplace_back( string( 200, 'd' ) );
+  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + dgram.payload.back().size();
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+// Send one control command and return the reply
+string command( const string& path, const string& text )
+{
+  LocalStreamSocket client;
+  client.connect( Address::from_unix_path( path ) );
+  client.write( text + "\n" );
+  string reply;
+  string chunk;
+  while ( not client.eof() ) {
+    client.read( chunk );
+    reply += chunk;
+  }
+  return reply;
+}
+
+// Step the hosts until host B has received `count` datagrams (resolving each other's Ethernet addresses on the
+// way), returning them
+vector<InternetDatagram> deliver( Host& a, Host& b, size_t count )
+{
+  vector<InternetDatagram> received;
+  const auto deadline = steady_clock::now() + seconds( 5 );
+  while ( received.size() < count ) {
+    check( steady_clock::now() < deadline, "timed out with " + to_string( received.size() ) + " delivered" );
+    a.step();
+    b.step();
+    while ( auto dgram = b.interface.maybe_receive() ) {
+      received.push_back( std::move( *dgram ) );
+    }
+    this_thread::sleep_for( microseconds( 200 ) );
+  }
+  return received;
+}
+
+void test_daemon()
+{
+  const VethPair link_a { "csdaemon0", "csdaemon1" };
+  const VethPair link_b { "csdaemon2", "csdaemon3" };
+  if ( not link_a.created() or not link_b.created() ) {
+    cerr << "skipping: could not create veth pairs (needs CAP_NET_ADMIN and the ip command)\n";
+    return;
+  }
+
+  istringstream config_in { config_text };
+  const RouterConfig config = RouterConfig::parse( config_in );
+  unique_ptr<RouterDaemon> daemon;
+  unique_ptr<Host> a;
+  unique_ptr<Host> b;
+  try {
+    daemon = make_unique<RouterDaemon>( config, DaemonOptions { .tick_interval = milliseconds( 5 ) } );
+    a = make_unique<Host>( AsyncNetworkInterface { host_a_eth, host_a_ip }, link_a.b() );
+    b = make_unique<Host>( AsyncNetworkInterface { host_b_eth, host_b_ip }, link_b.b() );
+  } catch ( const unix_error& e ) {
+    if ( e.code().value() == EPERM or e.code().value() == EACCES ) {
+      cerr << "skipping: packet sockets need CAP_NET_RAW\n";
+      return;
+    }
+    throw;
+  }
+
+  const string path = "/tmp/router_daemon_" + to_string( getpid() ) + ".sock";
+  {
+    LocalStreamSocket listener;
+    listener.bind( Address::from_unix_path( path ) );
+    listener.listen();
+    daemon->serve_control( std::move( listener ) );
+  }
+  constexpr uint16_t datagrams = 20;
+  thread runner { [&] { daemon->run(); } };
+  try {
+    // host A sends by way of the router; each side resolves the next hop by ARP through the running daemon
+    for ( uint16_t i = 0; i < datagrams; i++ ) {
+      a->interface.send_datagram( make_datagram( i, host_b_ip ), Address( "10.66.0.1" ) );
+    }
+    const auto received = deliver( *a, *b, datagrams );
+    for ( uint16_t i = 0; i < datagrams; i++ ) {
+      check( received[i].header.id == i, "datagrams in order" );
+      check( received[i].header.ttl == 63, "TTL decremented by the router" );
+    }
+
+    // a client that never finishes its command holds up neither forwarding nor other clients, and is dropped
+    LocalStreamSocket stalled;
+    stalled.connect( Address::from_unix_path( path ) );
+    stalled.write( "sta" );
+
+    // a route added over the control socket takes effect at once
+    const auto asked = steady_clock::now();
+    check( command( path, "route 10.68.0.0/16 1 10.67.0.2" ) == "ok\n", "route added" );
+    check( steady_clock::now() - asked < milliseconds( 500 ), "command answered while another client stalls" );
+    a->interface.send_datagram( make_datagram( 100, Address( "10.68.0.9" ) ), Address( "10.66.0.1" ) );
+    check( deliver( *a, *b, 1 ).front().header.id == 100, "datagram by the new route" );
+
+    check( command( path, "route 10.68.0.0/16 7" ).starts_with( "error: no such interface" ), "bad route refused" );
+    check( command( path, "reboot" ).starts_with( "error: unknown command" ), "unknown command refused" );
+    const string stats = command( path, "stats" );
+    check( stats.starts_with( "routes 3\n" ), "stats: " + stats );
+    check( stats.find( "interface 1 rx" ) != string::npos, "per-interface stats: " + stats );
+    check( command( path, "fds" ).starts_with( "error: descriptor statistics are off" ), "fds needs --fd-stats" );
+
+    string chunk;
+    stalled.read( chunk ); // returns once the daemon gives up on the client
+    check( chunk.empty() and stalled.eof(), "stalled client closed without a reply" );
+
+    check( command( path, "stop" ) == "ok\n", "stop acknowledged" );
+  } catch ( ... ) {
+    // stop the daemon so a failed check reports instead of terminating with the loop still running
+    daemon->stop();
+    runner.join();
+    ::unlink( path.c_str() );
+    throw;
+  }
+  runner.join();
+  ::unlink( path.c_str() );
+
+  const InterfaceStats& egress = daemon->router().interface( 1 ).stats();
+  check( egress.get( InterfaceCounter::Forwarded ) == datagrams + 1, "forwarded count" );
+  check( daemon->driver( 1 ).stats().frames_sent > datagrams, "frames sent by the link driver" );
+  check( daemon->loop().turns() > 0, "the loop turned" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_daemon();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
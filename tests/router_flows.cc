@@ -0,0 +1,216 @@
+#include "common.hh"
+#include "flow_sampler.hh"
+#include "router_common.hh"
+#include "socket.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <poll.h>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress router_eth0 { 0x02, 0, 0, 0, 0, 0x01 };
+const EthernetAddress router_eth1 { 0x02, 0, 0, 0, 0, 0x02 };
+const EthernetAddress gateway_eth { 0x02, 0, 0, 0, 0, 0x20 };
+
+constexpr uint8_t PROTO_UDP = 17;
+
+// A UDP datagram (just the ports and some payload) from 10.0.0.2 to `dst_ip`, framed for interface 0; with a
+// nonzero fragment `offset`, the "ports" are just more of the payload
+EthernetFrame make_frame( uint32_t dst_ip,
+                          uint16_t src_port,
+                          uint16_t dst_port,
+                          uint8_t ttl = 64,
+                          uint16_t offset = 0 )
+{
+  InternetDatagram dgram;
+  dgram.header.src = Address( "10.0.0.2" ).ipv4_numeric();
+  dgram.header.dst = dst_ip;
+  dgram.header.ttl = ttl;
+  dgram.header.offset = offset;
+  dgram.header.df = offset == 0;
+  dgram.header.proto = PROTO_UDP;
+  string udp( 108, 'x' );
+  udp[0] = static_cast<char>( src_port >> 8 );
+  udp[1] = static_cast<char>( src_port & 0xff );
+  udp[2] = static_cast<char>( dst_port >> 8 );
+  udp[3] = static_cast<char>( dst_port & 0xff );
+  dgram.payload.emplace_back( std::move( udp ) );
+  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + dgram.payload.back().size();
+  dgram.header.compute_checksum();
+
+  EthernetFrame frame;
+  frame.header.dst = router_eth0;
+  frame.header.src = gateway_eth;
+  frame.header.type = EthernetHeader::TYPE_IPv4;
+  frame.payload = serialize( dgram );
+  return frame;
+}
+
+Router make_router()
+{
+  Router router;
+  router.add_interface( AsyncNetworkInterface { router_eth0, Address( "10.0.0.1" ) } );
+  router.add_interface( AsyncNetworkInterface { router_eth1, Address( "192.168.0.1" ) } );
+  router.add_route( Address( "10.0.0.0" ).ipv4_numeric(), 8, {}, 0 );
+  router.add_route( Address( "172.16.0.0" ).ipv4_numeric(), 12, Address( "192.168.0.2" ), 1 );
+  learn_gateway( router, gateway_eth, ip( "192.168.0.2" ) );
+  return router;
+}
+
+// Every export datagram already queued on `collector`
+vector<FlowExport> receive_exports( UDPSocket& collector )
+{
+  vector<FlowExport> exports;
+  pollfd pfd { collector.fd_num(), POLLIN, 0 };
+  while ( ::poll( &pfd, 1, 0 ) == 1 ) {
+    Address source = collector.local_address();
+    string datagram;
+    collector.recv( source, datagram );
+    FlowExport message;
+    check( parse( message, { Buffer { std::move( datagram ) } } ), "export datagram parses" );
+    exports.push_back( std::move( message ) );
+  }
+  return exports;
+}
+
+// Sample every datagram and check the exported flows exactly
+void test_every_datagram( UDPSocket& collector )
+{
+  Router router = make_router();
+  auto sampler = make_shared<FlowSampler>( 1 );
+  router.set_flow_sampler( sampler );
+  UDPSocket exporter;
+  sampler->start_export( std::move( exporter ), collector.local_address(), chrono::hours( 1 ) );
+
+  const uint32_t far = Address( "172.16.0.1" ).ipv4_numeric();
+  for ( int i = 0; i < 10; i++ ) {
+    router.interface( 0 ).recv_frame( make_frame( far, 5000, 53 ) );
+  }
+  for ( int i = 0; i < 3; i++ ) {
+    router.interface( 0 ).recv_frame( make_frame( far, 5001, 443 ) );
+  }
+  router.interface( 0 ).recv_frame( make_frame( Address( "8.8.8.8" ).ipv4_numeric(), 5000, 53 ) );
+  router.interface( 0 ).recv_frame( make_frame( far, 5000, 53, 1 ) );
+  router.interface( 0 ).recv_frame( make_frame( far, 7000, 7001, 64, 185 ) ); // a later fragment
+  router.route();
+
+  check( sampler->sampled() == 16, "sampled count" );
+  sampler.reset();
+  router.set_flow_sampler( nullptr ); // the exporter's final flush happens when the last owner lets go
+
+  map<tuple<uint16_t, uint16_t, uint8_t>, FlowRecord> flows;
+  for ( const auto& message : receive_exports( collector ) ) {
+    check( message.sampling_rate == 1, "sampling rate" );
+    check( message.dropped == 0, "no samples dropped" );
+    for ( const auto& record : message.records ) {
+      flows[{ record.src_port, record.dst_port, record.outcome }] = record;
+    }
+  }
+  check( flows.size() == 5, "five flows, got " + to_string( flows.size() ) );
+
+  const FlowRecord& dns = flows.at( { 5000, 53, static_cast<uint8_t>( FlowOutcome::Forwarded ) } );
+  check( dns.src == Address( "10.0.0.2" ).ipv4_numeric() and dns.dst == far, "addresses" );
+  check( dns.protocol == PROTO_UDP, "protocol" );
+  check( dns.ingress == 0 and dns.egress == 1, "interfaces" );
+  check( dns.samples == 10 and dns.packets == 10, "forwarded packets" );
+  check( dns.bytes == 10 * 128, "forwarded bytes" );
+  check( flows.at( { 5001, 443, static_cast<uint8_t>( FlowOutcome::Forwarded ) } ).packets == 3, "second flow" );
+
+  const FlowRecord& lost = flows.at( { 5000, 53, static_cast<uint8_t>( FlowOutcome::NoRoute ) } );
+  check( lost.packets == 1 and lost.egress == FlowSampler::NO_INTERFACE, "no-route flow" );
+  check( flows.at( { 5000, 53, static_cast<uint8_t>( FlowOutcome::TtlExpired ) } ).packets == 1,
+         "TTL-expired flow" );
+  check( flows.at( { 0, 0, static_cast<uint8_t>( FlowOutcome::Forwarded ) } ).packets == 1,
+         "no ports read from a later fragment" );
+}
+
+// Sample 1 in 16: the scaled-up estimate should be close to the truth
+void test_estimate( UDPSocket& collector )
+{
+  constexpr uint32_t rate = 16;
+  constexpr uint64_t packets = 32000;
+
+  Router router = make_router();
+  auto sampler = make_shared<FlowSampler>( rate );
+  router.set_flow_sampler( sampler );
+  UDPSocket exporter;
+  sampler->start_export( std::move( exporter ), collector.local_address(), chrono::milliseconds( 100 ) );
+
+  const EthernetFrame frame = make_frame( Address( "172.16.0.1" ).ipv4_numeric(), 5000, 53 );
+  for ( uint64_t i = 0; i < packets; i++ ) {
+    router.interface( 0 ).recv_frame( frame );
+    router.route();
+    while ( router.interface( 1 ).maybe_send().has_value() ) {}
+  }
+  router.set_flow_sampler( nullptr );
+  sampler.reset();
+
+  uint64_t estimate = 0;
+  uint64_t last_sequence = 0;
+  bool first = true;
+  for ( const auto& message : receive_exports( collector ) ) {
+    check( message.sampling_rate == rate, "sampling rate" );
+    check( first or message.sequence == last_sequence + 1, "sequence numbers count up" );
+    first = false;
+    last_sequence = message.sequence;
+    for ( const auto& record : message.records ) {
+      estimate += record.packets;
+    }
+  }
+  check( estimate > packets * 8 / 10 and estimate < packets * 12 / 10,
+         "estimated " + to_string( estimate ) + " of " + to_string( packets ) + " packets" );
+}
+
+// A collector that refuses the exports (nothing listens on its port) costs them, but not the exporter
+void test_refused_export()
+{
+  Address refusing = Address( "127.0.0.1", 0 );
+  {
+    UDPSocket closed;
+    closed.bind( refusing );
+    refusing = closed.local_address();
+  }
+
+  Router router = make_router();
+  auto sampler = make_shared<FlowSampler>( 1 );
+  router.set_flow_sampler( sampler );
+  UDPSocket exporter;
+  exporter.connect( refusing ); // so the ICMP port unreachable comes back as ECONNREFUSED
+  sampler->start_export( std::move( exporter ), refusing, chrono::milliseconds( 5 ) );
+
+  const EthernetFrame frame = make_frame( Address( "172.16.0.1" ).ipv4_numeric(), 5000, 53 );
+  const auto deadline = chrono::steady_clock::now() + chrono::seconds( 5 );
+  while ( sampler->export_errors() < 2 ) {
+    check( chrono::steady_clock::now() < deadline, "timed out waiting for refused exports" );
+    router.interface( 0 ).recv_frame( frame );
+    router.route();
+    while ( router.interface( 1 ).maybe_send().has_value() ) {}
+    this_thread::sleep_for( chrono::milliseconds( 1 ) );
+  }
+  router.set_flow_sampler( nullptr );
+  sampler.reset(); // joins the exporter, which is still running
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    UDPSocket collector;
+    collector.bind( Address( "127.0.0.1", 0 ) );
+
+    test_every_datagram( collector );
+    test_estimate( collector );
+    test_refused_export();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+#include "common.hh"
+#include "heavy_hitters.hh"
+#include "metrics_exporter.hh"
+#include "router_common.hh"
+#include "sketch.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress router_eth0 { 0x02, 0, 0, 0, 0, 0x01 };
+const EthernetAddress router_eth1 { 0x02, 0, 0, 0, 0, 0x02 };
+
+// Draws ranks 0..n-1 with probability proportional to 1 / (rank + 1)^s
+class ZipfGenerator
+{
+  vector<double> cdf_ {};
+  mt19937 rng_ { 458 };
+  uniform_real_distribution<double> uniform_ { 0, 1 };
+
+public:
+  ZipfGenerator( size_t n, double s )
+  {
+    double sum = 0;
+    for ( size_t rank = 0; rank < n; rank++ ) {
+      sum += 1 / pow( static_cast<double>( rank + 1 ), s );
+      cdf_.push_back( sum );
+    }
+    for ( auto& value : cdf_ ) {
+      value /= sum;
+    }
+  }
+
+  size_t operator()()
+  {
+    const auto it = lower_bound( cdf_.begin(), cdf_.end(), uniform_( rng_ ) );
+    return min<size_t>( it - cdf_.begin(), cdf_.size() - 1 );
+  }
+};
+
+// A scattered IPv4 address for each rank
+uint32_t address_of( size_t rank )
+{
+  return 0x0a000000 + static_cast<uint32_t>( rank * 2654435761U % 0x00ffffff );
+}
+
+// Both sketches against exact counts of the same Zipf stream
+void test_zipf()
+{
+  constexpr size_t keys = 10'000;
+  constexpr size_t samples = 500'000;
+
+  ZipfGenerator zipf { keys, 1.2 };
+  vector<uint64_t> exact( keys );
+  CountMinSketch<> counts;
+  SpaceSaving<> top;
+  for ( size_t i = 0; i < samples; i++ ) {
+    const size_t rank = zipf();
+    exact[rank]++;
+    counts.add( address_of( rank ) );
+    top.add( address_of( rank ) );
+  }
+  check( counts.total() == samples, "sketch total" );
+
+  // Count-Min: never under, and over by more than e/width of the total only rarely
+  const auto bound = static_cast<uint64_t>( exp( 1.0 ) / CountMinSketch<>::width * samples );
+  size_t over_bound = 0;
+  for ( size_t rank = 0; rank < keys; rank++ ) {
+    const uint64_t estimate = counts.estimate( address_of( rank ) );
+    check( estimate >= exact[rank], "Count-Min undercounts rank " + to_string( rank ) );
+    over_bound += estimate - exact[rank] > bound;
+  }
+  check( over_bound < keys / 20, to_string( over_bound ) + " Count-Min estimates beyond the error bound" );
+
+  // SpaceSaving: each monitored count brackets the truth, and every sufficiently heavy key is monitored
+  const vector<HeavyHitter> hitters = top.top();
+  check( hitters.size() == SpaceSaving<>::capacity, "summary is full" );
+  unordered_map<uint32_t, size_t> rank_of;
+  for ( size_t rank = 0; rank < keys; rank++ ) {
+    rank_of.emplace( address_of( rank ), rank );
+  }
+  check( rank_of.size() == keys, "distinct addresses" );
+  for ( const auto& hitter : hitters ) {
+    const auto it = rank_of.find( hitter.key );
+    check( it != rank_of.end(), "monitored key came from the stream" );
+    const size_t rank = it->second;
+    check( hitter.lower_bound() <= exact[rank] and exact[rank] <= hitter.count, "count brackets the truth" );
+    check( hitter.error <= samples / SpaceSaving<>::capacity, "error bound" );
+  }
+  for ( size_t rank = 0; rank < keys; rank++ ) {
+    if ( exact[rank] > samples / SpaceSaving<>::capacity ) {
+      check( any_of( hitters.begin(),
+                     hitters.end(),
+                     [&]( const HeavyHitter& h ) { return h.key == address_of( rank ); } ),
+             "heavy rank " + to_string( rank ) + " is monitored" );
+    }
+  }
+
+  // and the five heaviest come out in order
+  for ( size_t rank = 0; rank < 5; rank++ ) {
+    check( hitters[rank].key == address_of( rank ), "rank " + to_string( rank ) + " in place" );
+  }
+}
+
+// Old traffic fades by half per window
+void test_decay()
+{
+  constexpr uint64_t window = 1000;
+  const uint32_t a = 0x0a000001;
+  const uint32_t b = 0x0a000002;
+
+  HeavyHitters hitters;
+  hitters.set_window( window );
+  for ( int i = 0; i < 1000; i++ ) {
+    hitters.record( b, a, 1 );
+  }
+  check( hitters.top_destinations().empty(), "nothing published during the first window" );
+  check( hitters.destination_estimate( a ) >= 1000, "live estimate" );
+
+  // the next window's first datagram publishes the last one's counts, then halves them
+  hitters.record( a, b, window + 1 );
+  auto top = hitters.top_destinations();
+  check( not top.empty() and top[0].key == a and top[0].count == 1000, "published at the window's end" );
+  check( hitters.top_sources()[0].key == b, "sources too" );
+  check( hitters.destination_estimate( a ) >= 500 and hitters.destination_estimate( a ) < 600, "halved" );
+
+  // ten idle windows later, `a` has all but disappeared and the new traffic dominates
+  for ( int i = 0; i < 100; i++ ) {
+    hitters.record( a, b, 12 * window );
+  }
+  hitters.publish();
+  top = hitters.top_destinations();
+  check( top[0].key == b and top[0].count == 100, "new traffic leads" );
+  check( hitters.destination_estimate( a ) < 2, "old traffic decayed" );
+}
+
+// Through the router: skewed traffic, queried through its stats and the metrics exporter
+void test_router()
+{
+  Router router;
+  router.add_interface( AsyncNetworkInterface { router_eth0, Address( "10.0.0.1" ) } );
+  router.add_interface( AsyncNetworkInterface { router_eth1, Address( "192.168.0.1" ) } );
+  router.add_route( Address( "172.16.0.0" ).ipv4_numeric(), 12, Address( "192.168.0.2" ), 1 );
+  router.track_heavy_hitters( true, 3600'000'000'000 ); // a window no test run outlasts
+
+  const uint32_t source = Address( "10.0.0.2" ).ipv4_numeric();
+  const uint32_t busy = Address( "172.16.0.7" ).ipv4_numeric();
+  const EthernetFrame to_busy = make_ipv4_frame( router_eth0, source, busy );
+  for ( uint32_t i = 0; i < 1000; i++ ) {
+    const uint32_t other = busy + 1 + i;
+    router.interface( 0 ).recv_frame( i % 4 == 3 ? make_ipv4_frame( router_eth0, source, other ) : to_busy );
+  }
+  router.route();
+  router.publish_heavy_hitters();
+
+  const auto top = router.stats().heavy_hitters.top_destinations();
+  check( not top.empty() and top[0].key == busy and top[0].count == 750, "busiest destination" );
+  check( router.stats().heavy_hitters.top_sources()[0].count == 1000, "busiest source" );
+
+  const string metrics = MetricsExporter { router }.render();
+  check( metrics.find( R"(router_heavy_hitter_packets{direction="destination",address="172.16.0.7"} 750)" )
+           != string::npos,
+         "exported:\n" + metrics );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_zipf();
+    test_decay();
+    test_router();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
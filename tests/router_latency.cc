@@ -0,0 +1,95 @@
+#include "common.hh"
+#include "router_common.hh"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+// Percentiles of a known distribution come back within the histogram's resolution
+void check_accuracy()
+{
+  LatencyHistogram histogram;
+  for ( uint64_t value = 1; value <= 100000; value++ ) {
+    histogram.record( value );
+  }
+
+  const auto close_to = []( uint64_t actual, uint64_t expected ) {
+    return actual >= expected and actual <= expected + expected / 32;
+  };
+  check( histogram.count() == 100000, "count" );
+  check( close_to( histogram.p50(), 50000 ), "p50 = " + to_string( histogram.p50() ) );
+  check( close_to( histogram.p99(), 99000 ), "p99 = " + to_string( histogram.p99() ) );
+  check( close_to( histogram.p999(), 99900 ), "p99.9 = " + to_string( histogram.p999() ) );
+  check( histogram.percentile( 1.0 ) == 100000, "p100 is the maximum" );
+
+  LatencyHistogram small;
+  for ( uint64_t value = 0; value < 32; value++ ) {
+    small.record( value );
+  }
+  check( small.p50() == 15, "small values are exact" );
+}
+
+int main()
+{
+  try {
+    check_accuracy();
+
+    const EthernetAddress eth0 = random_host_ethernet_address();
+    const EthernetAddress eth1 = random_host_ethernet_address();
+    const EthernetAddress host_eth = random_host_ethernet_address();
+    const uint32_t source = Address( "10.0.0.2" ).ipv4_numeric();
+    const uint32_t destination = Address( "192.168.0.2" ).ipv4_numeric();
+
+    Router router;
+    router.add_interface( AsyncNetworkInterface { eth0, Address( "10.0.0.1" ) } );
+    router.add_interface( AsyncNetworkInterface { eth1, Address( "192.168.0.1" ) } );
+    router.add_route( Address( "192.168.0.0" ).ipv4_numeric(), 24, {}, 1 );
+
+    // the first datagram waits 800 ms for ARP
+    router.interface( 0 ).recv_frame( make_ipv4_frame( eth0, source, destination ) );
+    router.route();
+    router.interface( 1 ).tick( 800 );
+    ARPMessage reply;
+    reply.opcode = ARPMessage::OPCODE_REPLY;
+    reply.sender_ethernet_address = host_eth;
+    reply.sender_ip_address = destination;
+    reply.target_ethernet_address = eth1;
+    reply.target_ip_address = Address( "192.168.0.1" ).ipv4_numeric();
+    EthernetFrame reply_frame;
+    reply_frame.header = { eth1, host_eth, EthernetHeader::TYPE_ARP };
+    reply_frame.payload = serialize( reply );
+    router.interface( 1 ).recv_frame( reply_frame );
+
+    constexpr unsigned count = 1000;
+    for ( unsigned i = 0; i < count; i++ ) {
+      router.interface( 0 ).recv_frame( make_ipv4_frame( eth0, source, destination ) );
+      router.route();
+    }
+
+    unsigned sent = 0;
+    while ( auto frame = router.interface( 1 ).maybe_send() ) {
+      sent += frame->header.type == EthernetHeader::TYPE_IPv4;
+    }
+    check( sent == count + 1, "not every datagram was forwarded" );
+
+    const auto& egress = router.interface( 1 ).stats();
+    check( egress.forwarding_ns.count() == count + 1, "forwarding latency not recorded per datagram" );
+    check( egress.forwarding_ns.p50() <= egress.forwarding_ns.p99(), "p50 > p99" );
+    check( egress.forwarding_ns.p99() <= egress.forwarding_ns.p999(), "p99 > p99.9" );
+    check( egress.forwarding_ns.p999() <= egress.forwarding_ns.max(), "p99.9 > max" );
+    check( egress.arp_wait_ms.count() == 1 and egress.arp_wait_ms.p50() == 800, "ARP wait not recorded" );
+    check( egress.tick_ns.count() == 1, "tick cost not recorded" );
+    check( router.stats().route_ns.count() == count + 1, "route() cost not recorded per call" );
+
+    cout << "forwarding latency (ns): p50=" << egress.forwarding_ns.p50() << " p99=" << egress.forwarding_ns.p99()
+         << " p99.9=" << egress.forwarding_ns.p999() << "\n";
+    cout << "route() cost (ns): p50=" << router.stats().route_ns.p50() << " p99=" << router.stats().route_ns.p99()
+         << "\n";
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
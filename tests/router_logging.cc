@@ -0,0 +1,128 @@
+#include "common.hh"
+#include "exception.hh"
+#include "logger.hh"
+#include "router.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// Everything logged so far, from a file the logger writes to
+class LogCapture
+{
+  string path_ = "/tmp/router_logging_" + to_string( getpid() );
+  int fd_ = CheckSystemCall( "open", ::open( path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600 ) ); // NOLINT
+
+public:
+  LogCapture() { global_logger().set_sink( fd_ ); }
+  ~LogCapture()
+  {
+    global_logger().set_sink( STDERR_FILENO );
+    ::close( fd_ );
+    ::unlink( path_.c_str() );
+  }
+
+  string contents() const
+  {
+    global_logger().flush();
+    ifstream in { path_ };
+    return { istreambuf_iterator<char>( in ), istreambuf_iterator<char>() };
+  }
+
+  LogCapture( const LogCapture& other ) = delete;
+  LogCapture& operator=( const LogCapture& other ) = delete;
+};
+
+size_t count_lines( const string& text )
+{
+  return ranges::count( text, '\n' );
+}
+
+int main()
+{
+  try {
+    const LogCapture capture;
+
+    // Below the runtime level: nothing is written, and the arguments are not evaluated
+    set_log_level( LogLevel::Info );
+    bool evaluated = false;
+    LOG_DEBUG( "value {}", ( evaluated = true ) );
+    check( not evaluated, "arguments of a filtered message are not evaluated" );
+
+    // Formatting
+    set_log_level( LogLevel::Debug );
+    LOG_INFO( "numbers {} {} {} and a {}", 42, uint8_t { 7 }, -3, "literal" );
+    LOG_WARNING( "address {}", LogIpv4 { 0x0a000102 } );
+    LOG_ERROR( "ethernet {}", EthernetAddress { 2, 0, 0, 0, 0, 0xab } );
+    LOG_ERROR( "no placeholders" );
+    LOG_ERROR( "too few arguments {} {}", 1 );
+    string text = capture.contents();
+    check( text.find( "INFO: numbers 42 7 -3 and a literal\n" ) != string::npos, "numbers: " + text );
+    check( text.find( "WARNING: address 10.0.1.2\n" ) != string::npos, "IPv4 address: " + text );
+    check( text.find( "ERROR: ethernet 02:00:00:00:00:ab\n" ) != string::npos, "Ethernet address: " + text );
+    check( text.find( "ERROR: no placeholders\n" ) != string::npos, "plain message: " + text );
+    check( text.find( "ERROR: too few arguments 1 {}\n" ) != string::npos, "missing argument: " + text );
+
+    // The router's messages
+    Router router;
+    router.add_interface( AsyncNetworkInterface { EthernetAddress { 2, 0, 0, 0, 0, 1 }, Address( "10.0.0.1" ) } );
+    router.add_route( Address( "10.0.0.0" ).ipv4_numeric(), 8, {}, 0 );
+    router.add_route( 0, 0, Address( "10.0.0.2" ), 0 );
+    text = capture.contents();
+    check( text.find( "DEBUG: Network interface has Ethernet address 02:00:00:00:00:01 and IP address 10.0.0.1\n" )
+             != string::npos,
+           "interface message: " + text );
+    check( text.find( "DEBUG: adding route 10.0.0.0/8 => (direct) on interface 0\n" ) != string::npos,
+           "direct route message: " + text );
+    check( text.find( "DEBUG: adding route 0.0.0.0/0 => 10.0.0.2 on interface 0\n" ) != string::npos,
+           "route message: " + text );
+
+    // Many threads at once: every message is either written whole or counted as dropped
+    const size_t lines_before = count_lines( capture.contents() );
+    const uint64_t dropped_before = global_logger().dropped();
+    constexpr size_t threads = 4;
+    constexpr size_t messages = 5000;
+    vector<thread> loggers;
+    for ( size_t t = 0; t < threads; t++ ) {
+      loggers.emplace_back( [t] {
+        for ( size_t i = 0; i < messages; i++ ) {
+          LOG_INFO( "thread {} message {}", t, i );
+        }
+      } );
+    }
+    for ( auto& logger : loggers ) {
+      logger.join();
+    }
+    text = capture.contents();
+    const size_t written = count_lines( text ) - lines_before;
+    const uint64_t dropped = global_logger().dropped() - dropped_before;
+    check( written + dropped == threads * messages,
+           "written " + to_string( written ) + " + dropped " + to_string( dropped ) );
+    check( text.find( "INFO: thread" ) != string::npos, "threaded messages written" );
+
+    // A message to an idle logger wakes its writer at once, rather than waiting for the writer's backstop
+    for ( int i = 0; i < 5; i++ ) {
+      this_thread::sleep_for( chrono::milliseconds( 20 ) ); // long enough for the writer to fall asleep
+      const auto logged = chrono::steady_clock::now();
+      LOG_INFO( "after a pause {}", i );
+      global_logger().flush();
+      check( chrono::steady_clock::now() - logged < chrono::milliseconds( 500 ), "idle writer woken" );
+    }
+    check( capture.contents().find( "INFO: after a pause 4\n" ) != string::npos, "message after a pause" );
+
+    set_log_level( LogLevel::Info );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#include "common.hh"
+#include "router_common.hh"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+size_t interfaces_total( Router& router, size_t count )
+{
+  size_t total = 0;
+  for ( size_t i = 0; i < count; i++ ) {
+    total += router.interface( i ).memory_usage().current;
+  }
+  return total;
+}
+
+// Flood interface 0 with datagrams for distinct unresolved hosts behind interface 1
+void flood( Router& router, const EthernetAddress& ingress_eth, unsigned count )
+{
+  for ( unsigned i = 0; i < count; i++ ) {
+    const uint32_t host = Address( "192.168.0.0" ).ipv4_numeric() + i;
+    router.interface( 0 ).recv_frame( make_ipv4_frame( ingress_eth, Address( "10.0.0.2" ).ipv4_numeric(), host ) );
+    router.route();
+  }
+}
+
+int main()
+{
+  try {
+    const EthernetAddress eth0 = random_host_ethernet_address();
+    const EthernetAddress eth1 = random_host_ethernet_address();
+
+    {
+      Router router;
+      router.add_interface( AsyncNetworkInterface { eth0, Address( "10.0.0.1" ) } );
+      router.add_interface( AsyncNetworkInterface { eth1, Address( "192.168.0.1" ) } );
+      router.add_route( Address( "192.168.0.0" ).ipv4_numeric(), 24, {}, 1 );
+
+      const size_t table_bytes = router.memory_usage().current;
+      check( table_bytes >= sizeof( RoutingTableElement ), "routing table is not accounted" );
+
+      flood( router, eth0, 100 );
+      check( router.memory_usage().current == table_bytes + interfaces_total( router, 2 ),
+             "router-wide usage is not the sum of its parts" );
+      check( router.interface( 1 ).memory_drops() == 0, "unexpected drops without a budget" );
+
+      while ( router.interface( 1 ).maybe_send() ) {}
+      check( router.memory_usage().peak > router.memory_usage().current, "peak did not track the high-water mark" );
+    }
+
+    {
+      Router router;
+      router.add_interface( AsyncNetworkInterface { eth0, Address( "10.0.0.1" ) } );
+      router.add_interface( AsyncNetworkInterface { eth1, Address( "192.168.0.1" ) } );
+      router.add_route( Address( "192.168.0.0" ).ipv4_numeric(), 24, {}, 1 );
+
+      const size_t limit = router.memory_usage().current + 4096;
+      router.set_memory_budget( limit );
+      flood( router, eth0, 100 );
+
+      check( router.memory_usage().peak <= limit, "router-wide budget was exceeded" );
+      check( router.interface( 0 ).memory_drops() + router.interface( 1 ).memory_drops() > 0,
+             "no packets were dropped over budget" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
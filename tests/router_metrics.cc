@@ -0,0 +1,145 @@
+#include "common.hh"
+#include "metrics_exporter.hh"
+#include "router_common.hh"
+#include "socket.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress router_eth0 { 0x02, 0, 0, 0, 0, 0x01 };
+const EthernetAddress router_eth1 { 0x02, 0, 0, 0, 0, 0x02 };
+const EthernetAddress gateway_eth { 0x02, 0, 0, 0, 0, 0x20 };
+
+EthernetFrame make_frame( uint32_t dst_ip )
+{
+  InternetDatagram dgram;
+  dgram.header.src = Address( "10.0.0.2" ).ipv4_numeric();
+  dgram.header.dst = dst_ip;
+  dgram.header.ttl = 64;
+  dgram.payload.emplace_back( string( 100, 'x' ) );
+  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + dgram.payload.back().size();
+  dgram.header.compute_checksum();
+
+  EthernetFrame frame;
+  frame.header.dst = router_eth0;
+  frame.header.src = gateway_eth;
+  frame.header.type = EthernetHeader::TYPE_IPv4;
+  frame.payload = serialize( dgram );
+  return frame;
+}
+
+// Send an HTTP request over a connected socket and return the whole response
+string scrape( Socket& socket )
+{
+  socket.write( "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n" );
+  string response;
+  string chunk;
+  while ( not socket.eof() ) {
+    socket.read( chunk );
+    response += chunk;
+  }
+  return response;
+}
+
+// The value of the sample whose name and labels are exactly `series`
+uint64_t sample( const string& text, const string& series )
+{
+  const size_t at = text.find( "\n" + series + " " );
+  check( at != string::npos, "no sample " + series + " in:\n" + text );
+  return stoull( text.substr( at + series.size() + 2 ) );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    Router router;
+    router.add_interface( AsyncNetworkInterface { router_eth0, Address( "10.0.0.1" ) } );
+    router.add_interface( AsyncNetworkInterface { router_eth1, Address( "192.168.0.1" ) } );
+    router.add_route( Address( "10.0.0.0" ).ipv4_numeric(), 8, {}, 0 );
+    router.add_route( Address( "172.16.0.0" ).ipv4_numeric(), 12, Address( "192.168.0.2" ), 1 );
+    learn_gateway( router, gateway_eth, ip( "192.168.0.2" ) );
+
+    const EthernetFrame routable = make_frame( Address( "172.16.0.1" ).ipv4_numeric() );
+    const EthernetFrame unroutable = make_frame( Address( "8.8.8.8" ).ipv4_numeric() );
+    for ( int i = 0; i < 5; i++ ) {
+      router.interface( 0 ).recv_frame( routable );
+    }
+    router.interface( 0 ).recv_frame( unroutable );
+    router.route();
+
+    // Over TCP on localhost
+    MetricsExporter tcp_exporter { router };
+    {
+      TCPSocket listener;
+      listener.set_reuseaddr();
+      listener.bind( Address( "127.0.0.1", 0 ) );
+      listener.listen();
+      const uint16_t port = listener.local_address().port();
+      tcp_exporter.serve( std::move( listener ) );
+
+      TCPSocket client;
+      client.connect( Address( "127.0.0.1", port ) );
+      const string response = scrape( client );
+      check( response.starts_with( "HTTP/1.0 200 OK\r\n" ), "status line: " + response );
+      check( response.find( "Content-Type: text/plain; version=0.0.4" ) != string::npos, "content type" );
+      check( response.find( "# TYPE router_interface_rx_packets_total counter" ) != string::npos, "TYPE line" );
+      check( sample( response, "router_routes" ) == 2, "routes" );
+      check( sample( response, R"(router_interface_rx_packets_total{interface="0"})" ) == 6, "rx packets" );
+      check( sample( response, R"(router_interface_forwarded_total{interface="1"})" ) == 5, "forwarded" );
+      check( sample( response, R"(router_interface_drops_total{interface="0",reason="no_route"})" ) == 1,
+             "no_route drops" );
+      check( sample( response, R"(router_interface_arp_entries{interface="1"})" ) == 1, "ARP entries" );
+      check( sample( response, R"(router_interface_memory_bytes{interface="1"})" ) > 0, "memory bytes" );
+      check( sample( response, "router_route_duration_ns_count" ) == 1, "route() summary" );
+      check( response.find( R"(router_interface_forwarding_latency_ns{interface="1",quantile="0.99"} )" )
+               != string::npos,
+             "forwarding latency summary" );
+    }
+
+    // Over a Unix-domain socket, while another thread forwards packets
+    const string path = "/tmp/router_metrics_" + to_string( getpid() ) + ".sock";
+    MetricsExporter local_exporter { router };
+    {
+      LocalStreamSocket listener;
+      listener.bind( Address::from_unix_path( path ) );
+      listener.listen();
+      local_exporter.serve( std::move( listener ) );
+    }
+
+    thread forwarder { [&] {
+      for ( int i = 0; i < 2000; i++ ) {
+        router.interface( 0 ).recv_frame( routable );
+        router.route();
+        while ( router.interface( 1 ).maybe_send().has_value() ) {}
+      }
+    } };
+    uint64_t last = 0;
+    for ( int i = 0; i < 20; i++ ) {
+      LocalStreamSocket client;
+      client.connect( Address::from_unix_path( path ) );
+      const uint64_t forwarded
+        = sample( scrape( client ), R"(router_interface_forwarded_total{interface="1"})" );
+      check( forwarded >= last, "counters never go backwards" );
+      last = forwarded;
+    }
+    forwarder.join();
+    ::unlink( path.c_str() );
+
+    check( local_exporter.render().find( R"(router_interface_forwarded_total{interface="1"} 2005)" )
+             != string::npos,
+           "final count" );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,198 @@
+#include "common.hh"
+#include "packet_capture.hh"
+#include "replay.hh"
+#include "router_common.hh"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const EthernetAddress sender_eth { 0x02, 0, 0, 0, 0, 0x10 };
+const EthernetAddress other_eth { 0x02, 0, 0, 0, 0, 0x11 };
+
+const string config_text = R"(
+# two interfaces, a gateway behind the second
+interface 02:00:00:00:00:01 10.0.0.1
+interface 02:00:00:00:00:02 192.168.0.1
+route 10.0.0.0/8 0
+route 172.16.0.0/12 1 192.168.0.2   # via the gateway
+neighbor 1 192.168.0.2 02:00:00:00:00:20
+port 02:00:00:00:00:10 0
+port 02:00:00:00:00:11 1
+)";
+
+const EthernetAddress elsewhere_eth { 0x02, 0, 0, 0, 0, 0x99 }; // as some other host's capture would show
+const uint32_t host_ip = ip( "10.0.0.2" );
+
+string temporary_path( const string& name )
+{
+  return "/tmp/router_replay_" + to_string( getpid() ) + "_" + name;
+}
+
+void write_file( const string& path, const string& contents )
+{
+  ofstream out { path, ios::binary };
+  out << contents;
+  check( out.good(), "write " + path );
+}
+
+// A big-endian pcap with microsecond timestamps, as another machine might have written: frames 20 ms apart
+string big_endian_pcap( const vector<EthernetFrame>& frames )
+{
+  string file;
+  const auto put32 = [&]( uint32_t value ) {
+    for ( int shift = 24; shift >= 0; shift -= 8 ) {
+      file.push_back( static_cast<char>( value >> shift ) );
+    }
+  };
+  put32( 0xa1b2c3d4 );
+  file += string( "\x00\x02\x00\x04", 4 );
+  put32( 0 );
+  put32( 0 );
+  put32( 65535 );
+  put32( 1 );
+
+  uint32_t usec = 0;
+  for ( const auto& frame : frames ) {
+    string bytes;
+    for ( const auto& buffer : serialize( frame ) ) {
+      bytes += string_view { buffer };
+    }
+    put32( 1000 );
+    put32( usec );
+    put32( bytes.size() );
+    put32( bytes.size() );
+    file += bytes;
+    usec += 20'000;
+  }
+  return file;
+}
+
+void test_config()
+{
+  istringstream in { config_text };
+  const RouterConfig config = RouterConfig::parse( in );
+  check( config.interfaces.size() == 2 and config.routes.size() == 2, "interfaces and routes" );
+  check( config.routes[1].prefix_length == 12 and config.routes[1].next_hop == "192.168.0.2", "route" );
+  check( config.neighbors.size() == 1 and config.ports.size() == 2, "neighbors and ports" );
+
+  for ( const string bad : { "route 10.0.0.0/8 5", "interface 02:00:00:00:00 10.0.0.1", "bogus 1 2", "" } ) {
+    istringstream bad_in { "interface 02:00:00:00:00:01 10.0.0.1\n" + bad + "\n" };
+    istringstream empty_in { bad };
+    bool threw = false;
+    try {
+      RouterConfig::parse( bad.empty() ? empty_in : bad_in );
+    } catch ( const runtime_error& ) {
+      threw = true;
+    }
+    check( threw, "rejects \"" + bad + "\"" );
+  }
+}
+
+void test_full_speed()
+{
+  // a trace written by the router's own capture tap
+  PacketCapture capture { {}, 64, 1518 };
+  const uint32_t far = Address( "172.16.0.1" ).ipv4_numeric();
+  for ( int i = 0; i < 20; i++ ) {
+    capture.capture( make_ipv4_frame( elsewhere_eth, host_ip, far + i, 64, 200, sender_eth ),
+                     CaptureDirection::Inbound );
+  }
+  capture.capture( make_ipv4_frame( elsewhere_eth, host_ip, ip( "8.8.8.8" ), 64, 200, sender_eth ),
+                   CaptureDirection::Inbound );
+  capture.capture( make_ipv4_frame( elsewhere_eth, host_ip, far, 1, 200, sender_eth ), CaptureDirection::Inbound );
+  capture.capture( make_ipv4_frame( elsewhere_eth, host_ip, ip( "10.0.0.7" ), 64, 200, other_eth ),
+                   CaptureDirection::Inbound );
+
+  ostringstream pcap;
+  capture.write_pcap( pcap );
+  const string path = temporary_path( "full.pcap" );
+  write_file( path, pcap.str() );
+
+  istringstream in { config_text };
+  const PcapFile trace { path };
+  ::unlink( path.c_str() );
+  check( trace.frames().size() == 23, "frames read back" );
+  check( trace.frames()[0].original_length == trace.frames()[0].bytes.size(), "whole frames" );
+
+  Replay replay { RouterConfig::parse( in ), trace };
+  check( replay.frames() == 23 and replay.skipped() == 0, "all frames injected" );
+
+  const ReplayResult result = replay.run( { .speed = 0, .loops = 3, .batch = 8 } );
+  check( result.frames == 69, "frames injected" );
+  check( result.bytes == 3 * ( 22 * 234 + 234 ), "bytes injected" );
+  // 20 per loop to the gateway, and one ARP request for 10.0.0.7 (whose datagrams wait for a reply)
+  check( result.sent_frames == 3 * 20 + 1, "sent " + to_string( result.sent_frames ) );
+  check( result.drops[static_cast<size_t>( DropReason::NoRoute )] == 3, "no-route drops" );
+  check( result.drops[static_cast<size_t>( DropReason::TtlExpired )] == 3, "TTL drops" );
+  check( result.total_drops() == 6, "no other drops" );
+  check( result.seconds > 0 and result.mpps() > 0 and result.gbps() > 0, "rates" );
+
+  // frames whose ports mapped them to interface 1 entered there
+  check( replay.router().interface( 1 ).stats().get( InterfaceCounter::RxPackets ) >= 3, "port mapping" );
+}
+
+void test_timed_and_foreign_files()
+{
+  const uint32_t far = Address( "172.16.0.1" ).ipv4_numeric();
+  const string path = temporary_path( "timed.pcap" );
+  const EthernetFrame frame = make_ipv4_frame( elsewhere_eth, host_ip, far, 64, 200, sender_eth );
+  write_file( path, big_endian_pcap( { frame, frame, frame } ) );
+  const PcapFile trace { path };
+  ::unlink( path.c_str() );
+  check( trace.frames().size() == 3, "big-endian frames" );
+  check( trace.frames()[1].timestamp_ns - trace.frames()[0].timestamp_ns == 20'000'000, "microsecond timestamps" );
+
+  // 40 ms of trace at double speed takes about 20 ms
+  istringstream in { config_text };
+  Replay replay { RouterConfig::parse( in ), trace };
+  const ReplayResult result = replay.run( { .speed = 2, .loops = 1, .batch = 64 } );
+  check( result.sent_frames == 3, "timed frames sent" );
+  check( result.seconds >= 0.019 and result.seconds < 1, "timing: " + to_string( result.seconds ) + " s" );
+
+  // a capture truncated by its snaplen cannot be replayed
+  PacketCapture short_capture { {}, 4, 64 };
+  short_capture.capture( frame, CaptureDirection::Inbound );
+  ostringstream pcap;
+  short_capture.write_pcap( pcap );
+  const string short_path = temporary_path( "short.pcap" );
+  write_file( short_path, pcap.str() );
+  const PcapFile short_trace { short_path };
+  ::unlink( short_path.c_str() );
+  istringstream in2 { config_text };
+  check( Replay( RouterConfig::parse( in2 ), short_trace ).skipped() == 1, "truncated frames skipped" );
+
+  // not a pcap file at all
+  const string bogus_path = temporary_path( "bogus.pcap" );
+  write_file( bogus_path, string( 100, 'x' ) );
+  bool threw = false;
+  try {
+    const PcapFile bogus { bogus_path };
+  } catch ( const runtime_error& ) {
+    threw = true;
+  }
+  ::unlink( bogus_path.c_str() );
+  check( threw, "rejects a file that is not pcap" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_config();
+    test_full_speed();
+    test_timed_and_foreign_files();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,197 @@
+#include "flow_sampler.hh"
+#include "forwarding_profile.hh"
+#include "router_common.hh"
+#include "socket.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+constexpr size_t packets = 200'000;
+constexpr size_t batch = 64;     // frames received before each call to route()
+constexpr size_t payload = 1000; // bytes of payload per datagram
+constexpr size_t routes = 64;
+constexpr uint32_t sampling_rate = 4096; // for the flow-sampling pass
+constexpr size_t rounds = 7;              // runs of each configuration, interleaved
+
+const EthernetAddress router_eth0 { 0x02, 0, 0, 0, 0, 0x01 };
+const EthernetAddress router_eth1 { 0x02, 0, 0, 0, 0, 0x02 };
+const EthernetAddress sender_eth { 0x02, 0, 0, 0, 0, 0x10 };
+const EthernetAddress gateway_eth { 0x02, 0, 0, 0, 0, 0x20 };
+
+EthernetFrame make_frame( uint32_t dst_ip )
+{
+  InternetDatagram dgram;
+  dgram.header.src = Address( "10.0.0.2" ).ipv4_numeric();
+  dgram.header.dst = dst_ip;
+  dgram.header.ttl = 64;
+  dgram.payload.emplace_back( string( payload, 'x' ) );
+  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + payload;
+  dgram.header.compute_checksum();
+
+  EthernetFrame frame;
+  frame.header.dst = router_eth0;
+  frame.header.src = sender_eth;
+  frame.header.type = EthernetHeader::TYPE_IPv4;
+  frame.payload = serialize( dgram );
+  return frame;
+}
+
+// Forward `packets` datagrams through a router with optional features turned on by `configure`, and return
+// the rate in Mpps
+double speed_test( const function<void( Router& )>& configure )
+{
+  Router router;
+  configure( router );
+  router.add_interface( AsyncNetworkInterface { router_eth0, Address( "10.0.0.1" ) } );
+  router.add_interface( AsyncNetworkInterface { router_eth1, Address( "192.168.0.1" ) } );
+
+  // a table of /24s behind a gateway on interface 1, and the sender's network on interface 0
+  const uint32_t gateway_ip = Address( "192.168.0.2" ).ipv4_numeric();
+  const uint32_t first_network = Address( "172.16.0.0" ).ipv4_numeric();
+  router.add_route( Address( "10.0.0.0" ).ipv4_numeric(), 8, {}, 0 );
+  for ( uint32_t i = 0; i < routes; i++ ) {
+    router.add_route( first_network + ( i << 8 ), 24, Address::from_ipv4_numeric( gateway_ip ), 1 );
+  }
+  learn_gateway( router, gateway_eth, gateway_ip );
+
+  vector<EthernetFrame> frames;
+  for ( uint32_t i = 0; i < batch; i++ ) {
+    frames.push_back( make_frame( first_network + ( ( i % routes ) << 8 ) + 1 ) );
+  }
+
+  this_thread_forwarding_profile().reset();
+  size_t forwarded = 0;
+  const auto start = steady_clock::now();
+  for ( size_t sent = 0; sent < packets; sent += batch ) {
+    for ( const auto& frame : frames ) {
+      router.interface( 0 ).recv_frame( frame );
+    }
+    router.route();
+    for ( auto frame = router.interface( 1 ).maybe_send(); frame.has_value();
+          frame = router.interface( 1 ).maybe_send() ) {
+      forwarded++;
+    }
+  }
+  const double seconds = duration<double>( steady_clock::now() - start ).count();
+
+  if ( forwarded != packets ) {
+    throw runtime_error( "forwarded " + to_string( forwarded ) + " of " + to_string( packets ) + " packets" );
+  }
+  return forwarded / seconds / 1e6;
+}
+
+// The median of some measurements
+double median( vector<double> values )
+{
+  sort( values.begin(), values.end() );
+  return values[values.size() / 2];
+}
+
+// The median rate of one configuration's runs, and their range
+void report( const string& variant, const vector<double>& mpps )
+{
+  const double bits_per_packet = ( EthernetHeader::LENGTH + IPv4Header::LENGTH + payload ) * 8.0;
+  cout << "Router forwarded " << packets << " packets (" << payload << "-byte payloads, " << routes + 1
+       << " routes" << ( variant.empty() ? "" : ", " + variant ) << "): median of " << mpps.size()
+       << " runs " << median( mpps ) << " Mpps (" << ranges::min( mpps ) << " to " << ranges::max( mpps )
+       << "), " << median( mpps ) * bits_per_packet / 1e3 << " Gbit/s.\n";
+}
+
+// How a feature changed the rate, from each run against the baseline run beside it
+void compare( const string& feature, const vector<double>& with, const vector<double>& baseline )
+{
+  vector<double> change;
+  for ( size_t i = 0; i < with.size(); i++ ) {
+    change.push_back( ( with[i] - baseline[i] ) / baseline[i] * 100 );
+  }
+  cout << feature << " changed the forwarding rate by a median " << median( change ) << "% (runs ranged from "
+       << ranges::min( change ) << "% to " << ranges::max( change ) << "%).\n";
+}
+
+// The cost of HeavyHitters::record() by itself, in ns, over Zipf-distributed destinations
+double heavy_hitters_ns()
+{
+  constexpr size_t records = 4'000'000;
+  constexpr size_t addresses = 100'000;
+
+  // a precomputed stream of ranks drawn from Zipf(1.1), each rank a scattered address
+  vector<double> cdf;
+  double sum = 0;
+  for ( size_t rank = 1; rank <= addresses; rank++ ) {
+    sum += 1 / pow( static_cast<double>( rank ), 1.1 );
+    cdf.push_back( sum );
+  }
+  mt19937 rng { 458 };
+  uniform_real_distribution<double> uniform { 0, sum };
+  vector<uint32_t> destinations;
+  for ( size_t i = 0; i < 65536; i++ ) {
+    const size_t rank = lower_bound( cdf.begin(), cdf.end(), uniform( rng ) ) - cdf.begin();
+    destinations.push_back( 0xac100000 + static_cast<uint32_t>( rank * 2654435761U % 0xfffff ) );
+  }
+
+  auto hitters = make_unique<HeavyHitters>();
+  const auto start = steady_clock::now();
+  for ( size_t i = 0; i < records; i++ ) {
+    hitters->record( 0x0a000002 + ( i & 3 ), destinations[i % 65536], 1 );
+  }
+  return duration<double, nano>( steady_clock::now() - start ).count() / records;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    // Flow sampling exports to a collector that nobody reads
+    UDPSocket collector;
+    collector.bind( Address( "127.0.0.1", 0 ) );
+    auto sampler = make_shared<FlowSampler>( sampling_rate );
+    sampler->start_export( UDPSocket {}, collector.local_address(), milliseconds( 100 ) );
+
+    // interleave the configurations, so drift in the machine's speed affects them alike
+    vector<double> baseline;
+    vector<double> sampled;
+    vector<double> tracked;
+    for ( size_t round = 0; round < rounds; round++ ) {
+      baseline.push_back( speed_test( []( Router& ) {} ) );
+      if ( round == 0 ) {
+#ifdef ROUTER_PROFILE
+        cout << "Per-stage profile ("
+             << ( this_thread_forwarding_profile().counters().hardware() ? "perf events" : "TSC fallback" )
+             << "):\n";
+        print_forwarding_profile( cout, this_thread_forwarding_profile(), packets );
+        cout << "\n";
+#else
+        cout << "(configure with -DROUTER_PROFILE=ON for a per-stage profile)\n\n";
+#endif
+      }
+      sampled.push_back( speed_test( [&]( Router& router ) { router.set_flow_sampler( sampler ); } ) );
+      tracked.push_back( speed_test( []( Router& router ) { router.track_heavy_hitters( true ); } ) );
+    }
+
+    cout << fixed << setprecision( 2 );
+    report( "", baseline );
+    report( "sampling 1 in " + to_string( sampling_rate ), sampled );
+    report( "tracking heavy hitters", tracked );
+    compare( "Flow sampling at 1 in " + to_string( sampling_rate ), sampled, baseline );
+    compare( "Heavy-hitter tracking", tracked, baseline );
+    cout << "(HeavyHitters::record() alone: " << heavy_hitters_ns() << " ns per datagram.)\n";
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
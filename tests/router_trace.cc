@@ -0,0 +1,212 @@
+#include "common.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+#include "packet_trace.hh"
+#include "router.hh"
+
+#include <atomic>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+string temporary_path( const string& name )
+{
+  return "/tmp/router_trace_" + to_string( getpid() ) + "_" + name;
+}
+
+// The ring keeps the newest `capacity` events, oldest first
+void check_ring()
+{
+  TraceRing ring;
+  check( ring.recorded() == 0 and ring.last( 10 ).empty(), "new ring is empty" );
+
+  for ( uint32_t i = 0; i < 3; i++ ) {
+    ring.record( 1, 2, 3, i );
+  }
+  auto events = ring.last( 10 );
+  check( events.size() == 3 and events.front().value == 0 and events.back().value == 2, "last() before wrap" );
+  check( events.front().type == 1 and events.front().source == 2 and events.front().detail == 3, "fields" );
+
+  for ( uint32_t i = 3; i < TraceRing::capacity + 100; i++ ) {
+    ring.record( 0, 0, 0, i );
+  }
+  events = ring.last( TraceRing::capacity * 2 );
+  check( events.size() == TraceRing::capacity, "ring holds capacity events" );
+  check( events.front().value == 100 and events.back().value == TraceRing::capacity + 99, "last() after wrap" );
+  for ( size_t i = 1; i < events.size(); i++ ) {
+    check( events[i].value == events[i - 1].value + 1, "events in order" );
+    check( events[i].timestamp >= events[i - 1].timestamp, "timestamps in order" );
+  }
+  check( ring.last( 5 ).front().value == TraceRing::capacity + 95, "last(5)" );
+}
+
+// A dump reads back as the same events, and prints readably
+void check_dump()
+{
+  TraceRing& ring = this_thread_trace_ring();
+  const uint64_t before = ring.recorded();
+  ring.record( static_cast<uint8_t>( PacketTraceEvent::Lookup ), 1, PACKET_TRACE_NO_MATCH, 0xc0a80002 );
+  ring.record( static_cast<uint8_t>( PacketTraceEvent::Drop ),
+               1,
+               static_cast<uint8_t>( DropReason::NoRoute ),
+               0xc0a80002 );
+  check( ring.recorded() == before + 2, "recorded()" );
+
+  const string path = temporary_path( "dump" );
+  {
+    ofstream create { path };
+  }
+  {
+    FileDescriptor fd { CheckSystemCall( "open", ::open( path.c_str(), O_WRONLY ) ) }; // NOLINT
+    write_trace_dump( fd.fd_num() );
+  }
+
+  ifstream in { path, ios::binary };
+  const auto sections = read_trace_dump( in );
+  ::unlink( path.c_str() );
+
+  const TraceSection* mine = nullptr;
+  for ( const auto& section : sections ) {
+    if ( section.thread == ring.snapshot().thread ) {
+      mine = &section;
+    }
+  }
+  check( mine != nullptr, "dump contains this thread's ring" );
+  check( mine->events.size() >= 2, "dump contains the events" );
+  check( mine->ticks_per_ns > 0, "dump is calibrated" );
+  check( mine->events.back().type == static_cast<uint8_t>( PacketTraceEvent::Drop ), "newest event is last" );
+
+  ostringstream printed;
+  print_trace( printed, *mine, 2 );
+  check( printed.str().find( "lookup dst=192.168.0.2 prefix=none" ) != string::npos, "lookup printed" );
+  check( printed.str().find( "drop reason=no_route" ) != string::npos, "drop printed" );
+
+  istringstream garbage { string( 200, 'x' ) };
+  bool threw = false;
+  try {
+    read_trace_dump( garbage );
+  } catch ( const runtime_error& ) {
+    threw = true;
+  }
+  check( threw, "malformed dump is rejected" );
+}
+
+// A process that crashes leaves its trace behind
+void check_crash_dump()
+{
+  const string path = temporary_path( "crash" );
+  const pid_t child = CheckSystemCall( "fork", fork() );
+  if ( child == 0 ) {
+    install_trace_crash_handler( path );
+    this_thread_trace_ring().record( static_cast<uint8_t>( PacketTraceEvent::Tx ), 7, 0, 1234 );
+    abort();
+  }
+
+  int status {};
+  CheckSystemCall( "waitpid", waitpid( child, &status, 0 ) );
+  check( WIFSIGNALED( status ) and WTERMSIG( status ) == SIGABRT, "child died of its signal" );
+
+  ifstream in { path, ios::binary };
+  const auto sections = read_trace_dump( in );
+  ::unlink( path.c_str() );
+  bool found = false;
+  for ( const auto& section : sections ) {
+    found |= not section.events.empty() and section.events.back().source == 7
+             and section.events.back().value == 1234;
+  }
+  check( found, "crash dump holds the last event" );
+}
+
+#ifdef ROUTER_TRACE
+// The router records a lookup and a drop for an unroutable datagram
+void check_router_hooks()
+{
+  Router router;
+  router.add_interface( AsyncNetworkInterface { EthernetAddress { 2, 0, 0, 0, 0, 1 }, Address( "10.0.0.1" ) } );
+
+  InternetDatagram dgram;
+  dgram.header.src = Address( "10.0.0.2" ).ipv4_numeric();
+  dgram.header.dst = Address( "192.168.0.2" ).ipv4_numeric();
+  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4;
+  dgram.header.compute_checksum();
+  EthernetFrame frame;
+  frame.header.dst = EthernetAddress { 2, 0, 0, 0, 0, 1 };
+  frame.header.type = EthernetHeader::TYPE_IPv4;
+  frame.payload = serialize( dgram );
+
+  router.interface( 0 ).recv_frame( frame );
+  router.route();
+
+  const auto events = this_thread_trace_ring().last( 3 );
+  check( events.size() == 3, "three events" );
+  check( events[0].type == static_cast<uint8_t>( PacketTraceEvent::Rx ), "rx traced" );
+  check( events[1].type == static_cast<uint8_t>( PacketTraceEvent::Lookup )
+           and events[1].detail == PACKET_TRACE_NO_MATCH,
+         "lookup miss traced" );
+  check( events[2].type == static_cast<uint8_t>( PacketTraceEvent::Drop )
+           and events[2].detail == static_cast<uint8_t>( DropReason::NoRoute ),
+         "drop traced" );
+}
+#endif
+
+// Another thread's view of a ring that is being recorded into: only whole, consecutive events
+void check_concurrent_reader()
+{
+  atomic<bool> started = false;
+  atomic<bool> stop = false;
+  thread writer { [&] {
+    TraceRing& ring = this_thread_trace_ring();
+    for ( uint32_t value = 0; not stop; value++ ) {
+      ring.record( 1, 2, 3, value );
+      started = true;
+    }
+  } };
+  while ( not started ) {}
+
+  const auto join = [&] {
+    stop = true;
+    writer.join();
+  };
+  try {
+    for ( int round = 0; round < 200; round++ ) {
+      for ( const auto& section : collect_trace() ) {
+        for ( size_t i = 1; i < section.events.size(); i++ ) {
+          const TraceEvent& event = section.events[i];
+          if ( event.type == 1 and section.events[i - 1].type == 1 ) {
+            check( event.value == section.events[i - 1].value + 1, "concurrent events consecutive" );
+            check( event.source == 2 and event.detail == 3, "concurrent events whole" );
+          }
+        }
+      }
+    }
+  } catch ( ... ) {
+    join();
+    throw;
+  }
+  join();
+}
+
+int main()
+{
+  try {
+    check_ring();
+    check_concurrent_reader();
+    check_dump();
+    check_crash_dump();
+#ifdef ROUTER_TRACE
+    check_router_hooks();
+#endif
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+#include "exception.hh"
+#include "shared_memory_link.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <poll.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+constexpr size_t frames = 20'000'000;
+constexpr size_t datagrams = 1'000'000;
+constexpr size_t batch = 64;
+constexpr size_t frame_size = 64; // minimum-size Ethernet frames, so per-frame costs dominate
+
+const EthernetAddress host_a_eth { 0x02, 0, 0, 0, 0x68, 0x0a };
+const EthernetAddress host_b_eth { 0x02, 0, 0, 0, 0x68, 0x0b };
+const Address host_a_ip { "10.68.0.1" };
+const Address host_b_ip { "10.68.0.2" };
+
+// Stream `frames` raw frames from this process to a forked one, and return the rate (until the child has
+// received the last) in Mpps. Whichever side has nothing to do yields, in case they share a CPU.
+double between_processes( const string& name, const SharedMemoryLinkOptions& options )
+{
+  SharedMemoryLink link { options };
+  const pid_t child = CheckSystemCall( "fork", ::fork() );
+  if ( child == 0 ) {
+    SharedMemoryDriver receiver { std::move( link ), SharedMemoryDriver::End::B, batch };
+    size_t received = 0;
+    size_t checksum = 0;
+    while ( received < frames ) {
+      const size_t got = receiver.receive_frames( batch, [&]( string_view frame ) { checksum += frame[0]; } );
+      received += got;
+      if ( got == 0 ) {
+        if ( options.notify ) {
+          pollfd ready { receiver.socket().fd_num(), POLLIN, 0 };
+          ::poll( &ready, 1, 1000 );
+        } else {
+          ::sched_yield();
+        }
+      }
+    }
+    ::_exit( checksum == frames * 'f' ? EXIT_SUCCESS : EXIT_FAILURE );
+  }
+
+  SharedMemoryDriver sender { std::move( link ), SharedMemoryDriver::End::A, batch };
+  const string frame( frame_size, 'f' );
+  const vector<string_view> burst( batch, frame );
+
+  const auto start = steady_clock::now();
+  for ( size_t sent = 0; sent < frames; ) {
+    const size_t more = sender.send_frames( span { burst }.first( min( batch, frames - sent ) ) );
+    sent += more;
+    if ( more == 0 ) {
+      ::sched_yield();
+    }
+  }
+  int status = 0;
+  ::waitpid( child, &status, 0 );
+  const double seconds = duration<double>( steady_clock::now() - start ).count();
+  if ( not WIFEXITED( status ) or WEXITSTATUS( status ) != EXIT_SUCCESS ) {
+    throw runtime_error( name + ": the receiving process failed" );
+  }
+
+  const double mpps = frames / seconds / 1e6;
+  cout << fixed << setprecision( 2 );
+  cout << name << ": " << frames << " frames of " << frame_size << " bytes in " << seconds << " s: " << mpps
+       << " Mpps, " << mpps * frame_size * 8 / 1e3 << " Gbit/s; " << sender.stats().send_calls
+       << " wakeups written.\n";
+  return mpps;
+}
+
+// Datagrams from one NetworkInterface to another through the driver, both in this process: the cost of
+// serializing and parsing, on top of the ring
+void through_interfaces()
+{
+  SharedMemoryLink link;
+  SharedMemoryDriver driver_a { link.duplicate(), SharedMemoryDriver::End::A, batch };
+  SharedMemoryDriver driver_b { std::move( link ), SharedMemoryDriver::End::B, batch };
+  NetworkInterface host_a { host_a_eth, host_a_ip };
+  AsyncNetworkInterface host_b { host_b_eth, host_b_ip };
+  const auto ignore = []( InternetDatagram&& ) {};
+
+  InternetDatagram dgram;
+  dgram.header.src = host_a_ip.ipv4_numeric();
+  dgram.header.dst = host_b_ip.ipv4_numeric();
+  dgram.payload.emplace_back( string( frame_size - EthernetHeader::LENGTH - 20, 'x' ) );
+  dgram.header.len = 20 + dgram.payload.back().size();
+  dgram.header.compute_checksum();
+
+  size_t queued = 0;
+  size_t delivered = 0;
+  const auto start = steady_clock::now();
+  while ( delivered < datagrams ) {
+    for ( size_t i = 0; i < batch and queued < datagrams; i++, queued++ ) {
+      host_a.send_datagram( dgram, host_b_ip );
+    }
+    driver_a.send( host_a );
+    driver_b.receive( host_b );
+    driver_b.send( host_b ); // the ARP reply
+    driver_a.receive( host_a, ignore );
+    while ( host_b.maybe_receive().has_value() ) {
+      delivered++;
+    }
+  }
+  const double seconds = duration<double>( steady_clock::now() - start ).count();
+  cout << "Through NetworkInterfaces, one process: " << delivered << " datagrams in " << seconds << " s: "
+       << delivered / seconds / 1e6 << " Mpps.\n";
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    const double polled = between_processes( "Between processes, polling", { .notify = false } );
+    between_processes( "Between processes, eventfd wakeups", { .notify = true } );
+    through_interfaces();
+    if ( polled < 10 ) {
+      cout << "(under the 10 Mpps target: is this machine sharing one CPU between the two processes?)\n";
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
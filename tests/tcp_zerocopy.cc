@@ -0,0 +1,123 @@
+#include "common.hh"
+#include "socket.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <poll.h>
+#include <string>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+// Both ends of a loopback connection
+struct Connection
+{
+  TCPSocket listener {};
+  TCPSocket client {};
+  TCPSocket server {};
+
+  Connection()
+  {
+    listener.bind( Address( "127.0.0.1", 0 ) );
+    listener.listen();
+    client.connect( listener.local_address() );
+    server = listener.accept();
+  }
+};
+
+// Read everything the client sends until it shuts down, on another thread
+string drain( TCPSocket& server )
+{
+  string received;
+  string chunk;
+  while ( not server.eof() ) {
+    server.read( chunk );
+    received.append( chunk );
+  }
+  return received;
+}
+
+// Wait for the error queue to report every zero-copy send
+void reap_all( TCPSocket& socket )
+{
+  const auto deadline = steady_clock::now() + seconds( 10 );
+  while ( socket.zerocopy_in_flight() > 0 ) {
+    check( steady_clock::now() < deadline, "timed out waiting for completions" );
+    pollfd ready { socket.fd_num(), 0, 0 }; // POLLERR is always reported
+    ::poll( &ready, 1, 100 );
+    socket.reap_completions();
+  }
+}
+
+// Large writes go out with MSG_ZEROCOPY and arrive intact; the Buffers are held until the kernel is done
+// with them, and small writes are copied
+void test_stream()
+{
+  Connection connection;
+  connection.client.set_zerocopy( false );
+  string received;
+  thread reader { [&] { received = drain( connection.server ); } };
+
+  string expected;
+  vector<Buffer> small { string( 100, 's' ) };
+  for ( size_t i = 0; i < 50; i++ ) {
+    vector<Buffer> buffers { string( 40000, static_cast<char>( 'a' + i % 26 ) ), string( 30000, '-' ) };
+    // a blocking socket sends it all
+    check( connection.client.write_zerocopy( buffers ) == 70000, "large write" );
+    expected.append( string_view { buffers[0] } ).append( string_view { buffers[1] } );
+    expected.append( string_view { small[0] } );
+    check( connection.client.write_zerocopy( small ) == 100, "small write" );
+  }
+
+  reap_all( connection.client );
+  connection.client.shutdown( SHUT_WR );
+  reader.join();
+
+  const auto& stats = connection.client.zerocopy_stats();
+  check( received == expected, "stream contents" );
+  check( stats.zerocopy_sends == 50, "large writes sent with MSG_ZEROCOPY: " + to_string( stats.zerocopy_sends ) );
+  check( stats.copied_sends >= 50, "small writes copied" );
+  check( stats.completions == 50, "every send completed: " + to_string( stats.completions ) );
+}
+
+// The peer is on this host, so the kernel copies after all; by default the socket notices and stops trying
+void test_fallback()
+{
+  Connection connection;
+  connection.client.set_zerocopy();
+  thread reader { [&] { drain( connection.server ); } };
+
+  const vector<Buffer> buffers { string( 65536, 'z' ) };
+  for ( size_t i = 0; i < 5 and connection.client.zerocopy_stats().kernel_copied == 0; i++ ) {
+    connection.client.write_zerocopy( buffers );
+    reap_all( connection.client );
+  }
+  const auto& stats = connection.client.zerocopy_stats();
+  check( stats.kernel_copied > 0, "loopback reported as copied" );
+
+  const uint64_t before = stats.zerocopy_sends;
+  connection.client.write_zerocopy( buffers );
+  check( stats.zerocopy_sends == before and connection.client.zerocopy_in_flight() == 0, "fell back to copying" );
+
+  connection.client.shutdown( SHUT_WR );
+  reader.join();
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_stream();
+    test_fallback();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
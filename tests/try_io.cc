@@ -0,0 +1,108 @@
+#include "common.hh"
+#include "exception.hh"
+#include "socket.hh"
+
+#include <array>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+static_assert( sizeof( IOResult ) <= 16, "IOResult should stay small enough to return in registers" );
+
+// Would-block, data, EOF and an error each come back as their own status on a pipe
+void test_pipe()
+{
+  array<int, 2> ends {};
+  CheckSystemCall( "pipe2", ::pipe2( ends.data(), O_CLOEXEC | O_NONBLOCK ) );
+  FileDescriptor reader { ends[0] };
+  FileDescriptor writer { ends[1] };
+
+  array<char, 64> space {};
+  check( reader.try_read( space ).would_block(), "empty pipe would block" );
+  check( not reader.eof(), "and is not at EOF" );
+
+  const array<string_view, 3> parts { "abc", "", "defg" };
+  const IOResult written = writer.try_write( parts );
+  check( written.ok() and written.bytes == 7, "gathered write" );
+  check( writer.try_write( "" ).ok() and writer.try_write( "" ).bytes == 0, "an empty write is not an error" );
+
+  ReadBuffer buffer;
+  const IOResult read = reader.try_read( buffer );
+  check( read.ok() and read.bytes == 7 and buffer.readable() == "abcdefg", "read into a ReadBuffer" );
+
+  const IOResult wrong_end = reader.try_write( "x" );
+  check( wrong_end.failed() and wrong_end.error == EBADF, "writing the read end fails with EBADF" );
+
+  writer.close();
+  check( reader.try_read( space ).eof() and reader.eof(), "EOF once the writer closes" );
+  check( reader.read_count() == 2, "only successful reads counted" );
+}
+
+// A non-blocking listener accepts when a client has connected, and would block otherwise
+void test_accept()
+{
+  TCPSocket listener;
+  listener.bind( Address( "127.0.0.1", 0 ) );
+  listener.listen();
+  listener.set_blocking( false );
+
+  optional<TCPSocket> connection;
+  check( listener.try_accept( connection ).would_block() and not connection.has_value(), "nobody yet" );
+
+  TCPSocket client;
+  client.connect( listener.local_address() );
+  check( listener.try_accept( connection ).ok() and connection.has_value(), "accepted" );
+
+  client.write( "hello" );
+  client.shutdown( SHUT_WR );
+  array<char, 16> space {};
+  const IOResult read = connection->try_read( space );
+  check( read.ok() and string_view( space.data(), read.bytes ) == "hello", "data" );
+  check( connection->try_read( space ).eof(), "then EOF" );
+}
+
+// Datagrams into a slot: would-block, whole, and truncated
+void test_recv()
+{
+  UDPSocket receiver;
+  receiver.bind( Address( "127.0.0.1", 0 ) );
+  receiver.set_blocking( false );
+  UDPSocket sender;
+  sender.connect( receiver.local_address() );
+
+  array<char, 8> space {};
+  DatagramSocket::Slot slot;
+  slot.buffer = space;
+  check( receiver.try_recv( slot ).would_block(), "nothing waiting" );
+
+  sender.send( "short" );
+  const IOResult whole = receiver.try_recv( slot );
+  check( whole.ok() and whole.bytes == 5 and not slot.truncated, "whole datagram" );
+  check( Address( slot.address, slot.address_size ) == sender.local_address(), "sender's address" );
+
+  sender.send( "much too long" );
+  const IOResult cut = receiver.try_recv( slot );
+  check( cut.ok() and cut.bytes == 8 and slot.length == 8 and slot.truncated, "truncated datagram" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_pipe();
+    test_accept();
+    test_recv();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
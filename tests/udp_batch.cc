@@ -0,0 +1,105 @@
+#include "common.hh"
+#include "socket.hh"
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+// A set of receive slots, each with its own buffer, reused across calls
+template<size_t N>
+struct Slots
+{
+  array<array<char, 2048>, N> buffers {};
+  array<DatagramSocket::Slot, N> slots {};
+
+  Slots()
+  {
+    for ( size_t i = 0; i < N; i++ ) {
+      slots[i].buffer = buffers[i];
+    }
+  }
+
+  string_view payload( size_t i ) const { return { slots[i].buffer.data(), slots[i].length }; }
+};
+
+// Datagrams sent in one batch to several destinations arrive whole, in order, with their sender's address
+void test_round_trip()
+{
+  UDPSocket sender;
+  sender.bind( Address( "127.0.0.1", 0 ) );
+  UDPSocket receiver_a;
+  receiver_a.bind( Address( "127.0.0.1", 0 ) );
+  UDPSocket receiver_b;
+  receiver_b.bind( Address( "127.0.0.1", 0 ) );
+
+  constexpr size_t count = 40;
+  vector<string> payloads;
+  vector<DatagramSocket::Slot> outgoing( count );
+  for ( size_t i = 0; i < count; i++ ) {
+    payloads.push_back( "datagram " + to_string( i ) + string( i * 10, '.' ) );
+  }
+  for ( size_t i = 0; i < count; i++ ) {
+    const Address destination = i % 2 ? receiver_b.local_address() : receiver_a.local_address();
+    outgoing[i].buffer = payloads[i];
+    outgoing[i].length = payloads[i].size();
+    memcpy( &outgoing[i].address.storage, static_cast<const sockaddr*>( destination ), destination.size() );
+    outgoing[i].address_size = destination.size();
+  }
+  check( sender.send_batch( outgoing ) == count, "whole batch sent" );
+
+  Slots<16> in;
+  for ( auto* receiver : { &receiver_a, &receiver_b } ) {
+    size_t next = receiver == &receiver_a ? 0 : 1;
+    while ( next < count ) {
+      const size_t got = receiver->recv_batch( in.slots );
+      check( got > 0, "received something" );
+      for ( size_t i = 0; i < got; i++, next += 2 ) {
+        check( in.payload( i ) == payloads[next], "datagram " + to_string( next ) );
+        check( not in.slots[i].truncated, "not truncated" );
+        check( Address( in.slots[i].address, in.slots[i].address_size ) == sender.local_address(), "sender" );
+      }
+    }
+  }
+  check( receiver_a.read_count() <= 4, "few receive calls: " + to_string( receiver_a.read_count() ) );
+}
+
+// A non-blocking socket with nothing waiting returns 0; an oversized datagram is marked truncated
+void test_edges()
+{
+  UDPSocket receiver;
+  receiver.bind( Address( "127.0.0.1", 0 ) );
+  receiver.set_blocking( false );
+  Slots<4> in;
+  check( receiver.recv_batch( in.slots ) == 0, "nothing waiting" );
+
+  UDPSocket sender;
+  sender.connect( receiver.local_address() );
+  string big( 3000, 'b' );
+  DatagramSocket::Slot slot;
+  slot.buffer = big;
+  slot.length = big.size();
+  check( sender.send_batch( span { &slot, 1 } ) == 1, "sent to the connected peer" );
+  check( receiver.recv_batch( in.slots ) == 1, "received one" );
+  check( in.slots[0].truncated and in.slots[0].length == 2048, "truncated to the buffer" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_round_trip();
+    test_edges();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+#include "common.hh"
+#include "socket.hh"
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+// A receiving slot with room for a whole coalesced run
+struct Receiver
+{
+  UDPSocket socket {};
+  array<char, 65536> buffer {};
+  DatagramSocket::Slot slot {};
+
+  Receiver()
+  {
+    socket.bind( Address( "127.0.0.1", 0 ) );
+    socket.set_blocking( false );
+    slot.buffer = buffer;
+  }
+
+  string_view received() const { return { buffer.data(), slot.length }; }
+};
+
+DatagramSocket::Slot outgoing( string& payload, const Address& destination )
+{
+  DatagramSocket::Slot slot;
+  slot.buffer = payload;
+  slot.length = payload.size();
+  memcpy( &slot.address.storage, static_cast<const sockaddr*>( destination ), destination.size() );
+  slot.address_size = destination.size();
+  return slot;
+}
+
+// Without GRO, one segmented send arrives as separate datagrams of the segment size
+void test_segmentation()
+{
+  Receiver receiver;
+  UDPSocket sender;
+  string payload = pattern( 10 * 1000 + 300 );
+  check( sender.send_segments( outgoing( payload, receiver.socket.local_address() ), 1000 ) == payload.size(),
+         "whole buffer sent" );
+  check( sender.write_count() == 1, "in one system call" );
+
+  string reassembled;
+  for ( size_t i = 0; i < 11; i++ ) {
+    const size_t segment_size = receiver.socket.recv_segments( receiver.slot );
+    check( segment_size == ( i < 10 ? 1000 : 300 ), "segment " + to_string( i ) + " size" );
+    check( receiver.slot.length == segment_size, "one datagram per receive" );
+    reassembled.append( receiver.received() );
+  }
+  check( reassembled == payload, "segments intact and in order" );
+  check( receiver.socket.recv_segments( receiver.slot ) == 0, "nothing more" );
+}
+
+// With GRO, the run comes back as one buffer and its segment size; a connected socket with a default segment
+// size splits plain sends too
+void test_coalescing()
+{
+  Receiver receiver;
+  receiver.socket.set_gro( true );
+  UDPSocket sender;
+  sender.connect( receiver.socket.local_address() );
+
+  string payload = pattern( 20 * 1200 );
+  DatagramSocket::Slot slot = outgoing( payload, receiver.socket.local_address() );
+  slot.address_size = 0;
+  check( sender.send_segments( slot, 1200 ) == payload.size(), "sent to the connected peer" );
+
+  string reassembled;
+  while ( reassembled.size() < payload.size() ) {
+    const size_t segment_size = receiver.socket.recv_segments( receiver.slot );
+    check( segment_size == 1200, "segment size reported: " + to_string( segment_size ) );
+    check( receiver.slot.length % 1200 == 0, "whole segments" );
+    check( Address( receiver.slot.address, receiver.slot.address_size ) == sender.local_address(), "sender" );
+    reassembled.append( receiver.received() );
+  }
+  check( reassembled == payload, "coalesced data intact" );
+  check( receiver.socket.read_count() < 20, "fewer receives than datagrams" );
+
+  sender.set_segment_size( 500 );
+  sender.send( pattern( 1500 ) );
+  check( receiver.socket.recv_segments( receiver.slot ) == 500 and receiver.slot.length == 1500,
+         "socket-wide segment size" );
+}
+
+void test_limits()
+{
+  UDPSocket sender;
+  string payload( 65 * 100, 'x' );
+  DatagramSocket::Slot slot = outgoing( payload, Address( "127.0.0.1", 9 ) );
+  bool refused = false;
+  try {
+    sender.send_segments( slot, 100 );
+  } catch ( const runtime_error& ) {
+    refused = true;
+  }
+  check( refused, "more than kMaxSegments refused" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_segmentation();
+    test_coalescing();
+    test_limits();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
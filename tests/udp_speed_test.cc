@@ -0,0 +1,188 @@
+#include "socket.hh"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+constexpr size_t datagrams = 1'000'000;
+constexpr size_t batch = 64;
+constexpr size_t payload_size = 64; // small, so per-datagram costs dominate
+
+struct Result
+{
+  double seconds;
+  uint64_t syscalls;
+};
+
+void report( const string& name, const Result& result )
+{
+  cout << fixed << setprecision( 2 );
+  cout << name << ": " << datagrams << " datagrams of " << payload_size << " bytes in " << result.seconds
+       << " s: " << datagrams / result.seconds / 1e6 << " Mpps; " << result.syscalls << " system calls ("
+       << static_cast<double>( datagrams * 2 ) / static_cast<double>( result.syscalls )
+       << " datagrams per call).\n";
+}
+
+// A sender and receiver on loopback, one thread: a burst of `batch` datagrams out, then the same back in
+// (so the receive buffer never overflows)
+struct Loopback
+{
+  UDPSocket sender {};
+  UDPSocket receiver {};
+  Address destination { "127.0.0.1" };
+
+  Loopback()
+  {
+    receiver.set_buffer_sizes( 4 << 20 );
+    receiver.bind( Address( "127.0.0.1", 0 ) );
+    destination = receiver.local_address();
+  }
+};
+
+// One sendto() and one recv() per datagram, each recv() resizing its string and resolving the sender
+Result one_at_a_time()
+{
+  Loopback loopback;
+  const string payload( payload_size, 'x' );
+  Address source { "0.0.0.0" };
+  string received;
+
+  const auto start = steady_clock::now();
+  for ( size_t done = 0; done < datagrams; done += batch ) {
+    for ( size_t i = 0; i < batch; i++ ) {
+      loopback.sender.sendto( loopback.destination, payload );
+    }
+    for ( size_t i = 0; i < batch; i++ ) {
+      loopback.receiver.recv( source, received );
+    }
+  }
+  const double seconds = duration<double>( steady_clock::now() - start ).count();
+  return { seconds, loopback.sender.write_count() + loopback.receiver.read_count() };
+}
+
+// send_batch() and recv_batch(), with the same slots and buffers every time
+Result batched()
+{
+  Loopback loopback;
+  const string payload( payload_size, 'x' );
+  array<DatagramSocket::Slot, batch> outgoing {};
+  for ( auto& slot : outgoing ) {
+    slot.buffer = { const_cast<char*>( payload.data() ), payload.size() }; // NOLINT(*-const-cast)
+    slot.length = payload.size();
+    const Address& destination = loopback.destination;
+    memcpy( &slot.address.storage, static_cast<const sockaddr*>( destination ), destination.size() );
+    slot.address_size = loopback.destination.size();
+  }
+  array<array<char, 2048>, batch> buffers {};
+  array<DatagramSocket::Slot, batch> incoming {};
+  for ( size_t i = 0; i < batch; i++ ) {
+    incoming[i].buffer = buffers[i];
+  }
+
+  const auto start = steady_clock::now();
+  for ( size_t done = 0; done < datagrams; done += batch ) {
+    for ( size_t sent = 0; sent < batch; ) {
+      sent += loopback.sender.send_batch( span { outgoing }.subspan( sent ) );
+    }
+    for ( size_t received = 0; received < batch; ) {
+      received += loopback.receiver.recv_batch( span { incoming }.first( batch - received ) );
+    }
+  }
+  const double seconds = duration<double>( steady_clock::now() - start ).count();
+  return { seconds, loopback.sender.write_count() + loopback.receiver.read_count() };
+}
+
+// Bulk transfer of MTU-sized datagrams: one sendto() and recv() each, against send_segments() of
+// `bulk_segments` at a time to a receiver with GRO
+constexpr size_t bulk_datagrams = 396'000; // a whole number of sends
+constexpr size_t bulk_size = 1400;
+constexpr size_t bulk_segments = 44;         // 61,600 bytes per send
+
+void report_bulk( const string& name, const Result& result )
+{
+  cout << fixed << setprecision( 2 );
+  cout << name << ": " << bulk_datagrams << " datagrams of " << bulk_size << " bytes in " << result.seconds
+       << " s: " << static_cast<double>( bulk_datagrams * bulk_size ) * 8 / result.seconds / 1e9 << " Gbit/s; "
+       << result.syscalls << " system calls.\n";
+}
+
+Result bulk_one_at_a_time()
+{
+  Loopback loopback;
+  const string payload( bulk_size, 'x' );
+  Address source { "0.0.0.0" };
+  string received;
+
+  const auto start = steady_clock::now();
+  for ( size_t done = 0; done < bulk_datagrams; done += bulk_segments ) {
+    for ( size_t i = 0; i < bulk_segments; i++ ) {
+      loopback.sender.sendto( loopback.destination, payload );
+    }
+    for ( size_t i = 0; i < bulk_segments; i++ ) {
+      loopback.receiver.recv( source, received );
+    }
+  }
+  const double seconds = duration<double>( steady_clock::now() - start ).count();
+  return { seconds, loopback.sender.write_count() + loopback.receiver.read_count() };
+}
+
+Result bulk_segmented()
+{
+  Loopback loopback;
+  loopback.receiver.set_gro( true );
+  string payload( bulk_size * bulk_segments, 'x' );
+  DatagramSocket::Slot outgoing;
+  outgoing.buffer = payload;
+  outgoing.length = payload.size();
+  const Address& destination = loopback.destination;
+  memcpy( &outgoing.address.storage, static_cast<const sockaddr*>( destination ), destination.size() );
+  outgoing.address_size = destination.size();
+  string buffer( 65536, 0 );
+  DatagramSocket::Slot incoming;
+  incoming.buffer = buffer;
+
+  const auto start = steady_clock::now();
+  for ( size_t done = 0; done < bulk_datagrams; done += bulk_segments ) {
+    loopback.sender.send_segments( outgoing, bulk_size );
+    for ( size_t received = 0; received < payload.size(); received += incoming.length ) {
+      loopback.receiver.recv_segments( incoming );
+    }
+  }
+  const double seconds = duration<double>( steady_clock::now() - start ).count();
+  return { seconds, loopback.sender.write_count() + loopback.receiver.read_count() };
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    const Result single = one_at_a_time();
+    report( "sendto/recv", single );
+    const Result batches = batched();
+    report( "send_batch/recv_batch", batches );
+    cout << "Batching changed the rate by " << ( single.seconds / batches.seconds - 1 ) * 100 << "%.\n";
+
+    const Result bulk_single = bulk_one_at_a_time();
+    report_bulk( "Bulk, sendto/recv", bulk_single );
+    const Result bulk_gso = bulk_segmented();
+    report_bulk( "Bulk, send_segments/recv_segments with GRO", bulk_gso );
+    cout << "Segmentation offload changed the rate by " << ( bulk_single.seconds / bulk_gso.seconds - 1 ) * 100
+         << "%, with " << static_cast<double>( bulk_single.syscalls ) / static_cast<double>( bulk_gso.syscalls )
+         << "x fewer system calls.\n";
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdlib>
+#include <string>
+
+// A veth pair for the length of a test: a private link, so frames from other traffic (e.g. on the loopback
+// device) never reach the test's packet sockets. Creating one needs CAP_NET_ADMIN and the ip command; give each
+// test its own names, since tests run in parallel.
+class VethPair
+{
+  std::string a_;
+  std::string b_;
+  bool created_ = false;
+
+  static bool run( const std::string& command )
+  {
+    return system( ( "ip " + command + " >/dev/null 2>&1" ).c_str() ) == 0;
+  }
+
+public:
+  VethPair( const std::string& a, const std::string& b ) : a_( a ), b_( b )
+  {
+    run( "link del " + a_ ); // left behind by a test that was killed
+    created_ = run( "link add " + a_ + " type veth peer name " + b_ ) and run( "link set " + a_ + " up" )
+               and run( "link set " + b_ + " up" );
+  }
+
+  ~VethPair() { run( "link del " + a_ ); } // takes the peer with it
+
+  bool created() const { return created_; }
+  const std::string& a() const { return a_; }
+  const std::string& b() const { return b_; }
+
+  VethPair( const VethPair& other ) = delete;
+  VethPair& operator=( const VethPair& other ) = delete;
+  VethPair( VethPair&& other ) = delete;
+  VethPair& operator=( VethPair&& other ) = delete;
+};
@@ -0,0 +1,110 @@
+#include "exception.hh"
+#include "socket.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+constexpr size_t total_bytes = size_t { 2 } << 30;
+constexpr size_t write_size = 256 * 1024;
+constexpr size_t max_in_flight = 32;
+
+enum class Mode
+{
+  Copy,
+  ZeroCopy,
+  ZeroCopyWithFallback,
+};
+
+double cpu_seconds()
+{
+  rusage usage {};
+  CheckSystemCall( "getrusage", ::getrusage( RUSAGE_SELF, &usage ) );
+  const auto seconds = []( const timeval& t ) { return static_cast<double>( t.tv_sec ) + t.tv_usec / 1e6; };
+  return seconds( usage.ru_utime ) + seconds( usage.ru_stime );
+}
+
+// Send `total_bytes` over loopback TCP to a forked reader, and report the sender's CPU time per GB
+void run( const string& name, Mode mode )
+{
+  TCPSocket listener;
+  listener.bind( Address( "127.0.0.1", 0 ) );
+  listener.listen();
+
+  const pid_t child = CheckSystemCall( "fork", ::fork() );
+  if ( child == 0 ) {
+    TCPSocket reader;
+    reader.connect( listener.local_address() );
+    string chunk;
+    size_t received = 0;
+    while ( not reader.eof() ) {
+      reader.read( chunk );
+      received += chunk.size();
+    }
+    ::_exit( received == total_bytes ? EXIT_SUCCESS : EXIT_FAILURE );
+  }
+
+  TCPSocket sender = listener.accept();
+  if ( mode != Mode::Copy ) {
+    sender.set_zerocopy( mode == Mode::ZeroCopyWithFallback );
+  }
+  const vector<Buffer> buffers { string( write_size, 'x' ) };
+
+  const double cpu_before = cpu_seconds();
+  const auto start = steady_clock::now();
+  for ( size_t sent = 0; sent < total_bytes; ) {
+    if ( mode == Mode::Copy ) {
+      sent += sender.write( string_view { buffers[0] } );
+    } else {
+      sent += sender.write_zerocopy( buffers );
+      if ( sender.zerocopy_in_flight() >= max_in_flight ) {
+        sender.reap_completions();
+      }
+    }
+  }
+  while ( sender.zerocopy_in_flight() > 0 ) {
+    sender.reap_completions();
+  }
+  sender.shutdown( SHUT_WR );
+  int status = 0;
+  ::waitpid( child, &status, 0 );
+  const double seconds = duration<double>( steady_clock::now() - start ).count();
+  const double cpu = cpu_seconds() - cpu_before;
+  if ( not WIFEXITED( status ) or WEXITSTATUS( status ) != EXIT_SUCCESS ) {
+    throw runtime_error( name + ": the reader did not receive everything" );
+  }
+
+  const double gigabytes = static_cast<double>( total_bytes ) / 1e9;
+  const auto& stats = sender.zerocopy_stats();
+  cout << fixed << setprecision( 2 );
+  cout << name << ": " << gigabytes / seconds << " GB/s; sender CPU " << cpu / gigabytes << " s/GB; "
+       << stats.zerocopy_sends << " MSG_ZEROCOPY sends (" << stats.kernel_copied << " copied by the kernel), "
+       << stats.copied_sends << " copied.\n";
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    run( "write (copying)", Mode::Copy );
+    run( "write_zerocopy, always", Mode::ZeroCopy );
+    run( "write_zerocopy, falling back", Mode::ZeroCopyWithFallback );
+    cout << "(over loopback the kernel copies MSG_ZEROCOPY data on delivery, so only a real NIC shows the gain)\n";
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
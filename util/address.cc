@@ -7,8 +7,10 @@
 #include <cstring>
 #include <linux/if_packet.h>
 #include <memory>
+#include <net/if.h>
 #include <netdb.h>
 #include <stdexcept>
+#include <sys/un.h>
 #include <system_error>
 
 using namespace std;
@@ -148,6 +150,31 @@ Address Address::from_ipv4_numeric( const uint32_t ip_address )
   return { reinterpret_cast<sockaddr*>( &ipv4_addr ), sizeof( ipv4_addr ) }; // NOLINT(*-reinterpret-cast)
 }
 
+Address Address::from_unix_path( const string& path )
+{
+  sockaddr_un unix_addr {};
+  unix_addr.sun_family = AF_UNIX;
+  if ( path.size() >= sizeof( unix_addr.sun_path ) ) {
+    throw runtime_error( "Unix socket path too long: " + path );
+  }
+  path.copy( unix_addr.sun_path, path.size() );
+
+  return { reinterpret_cast<sockaddr*>( &unix_addr ), sizeof( unix_addr ) }; // NOLINT(*-reinterpret-cast)
+}
+
+Address Address::from_packet_interface( const string& device, const uint16_t protocol )
+{
+  sockaddr_ll packet_addr {};
+  packet_addr.sll_family = AF_PACKET;
+  packet_addr.sll_protocol = htons( protocol );
+  packet_addr.sll_ifindex = static_cast<int>( if_nametoindex( device.c_str() ) );
+  if ( packet_addr.sll_ifindex == 0 ) {
+    throw unix_error( "if_nametoindex " + device );
+  }
+
+  return { reinterpret_cast<sockaddr*>( &packet_addr ), sizeof( packet_addr ) }; // NOLINT(*-reinterpret-cast)
+}
+
 // equality
 bool Address::operator==( const Address& other ) const
 {
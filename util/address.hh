@@ -59,6 +59,11 @@ public:
   uint32_t ipv4_numeric() const;
   //! Create an Address from a 32-bit raw numeric IP address
   static Address from_ipv4_numeric( uint32_t ip_address );
+  //! Create a [Unix-domain](\ref man7::unix) socket Address from a filesystem path
+  static Address from_unix_path( const std::string& path );
+  //! Create a [packet socket](\ref man7::packet) Address for a network device (e.g. "lo") and an
+  //! Ethernet protocol (host byte order; e.g. ETH_P_ALL)
+  static Address from_packet_interface( const std::string& device, uint16_t protocol );
   //! Human-readable string, e.g., "8.8.8.8:53".
   std::string to_string() const;
   //!@}
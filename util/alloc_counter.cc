@@ -0,0 +1,160 @@
+#include "alloc_counter.hh"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace {
+
+atomic<uint64_t> global_allocations { 0 };
+atomic<uint64_t> global_deallocations { 0 };
+atomic<uint64_t> global_bytes { 0 };
+
+// constinit: usable from operator new even before (or after) the thread's dynamic initialization
+constinit thread_local AllocationCounts thread_counts {};
+
+#ifndef __SANITIZE_ADDRESS__ // AddressSanitizer's operator new and delete stay in place (see allocation_counting)
+
+void* allocate( size_t size, size_t alignment = 0 )
+{
+  if ( size == 0 ) {
+    size = 1;
+  }
+  void* memory = nullptr;
+  if ( alignment > alignof( max_align_t ) ) {
+    if ( posix_memalign( &memory, alignment, size ) != 0 ) {
+      memory = nullptr;
+    }
+  } else {
+    memory = malloc( size ); // NOLINT(*-no-malloc)
+  }
+  if ( memory ) {
+    global_allocations.fetch_add( 1, memory_order_relaxed );
+    global_bytes.fetch_add( size, memory_order_relaxed );
+    thread_counts.allocations++;
+    thread_counts.bytes += size;
+  }
+  return memory;
+}
+
+void* allocate_or_throw( size_t size, size_t alignment = 0 )
+{
+  void* memory = allocate( size, alignment );
+  if ( not memory ) {
+    throw bad_alloc();
+  }
+  return memory;
+}
+
+void deallocate( void* memory )
+{
+  if ( memory ) {
+    global_deallocations.fetch_add( 1, memory_order_relaxed );
+    thread_counts.deallocations++;
+    free( memory ); // NOLINT(*-no-malloc)
+  }
+}
+
+#endif
+
+} // namespace
+
+AllocationCounts global_allocation_counts()
+{
+  return { global_allocations.load( memory_order_relaxed ),
+           global_deallocations.load( memory_order_relaxed ),
+           global_bytes.load( memory_order_relaxed ) };
+}
+
+AllocationCounts this_thread_allocation_counts()
+{
+  return thread_counts;
+}
+
+#ifndef __SANITIZE_ADDRESS__
+// NOLINTBEGIN(*-new-delete-operators)
+void* operator new( size_t size )
+{
+  return allocate_or_throw( size );
+}
+void* operator new[]( size_t size )
+{
+  return allocate_or_throw( size );
+}
+void* operator new( size_t size, align_val_t alignment )
+{
+  return allocate_or_throw( size, static_cast<size_t>( alignment ) );
+}
+void* operator new[]( size_t size, align_val_t alignment )
+{
+  return allocate_or_throw( size, static_cast<size_t>( alignment ) );
+}
+void* operator new( size_t size, const nothrow_t& /* tag */ ) noexcept
+{
+  return allocate( size );
+}
+void* operator new[]( size_t size, const nothrow_t& /* tag */ ) noexcept
+{
+  return allocate( size );
+}
+void* operator new( size_t size, align_val_t alignment, const nothrow_t& /* tag */ ) noexcept
+{
+  return allocate( size, static_cast<size_t>( alignment ) );
+}
+void* operator new[]( size_t size, align_val_t alignment, const nothrow_t& /* tag */ ) noexcept
+{
+  return allocate( size, static_cast<size_t>( alignment ) );
+}
+
+void operator delete( void* memory ) noexcept
+{
+  deallocate( memory );
+}
+void operator delete[]( void* memory ) noexcept
+{
+  deallocate( memory );
+}
+void operator delete( void* memory, size_t /* size */ ) noexcept
+{
+  deallocate( memory );
+}
+void operator delete[]( void* memory, size_t /* size */ ) noexcept
+{
+  deallocate( memory );
+}
+void operator delete( void* memory, align_val_t /* alignment */ ) noexcept
+{
+  deallocate( memory );
+}
+void operator delete[]( void* memory, align_val_t /* alignment */ ) noexcept
+{
+  deallocate( memory );
+}
+void operator delete( void* memory, size_t /* size */, align_val_t /* alignment */ ) noexcept
+{
+  deallocate( memory );
+}
+void operator delete[]( void* memory, size_t /* size */, align_val_t /* alignment */ ) noexcept
+{
+  deallocate( memory );
+}
+void operator delete( void* memory, const nothrow_t& /* tag */ ) noexcept
+{
+  deallocate( memory );
+}
+void operator delete[]( void* memory, const nothrow_t& /* tag */ ) noexcept
+{
+  deallocate( memory );
+}
+void operator delete( void* memory, align_val_t /* alignment */, const nothrow_t& /* tag */ ) noexcept
+{
+  deallocate( memory );
+}
+void operator delete[]( void* memory, align_val_t /* alignment */, const nothrow_t& /* tag */ ) noexcept
+{
+  deallocate( memory );
+}
+// NOLINTEND(*-new-delete-operators)
+#endif
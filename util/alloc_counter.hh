@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts of calls to operator new and operator delete
+struct AllocationCounts
+{
+  uint64_t allocations {};
+  uint64_t deallocations {};
+  uint64_t bytes {}; // requested by the allocations
+
+  AllocationCounts operator-( const AllocationCounts& other ) const
+  {
+    return { allocations - other.allocations, deallocations - other.deallocations, bytes - other.bytes };
+  }
+};
+
+// Allocation counting is opt-in: alloc_counter.cc replaces the global operator new and delete, so it is
+// built into its own library (alloc_counter_debug or _sanitized), linked only into the programs that count.
+// Under AddressSanitizer, which has its own operator new and delete, nothing is replaced and every count
+// stays zero.
+#if defined( __SANITIZE_ADDRESS__ )
+constexpr bool allocation_counting = false;
+#else
+constexpr bool allocation_counting = true;
+#endif
+
+// Every allocation in the process since it started
+AllocationCounts global_allocation_counts();
+
+// Allocations made by the calling thread since it started
+AllocationCounts this_thread_allocation_counts();
+
+// Allocations made by the calling thread while the scope is alive
+class AllocationScope
+{
+public:
+  AllocationScope() : start_( this_thread_allocation_counts() ) {}
+
+  AllocationCounts counts() const { return this_thread_allocation_counts() - start_; }
+
+private:
+  AllocationCounts start_;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Small integer identifying the calling thread, handed out in order of first use
+inline size_t this_thread_index()
+{
+  static std::atomic<size_t> next_index { 0 };
+  thread_local const size_t index = next_index.fetch_add( 1, std::memory_order_relaxed );
+  return index;
+}
+
+// A fixed set of event counters, sharded so that each thread increments counters on its own cache lines.
+// Increments are relaxed atomic adds (no contention unless more threads than shards share a shard), and
+// readers may sum the shards at any time without stopping the writers.
+template<size_t N, size_t Shards = 8>
+class ShardedCounters
+{
+  static constexpr size_t cache_line = 64;
+
+  struct alignas( cache_line ) Shard
+  {
+    std::array<std::atomic<uint64_t>, N> counts {};
+  };
+
+  std::array<Shard, Shards> shards_ {};
+
+public:
+  static constexpr size_t size() { return N; }
+
+  void add( size_t counter, uint64_t n = 1 )
+  {
+    shards_[this_thread_index() % Shards].counts[counter].fetch_add( n, std::memory_order_relaxed );
+  }
+
+  // Sum of one counter across all shards (a consistent snapshot per counter, not across counters)
+  uint64_t get( size_t counter ) const
+  {
+    uint64_t total = 0;
+    for ( const auto& shard : shards_ ) {
+      total += shard.counts[counter].load( std::memory_order_relaxed );
+    }
+    return total;
+  }
+
+  std::array<uint64_t, N> snapshot() const
+  {
+    std::array<uint64_t, N> totals {};
+    for ( const auto& shard : shards_ ) {
+      for ( size_t i = 0; i < N; i++ ) {
+        totals[i] += shard.counts[i].load( std::memory_order_relaxed );
+      }
+    }
+    return totals;
+  }
+};
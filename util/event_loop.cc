@@ -0,0 +1,153 @@
+#include "event_loop.hh"
+
+#include "exception.hh"
+#include "histogram.hh"
+
+#include <array>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Registration of the stop() eventfd
+constexpr EventLoop::Id wakeup_id = 0;
+
+void watch( int epoll, int fd, EventLoop::Id id )
+{
+  epoll_event event {};
+  event.events = EPOLLIN;
+  event.data.u64 = id;
+  CheckSystemCall( "epoll_ctl", ::epoll_ctl( epoll, EPOLL_CTL_ADD, fd, &event ) );
+}
+
+} // namespace
+
+EventLoop::EventLoop()
+  : epoll_( CheckSystemCall( "epoll_create1", ::epoll_create1( EPOLL_CLOEXEC ) ) )
+  , wakeup_( CheckSystemCall( "eventfd", ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) )
+{
+  watch( epoll_.fd_num(), wakeup_.fd_num(), wakeup_id );
+}
+
+EventLoop::Id EventLoop::add( FileDescriptor&& fd, function<void()> callback )
+{
+  const Id id = next_id_++;
+  watch( epoll_.fd_num(), fd.fd_num(), id );
+  registrations_.emplace( id, make_unique<Registration>( std::move( fd ), std::move( callback ) ) );
+  return id;
+}
+
+EventLoop::Id EventLoop::add_reader( const FileDescriptor& fd, function<void()> on_readable )
+{
+  return add( fd.duplicate(), std::move( on_readable ) );
+}
+
+EventLoop::Id EventLoop::add_timer( const chrono::nanoseconds interval, function<void( uint64_t )> on_expiry )
+{
+  if ( interval <= chrono::nanoseconds::zero() ) {
+    throw runtime_error( "EventLoop::add_timer: interval must be positive" ); // zero would disarm the timerfd
+  }
+
+  FileDescriptor timer { CheckSystemCall( "timerfd_create",
+                                          ::timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC ) ) };
+  itimerspec spec {};
+  spec.it_interval.tv_sec = interval.count() / 1'000'000'000;
+  spec.it_interval.tv_nsec = interval.count() % 1'000'000'000;
+  spec.it_value = spec.it_interval;
+  CheckSystemCall( "timerfd_settime", ::timerfd_settime( timer.fd_num(), 0, &spec, nullptr ) );
+
+  const int timer_fd = timer.fd_num();
+  return add( std::move( timer ), [timer_fd, on_expiry = std::move( on_expiry ), last = monotonic_ns()]() mutable {
+    uint64_t expirations = 0;
+    if ( ::read( timer_fd, &expirations, sizeof( expirations ) ) != sizeof( expirations ) ) {
+      return; // already consumed
+    }
+    const uint64_t now = monotonic_ns();
+    const uint64_t elapsed = now - last;
+    last = now;
+    on_expiry( elapsed );
+  } );
+}
+
+void EventLoop::set_writable( const Id id, const bool writable )
+{
+  const auto it = registrations_.find( id );
+  if ( it == registrations_.end() ) {
+    return;
+  }
+  epoll_event event {};
+  event.events = writable ? EPOLLIN | EPOLLOUT : EPOLLIN;
+  event.data.u64 = id;
+  CheckSystemCall( "epoll_ctl", ::epoll_ctl( epoll_.fd_num(), EPOLL_CTL_MOD, it->second->fd.fd_num(), &event ) );
+}
+
+void EventLoop::after_events( function<void()> hook )
+{
+  hooks_.push_back( std::move( hook ) );
+}
+
+void EventLoop::remove( const Id id )
+{
+  const auto it = registrations_.find( id );
+  if ( it == registrations_.end() ) {
+    return;
+  }
+  CheckSystemCall( "epoll_ctl", ::epoll_ctl( epoll_.fd_num(), EPOLL_CTL_DEL, it->second->fd.fd_num(), nullptr ) );
+  retired_.push_back( std::move( it->second ) ); // its callback may be the one running
+  registrations_.erase( it );
+}
+
+size_t EventLoop::run_once( const optional<chrono::milliseconds> timeout )
+{
+  array<epoll_event, max_events> ready {};
+  const int count = ::epoll_wait(
+    epoll_.fd_num(), ready.data(), ready.size(), timeout.has_value() ? static_cast<int>( timeout->count() ) : -1 );
+  if ( count < 0 ) {
+    if ( errno == EINTR ) {
+      return 0;
+    }
+    throw unix_error( "epoll_wait" );
+  }
+  turns_++;
+
+  for ( size_t i = 0; i < static_cast<size_t>( count ); i++ ) {
+    const Id id = ready[i].data.u64;
+    if ( id == wakeup_id ) {
+      uint64_t ignored = 0;
+      static_cast<void>( ::read( wakeup_.fd_num(), &ignored, sizeof( ignored ) ) );
+      stopping_ = true;
+      continue;
+    }
+    // a callback may have removed this registration (or others) earlier in the turn
+    const auto it = registrations_.find( id );
+    if ( it != registrations_.end() ) {
+      events_++;
+      it->second->callback();
+    }
+  }
+
+  for ( const auto& hook : hooks_ ) {
+    hook();
+  }
+  retired_.clear();
+  return count;
+}
+
+void EventLoop::run()
+{
+  stopping_ = false;
+  while ( not stopping_ ) {
+    run_once();
+  }
+}
+
+void EventLoop::stop()
+{
+  const uint64_t one = 1;
+  static_cast<void>( ::write( wakeup_.fd_num(), &one, sizeof( one ) ) );
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// A single-threaded event loop on epoll, with timers on timerfd.
+//
+// Each turn waits for up to `max_events` ready descriptors, calls their callbacks, then calls every
+// after_events() hook once: handlers only move work into queues (e.g. a LinkDriver receiving into its
+// interface), and the hooks act on a whole batch at a time (e.g. Router::route(), then each driver's send()).
+// Descriptors are level-triggered, so a handler that leaves data unread is called again next turn.
+class EventLoop
+{
+public:
+  using Id = uint64_t; // names a registration, to remove it
+
+  static constexpr size_t max_events = 64;
+
+  EventLoop();
+
+  // Call `on_readable` whenever `fd` is readable
+  Id add_reader( const FileDescriptor& fd, std::function<void()> on_readable );
+
+  // Call `on_expiry` every `interval` (on the monotonic clock) with the nanoseconds that really elapsed since
+  // the previous call (or since the timer was added), however late the loop got to it. Missed expirations
+  // fold into one call. A single value may be shorter than `interval` (an on-time call right after a late
+  // one), but the values always sum to the time since the timer was added: after n expirations, at least
+  // n * interval. The interval must be positive.
+  Id add_timer( std::chrono::nanoseconds interval, std::function<void( uint64_t elapsed_ns )> on_expiry );
+
+  // Also call the callback of reader `id` whenever its descriptor is writable (or, with false, stop): for a
+  // non-blocking connection with output queued
+  void set_writable( Id id, bool writable );
+
+  // Call `hook` after each turn's callbacks, in the order added
+  void after_events( std::function<void()> hook );
+
+  void remove( Id id );
+
+  // Wait (up to `timeout`, or indefinitely) for ready descriptors, call their callbacks and then the hooks;
+  // returns the number of ready descriptors
+  size_t run_once( std::optional<std::chrono::milliseconds> timeout = std::nullopt );
+
+  // Run turns until stop()
+  void run();
+
+  // Make run() return after the current turn; safe from any thread, and from a signal handler
+  void stop();
+
+  // Turns taken, and callbacks called, so far
+  uint64_t turns() const { return turns_; }
+  uint64_t events() const { return events_; }
+
+private:
+  struct Registration
+  {
+    FileDescriptor fd;
+    std::function<void()> callback;
+  };
+
+  Id add( FileDescriptor&& fd, std::function<void()> callback );
+
+  FileDescriptor epoll_;
+  FileDescriptor wakeup_; // an eventfd, written by stop()
+  bool stopping_ {};
+  Id next_id_ { 1 };
+  std::unordered_map<Id, std::unique_ptr<Registration>> registrations_ {};
+  std::vector<std::unique_ptr<Registration>> retired_ {}; // removed during this turn, freed at its end
+  std::vector<std::function<void()>> hooks_ {};
+  uint64_t turns_ {};
+  uint64_t events_ {};
+};
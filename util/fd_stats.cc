@@ -0,0 +1,97 @@
+#include "fd_stats.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+atomic<bool> FDStats::enabled_ { false };
+
+namespace {
+
+// The live FDStats, for dump()
+struct Registry
+{
+  mutex lock {};
+  unordered_set<const FDStats*> live {};
+};
+
+Registry& registry()
+{
+  static Registry the_registry;
+  return the_registry;
+}
+
+// Single-writer increment, as in LatencyHistogram
+void bump( atomic<uint64_t>& counter, uint64_t n )
+{
+  counter.store( counter.load( memory_order_relaxed ) + n, memory_order_relaxed );
+}
+
+void print( ostream& out, const char* name, const FDStats::Direction& direction )
+{
+  const auto load = []( const atomic<uint64_t>& counter ) { return counter.load( memory_order_relaxed ); };
+  out << " " << name << " calls " << load( direction.calls ) << " bytes " << load( direction.bytes ) << " short "
+      << load( direction.short_calls ) << " eagain " << load( direction.would_block ) << " errors "
+      << load( direction.errors ) << " p50_ns " << direction.latency_ns.p50() << " p99_ns "
+      << direction.latency_ns.p99() << " max_ns " << direction.latency_ns.max();
+}
+
+} // namespace
+
+FDStats::FDStats( const int fd ) : fd_( fd )
+{
+  const lock_guard guard { registry().lock };
+  registry().live.insert( this );
+}
+
+FDStats::~FDStats()
+{
+  const lock_guard guard { registry().lock };
+  registry().live.erase( this );
+}
+
+void FDStats::record( Direction& direction, const uint64_t start_ns, const ssize_t result, const size_t requested )
+{
+  const int saved_errno = errno;
+  direction.latency_ns.record( monotonic_ns() - start_ns );
+  bump( direction.calls, 1 );
+  if ( result >= 0 ) {
+    bump( direction.bytes, result );
+    if ( result > 0 and static_cast<size_t>( result ) < requested ) {
+      bump( direction.short_calls, 1 );
+    }
+  } else if ( saved_errno == EAGAIN or saved_errno == EWOULDBLOCK ) {
+    bump( direction.would_block, 1 );
+  } else {
+    bump( direction.errors, 1 );
+  }
+  errno = saved_errno;
+}
+
+void FDStats::enable( const bool enabled )
+{
+  enabled_.store( enabled, memory_order_relaxed );
+}
+
+size_t FDStats::live()
+{
+  const lock_guard guard { registry().lock };
+  return registry().live.size();
+}
+
+void FDStats::dump( ostream& out )
+{
+  const lock_guard guard { registry().lock };
+  vector<const FDStats*> sorted { registry().live.begin(), registry().live.end() };
+  sort( sorted.begin(), sorted.end(), []( const FDStats* a, const FDStats* b ) { return a->fd() < b->fd(); } );
+  for ( const FDStats* stats : sorted ) {
+    out << "fd " << stats->fd();
+    print( out, "read", stats->reads );
+    print( out, "write", stats->writes );
+    out << "\n";
+  }
+}
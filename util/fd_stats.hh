@@ -0,0 +1,64 @@
+#pragma once
+
+#include "histogram.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <sys/types.h>
+
+// I/O statistics for one file descriptor: per direction, the system calls made, bytes moved, short
+// transfers (fewer bytes than asked for, but more than none), EAGAINs, other errors, and a latency
+// histogram of the calls.
+//
+// Tracking is switched on for the whole process with FDStats::enable(); FileDescriptors opened while it
+// is on get an FDStats, and those opened while it is off have none and pay only a null-pointer test per
+// call. Every live FDStats is in a registry that dump() prints.
+//
+// Each direction has a single writer (the thread reading, or the thread writing, the descriptor); other
+// threads may read the counters at any time, as with LatencyHistogram.
+class FDStats
+{
+public:
+  struct Direction
+  {
+    std::atomic<uint64_t> calls {};
+    std::atomic<uint64_t> bytes {};
+    std::atomic<uint64_t> short_calls {};
+    std::atomic<uint64_t> would_block {};
+    std::atomic<uint64_t> errors {};
+    LatencyHistogram latency_ns {};
+  };
+
+  Direction reads {};
+  Direction writes {};
+
+  explicit FDStats( int fd );
+  ~FDStats();
+
+  int fd() const { return fd_; }
+
+  // Account for a call that began at `start_ns`, asked for `requested` bytes (0 when a shorter result is
+  // not "short", e.g. a datagram) and returned `result` (with errno set if negative); errno is preserved
+  static void record( Direction& direction, uint64_t start_ns, ssize_t result, size_t requested );
+
+  static void enable( bool enabled );
+  static bool enabled() { return enabled_.load( std::memory_order_relaxed ); }
+
+  // Number of live descriptors being tracked
+  static size_t live();
+
+  // One line per live tracked descriptor, in order of descriptor number
+  static void dump( std::ostream& out );
+
+  FDStats( const FDStats& other ) = delete;
+  FDStats& operator=( const FDStats& other ) = delete;
+  FDStats( FDStats&& other ) = delete;
+  FDStats& operator=( FDStats&& other ) = delete;
+
+private:
+  int fd_;
+
+  static std::atomic<bool> enabled_;
+};
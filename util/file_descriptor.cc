@@ -3,9 +3,12 @@
 #include "exception.hh"
 
 #include <algorithm>
+#include <array>
 #include <fcntl.h>
 #include <iostream>
+#include <poll.h>
 #include <stdexcept>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/uio.h>
@@ -37,7 +40,8 @@ T FileDescriptor::CheckSystemCall( std::string_view s_attempt, T return_value )
 }
 
 // fd is the file descriptor number returned by [open(2)](\ref man2::open) or similar
-FileDescriptor::FDWrapper::FDWrapper( int fd ) : fd_( fd )
+FileDescriptor::FDWrapper::FDWrapper( int fd )
+  : fd_( fd ), stats_( FDStats::enabled() and fd >= 0 ? make_unique<FDStats>( fd ) : nullptr )
 {
   if ( fd < 0 ) {
     throw runtime_error( "invalid fd number:" + to_string( fd ) );
@@ -85,7 +89,9 @@ void FileDescriptor::read( string& buffer )
   buffer.clear();
   buffer.resize( kReadBufferSize );
 
+  const uint64_t start = io_start();
   const ssize_t bytes_read = ::read( fd_num(), buffer.data(), buffer.size() );
+  record_read( start, bytes_read, buffer.size() );
   if ( bytes_read < 0 ) {
     if ( internal_fd_->non_blocking_ and ( errno == EAGAIN or errno == EINPROGRESS ) ) {
       return;
@@ -123,7 +129,9 @@ void FileDescriptor::read( vector<unique_ptr<string>>& buffers )
     total_size += x->size();
   }
 
+  const uint64_t start = io_start();
   const ssize_t bytes_read = ::readv( fd_num(), iovecs.data(), static_cast<int>( iovecs.size() ) );
+  record_read( start, bytes_read, total_size );
   if ( bytes_read < 0 ) {
     if ( internal_fd_->non_blocking_ and ( errno == EAGAIN or errno == EINPROGRESS ) ) {
       return;
@@ -150,6 +158,98 @@ void FileDescriptor::read( vector<unique_ptr<string>>& buffers )
   }
 }
 
+size_t FileDescriptor::read( ReadBuffer& buffer )
+{
+  const span<char> space = buffer.prepare();
+  const uint64_t start = io_start();
+  const ssize_t bytes_read = ::read( fd_num(), space.data(), space.size() );
+  record_read( start, bytes_read, space.size() );
+  if ( bytes_read < 0 ) {
+    if ( internal_fd_->non_blocking_ and ( errno == EAGAIN or errno == EINPROGRESS ) ) {
+      return 0;
+    }
+    throw unix_error { "read" };
+  }
+
+  register_read();
+
+  if ( bytes_read == 0 ) {
+    internal_fd_->eof_ = true;
+  }
+
+  buffer.commit( bytes_read );
+  return bytes_read;
+}
+
+IOResult IOResult::from_syscall( const ssize_t result )
+{
+  if ( result >= 0 ) {
+    return { static_cast<size_t>( result ), 0, Status::Ok };
+  }
+  if ( errno == EAGAIN or errno == EWOULDBLOCK ) {
+    return { 0, 0, Status::WouldBlock };
+  }
+  return { 0, errno, Status::Error };
+}
+
+IOResult FileDescriptor::try_read( const span<char> buffer )
+{
+  const uint64_t start = io_start();
+  const ssize_t bytes_read = ::read( fd_num(), buffer.data(), buffer.size() );
+  record_read( start, bytes_read, buffer.size() );
+  IOResult result = IOResult::from_syscall( bytes_read );
+  if ( result.ok() ) {
+    register_read();
+    if ( result.bytes == 0 and not buffer.empty() ) {
+      internal_fd_->eof_ = true;
+      result.status = IOResult::Status::Eof;
+    }
+  }
+  return result;
+}
+
+IOResult FileDescriptor::try_read( ReadBuffer& buffer )
+{
+  const IOResult result = try_read( buffer.prepare() );
+  if ( result.ok() ) {
+    buffer.commit( result.bytes );
+  }
+  return result;
+}
+
+IOResult FileDescriptor::try_write( const string_view buffer )
+{
+  const uint64_t start = io_start();
+  const ssize_t bytes_written = ::write( fd_num(), buffer.data(), buffer.size() );
+  record_write( start, bytes_written, buffer.size() );
+  const IOResult result = IOResult::from_syscall( bytes_written );
+  if ( result.ok() ) {
+    register_write();
+  }
+  return result;
+}
+
+IOResult FileDescriptor::try_write( const span<const string_view> buffers )
+{
+  static constexpr size_t max_iovecs = 64;
+  array<iovec, max_iovecs> iovecs; // NOLINT(*-member-init)
+  const size_t count = min( buffers.size(), max_iovecs );
+  size_t total_size = 0;
+  for ( size_t i = 0; i < count; i++ ) {
+    iovecs[i] = { const_cast<char*>( buffers[i].data() ), buffers[i].size() }; // NOLINT(*-const-cast)
+    total_size += buffers[i].size();
+  }
+
+  const uint64_t start = io_start();
+  const ssize_t bytes_written = ::writev( fd_num(), iovecs.data(), static_cast<int>( count ) );
+  record_write( start, bytes_written, total_size );
+  const IOResult result = IOResult::from_syscall( bytes_written );
+  if ( result.ok() ) {
+    register_write();
+  }
+  return result;
+}
+
 size_t FileDescriptor::write( string_view buffer )
 {
   return write( vector<string_view> { buffer } );
@@ -165,8 +265,10 @@ size_t FileDescriptor::write( const vector<string_view>& buffers )
     total_size += x.size();
   }
 
-  const ssize_t bytes_written
-    = CheckSystemCall( "writev", ::writev( fd_num(), iovecs.data(), static_cast<int>( iovecs.size() ) ) );
+  const uint64_t start = io_start();
+  const ssize_t result = ::writev( fd_num(), iovecs.data(), static_cast<int>( iovecs.size() ) );
+  record_write( start, result, total_size );
+  const ssize_t bytes_written = CheckSystemCall( "writev", result );
   register_write();
 
   if ( bytes_written == 0 and total_size != 0 ) {
@@ -180,6 +282,181 @@ size_t FileDescriptor::write( const vector<string_view>& buffers )
   return bytes_written;
 }
 
+namespace {
+
+// the most transfer_to() asks of one system call
+constexpr size_t kTransferChunk = 1 << 20;
+
+// Wait until a non-blocking `fd` can take more: transfer_to() has already taken the bytes from the source
+void wait_writable( int fd )
+{
+  pollfd ready { fd, POLLOUT, 0 };
+  CheckSystemCall( "poll", ::poll( &ready, 1, -1 ) );
+}
+
+// Write all of `length` bytes, waiting out EAGAIN
+void write_all( int fd, const char* data, size_t length )
+{
+  while ( length > 0 ) {
+    const ssize_t written = ::write( fd, data, length );
+    if ( written < 0 ) {
+      if ( errno != EAGAIN ) {
+        throw unix_error { "write" };
+      }
+      wait_writable( fd );
+      continue;
+    }
+    data += written;
+    length -= written;
+  }
+}
+
+// Splice all of `length` bytes already in the pipe `from` to `to`, waiting out EAGAIN
+void splice_all( int from, int to, size_t length )
+{
+  while ( length > 0 ) {
+    const ssize_t moved = ::splice( from, nullptr, to, nullptr, length, SPLICE_F_MOVE );
+    if ( moved < 0 ) {
+      if ( errno != EAGAIN ) {
+        throw unix_error { "splice" };
+      }
+      wait_writable( to );
+      continue;
+    }
+    length -= moved;
+  }
+}
+
+// A pipe for splicing between two descriptors that are not pipes themselves, kept for the thread's lifetime.
+// It is shared by every transfer on the thread, so it must be empty between transfers: one that fails with
+// bytes still in it (say, the destination reset) replaces it, so they can never reach another destination.
+class BouncePipe
+{
+  array<int, 2> ends_ {};
+
+  void open() { CheckSystemCall( "pipe2", ::pipe2( ends_.data(), O_CLOEXEC ) ); }
+  void close()
+  {
+    ::close( ends_[0] );
+    ::close( ends_[1] );
+  }
+
+public:
+  BouncePipe() { open(); }
+  ~BouncePipe() { close(); }
+
+  int read_end() const { return ends_[0]; }
+  int write_end() const { return ends_[1]; }
+
+  // Discard whatever is in the pipe
+  void reset()
+  {
+    close();
+    open();
+  }
+
+  BouncePipe( const BouncePipe& other ) = delete;
+  BouncePipe& operator=( const BouncePipe& other ) = delete;
+  BouncePipe( BouncePipe&& other ) = delete;
+  BouncePipe& operator=( BouncePipe&& other ) = delete;
+};
+
+BouncePipe& bounce_pipe()
+{
+  thread_local BouncePipe pipe;
+  return pipe;
+}
+
+} // namespace
+
+size_t FileDescriptor::transfer_to( FileDescriptor& destination, const size_t count )
+{
+  struct stat source_info {};
+  struct stat destination_info {};
+  CheckSystemCall( "fstat", ::fstat( fd_num(), &source_info ) );
+  CheckSystemCall( "fstat", ::fstat( destination.fd_num(), &destination_info ) );
+
+  enum class Method
+  {
+    SendFile,
+    Splice,
+    SpliceThroughPipe,
+    Copy,
+  };
+  Method method = Method::Copy;
+  if ( S_ISREG( source_info.st_mode ) or S_ISBLK( source_info.st_mode ) ) {
+    method = Method::SendFile;
+  } else if ( S_ISFIFO( source_info.st_mode ) or S_ISFIFO( destination_info.st_mode ) ) {
+    method = Method::Splice;
+  } else if ( S_ISSOCK( source_info.st_mode ) ) {
+    method = Method::SpliceThroughPipe;
+  }
+
+  size_t moved = 0;
+  while ( moved < count ) {
+    const size_t want = min( count - moved, kTransferChunk );
+    const uint64_t start = stats() or destination.stats() ? monotonic_ns() : 0;
+    size_t asked = want;
+    ssize_t result = 0;
+    switch ( method ) {
+      case Method::SendFile:
+        result = ::sendfile( destination.fd_num(), fd_num(), nullptr, want );
+        break;
+      case Method::Splice:
+        result = ::splice( fd_num(), nullptr, destination.fd_num(), nullptr, want, SPLICE_F_MOVE );
+        break;
+      case Method::SpliceThroughPipe:
+        result = ::splice( fd_num(), nullptr, bounce_pipe().write_end(), nullptr, want, SPLICE_F_MOVE );
+        if ( result > 0 ) {
+          try {
+            splice_all( bounce_pipe().read_end(), destination.fd_num(), result );
+          } catch ( ... ) {
+            bounce_pipe().reset();
+            throw;
+          }
+        }
+        break;
+      case Method::Copy: {
+        array<char, kReadBufferSize> chunk; // NOLINT(*-member-init)
+        asked = min( want, chunk.size() );
+        result = ::read( fd_num(), chunk.data(), asked );
+        if ( result > 0 ) {
+          write_all( destination.fd_num(), chunk.data(), result );
+        }
+        break;
+      }
+    }
+
+    record_read( start, result, asked );
+    if ( result > 0 ) { // a failure is the source's read; nothing was written
+      destination.record_write( start, result, asked );
+    }
+    if ( result < 0 ) {
+      if ( ( errno == EINVAL or errno == ENOSYS ) and method != Method::Copy ) {
+        method = Method::Copy; // the kernel can't do this pair in place
+        continue;
+      }
+      if ( errno == EAGAIN ) {
+        if ( destination.internal_fd_->non_blocking_ and not internal_fd_->non_blocking_ ) {
+          wait_writable( destination.fd_num() ); // sendfile or splice straight into a full destination
+          continue;
+        }
+        break;
+      }
+      throw unix_error { "transfer_to" };
+    }
+
+    register_read();
+    if ( result == 0 ) {
+      set_eof();
+      break;
+    }
+    destination.register_write();
+    moved += result;
+  }
+  return moved;
+}
+
 void FileDescriptor::set_blocking( bool blocking )
 {
   int flags = CheckSystemCall( "fcntl", fcntl( fd_num(), F_GETFL ) ); // NOLINT(*-vararg)
@@ -1,10 +1,42 @@
 #pragma once
 
+#include "fd_stats.hh"
+#include "read_buffer.hh"
+
 #include <cstddef>
+#include <cstdint>
 #include <limits>
 #include <memory>
+#include <span>
+#include <string_view>
+#include <sys/types.h>
 #include <vector>
 
+// The outcome of a try_ call (FileDescriptor::try_read() and the like): reported, never thrown, and with
+// no string to build on the error path
+struct IOResult
+{
+  enum class Status : uint8_t
+  {
+    Ok,         // `bytes` were transferred (possibly 0, e.g. for an empty write)
+    WouldBlock, // non-blocking, and nothing could be done now (EAGAIN)
+    Eof,        // the peer has finished sending
+    Error,      // the system call failed with `error`
+  };
+
+  size_t bytes {};
+  int error {}; // errno, if Status::Error
+  Status status {};
+
+  bool ok() const { return status == Status::Ok; }
+  bool would_block() const { return status == Status::WouldBlock; }
+  bool eof() const { return status == Status::Eof; }
+  bool failed() const { return status == Status::Error; }
+
+  // The result of a system call returning `result` (and errno, if negative)
+  static IOResult from_syscall( ssize_t result );
+};
+
 // A reference-counted handle to a file descriptor
 class FileDescriptor
 {
@@ -20,6 +52,9 @@ class FileDescriptor
     unsigned read_count_ = 0;   // The number of times FDWrapper::fd_ has been read
     unsigned write_count_ = 0;  // The numberof times FDWrapper::fd_ has been written
 
+    // I/O statistics, if FDStats was enabled when FDWrapper::fd_ was opened
+    std::unique_ptr<FDStats> stats_;
+
     // Construct from a file descriptor number returned by the kernel
     explicit FDWrapper( int fd );
     // Closes the file descriptor upon destruction
@@ -51,6 +86,23 @@ protected:
   void register_read() { ++internal_fd_->read_count_; }   // increment read count
   void register_write() { ++internal_fd_->write_count_; } // increment write count
 
+  // I/O statistics: io_start() is the time to hand to record_read() or record_write() after the system call
+  // (and is 0, without reading the clock, if this descriptor is not tracked); `requested` is as for
+  // FDStats::record()
+  uint64_t io_start() const { return internal_fd_->stats_ ? monotonic_ns() : 0; }
+  void record_read( uint64_t start_ns, ssize_t result, size_t requested = 0 )
+  {
+    if ( internal_fd_->stats_ ) {
+      FDStats::record( internal_fd_->stats_->reads, start_ns, result, requested );
+    }
+  }
+  void record_write( uint64_t start_ns, ssize_t result, size_t requested = 0 )
+  {
+    if ( internal_fd_->stats_ ) {
+      FDStats::record( internal_fd_->stats_->writes, start_ns, result, requested );
+    }
+  }
+
   template<typename T>
   T CheckSystemCall( std::string_view s_attempt, T return_value ) const;
 
@@ -65,11 +117,31 @@ public:
   void read( std::string& buffer );
   void read( std::vector<std::unique_ptr<std::string>>& buffers );
 
+  // Read up to buffer.read_size() more bytes into `buffer`, after those not yet consumed, with no
+  // allocation or zero-filling once the buffer has grown to fit the traffic
+  // returns number of bytes read (0 at EOF, or if a non-blocking descriptor had nothing to read)
+  size_t read( ReadBuffer& buffer );
+
+  // Exception-free reads and writes for event loops: as read() and write(), but telling would-block,
+  // EOF and errors apart in the IOResult instead of returning 0 or throwing (a gathered write takes at
+  // most the first 64 buffers; the bytes written say how far it got)
+  IOResult try_read( std::span<char> buffer );
+  IOResult try_read( ReadBuffer& buffer );
+  IOResult try_write( std::string_view buffer );
+  IOResult try_write( std::span<const std::string_view> buffers );
+
   // Attempt to write a buffer
   // returns number of bytes written
   size_t write( std::string_view buffer );
   size_t write( const std::vector<std::string_view>& buffers );
 
+  // Move up to `count` bytes from this descriptor to `destination` without bringing them into user space:
+  // with sendfile(2) from a file, splice(2) to or from a pipe, or splice(2) through a pipe between two
+  // sockets; if the kernel refuses those, with read() and write(). Stops early at EOF (setting eof()) or
+  // when a non-blocking source runs dry; bytes taken from the source are always delivered in full.
+  // returns number of bytes moved
+  size_t transfer_to( FileDescriptor& destination, size_t count );
+
   // Close the underlying file descriptor
   void close() { internal_fd_->close(); }
 
@@ -88,6 +160,7 @@ public:
   bool closed() const { return internal_fd_->closed_; }                   // closed flag state
   unsigned int read_count() const { return internal_fd_->read_count_; }   // number of reads
   unsigned int write_count() const { return internal_fd_->write_count_; } // number of writes
+  const FDStats* stats() const { return internal_fd_->stats_.get(); }      // I/O statistics, if tracked
 
   // Copy/move constructor/assignment operators
   // FileDescriptor can be moved, but cannot be copied implicitly (see duplicate())
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Nanoseconds on the monotonic clock
+inline uint64_t monotonic_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch() )
+    .count();
+}
+
+// A log-linear ("HDR-style") histogram of non-negative integer samples, e.g. latencies in nanoseconds.
+// Each power-of-two range is split into 32 equal sub-buckets, so any reported percentile is within ~3% of
+// the true sample. Samples of 2^40 or more share the last bucket.
+//
+// Recording is allocation-free and lock-free. A histogram has a single writer (the thread that owns the
+// measured object); other threads may read it at any time and see a slightly stale but usable picture.
+class LatencyHistogram
+{
+public:
+  static constexpr unsigned sub_bucket_bits = 5;
+  static constexpr unsigned max_bits = 40;
+  static constexpr uint64_t sub_buckets = uint64_t { 1 } << sub_bucket_bits;
+  static constexpr size_t buckets = ( max_bits - sub_bucket_bits + 1 ) * sub_buckets;
+
+  static constexpr size_t bucket_index( uint64_t value )
+  {
+    if ( value < sub_buckets ) {
+      return value;
+    }
+    const unsigned msb = std::bit_width( value ) - 1;
+    if ( msb >= max_bits ) {
+      return buckets - 1;
+    }
+    const unsigned shift = msb - sub_bucket_bits;
+    return ( shift + 1 ) * sub_buckets + ( ( value >> shift ) - sub_buckets );
+  }
+
+  // Largest value that lands in bucket `index`
+  static constexpr uint64_t bucket_upper_bound( size_t index )
+  {
+    if ( index < sub_buckets ) {
+      return index;
+    }
+    const uint64_t shift = index / sub_buckets - 1;
+    const uint64_t base = ( index % sub_buckets + sub_buckets ) << shift;
+    return base + ( uint64_t { 1 } << shift ) - 1;
+  }
+
+  void record( uint64_t value )
+  {
+    bump( counts_[bucket_index( value )], 1 );
+    bump( count_, 1 );
+    bump( sum_, value );
+    if ( value > max_.load( std::memory_order_relaxed ) ) {
+      max_.store( value, std::memory_order_relaxed );
+    }
+  }
+
+  uint64_t count() const { return count_.load( std::memory_order_relaxed ); }
+  uint64_t max() const { return max_.load( std::memory_order_relaxed ); }
+  uint64_t sum() const { return sum_.load( std::memory_order_relaxed ); }
+  double mean() const { return count() ? static_cast<double>( sum() ) / static_cast<double>( count() ) : 0; }
+
+  // Smallest bucket bound that at least fraction `q` (0 < q <= 1) of the samples do not exceed
+  uint64_t percentile( double q ) const
+  {
+    std::array<uint64_t, buckets> counts {};
+    uint64_t total = 0;
+    for ( size_t i = 0; i < buckets; i++ ) {
+      counts[i] = counts_[i].load( std::memory_order_relaxed );
+      total += counts[i];
+    }
+    if ( total == 0 ) {
+      return 0;
+    }
+
+    const auto rank = std::max<uint64_t>( 1, std::ceil( q * static_cast<double>( total ) ) );
+    uint64_t seen = 0;
+    for ( size_t i = 0; i < buckets; i++ ) {
+      seen += counts[i];
+      if ( seen >= rank ) {
+        return std::min( bucket_upper_bound( i ), max() );
+      }
+    }
+    return max();
+  }
+
+  uint64_t p50() const { return percentile( 0.5 ); }
+  uint64_t p99() const { return percentile( 0.99 ); }
+  uint64_t p999() const { return percentile( 0.999 ); }
+
+  // Visit every non-empty bucket as (upper bound, count), in increasing order
+  template<class Visitor>
+  void for_each_bucket( Visitor&& visit ) const
+  {
+    for ( size_t i = 0; i < buckets; i++ ) {
+      const uint64_t n = counts_[i].load( std::memory_order_relaxed );
+      if ( n ) {
+        visit( bucket_upper_bound( i ), n );
+      }
+    }
+  }
+
+private:
+  // Single-writer increment: a plain load and store, never a locked read-modify-write
+  static void bump( std::atomic<uint64_t>& counter, uint64_t n )
+  {
+    counter.store( counter.load( std::memory_order_relaxed ) + n, std::memory_order_relaxed );
+  }
+
+  std::array<std::atomic<uint64_t>, buckets> counts_ {};
+  std::atomic<uint64_t> count_ {};
+  std::atomic<uint64_t> sum_ {};
+  std::atomic<uint64_t> max_ {};
+};
@@ -0,0 +1,518 @@
+#include "io_uring_loop.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+// Completions of cancel requests carry this instead of an operation's Id
+constexpr uint64_t cancel_tag = 0;
+
+// Most iovecs gathered into one writev()
+constexpr size_t max_batch_iovecs = 1024;
+
+// Ring indices are shared with the kernel: read its updates with acquire, and publish ours with release
+template<class T>
+T load_acquire( T* value )
+{
+  return atomic_ref<T>( *value ).load( memory_order_acquire );
+}
+
+template<class T>
+void store_release( T* value, T update )
+{
+  atomic_ref<T>( *value ).store( update, memory_order_release );
+}
+
+char* map_ring( int fd, size_t length, off_t offset, const char* what )
+{
+  void* mapping = ::mmap( nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset );
+  if ( mapping == MAP_FAILED ) {
+    throw unix_error( what );
+  }
+  return static_cast<char*>( mapping );
+}
+
+} // namespace
+
+IOUringLoop::IOUringLoop( const unsigned entries )
+  : ring_fd_( CheckSystemCall( "io_uring_setup",
+                               static_cast<int>( ::syscall( __NR_io_uring_setup, entries, &params_ ) ) ) )
+{
+  try {
+    sq_ring_length_ = params_.sq_off.array + params_.sq_entries * sizeof( unsigned );
+    cq_ring_length_ = params_.cq_off.cqes + params_.cq_entries * sizeof( io_uring_cqe );
+    if ( params_.features & IORING_FEAT_SINGLE_MMAP ) {
+      sq_ring_length_ = max( sq_ring_length_, cq_ring_length_ );
+      sq_ring_ = map_ring( ring_fd_.fd_num(), sq_ring_length_, IORING_OFF_SQ_RING, "mmap io_uring rings" );
+      cq_ring_ = sq_ring_;
+      cq_ring_length_ = 0; // shares the submission ring's mapping
+    } else {
+      sq_ring_ = map_ring( ring_fd_.fd_num(), sq_ring_length_, IORING_OFF_SQ_RING, "mmap io_uring SQ ring" );
+      cq_ring_ = map_ring( ring_fd_.fd_num(), cq_ring_length_, IORING_OFF_CQ_RING, "mmap io_uring CQ ring" );
+    }
+    sqes_length_ = params_.sq_entries * sizeof( io_uring_sqe );
+    sqes_ = reinterpret_cast<io_uring_sqe*>( // NOLINT(*-reinterpret-cast)
+      map_ring( ring_fd_.fd_num(), sqes_length_, IORING_OFF_SQES, "mmap io_uring SQEs" ) );
+  } catch ( ... ) {
+    unmap();
+    throw;
+  }
+
+  // NOLINTBEGIN(*-reinterpret-cast)
+  sq_head_ = reinterpret_cast<unsigned*>( sq_ring_ + params_.sq_off.head );
+  sq_tail_ = reinterpret_cast<unsigned*>( sq_ring_ + params_.sq_off.tail );
+  sq_mask_ = *reinterpret_cast<unsigned*>( sq_ring_ + params_.sq_off.ring_mask );
+  cq_head_ = reinterpret_cast<unsigned*>( cq_ring_ + params_.cq_off.head );
+  cq_tail_ = reinterpret_cast<unsigned*>( cq_ring_ + params_.cq_off.tail );
+  cq_mask_ = *reinterpret_cast<unsigned*>( cq_ring_ + params_.cq_off.ring_mask );
+  cqes_ = reinterpret_cast<io_uring_cqe*>( cq_ring_ + params_.cq_off.cqes );
+
+  // submission queue slot i always holds entry i
+  auto* array = reinterpret_cast<unsigned*>( sq_ring_ + params_.sq_off.array );
+  // NOLINTEND(*-reinterpret-cast)
+  for ( unsigned i = 0; i < params_.sq_entries; i++ ) {
+    array[i] = i;
+  }
+  sq_local_tail_ = *sq_tail_;
+}
+
+IOUringLoop::~IOUringLoop()
+{
+  for ( auto& [group, buffers] : buffer_rings_ ) {
+    io_uring_buf_reg registration {};
+    registration.bgid = group;
+    ::syscall( __NR_io_uring_register, ring_fd_.fd_num(), IORING_UNREGISTER_PBUF_RING, &registration, 1 );
+    ::munmap( buffers.ring, buffers.ring_length );
+  }
+  unmap();
+}
+
+void IOUringLoop::unmap()
+{
+  if ( sqes_ ) {
+    ::munmap( sqes_, sqes_length_ );
+  }
+  if ( cq_ring_ and cq_ring_length_ ) {
+    ::munmap( cq_ring_, cq_ring_length_ );
+  }
+  if ( sq_ring_ ) {
+    ::munmap( sq_ring_, sq_ring_length_ );
+  }
+}
+
+void IOUringLoop::add_buffer_ring( const uint16_t group, const uint16_t count, const uint32_t size )
+{
+  if ( not has_single_bit( count ) or count > 32768 or size == 0 ) {
+    throw runtime_error( "IOUringLoop: a buffer ring needs a power-of-two count (at most 32768) of buffers" );
+  }
+  if ( buffer_rings_.contains( group ) ) {
+    throw runtime_error( "IOUringLoop: buffer group " + to_string( group ) + " already exists" );
+  }
+
+  BufferRing buffers;
+  buffers.ring_length = count * sizeof( io_uring_buf );
+  void* mapping
+    = ::mmap( nullptr, buffers.ring_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  if ( mapping == MAP_FAILED ) {
+    throw unix_error( "mmap buffer ring" );
+  }
+  buffers.ring = static_cast<io_uring_buf_ring*>( mapping );
+  buffers.memory.resize( static_cast<size_t>( count ) * size );
+  buffers.size = size;
+  buffers.mask = count - 1;
+
+  io_uring_buf_reg registration {};
+  registration.ring_addr = reinterpret_cast<uint64_t>( mapping ); // NOLINT(*-reinterpret-cast)
+  registration.ring_entries = count;
+  registration.bgid = group;
+  if ( ::syscall( __NR_io_uring_register, ring_fd_.fd_num(), IORING_REGISTER_PBUF_RING, &registration, 1 ) < 0 ) {
+    const int error = errno;
+    ::munmap( mapping, buffers.ring_length );
+    throw unix_error( "io_uring_register (buffer ring)", error );
+  }
+
+  buffer_rings_.emplace( group, std::move( buffers ) );
+  for ( uint16_t i = 0; i < count; i++ ) {
+    recycle( group, i );
+  }
+}
+
+// Give a buffer back to the kernel
+void IOUringLoop::recycle( const uint16_t group, const uint16_t buffer )
+{
+  BufferRing& buffers = buffer_rings_.at( group );
+  auto* slots = reinterpret_cast<io_uring_buf*>( buffers.ring ); // NOLINT(*-reinterpret-cast)
+  io_uring_buf& slot = slots[buffers.tail & buffers.mask];
+  slot.addr = reinterpret_cast<uint64_t>( &buffers.memory[static_cast<size_t>( buffer ) * buffers.size] ); // NOLINT
+  slot.len = buffers.size;
+  slot.bid = buffer;
+  buffers.tail++;
+  store_release( &buffers.ring->tail, buffers.tail );
+}
+
+io_uring_sqe& IOUringLoop::next_sqe()
+{
+  if ( sq_local_tail_ - load_acquire( sq_head_ ) == params_.sq_entries ) {
+    submit_and_wait( 0, nullptr ); // full: hand the kernel what is queued so far
+    if ( sq_local_tail_ - load_acquire( sq_head_ ) == params_.sq_entries ) {
+      throw runtime_error( "IOUringLoop: submission queue is full" );
+    }
+  }
+  io_uring_sqe& sqe = sqes_[sq_local_tail_ & sq_mask_];
+  sq_local_tail_++;
+  unsubmitted_++;
+  submissions_++;
+  memset( &sqe, 0, sizeof( sqe ) );
+  return sqe;
+}
+
+void IOUringLoop::submit_and_wait( const unsigned wait_for, const __kernel_timespec* timeout )
+{
+  if ( unsubmitted_ == 0 and wait_for == 0 ) {
+    return;
+  }
+  store_release( sq_tail_, sq_local_tail_ );
+
+  unsigned flags = wait_for ? IORING_ENTER_GETEVENTS : 0;
+  io_uring_getevents_arg argument {};
+  const void* extra = nullptr;
+  size_t extra_size = 0;
+  if ( timeout ) {
+    argument.ts = reinterpret_cast<uint64_t>( timeout ); // NOLINT(*-reinterpret-cast)
+    flags |= IORING_ENTER_EXT_ARG;
+    extra = &argument;
+    extra_size = sizeof( argument );
+  }
+
+  enter_calls_++;
+  const long submitted
+    = ::syscall( __NR_io_uring_enter, ring_fd_.fd_num(), unsubmitted_, wait_for, flags, extra, extra_size );
+  if ( submitted < 0 ) {
+    if ( errno == ETIME or errno == EINTR or errno == EAGAIN or errno == EBUSY ) {
+      return; // timed out, interrupted, or completions must be drained first: the caller carries on
+    }
+    throw unix_error( "io_uring_enter" );
+  }
+  unsubmitted_ -= static_cast<unsigned>( submitted );
+}
+
+IOUringLoop::Id IOUringLoop::add( Operation&& operation )
+{
+  const Id id = next_id_++;
+  arm( id, operations_.emplace( id, std::move( operation ) ).first->second );
+  return id;
+}
+
+// Queue the submission that starts (or continues) an operation
+void IOUringLoop::arm( const Id id, Operation& operation )
+{
+  io_uring_sqe& sqe = next_sqe();
+  sqe.user_data = id;
+  switch ( operation.kind ) {
+    case Kind::Recv:
+      sqe.opcode = IORING_OP_RECV;
+      sqe.fd = operation.fd->fd_num();
+      sqe.ioprio = IORING_RECV_MULTISHOT;
+      sqe.flags = IOSQE_BUFFER_SELECT;
+      sqe.buf_group = operation.group;
+      break;
+    case Kind::Write:
+      throw logic_error( "IOUringLoop: writes are armed by descriptor (arm_writes)" );
+    case Kind::Poll:
+      sqe.opcode = IORING_OP_POLL_ADD;
+      sqe.fd = operation.fd->fd_num();
+      sqe.poll32_events = operation.events;
+      sqe.len = 0;
+      break;
+    case Kind::Timeout:
+      sqe.opcode = IORING_OP_TIMEOUT;
+      sqe.fd = -1;
+      sqe.addr = reinterpret_cast<uint64_t>( &operation.timeout ); // NOLINT(*-reinterpret-cast)
+      sqe.len = 1;
+      break;
+  }
+}
+
+IOUringLoop::Id IOUringLoop::recv_multishot( const FileDescriptor& socket,
+                                             const uint16_t group,
+                                             function<void( string_view )> on_data,
+                                             ResultCallback on_close )
+{
+  if ( not buffer_rings_.contains( group ) ) {
+    throw runtime_error( "IOUringLoop: no buffer group " + to_string( group ) );
+  }
+  Operation operation;
+  operation.kind = Kind::Recv;
+  operation.fd = socket.duplicate();
+  operation.group = group;
+  operation.on_data = std::move( on_data );
+  operation.on_result = std::move( on_close );
+  return add( std::move( operation ) );
+}
+
+IOUringLoop::Id IOUringLoop::write( const FileDescriptor& fd, vector<Buffer> buffers, ResultCallback on_done )
+{
+  Operation operation;
+  operation.kind = Kind::Write;
+  operation.fd = fd.duplicate();
+  operation.on_result = std::move( on_done );
+  operation.buffers = std::move( buffers );
+  for ( const auto& buffer : operation.buffers ) {
+    const string_view bytes = buffer;
+    if ( not bytes.empty() ) {
+      operation.iovecs.push_back( { const_cast<char*>( bytes.data() ), bytes.size() } ); // NOLINT(*-const-cast)
+    }
+  }
+
+  // one writev() in flight per descriptor, so that writes land in order
+  const Id id = next_id_++;
+  operations_.emplace( id, std::move( operation ) );
+  const int fd_num = fd.fd_num();
+  WriteQueue& queue = write_queues_[fd_num];
+  queue.ids.push_back( id );
+  if ( queue.in_flight == 0 ) {
+    arm_writes( fd_num, queue );
+  }
+  return id;
+}
+
+// Gather the descriptor's waiting writes into one writev()
+void IOUringLoop::arm_writes( const int fd, WriteQueue& queue )
+{
+  queue.batch.clear();
+  queue.in_flight = 0;
+  for ( const Id id : queue.ids ) {
+    if ( queue.batch.size() >= max_batch_iovecs ) {
+      break;
+    }
+    const Operation& operation = operations_.at( id );
+    const size_t take
+      = min( operation.iovecs.size() - operation.next_iovec, max_batch_iovecs - queue.batch.size() );
+    const auto first = operation.iovecs.begin() + static_cast<ptrdiff_t>( operation.next_iovec );
+    queue.batch.insert( queue.batch.end(), first, first + static_cast<ptrdiff_t>( take ) );
+    queue.in_flight++;
+  }
+
+  io_uring_sqe& sqe = next_sqe();
+  sqe.user_data = queue.ids.front();
+  sqe.opcode = IORING_OP_WRITEV;
+  sqe.fd = fd;
+  sqe.addr = reinterpret_cast<uint64_t>( queue.batch.data() ); // NOLINT(*-reinterpret-cast)
+  sqe.len = queue.batch.size();
+  sqe.off = static_cast<uint64_t>( -1 ); // the descriptor's current position, if it has one
+}
+
+IOUringLoop::Id IOUringLoop::poll( const FileDescriptor& fd,
+                                   const uint32_t events,
+                                   ResultCallback on_ready,
+                                   const bool repeat )
+{
+  Operation operation;
+  operation.kind = Kind::Poll;
+  operation.fd = fd.duplicate();
+  operation.events = events;
+  operation.repeat = repeat;
+  operation.on_result = std::move( on_ready );
+  return add( std::move( operation ) );
+}
+
+IOUringLoop::Id IOUringLoop::add_timeout( const chrono::nanoseconds delay, ResultCallback on_timeout )
+{
+  Operation operation;
+  operation.kind = Kind::Timeout;
+  operation.timeout.tv_sec = delay.count() / 1'000'000'000;
+  operation.timeout.tv_nsec = delay.count() % 1'000'000'000;
+  operation.on_result = std::move( on_timeout );
+  return add( std::move( operation ) );
+}
+
+void IOUringLoop::cancel( const Id id )
+{
+  const auto it = operations_.find( id );
+  if ( it == operations_.end() or it->second.cancelled ) {
+    return;
+  }
+  Operation& operation = it->second;
+
+  // a write that has not reached the kernel is simply dropped; one in flight finishes, unreported
+  if ( operation.kind == Kind::Write ) {
+    WriteQueue& queue = write_queues_.at( operation.fd->fd_num() );
+    const auto position = find( queue.ids.begin(), queue.ids.end(), id );
+    if ( static_cast<size_t>( position - queue.ids.begin() ) >= queue.in_flight ) {
+      queue.ids.erase( position );
+      operations_.erase( it );
+    } else {
+      operation.cancelled = true;
+    }
+    return;
+  }
+
+  // otherwise the kernel will finish it with a last completion, which removes it
+  operation.cancelled = true;
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_ASYNC_CANCEL;
+  sqe.fd = -1;
+  sqe.addr = id;
+  sqe.user_data = cancel_tag;
+}
+
+size_t IOUringLoop::wait( const optional<chrono::nanoseconds> timeout )
+{
+  if ( *cq_head_ == load_acquire( cq_tail_ ) ) {
+    if ( operations_.empty() and unsubmitted_ == 0 ) {
+      return 0; // nothing could ever complete
+    }
+    __kernel_timespec limit {};
+    if ( timeout.has_value() ) {
+      limit.tv_sec = timeout->count() / 1'000'000'000;
+      limit.tv_nsec = timeout->count() % 1'000'000'000;
+    }
+    submit_and_wait( 1, timeout.has_value() ? &limit : nullptr );
+  } else {
+    submit_and_wait( 0, nullptr );
+  }
+
+  size_t dispatched = 0;
+  unsigned head = *cq_head_;
+  for ( unsigned tail = load_acquire( cq_tail_ ); head != tail; tail = load_acquire( cq_tail_ ) ) {
+    while ( head != tail ) {
+      const io_uring_cqe cqe = cqes_[head & cq_mask_];
+      head++;
+      store_release( cq_head_, head ); // the slot is free as soon as it is copied
+      completions_++;
+      if ( cqe.user_data != cancel_tag ) {
+        complete( cqe );
+        dispatched++;
+      }
+    }
+  }
+  return dispatched;
+}
+
+void IOUringLoop::complete( const io_uring_cqe& cqe )
+{
+  const auto it = operations_.find( cqe.user_data );
+  const bool more = cqe.flags & IORING_CQE_F_MORE;
+  if ( it == operations_.end() ) {
+    return;
+  }
+  const Id id = it->first;
+  Operation& operation = it->second;
+
+  switch ( operation.kind ) {
+    case Kind::Recv: {
+      if ( cqe.flags & IORING_CQE_F_BUFFER ) {
+        const auto buffer = static_cast<uint16_t>( cqe.flags >> IORING_CQE_BUFFER_SHIFT );
+        const BufferRing& buffers = buffer_rings_.at( operation.group );
+        if ( cqe.res > 0 and not operation.cancelled ) {
+          operation.on_data( { &buffers.memory[static_cast<size_t>( buffer ) * buffers.size],
+                               static_cast<size_t>( cqe.res ) } );
+        }
+        recycle( operation.group, buffer );
+      }
+      if ( more ) {
+        return;
+      }
+      if ( not operation.cancelled and ( cqe.res > 0 or cqe.res == -ENOBUFS ) ) {
+        arm( id, operation ); // the kernel stopped early (e.g. ran out of buffers): carry on
+        return;
+      }
+      break;
+    }
+
+    case Kind::Write:
+      finish_writes( operation.fd->fd_num(), cqe.res );
+      return;
+
+    case Kind::Poll:
+      if ( not operation.cancelled and cqe.res != -ECANCELED ) {
+        operation.on_result( cqe.res );
+      }
+      if ( more ) {
+        return;
+      }
+      if ( operation.repeat and not operation.cancelled and cqe.res >= 0 ) {
+        arm( id, operation );
+        return;
+      }
+      operations_.erase( id );
+      return;
+
+    case Kind::Timeout:
+      if ( operation.cancelled or cqe.res == -ECANCELED ) {
+        operations_.erase( it );
+        return;
+      }
+      break;
+  }
+
+  // the operation is over: report how it ended
+  ResultCallback on_result = std::move( operation.on_result );
+  const bool report = not operation.cancelled;
+  operations_.erase( it );
+  if ( report and on_result ) {
+    on_result( cqe.res == -ETIME ? 0 : cqe.res );
+  }
+}
+
+// A descriptor's writev() completed: credit the bytes to its writes in order, and send what is left
+void IOUringLoop::finish_writes( const int fd, int result )
+{
+  if ( result == -EAGAIN or result == -EINTR ) {
+    result = 0; // try again from where it stopped
+  }
+
+  WriteQueue& queue = write_queues_.at( fd );
+  vector<pair<ResultCallback, int>> finished;
+  auto remaining = static_cast<size_t>( max( result, 0 ) );
+  for ( size_t i = 0; i < queue.in_flight; i++ ) {
+    Operation& operation = operations_.at( queue.ids.front() );
+    if ( result >= 0 ) {
+      while ( remaining > 0 and operation.next_iovec < operation.iovecs.size() ) {
+        iovec& next = operation.iovecs[operation.next_iovec];
+        const size_t taken = min( remaining, next.iov_len );
+        next.iov_base = static_cast<char*>( next.iov_base ) + taken;
+        next.iov_len -= taken;
+        operation.written += taken;
+        remaining -= taken;
+        if ( next.iov_len == 0 ) {
+          operation.next_iovec++;
+        }
+      }
+      if ( operation.next_iovec < operation.iovecs.size() ) {
+        break; // a short write: this one continues in the next writev()
+      }
+    }
+
+    // done, or failed (then every write in the batch fails with it)
+    if ( not operation.cancelled and operation.on_result ) {
+      finished.emplace_back( std::move( operation.on_result ),
+                             result < 0 ? result : static_cast<int>( operation.written ) );
+    }
+    operations_.erase( queue.ids.front() );
+    queue.ids.pop_front();
+  }
+
+  if ( queue.ids.empty() ) {
+    write_queues_.erase( fd );
+  } else {
+    arm_writes( fd, queue );
+  }
+
+  for ( auto& [on_done, outcome] : finished ) {
+    on_done( outcome );
+  }
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "buffer.hh"
+#include "file_descriptor.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <sys/uio.h>
+#include <unordered_map>
+#include <vector>
+
+// An event loop on an io_uring: operations are queued as submission entries, handed to the kernel together
+// by one io_uring_enter() per turn of the loop, and their completions are dispatched to callbacks.
+//
+// - recv_multishot(): one request keeps receiving into buffers the kernel picks from a registered buffer ring
+//   (see add_buffer_ring()), with a completion per datagram or chunk of stream, until the socket closes
+// - write(): writes a vector of Buffers, finishing short writes. Writes to one descriptor land in order, and
+//   those queued while another is in flight go out together in one writev().
+// - poll(): readiness, once or repeatedly, for descriptors read by other means (e.g. a PacketSocketDriver).
+//   A repeating poll is re-armed after each completion, so it reports readiness as long as it lasts rather
+//   than only the wakeups a multishot poll would see.
+// - add_timeout(): a callback after a delay
+//
+// Callbacks run on the thread calling wait(), and may start or cancel operations. Talking to io_uring
+// directly (there is no liburing here) needs Linux 6.0 or later.
+class IOUringLoop
+{
+public:
+  using Id = uint64_t; // names an operation, to cancel it
+
+  // Called with the result of an operation: bytes written, or 0 for a timeout or EOF, or a negative errno
+  using ResultCallback = std::function<void( int result )>;
+
+  // Throws unix_error with ENOSYS or EPERM where the kernel has no io_uring or has it turned off
+  explicit IOUringLoop( unsigned entries = 256 );
+  ~IOUringLoop();
+
+  // Register `count` buffers of `size` bytes as buffer group `group` (count must be a power of two)
+  void add_buffer_ring( uint16_t group, uint16_t count, uint32_t size );
+
+  // Receive from `socket` into buffers from `group`, passing each chunk to `on_data` (valid only during the
+  // call). When the kernel ends the request for lack of buffers it is started again; when the socket
+  // reaches EOF or fails, `on_close` gets 0 or the negative errno, and the request is over.
+  Id recv_multishot( const FileDescriptor& socket,
+                     uint16_t group,
+                     std::function<void( std::string_view data )> on_data,
+                     ResultCallback on_close = {} );
+
+  // Write all of `buffers` to `fd`, then call `on_done` with the total (or a negative errno on failure).
+  // The Buffers are kept alive until then.
+  Id write( const FileDescriptor& fd, std::vector<Buffer> buffers, ResultCallback on_done = {} );
+
+  // Call `on_ready` with the ready events (e.g. POLLIN) when `fd` is ready for `events`; keep watching if
+  // `repeat`
+  Id poll( const FileDescriptor& fd, uint32_t events, ResultCallback on_ready, bool repeat = true );
+
+  // Call `on_timeout` with 0 once `delay` has passed
+  Id add_timeout( std::chrono::nanoseconds delay, ResultCallback on_timeout );
+
+  // Stop an operation: its callbacks are not called again
+  void cancel( Id id );
+
+  // Submit everything queued, wait until at least one completion arrives (or `timeout` passes), and dispatch
+  // the completions; returns how many were dispatched
+  size_t wait( std::optional<std::chrono::nanoseconds> timeout = std::nullopt );
+
+  // Operations that have not finished
+  size_t pending() const { return operations_.size(); }
+
+  // Cost accounting: io_uring_enter() calls, submission entries, and completions
+  uint64_t enter_calls() const { return enter_calls_; }
+  uint64_t submissions() const { return submissions_; }
+  uint64_t completions() const { return completions_; }
+
+  IOUringLoop( const IOUringLoop& other ) = delete;
+  IOUringLoop& operator=( const IOUringLoop& other ) = delete;
+  IOUringLoop( IOUringLoop&& other ) = delete;
+  IOUringLoop& operator=( IOUringLoop&& other ) = delete;
+
+private:
+  enum class Kind : uint8_t
+  {
+    Recv,
+    Write,
+    Poll,
+    Timeout
+  };
+
+  struct Operation
+  {
+    Kind kind {};
+    std::optional<FileDescriptor> fd {}; // kept open while the kernel may use it
+    uint16_t group {};
+    uint32_t events {};
+    bool repeat {};
+    bool cancelled {};
+    std::function<void( std::string_view )> on_data {};
+    ResultCallback on_result {};
+
+    // write: the Buffers, what is left of them, and the total so far
+    std::vector<Buffer> buffers {};
+    std::vector<iovec> iovecs {};
+    size_t next_iovec {};
+    size_t written {};
+
+    __kernel_timespec timeout {};
+  };
+
+  // One descriptor's writes, oldest first; the first `in_flight` of them are in the writev() of `batch`
+  struct WriteQueue
+  {
+    std::deque<Id> ids {};
+    size_t in_flight {};
+    std::vector<iovec> batch {};
+  };
+
+  // A registered group of provided buffers: the ring shared with the kernel, and the memory it points into
+  struct BufferRing
+  {
+    io_uring_buf_ring* ring {};
+    size_t ring_length {};
+    std::vector<char> memory {};
+    uint32_t size {};
+    uint16_t mask {};
+    uint16_t tail {};
+  };
+
+  void unmap();
+  io_uring_sqe& next_sqe();
+  void submit_and_wait( unsigned wait_for, const __kernel_timespec* timeout );
+  Id add( Operation&& operation );
+  void arm( Id id, Operation& operation );
+  void complete( const io_uring_cqe& cqe );
+  void recycle( uint16_t group, uint16_t buffer );
+  void arm_writes( int fd, WriteQueue& queue );
+  void finish_writes( int fd, int result );
+
+  io_uring_params params_ {};
+  FileDescriptor ring_fd_;
+
+  // the shared rings: submission queue indices and entries, and completion queue
+  char* sq_ring_ {};
+  size_t sq_ring_length_ {};
+  char* cq_ring_ {};
+  size_t cq_ring_length_ {};
+  io_uring_sqe* sqes_ {};
+  size_t sqes_length_ {};
+  unsigned* sq_head_ {};
+  unsigned* sq_tail_ {};
+  unsigned sq_mask_ {};
+  unsigned* cq_head_ {};
+  unsigned* cq_tail_ {};
+  unsigned cq_mask_ {};
+  io_uring_cqe* cqes_ {};
+  unsigned sq_local_tail_ {}; // our tail, ahead of the published one by entries not yet submitted
+  unsigned unsubmitted_ {};
+
+  Id next_id_ { 1 };
+  std::unordered_map<Id, Operation> operations_ {};
+  std::unordered_map<int, WriteQueue> write_queues_ {};
+  std::unordered_map<uint16_t, BufferRing> buffer_rings_ {};
+
+  uint64_t enter_calls_ {};
+  uint64_t submissions_ {};
+  uint64_t completions_ {};
+};
@@ -0,0 +1,209 @@
+#include "logger.hh"
+
+#include <chrono>
+#include <sstream>
+#include <unistd.h>
+
+using namespace std;
+
+// How long the idle writer sleeps before looking at the queue anyway, should a wakeup ever go missing
+static constexpr chrono::milliseconds wake_backstop { 1000 };
+
+void log_print( ostream& out, const LogIpv4 ip )
+{
+  out << ( ( ip.address >> 24 ) & 0xff ) << '.' << ( ( ip.address >> 16 ) & 0xff ) << '.'
+      << ( ( ip.address >> 8 ) & 0xff ) << '.' << ( ip.address & 0xff );
+}
+
+void log_print( ostream& out, const EthernetAddress& address )
+{
+  out << to_string( address );
+}
+
+void log_print( ostream& out, const char* str )
+{
+  out << ( str ? str : "(null)" );
+}
+
+const char* log_print_until_placeholder( ostream& out, const char* format )
+{
+  const char* placeholder = strstr( format, "{}" );
+  if ( not placeholder ) {
+    out << format;
+    return format + strlen( format );
+  }
+  out.write( format, placeholder - format );
+  return placeholder + 2;
+}
+
+// write(2) all of `text`, giving up quietly on error (there is nowhere to report it)
+static void write_all( const int fd, string_view text )
+{
+  while ( not text.empty() ) {
+    const ssize_t written = ::write( fd, text.data(), text.size() );
+    if ( written <= 0 ) {
+      return;
+    }
+    text.remove_prefix( written );
+  }
+}
+
+static string_view level_name( const LogLevel level )
+{
+  switch ( level ) {
+    case LogLevel::Debug:
+      return "DEBUG";
+    case LogLevel::Info:
+      return "INFO";
+    case LogLevel::Warning:
+      return "WARNING";
+    case LogLevel::Error:
+      return "ERROR";
+    default:
+      return "LOG";
+  }
+}
+
+Logger::Logger()
+{
+  for ( size_t i = 0; i < capacity; i++ ) {
+    slots_[i].sequence.store( i, memory_order_relaxed );
+  }
+  writer_ = thread( [this] { drain(); } );
+}
+
+Logger::~Logger()
+{
+  {
+    const lock_guard lock { wake_mutex_ };
+    stopping_.store( true );
+  }
+  wake_.notify_one();
+  writer_.join();
+}
+
+void Logger::push( const LogRecord& record )
+{
+  uint64_t position = enqueued_.load( memory_order_relaxed );
+  Slot* slot = nullptr;
+  while ( true ) {
+    slot = &slots_[position % capacity];
+    const uint64_t sequence = slot->sequence.load( memory_order_acquire );
+    if ( sequence == position ) {
+      // the slot is free for this position; claim it
+      if ( enqueued_.compare_exchange_weak( position, position + 1, memory_order_relaxed ) ) {
+        break;
+      }
+    } else if ( sequence < position ) {
+      // the writer has not yet consumed the record a full lap ago: the queue is full
+      dropped_.fetch_add( 1, memory_order_relaxed );
+      return;
+    } else {
+      position = enqueued_.load( memory_order_relaxed );
+    }
+  }
+  slot->record = record;
+  slot->sequence.store( position + 1, memory_order_release );
+
+  // pairs with the fence in wait_for_records(): either the writer sees this record, or this sees it asleep
+  atomic_thread_fence( memory_order_seq_cst );
+  if ( sleeping_.load( memory_order_relaxed ) ) {
+    wake();
+  }
+}
+
+void Logger::wake()
+{
+  {
+    const lock_guard lock { wake_mutex_ };
+    sleeping_.store( false, memory_order_relaxed );
+  }
+  wake_.notify_one();
+}
+
+// Sleep until a producer (or the destructor) wakes the writer, unless a record arrived meanwhile
+void Logger::wait_for_records()
+{
+  sleeping_.store( true, memory_order_relaxed );
+  atomic_thread_fence( memory_order_seq_cst );
+  if ( slots_[read_ % capacity].sequence.load( memory_order_acquire ) == read_ + 1 ) {
+    sleeping_.store( false, memory_order_relaxed );
+    return;
+  }
+
+  unique_lock lock { wake_mutex_ };
+  wake_.wait_for( lock, wake_backstop, [this] {
+    return not sleeping_.load( memory_order_relaxed ) or stopping_.load( memory_order_relaxed );
+  } );
+  sleeping_.store( false, memory_order_relaxed );
+}
+
+bool Logger::pop( LogRecord& record )
+{
+  Slot& slot = slots_[read_ % capacity];
+  if ( slot.sequence.load( memory_order_acquire ) != read_ + 1 ) {
+    return false;
+  }
+  record = slot.record;
+  slot.sequence.store( read_ + capacity, memory_order_release );
+  read_++;
+  return true;
+}
+
+void Logger::drain()
+{
+  ostringstream text;
+  LogRecord record;
+  while ( true ) {
+    // anything logged before stopping_ was set is written before the thread exits
+    const bool stopping = stopping_.load();
+
+    // format a batch, and write it with one system call
+    size_t batch = 0;
+    while ( batch < capacity and pop( record ) ) {
+      text << level_name( record.level ) << ": ";
+      record.formatter( text, record.format, record.arguments.data() );
+      text << '\n';
+      batch++;
+    }
+
+    if ( batch > 0 ) {
+      const string lines = text.str();
+      text.str( {} );
+      write_all( sink_.load(), lines );
+      written_.store( read_, memory_order_release );
+      written_.notify_all(); // for flush()
+    } else if ( stopping ) {
+      return;
+    } else {
+      wait_for_records();
+    }
+  }
+}
+
+void Logger::flush()
+{
+  const uint64_t target = enqueued_.load();
+  uint64_t written = written_.load( memory_order_acquire );
+  while ( written < target ) {
+    written_.wait( written, memory_order_acquire );
+    written = written_.load( memory_order_acquire );
+  }
+}
+
+void Logger::set_sink( const int fd )
+{
+  flush();
+  sink_.store( fd );
+}
+
+Logger& global_logger()
+{
+  static Logger logger;
+  return logger;
+}
+
+void set_log_level( const LogLevel level )
+{
+  runtime_log_level.store( level );
+}
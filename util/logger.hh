@@ -0,0 +1,185 @@
+#pragma once
+
+#include "ethernet_header.hh"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <type_traits>
+
+// Leveled logging that costs the caller as little as possible.
+//
+//   LOG_DEBUG( "adding route {}/{} on interface {}", LogIpv4 { prefix }, prefix_length, interface_num );
+//
+// - Messages below ROUTER_LOG_LEVEL (a CMake cache variable; default Debug) are compiled out.
+// - Messages below the runtime level (set_log_level(); default Info) cost one relaxed load, and their
+//   arguments are not evaluated.
+// - Otherwise the arguments are copied, unformatted, into a lock-free queue, and a background thread
+//   formats and writes them. If the queue is full the message is dropped (and counted), never waited for.
+//   The thread sleeps while the queue is empty; the message that finds it asleep wakes it.
+//
+// Each "{}" in the format is replaced by the next argument. The format must be a string literal, and
+// arguments must be trivially copyable: numbers, EthernetAddress, LogIpv4, or string literals.
+
+enum class LogLevel : uint8_t
+{
+  Debug,
+  Info,
+  Warning,
+  Error,
+  Off
+};
+
+#ifndef ROUTER_LOG_LEVEL
+#define ROUTER_LOG_LEVEL Debug
+#endif
+
+inline constexpr LogLevel compiled_log_level = LogLevel::ROUTER_LOG_LEVEL;
+
+// An IPv4 address (in host byte order, as from Address::ipv4_numeric()), logged as a dotted quad
+struct LogIpv4
+{
+  uint32_t address;
+};
+
+void log_print( std::ostream& out, LogIpv4 ip );
+void log_print( std::ostream& out, const EthernetAddress& address );
+void log_print( std::ostream& out, const char* str );
+
+template<class T>
+void log_print( std::ostream& out, const T& value )
+{
+  if constexpr ( std::is_integral_v<T> and sizeof( T ) == 1 ) {
+    out << static_cast<int>( value ); // a uint8_t is a number, not a character
+  } else {
+    out << value;
+  }
+}
+
+// One queued message: the format, the arguments' bytes, and how to turn them into text
+struct LogRecord
+{
+  static constexpr size_t max_argument_bytes = 88;
+
+  using Formatter = void ( * )( std::ostream& out, const char* format, const std::byte* arguments );
+
+  LogLevel level {};
+  const char* format {};
+  Formatter formatter {};
+  std::array<std::byte, max_argument_bytes> arguments {};
+};
+
+// Write `format` to `out` up to its next "{}", and return what follows the "{}" (or the end)
+const char* log_print_until_placeholder( std::ostream& out, const char* format );
+
+template<class... Args>
+void format_log_record( std::ostream& out, const char* format, const std::byte* arguments )
+{
+  [[maybe_unused]] const auto next = [&]<class T>( T* /* type tag */ ) {
+    std::array<std::byte, sizeof( T )> bytes {};
+    std::memcpy( bytes.data(), arguments, sizeof( T ) );
+    arguments += sizeof( T );
+    format = log_print_until_placeholder( out, format );
+    log_print( out, std::bit_cast<T>( bytes ) );
+  };
+  ( next( static_cast<Args*>( nullptr ) ), ... );
+  out << format;
+}
+
+// A bounded multi-producer, single-consumer queue of LogRecords, and the thread that drains it
+class Logger
+{
+public:
+  static constexpr size_t capacity = 1024;
+
+  Logger();
+  ~Logger();
+
+  template<class... Args>
+  void log( LogLevel level, const char* format, Args... args )
+  {
+    static_assert( ( std::is_trivially_copyable_v<Args> and ... ), "log arguments must be trivially copyable" );
+    static_assert( ( sizeof( Args ) + ... + 0 ) <= LogRecord::max_argument_bytes, "too many log arguments" );
+
+    LogRecord record { level, format, format_log_record<Args...>, {} };
+    [[maybe_unused]] std::byte* out = record.arguments.data();
+    ( ( std::memcpy( out, &args, sizeof( Args ) ), out += sizeof( Args ) ), ... );
+    push( record );
+  }
+
+  // Wait until every message logged so far has been written
+  void flush();
+
+  // Send output to `fd` (default: stderr); the descriptor must stay open while in use
+  void set_sink( int fd );
+
+  // Messages lost because the queue was full
+  uint64_t dropped() const { return dropped_.load( std::memory_order_relaxed ); }
+
+  Logger( const Logger& other ) = delete;
+  Logger& operator=( const Logger& other ) = delete;
+  Logger( Logger&& other ) = delete;
+  Logger& operator=( Logger&& other ) = delete;
+
+private:
+  struct Slot
+  {
+    std::atomic<uint64_t> sequence; // == position when free for that enqueue, position + 1 once filled
+    LogRecord record;
+  };
+
+  void push( const LogRecord& record );
+  bool pop( LogRecord& record );
+  void drain();
+  void wait_for_records();
+  void wake();
+
+  std::array<Slot, capacity> slots_ {};
+  alignas( 64 ) std::atomic<uint64_t> enqueued_ { 0 };
+  alignas( 64 ) std::atomic<uint64_t> written_ { 0 }; // records written to the sink
+  uint64_t read_ {};                                   // records taken from the queue (writer thread only)
+  std::atomic<uint64_t> dropped_ { 0 };
+  std::atomic<int> sink_ { 2 };
+  std::atomic<bool> stopping_ { false };
+
+  // The writer sets sleeping_ before its last look at the queue; a producer that then sees it set wakes it
+  std::atomic<bool> sleeping_ { false };
+  std::mutex wake_mutex_ {};
+  std::condition_variable wake_ {};
+
+  std::thread writer_ {};
+};
+
+// The process-wide logger (created, with its thread, on first use)
+Logger& global_logger();
+
+// The least severe level that is logged at runtime
+void set_log_level( LogLevel level );
+
+inline std::atomic<LogLevel> runtime_log_level { LogLevel::Info };
+
+inline bool log_enabled( LogLevel level )
+{
+  return level >= runtime_log_level.load( std::memory_order_relaxed );
+}
+
+#define ROUTER_LOG( level, ... )                                                                                   \
+  do {                                                                                                             \
+    if constexpr ( LogLevel::level >= compiled_log_level ) {                                                       \
+      if ( log_enabled( LogLevel::level ) ) {                                                                      \
+        global_logger().log( LogLevel::level, __VA_ARGS__ );                                                       \
+      }                                                                                                            \
+    }                                                                                                              \
+  } while ( false )
+
+#define LOG_DEBUG( ... ) ROUTER_LOG( Debug, __VA_ARGS__ )
+#define LOG_INFO( ... ) ROUTER_LOG( Info, __VA_ARGS__ )
+#define LOG_WARNING( ... ) ROUTER_LOG( Warning, __VA_ARGS__ )
+#define LOG_ERROR( ... ) ROUTER_LOG( Error, __VA_ARGS__ )
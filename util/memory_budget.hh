@@ -0,0 +1,75 @@
+#pragma once
+
+#include "buffer.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Current and high-water-mark byte counts for a pool of memory
+struct MemoryUsage
+{
+  size_t current {};
+  size_t peak {};
+};
+
+// What to do when admitting something would push a pool past its budget
+enum class DropPolicy : uint8_t
+{
+  DropNewest, // refuse the arriving packet ("tail drop")
+  DropOldest, // evict the oldest queued packets until the arriving one fits
+};
+
+// Byte accounting against an optional limit (a limit of zero means "unlimited")
+class MemoryBudget
+{
+  size_t limit_ {};
+  MemoryUsage usage_ {};
+
+public:
+  explicit MemoryBudget( size_t limit = 0 ) : limit_( limit ) {}
+
+  size_t limit() const { return limit_; }
+  void set_limit( size_t limit ) { limit_ = limit; }
+
+  const MemoryUsage& usage() const { return usage_; }
+
+  // Would charging `bytes` more stay within the limit?
+  bool fits( size_t bytes ) const { return limit_ == 0 or usage_.current + bytes <= limit_; }
+
+  void charge( size_t bytes )
+  {
+    usage_.current += bytes;
+    usage_.peak = std::max( usage_.peak, usage_.current );
+  }
+
+  void release( size_t bytes ) { usage_.current -= std::min( bytes, usage_.current ); }
+};
+
+// Heap bytes behind one Buffer: the shared_ptr control block, the std::string object and,
+// once the string outgrows its inline storage, its character array
+inline size_t memory_footprint( const Buffer& buffer )
+{
+  constexpr size_t control_block = 2 * sizeof( long );
+  constexpr size_t inline_capacity = 15;
+  const size_t chars = buffer.size() > inline_capacity ? buffer.size() + 1 : 0;
+  return control_block + sizeof( std::string ) + chars;
+}
+
+// Heap bytes behind a list of Buffers (the vector's own array plus every Buffer)
+inline size_t memory_footprint( const std::vector<Buffer>& buffers )
+{
+  size_t bytes = buffers.capacity() * sizeof( Buffer );
+  for ( const auto& buffer : buffers ) {
+    bytes += memory_footprint( buffer );
+  }
+  return bytes;
+}
+
+// Bytes held by one node of a std::map (the value plus the red-black tree links and color)
+template<class Key, class Value>
+constexpr size_t map_node_footprint()
+{
+  return sizeof( std::pair<const Key, Value> ) + 4 * sizeof( void* );
+}
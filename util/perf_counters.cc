@@ -0,0 +1,82 @@
+#include "perf_counters.hh"
+
+#include "exception.hh"
+
+#include <array>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Open a user-space counter for the calling thread, in the group led by `group` (-1 to lead a new group)
+int open_counter( const uint64_t config, const int group )
+{
+  perf_event_attr attr {};
+  attr.size = sizeof( attr );
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.read_format = PERF_FORMAT_GROUP;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return static_cast<int>( syscall( SYS_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC ) );
+}
+
+uint64_t fallback_ticks()
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+  return __rdtsc();
+#else
+  timespec ts {};
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return static_cast<uint64_t>( ts.tv_sec ) * 1'000'000'000 + ts.tv_nsec;
+#endif
+}
+
+} // namespace
+
+PerfCounters::PerfCounters()
+{
+  const int leader = open_counter( PERF_COUNT_HW_CPU_CYCLES, -1 );
+  if ( leader < 0 ) {
+    return; // no PMU, or not permitted: use the fallback
+  }
+  events_.emplace_back( leader );
+
+  // members are optional; a PMU may lack an event or have too few counters for the group
+  const int instructions = open_counter( PERF_COUNT_HW_INSTRUCTIONS, leader );
+  if ( instructions >= 0 ) {
+    instructions_ = events_.size();
+    events_.emplace_back( instructions );
+  }
+  const int cache_misses = open_counter( PERF_COUNT_HW_CACHE_MISSES, leader );
+  if ( cache_misses >= 0 ) {
+    cache_misses_ = events_.size();
+    events_.emplace_back( cache_misses );
+  }
+}
+
+PerfSample PerfCounters::read() const
+{
+  if ( events_.empty() ) {
+    return { fallback_ticks(), 0, 0 };
+  }
+
+  // PERF_FORMAT_GROUP: the number of events, then each event's value in the order they were opened
+  array<uint64_t, 4> values {};
+  CheckSystemCall( "read perf counters", ::read( events_.front().fd_num(), values.data(), sizeof( values ) ) );
+  PerfSample sample { values[1], 0, 0 };
+  if ( instructions_ != npos ) {
+    sample.instructions = values[1 + instructions_];
+  }
+  if ( cache_misses_ != npos ) {
+    sample.cache_misses = values[1 + cache_misses_];
+  }
+  return sample;
+}
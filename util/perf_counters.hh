@@ -0,0 +1,93 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hardware event counts (or, without perf events, time-stamp counter ticks)
+struct PerfSample
+{
+  uint64_t cycles {};       // CPU cycles, or TSC ticks in the fallback
+  uint64_t instructions {}; // 0 when unavailable
+  uint64_t cache_misses {}; // 0 when unavailable
+
+  PerfSample operator-( const PerfSample& other ) const
+  {
+    return { cycles - other.cycles, instructions - other.instructions, cache_misses - other.cache_misses };
+  }
+};
+
+// The calling thread's cycle, instruction and cache-miss counters, opened as one perf_event_open(2)
+// group so that a single read() returns all three consistently. Where perf events are unavailable (no
+// PMU, or forbidden by perf_event_paranoid) it falls back to the time-stamp counter.
+class PerfCounters
+{
+public:
+  PerfCounters();
+
+  // Are these hardware counters (rather than the TSC fallback)?
+  bool hardware() const { return not events_.empty(); }
+  bool counts_instructions() const { return instructions_ != npos; }
+  bool counts_cache_misses() const { return cache_misses_ != npos; }
+
+  PerfSample read() const;
+
+private:
+  static constexpr size_t npos = static_cast<size_t>( -1 );
+
+  std::vector<FileDescriptor> events_ {}; // group leader (cycles) first
+  size_t instructions_ = npos;            // position of each event in a group read
+  size_t cache_misses_ = npos;
+};
+
+// Totals of PerfSamples attributed to each of N stages
+template<size_t N>
+class StageProfile
+{
+public:
+  struct Totals
+  {
+    uint64_t calls {};
+    PerfSample counts {};
+  };
+
+  const PerfCounters& counters() const { return counters_; }
+
+  void add( size_t stage, const PerfSample& delta )
+  {
+    Totals& totals = totals_.at( stage );
+    totals.calls++;
+    totals.counts.cycles += delta.cycles;
+    totals.counts.instructions += delta.instructions;
+    totals.counts.cache_misses += delta.cache_misses;
+  }
+
+  const Totals& totals( size_t stage ) const { return totals_.at( stage ); }
+  void reset() { totals_ = {}; }
+
+private:
+  PerfCounters counters_ {};
+  std::array<Totals, N> totals_ {};
+};
+
+// Attributes the counts since construction (or since the previous lap) to a stage on each lap()
+template<class Profile>
+class StageTimer
+{
+public:
+  explicit StageTimer( Profile& profile ) : profile_( profile ), last_( profile.counters().read() ) {}
+
+  void lap( size_t stage )
+  {
+    const PerfSample now = profile_.counters().read();
+    profile_.add( stage, now - last_ );
+    last_ = now;
+  }
+
+private:
+  Profile& profile_;
+  PerfSample last_;
+};
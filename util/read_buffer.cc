@@ -0,0 +1,53 @@
+#include "read_buffer.hh"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+ReadBuffer::ReadBuffer( const size_t initial_read_size )
+  : read_size_( min( max( initial_read_size, size_t { 1 } ), kMaxReadSize ) )
+{}
+
+void ReadBuffer::consume( const size_t length )
+{
+  if ( length > size() ) {
+    throw runtime_error( "ReadBuffer::consume() beyond the readable bytes" );
+  }
+  start_ += length;
+  if ( start_ == end_ ) {
+    start_ = end_ = 0; // the next read starts at the front: no move needed
+  }
+}
+
+span<char> ReadBuffer::prepare()
+{
+  if ( capacity_ - end_ < read_size_ ) {
+    const size_t unread = size();
+    if ( unread + read_size_ <= capacity_ ) {
+      memmove( storage_.get(), storage_.get() + start_, unread );
+    } else {
+      const size_t capacity = max( unread + read_size_, capacity_ * 2 );
+      auto storage = make_unique_for_overwrite<char[]>( capacity ); // NOLINT(*-avoid-c-arrays)
+      if ( unread > 0 ) {
+        memcpy( storage.get(), storage_.get() + start_, unread );
+      }
+      storage_ = std::move( storage );
+      capacity_ = capacity;
+    }
+    start_ = 0;
+    end_ = unread;
+  }
+  return { storage_.get() + end_, read_size_ };
+}
+
+void ReadBuffer::commit( const size_t length )
+{
+  if ( length > capacity_ - end_ ) {
+    throw runtime_error( "ReadBuffer::commit() beyond the prepared space" );
+  }
+  end_ += length;
+  if ( length == read_size_ and read_size_ < kMaxReadSize ) {
+    read_size_ *= 2; // the read filled the space, so there was probably more waiting
+  }
+}
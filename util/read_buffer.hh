@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+
+// A reusable buffer for FileDescriptor::read( ReadBuffer& ): bytes are read in after any the caller has
+// not yet consumed, into storage that is allocated without being zero-filled and kept from read to read.
+// Each read asks for read_size() bytes, which doubles (up to kMaxReadSize) whenever a read fills it.
+class ReadBuffer
+{
+  std::unique_ptr<char[]> storage_ {}; // NOLINT(*-avoid-c-arrays)
+  size_t capacity_ {};
+  size_t start_ {}; // first unconsumed byte
+  size_t end_ {};   // one past the last byte read
+  size_t read_size_;
+
+public:
+  static constexpr size_t kInitialReadSize = 16384;
+  static constexpr size_t kMaxReadSize = 1 << 20;
+
+  explicit ReadBuffer( size_t initial_read_size = kInitialReadSize );
+
+  // The bytes read and not yet consumed
+  std::string_view readable() const { return { storage_.get() + start_, end_ - start_ }; }
+  size_t size() const { return end_ - start_; }
+  bool empty() const { return start_ == end_; }
+
+  // Discard the first `length` readable bytes
+  void consume( size_t length );
+
+  // The size of the next read
+  size_t read_size() const { return read_size_; }
+
+  // Room for the next read, after the readable bytes (moving or reallocating them if need be)
+  std::span<char> prepare();
+  // Make `length` bytes just read into prepare()'s span readable
+  void commit( size_t length );
+};
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Streaming summaries of a sequence of (key, weight) updates in fixed memory, for finding the keys that
+// dominate a stream too large to count exactly. Keys are 32-bit, e.g. IPv4 addresses.
+
+// A Count-Min sketch: Depth rows of Width counters, each row indexed by its own hash of the key.
+// An estimate never undercounts; with probability at least 1 - 2^-Depth it overcounts by at most
+// (e / Width) times the total weight added.
+//
+// One thread updates the sketch; other threads may call estimate() at any time.
+template<size_t Width = 2048, size_t Depth = 4>
+class CountMinSketch
+{
+  static_assert( std::has_single_bit( Width ) and Width > 1, "width must be a power of two" );
+  static constexpr unsigned width_bits = std::bit_width( Width ) - 1;
+  static_assert( Depth > 0 and Depth * width_bits <= 64, "each row's column comes from its own bits of one hash" );
+
+  // One well-mixed 64-bit hash of the key, sliced into a column per row
+  static uint64_t hash( uint32_t key )
+  {
+    uint64_t h = ( key ^ 0x5bd1e995 ) * 0x9e3779b97f4a7c15;
+    h ^= h >> 29;
+    return h * 0xbf58476d1ce4e5b9;
+  }
+
+  static size_t column( uint64_t hash, size_t row )
+  {
+    return ( hash >> ( 64 - ( row + 1 ) * width_bits ) ) & ( Width - 1 );
+  }
+
+public:
+  static constexpr size_t width = Width;
+  static constexpr size_t depth = Depth;
+
+  // Add `weight` to `key`'s count and return its new estimate
+  uint64_t add( uint32_t key, uint32_t weight = 1 )
+  {
+    const uint64_t h = hash( key );
+    uint64_t estimate = UINT64_MAX;
+    for ( size_t row = 0; row < Depth; row++ ) {
+      auto& counter = rows_[row][column( h, row )];
+      const uint32_t value = counter.load( std::memory_order_relaxed ) + weight;
+      counter.store( value, std::memory_order_relaxed ); // single writer: no locked read-modify-write
+      estimate = std::min<uint64_t>( estimate, value );
+    }
+    total_.store( total_.load( std::memory_order_relaxed ) + weight, std::memory_order_relaxed );
+    return estimate;
+  }
+
+  // Upper bound on the weight added for `key`
+  uint64_t estimate( uint32_t key ) const
+  {
+    const uint64_t h = hash( key );
+    uint64_t estimate = UINT64_MAX;
+    for ( size_t row = 0; row < Depth; row++ ) {
+      estimate = std::min<uint64_t>( estimate, rows_[row][column( h, row )].load( std::memory_order_relaxed ) );
+    }
+    return estimate;
+  }
+
+  // Total weight added
+  uint64_t total() const { return total_.load( std::memory_order_relaxed ); }
+
+  // Halve every count (the writer only): old weight fades geometrically
+  void decay()
+  {
+    for ( auto& row : rows_ ) {
+      for ( auto& counter : row ) {
+        counter.store( counter.load( std::memory_order_relaxed ) / 2, std::memory_order_relaxed );
+      }
+    }
+    total_.store( total_.load( std::memory_order_relaxed ) / 2, std::memory_order_relaxed );
+  }
+
+private:
+  std::array<std::array<std::atomic<uint32_t>, Width>, Depth> rows_ {};
+  std::atomic<uint64_t> total_ {};
+};
+
+// One of a SpaceSaving summary's monitored keys
+struct HeavyHitter
+{
+  uint32_t key {};
+  uint64_t count {}; // an upper bound on the key's weight...
+  uint64_t error {}; // ...which overcounts by at most this much
+
+  uint64_t lower_bound() const { return count - error; }
+};
+
+// The SpaceSaving algorithm (Metwally et al.): Capacity counters that always hold every key whose weight
+// exceeds total / Capacity. A key that is not monitored evicts the smallest counter and inherits its count
+// (recorded as that key's possible error).
+//
+// Given an upper bound on each key's weight so far (e.g. from a CountMinSketch), a key that is not monitored
+// evicts only if that bound exceeds the smallest count. Every key heavier than the smallest count is still
+// admitted, and the light tail of a skewed stream no longer churns through the summary.
+//
+// Single-threaded: the owner publishes top() to other threads if they need it.
+template<size_t Capacity = 32>
+class SpaceSaving
+{
+  static_assert( Capacity > 0 and Capacity < 256, "entries are indexed by a byte" );
+
+  // An open-addressed index from key to entry, at most a quarter full so that probes stay short
+  static constexpr size_t slots = std::bit_ceil( 4 * Capacity );
+
+  static size_t home( uint32_t key ) { return ( uint64_t { key } * 0x9e3779b97f4a7c15 ) >> ( 64 - slot_bits ); }
+  static constexpr unsigned slot_bits = std::bit_width( slots ) - 1;
+
+public:
+  static constexpr size_t capacity = Capacity;
+
+  // Add `weight` to `key`, whose total weight so far is at most `bound`
+  void add( uint32_t key, uint64_t weight = 1, uint64_t bound = UINT64_MAX )
+  {
+    size_t slot = home( key );
+    for ( ; index_[slot]; slot = ( slot + 1 ) & ( slots - 1 ) ) {
+      const size_t i = index_[slot] - 1;
+      if ( keys_[i] == key ) {
+        counts_[i] += weight;
+        if ( i == min_index_ ) {
+          find_min();
+        }
+        return;
+      }
+    }
+
+    if ( size_ < Capacity ) {
+      index_[slot] = static_cast<uint8_t>( size_ + 1 );
+      keys_[size_] = key;
+      counts_[size_] = weight;
+      errors_[size_] = 0;
+      size_++;
+    } else if ( bound > counts_[min_index_] ) {
+      unindex( keys_[min_index_] );
+      index( key, min_index_ );
+      keys_[min_index_] = key;
+      errors_[min_index_] = counts_[min_index_];
+      counts_[min_index_] += weight;
+    } else {
+      return;
+    }
+    find_min();
+  }
+
+  // Halve every count and error: old weight fades geometrically
+  void decay()
+  {
+    for ( size_t i = 0; i < size_; i++ ) {
+      counts_[i] /= 2;
+      errors_[i] /= 2;
+    }
+  }
+
+  // The monitored keys, largest count first
+  std::vector<HeavyHitter> top() const
+  {
+    std::vector<HeavyHitter> out;
+    out.reserve( size_ );
+    for ( size_t i = 0; i < size_; i++ ) {
+      out.push_back( { keys_[i], counts_[i], errors_[i] } );
+    }
+    std::sort( out.begin(), out.end(), []( const auto& a, const auto& b ) { return a.count > b.count; } );
+    return out;
+  }
+
+  size_t size() const { return size_; }
+
+private:
+  void find_min()
+  {
+    min_index_ = 0;
+    for ( size_t i = 1; i < size_; i++ ) {
+      if ( counts_[i] < counts_[min_index_] ) {
+        min_index_ = i;
+      }
+    }
+  }
+
+  void index( uint32_t key, size_t entry )
+  {
+    size_t slot = home( key );
+    while ( index_[slot] ) {
+      slot = ( slot + 1 ) & ( slots - 1 );
+    }
+    index_[slot] = static_cast<uint8_t>( entry + 1 );
+  }
+
+  // Remove a monitored key from the index, shifting later members of its probe run back into the gap
+  void unindex( uint32_t key )
+  {
+    size_t gap = home( key );
+    while ( keys_[index_[gap] - 1] != key ) {
+      gap = ( gap + 1 ) & ( slots - 1 );
+    }
+    index_[gap] = 0;
+    for ( size_t slot = ( gap + 1 ) & ( slots - 1 ); index_[slot]; slot = ( slot + 1 ) & ( slots - 1 ) ) {
+      // an entry may fill the gap only if the gap lies on its probe path (between its home and its slot)
+      const size_t distance_to_gap = ( gap - home( keys_[index_[slot] - 1] ) ) & ( slots - 1 );
+      const size_t distance_to_slot = ( slot - home( keys_[index_[slot] - 1] ) ) & ( slots - 1 );
+      if ( distance_to_gap < distance_to_slot ) {
+        index_[gap] = index_[slot];
+        index_[slot] = 0;
+        gap = slot;
+      }
+    }
+  }
+
+  std::array<uint8_t, slots> index_ {}; // entry + 1, or 0 for an empty slot
+  std::array<uint32_t, Capacity> keys_ {};
+  std::array<uint64_t, Capacity> counts_ {};
+  std::array<uint64_t, Capacity> errors_ {};
+  size_t size_ {};
+  size_t min_index_ {};
+};
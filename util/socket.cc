@@ -2,9 +2,15 @@
 
 #include "exception.hh"
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstring>
+#include <linux/errqueue.h>
 #include <linux/if_packet.h>
 #include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
 #include <stdexcept>
 #include <sys/ioctl.h>
 #include <unistd.h>
@@ -115,6 +121,24 @@ void Socket::shutdown( const int how )
   }
 }
 
+namespace {
+
+// Total bytes in the first `count` messages of a recvmmsg() or sendmmsg() (which sets each msg_len), or -1 if
+// the call failed, as FDStats::record() expects
+ssize_t batch_bytes( const vector<mmsghdr>& messages, int count )
+{
+  if ( count < 0 ) {
+    return -1;
+  }
+  ssize_t total = 0;
+  for ( int i = 0; i < count; i++ ) {
+    total += messages[i].msg_len;
+  }
+  return total;
+}
+
+} // namespace
+
 //! \note If payload is too small to hold the received datagram, this method throws a std::runtime_error
 void DatagramSocket::recv( Address& source_address, string& payload )
 {
@@ -125,9 +149,11 @@ void DatagramSocket::recv( Address& source_address, string& payload )
   payload.clear();
   payload.resize( kReadBufferSize );
 
-  const ssize_t recv_len = CheckSystemCall(
-    "recvfrom",
-    ::recvfrom( fd_num(), payload.data(), payload.size(), MSG_TRUNC, datagram_source_address, &fromlen ) );
+  const uint64_t start = io_start();
+  const ssize_t result
+    = ::recvfrom( fd_num(), payload.data(), payload.size(), MSG_TRUNC, datagram_source_address, &fromlen );
+  record_read( start, result );
+  const ssize_t recv_len = CheckSystemCall( "recvfrom", result );
 
   if ( recv_len > static_cast<ssize_t>( payload.size() ) ) {
     throw runtime_error( "recvfrom (oversized datagram)" );
@@ -140,17 +166,197 @@ void DatagramSocket::recv( Address& source_address, string& payload )
 
 void DatagramSocket::sendto( const Address& destination, const string_view payload )
 {
-  CheckSystemCall( "sendto",
-                   ::sendto( fd_num(), payload.data(), payload.length(), 0, destination, destination.size() ) );
+  const uint64_t start = io_start();
+  const ssize_t result = ::sendto( fd_num(), payload.data(), payload.length(), 0, destination, destination.size() );
+  record_write( start, result, payload.length() );
+  CheckSystemCall( "sendto", result );
   register_write();
 }
 
 void DatagramSocket::send( const string_view payload )
 {
-  CheckSystemCall( "send", ::send( fd_num(), payload.data(), payload.length(), 0 ) );
+  const uint64_t start = io_start();
+  const ssize_t result = ::send( fd_num(), payload.data(), payload.length(), 0 );
+  record_write( start, result, payload.length() );
+  CheckSystemCall( "send", result );
   register_write();
 }
 
+IOResult DatagramSocket::try_recv( Slot& slot )
+{
+  socklen_t address_size = sizeof( slot.address.storage );
+  const uint64_t start = io_start();
+  const ssize_t received
+    = ::recvfrom( fd_num(), slot.buffer.data(), slot.buffer.size(), MSG_TRUNC, slot.address, &address_size );
+  record_read( start, received );
+  IOResult result = IOResult::from_syscall( received );
+  if ( result.ok() ) {
+    register_read();
+    slot.truncated = result.bytes > slot.buffer.size();
+    slot.length = result.bytes = min( result.bytes, slot.buffer.size() );
+    slot.address_size = address_size;
+  }
+  return result;
+}
+
+size_t DatagramSocket::recv_batch( const span<Slot> slots )
+{
+  if ( slots.empty() ) {
+    return 0;
+  }
+  messages_.resize( slots.size() );
+  iovecs_.resize( slots.size() );
+  for ( size_t i = 0; i < slots.size(); i++ ) {
+    iovecs_[i] = { slots[i].buffer.data(), slots[i].buffer.size() };
+    messages_[i] = {};
+    messages_[i].msg_hdr.msg_name = &slots[i].address.storage;
+    messages_[i].msg_hdr.msg_namelen = sizeof( slots[i].address.storage );
+    messages_[i].msg_hdr.msg_iov = &iovecs_[i];
+    messages_[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  const uint64_t start = io_start();
+  const int count = ::recvmmsg( fd_num(), messages_.data(), slots.size(), MSG_WAITFORONE, nullptr );
+  record_read( start, batch_bytes( messages_, count ) );
+  if ( count < 0 ) {
+    if ( errno == EAGAIN or errno == EWOULDBLOCK ) {
+      return 0;
+    }
+    throw unix_error( "recvmmsg" );
+  }
+
+  register_read();
+  for ( size_t i = 0; i < static_cast<size_t>( count ); i++ ) {
+    slots[i].length = messages_[i].msg_len;
+    slots[i].address_size = messages_[i].msg_hdr.msg_namelen;
+    slots[i].truncated = messages_[i].msg_hdr.msg_flags & MSG_TRUNC;
+  }
+  return count;
+}
+
+size_t DatagramSocket::send_batch( const span<const Slot> slots )
+{
+  if ( slots.empty() ) {
+    return 0;
+  }
+  messages_.resize( slots.size() );
+  iovecs_.resize( slots.size() );
+  size_t total_size = 0;
+  for ( size_t i = 0; i < slots.size(); i++ ) {
+    if ( slots[i].length > slots[i].buffer.size() ) {
+      throw runtime_error( "DatagramSocket::send_batch: length beyond the buffer" );
+    }
+    iovecs_[i] = { slots[i].buffer.data(), slots[i].length };
+    total_size += slots[i].length;
+    messages_[i] = {};
+    if ( slots[i].address_size > 0 ) {
+      // NOLINTNEXTLINE(*-const-cast)
+      messages_[i].msg_hdr.msg_name = const_cast<sockaddr_storage*>( &slots[i].address.storage );
+      messages_[i].msg_hdr.msg_namelen = slots[i].address_size;
+    }
+    messages_[i].msg_hdr.msg_iov = &iovecs_[i];
+    messages_[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  const uint64_t start = io_start();
+  const int count = ::sendmmsg( fd_num(), messages_.data(), slots.size(), 0 );
+  record_write( start, batch_bytes( messages_, count ), total_size );
+  if ( count < 0 ) {
+    if ( errno == EAGAIN or errno == EWOULDBLOCK ) {
+      return 0;
+    }
+    throw unix_error( "sendmmsg" );
+  }
+  register_write();
+  return count;
+}
+
+void UDPSocket::set_segment_size( const uint16_t segment_size )
+{
+  setsockopt( SOL_UDP, UDP_SEGMENT, int { segment_size } );
+}
+
+void UDPSocket::set_gro( const bool enabled )
+{
+  setsockopt( SOL_UDP, UDP_GRO, int { enabled } );
+}
+
+size_t UDPSocket::send_segments( const Slot& slot, const uint16_t segment_size )
+{
+  if ( slot.length > slot.buffer.size() or slot.length > kMaxSegmentedBytes ) {
+    throw runtime_error( "UDPSocket::send_segments: length beyond the buffer or the limit" );
+  }
+  if ( segment_size == 0 or ( slot.length + segment_size - 1 ) / segment_size > kMaxSegments ) {
+    throw runtime_error( "UDPSocket::send_segments: too many segments" );
+  }
+
+  iovec iov { slot.buffer.data(), slot.length };
+  msghdr message {};
+  if ( slot.address_size > 0 ) {
+    message.msg_name = const_cast<sockaddr_storage*>( &slot.address.storage ); // NOLINT(*-const-cast)
+    message.msg_namelen = slot.address_size;
+  }
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+
+  alignas( cmsghdr ) array<char, CMSG_SPACE( sizeof( uint16_t ) )> control {};
+  message.msg_control = control.data();
+  message.msg_controllen = control.size();
+  cmsghdr* header = CMSG_FIRSTHDR( &message );
+  header->cmsg_level = SOL_UDP;
+  header->cmsg_type = UDP_SEGMENT;
+  header->cmsg_len = CMSG_LEN( sizeof( uint16_t ) );
+  memcpy( CMSG_DATA( header ), &segment_size, sizeof( segment_size ) );
+
+  const uint64_t start = io_start();
+  const ssize_t sent = ::sendmsg( fd_num(), &message, 0 );
+  record_write( start, sent, slot.length );
+  if ( sent < 0 ) {
+    if ( errno == EAGAIN or errno == EWOULDBLOCK ) {
+      return 0;
+    }
+    throw unix_error( "sendmsg (UDP_SEGMENT)" );
+  }
+  register_write();
+  return sent;
+}
+
+size_t UDPSocket::recv_segments( Slot& slot )
+{
+  iovec iov { slot.buffer.data(), slot.buffer.size() };
+  msghdr message {};
+  message.msg_name = &slot.address.storage;
+  message.msg_namelen = sizeof( slot.address.storage );
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  alignas( cmsghdr ) array<char, CMSG_SPACE( sizeof( int ) )> control {};
+  message.msg_control = control.data();
+  message.msg_controllen = control.size();
+
+  const uint64_t start = io_start();
+  const ssize_t received = ::recvmsg( fd_num(), &message, 0 );
+  record_read( start, received );
+  if ( received < 0 ) {
+    if ( errno == EAGAIN or errno == EWOULDBLOCK ) {
+      return 0;
+    }
+    throw unix_error( "recvmsg (UDP_GRO)" );
+  }
+  register_read();
+  slot.length = received;
+  slot.address_size = message.msg_namelen;
+  slot.truncated = message.msg_flags & MSG_TRUNC;
+
+  for ( cmsghdr* header = CMSG_FIRSTHDR( &message ); header != nullptr; header = CMSG_NXTHDR( &message, header ) ) {
+    if ( header->cmsg_level == SOL_UDP and header->cmsg_type == UDP_GRO ) {
+      int segment_size {};
+      memcpy( &segment_size, CMSG_DATA( header ), sizeof( segment_size ) );
+      return segment_size;
+    }
+  }
+  return slot.length;
+}
+
 // mark the socket as listening for incoming connections
 //! \param[in] backlog is the number of waiting connections to queue (see [listen(2)](\ref man2::listen))
 void TCPSocket::listen( const int backlog )
@@ -164,7 +370,143 @@ void TCPSocket::listen( const int backlog )
 TCPSocket TCPSocket::accept()
 {
   register_read();
-  return TCPSocket( FileDescriptor( CheckSystemCall( "accept", ::accept( fd_num(), nullptr, nullptr ) ) ) );
+  const uint64_t start = io_start();
+  const int fd = ::accept( fd_num(), nullptr, nullptr );
+  record_read( start, min( fd, 0 ) ); // an accepted connection counts as a read of no bytes
+  return TCPSocket( FileDescriptor( CheckSystemCall( "accept", fd ) ) );
+}
+
+void TCPSocket::set_zerocopy( const bool fall_back_if_copied )
+{
+  setsockopt( SOL_SOCKET, SO_ZEROCOPY, int { true } );
+  zerocopy_ = true;
+  fall_back_if_copied_ = fall_back_if_copied;
+}
+
+size_t TCPSocket::write_zerocopy( const vector<Buffer>& buffers )
+{
+  vector<iovec> iovecs;
+  iovecs.reserve( buffers.size() );
+  size_t total_size = 0;
+  for ( const auto& x : buffers ) {
+    const string_view data { x };
+    iovecs.push_back( { const_cast<char*>( data.data() ), data.size() } ); // NOLINT(*-const-cast)
+    total_size += data.size();
+  }
+
+  if ( zerocopy_ and total_size >= kZeroCopyMinimum ) {
+    msghdr message {};
+    message.msg_iov = iovecs.data();
+    message.msg_iovlen = iovecs.size();
+    const uint64_t start = io_start();
+    const ssize_t bytes_written = ::sendmsg( fd_num(), &message, MSG_ZEROCOPY );
+    record_write( start, bytes_written, total_size );
+    if ( bytes_written > 0 ) {
+      register_write();
+      zerocopy_stats_.zerocopy_sends++;
+      in_flight_.emplace_back( next_sequence_++, buffers );
+      return bytes_written;
+    }
+    if ( bytes_written < 0 and errno != ENOBUFS ) {
+      return CheckSystemCall( "sendmsg (MSG_ZEROCOPY)", bytes_written ); // 0 on EAGAIN, or throws
+    }
+    // out of memory for pinning pages: copy this one instead
+  }
+
+  zerocopy_stats_.copied_sends++;
+  const vector<string_view> views { buffers.begin(), buffers.end() };
+  return write( views );
+}
+
+size_t TCPSocket::reap_completions()
+{
+  size_t completed = 0;
+  while ( not in_flight_.empty() ) {
+    constexpr size_t control_size = CMSG_SPACE( sizeof( sock_extended_err ) + sizeof( sockaddr_in ) );
+    alignas( cmsghdr ) array<char, control_size> control {};
+    msghdr message {};
+    message.msg_control = control.data();
+    message.msg_controllen = control.size();
+    if ( ::recvmsg( fd_num(), &message, MSG_ERRQUEUE | MSG_DONTWAIT ) < 0 ) {
+      if ( errno == EAGAIN or errno == EWOULDBLOCK ) {
+        break;
+      }
+      throw unix_error( "recvmsg (MSG_ERRQUEUE)" );
+    }
+
+    for ( cmsghdr* header = CMSG_FIRSTHDR( &message ); header != nullptr;
+          header = CMSG_NXTHDR( &message, header ) ) {
+      if ( header->cmsg_level != SOL_IP or header->cmsg_type != IP_RECVERR ) {
+        continue;
+      }
+      sock_extended_err error {};
+      memcpy( &error, CMSG_DATA( header ), sizeof( error ) );
+      if ( error.ee_origin != SO_EE_ORIGIN_ZEROCOPY or error.ee_errno != 0 ) {
+        continue;
+      }
+
+      // sends [ee_info, ee_data] are done (compared modulo 2^32); TCP completes them in order
+      const uint32_t range = error.ee_data - error.ee_info;
+      while ( not in_flight_.empty() and in_flight_.front().first - error.ee_info <= range ) {
+        in_flight_.pop_front();
+        completed++;
+      }
+      const uint64_t count = static_cast<uint64_t>( range ) + 1;
+      zerocopy_stats_.completions += count;
+      if ( error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED ) {
+        zerocopy_stats_.kernel_copied += count;
+        if ( fall_back_if_copied_ ) {
+          zerocopy_ = false;
+        }
+      }
+    }
+  }
+  return completed;
+}
+
+IOResult TCPSocket::try_accept( optional<TCPSocket>& connection )
+{
+  const uint64_t start = io_start();
+  const int fd = ::accept( fd_num(), nullptr, nullptr );
+  record_read( start, min( fd, 0 ) );
+  const IOResult result = IOResult::from_syscall( fd );
+  if ( result.ok() ) {
+    register_read();
+    connection = TCPSocket( FileDescriptor( fd ) );
+  }
+  return { 0, result.error, result.status };
+}
+
+// mark the socket as listening for incoming connections
+//! \param[in] backlog is the number of waiting connections to queue (see [listen(2)](\ref man2::listen))
+void LocalStreamSocket::listen( const int backlog )
+{
+  CheckSystemCall( "listen", ::listen( fd_num(), backlog ) );
+}
+
+// accept a new incoming connection
+//! \returns a new LocalStreamSocket connected to the peer.
+//! \note This function blocks until a new connection is available
+LocalStreamSocket LocalStreamSocket::accept()
+{
+  register_read();
+  const uint64_t start = io_start();
+  const int fd = ::accept( fd_num(), nullptr, nullptr );
+  record_read( start, min( fd, 0 ) );
+  return LocalStreamSocket( FileDescriptor( CheckSystemCall( "accept", fd ) ) );
+}
+
+IOResult LocalStreamSocket::try_accept( optional<LocalStreamSocket>& connection )
+{
+  const uint64_t start = io_start();
+  const int fd = ::accept( fd_num(), nullptr, nullptr );
+  record_read( start, min( fd, 0 ) );
+  const IOResult result = IOResult::from_syscall( fd );
+  if ( result.ok() ) {
+    register_read();
+    connection = LocalStreamSocket( FileDescriptor( fd ) );
+  }
+  return { 0, result.error, result.status };
 }
 
 // get socket option
@@ -200,6 +542,12 @@ void Socket::set_reuseaddr()
   setsockopt( SOL_SOCKET, SO_REUSEADDR, int { true } );
 }
 
+void Socket::set_buffer_sizes( const int bytes )
+{
+  setsockopt( SOL_SOCKET, SO_RCVBUF, bytes );
+  setsockopt( SOL_SOCKET, SO_SNDBUF, bytes );
+}
+
 void Socket::throw_if_error() const
 {
   int socket_error = 0;
@@ -219,3 +567,18 @@ void PacketSocket::set_promiscuous()
               PACKET_ADD_MEMBERSHIP,
               packet_mreq { local_address().as<sockaddr_ll>()->sll_ifindex, PACKET_MR_PROMISC, {}, {} } );
 }
+
+void PacketSocket::set_packet_version( const int version )
+{
+  setsockopt( SOL_PACKET, PACKET_VERSION, version );
+}
+
+void PacketSocket::set_rx_ring( const tpacket_req3& request )
+{
+  setsockopt( SOL_PACKET, PACKET_RX_RING, request );
+}
+
+void PacketSocket::set_tx_ring( const tpacket_req3& request )
+{
+  setsockopt( SOL_PACKET, PACKET_TX_RING, request );
+}
@@ -1,11 +1,17 @@
 #pragma once
 
 #include "address.hh"
+#include "buffer.hh"
 #include "file_descriptor.hh"
 
 #include <cstdint>
+#include <deque>
 #include <functional>
+#include <linux/if_packet.h>
+#include <optional>
+#include <span>
 #include <sys/socket.h>
+#include <vector>
 
 //! \brief Base class for network sockets (TCP, UDP, etc.)
 //! \details Socket is generally used via a subclass. See TCPSocket and UDPSocket for usage examples.
@@ -54,6 +60,10 @@ public:
   //! Allow local address to be reused sooner via [SO_REUSEADDR](\ref man7::socket)
   void set_reuseaddr();
 
+  //! Ask for kernel receive and send buffers of `bytes` each via [SO_RCVBUF and SO_SNDBUF](\ref man7::socket)
+  //! (capped by net.core.rmem_max and wmem_max), so bursts wait rather than drop
+  void set_buffer_sizes( int bytes );
+
   //! Check for errors (will be seen on non-blocking sockets)
   void throw_if_error() const;
 };
@@ -62,7 +72,20 @@ class DatagramSocket : public Socket
 {
   using Socket::Socket;
 
+  std::vector<mmsghdr> messages_ {}; // scratch for recv_batch() and send_batch(), kept between calls
+  std::vector<iovec> iovecs_ {};
+
 public:
+  //! One datagram of a batch, in storage the caller owns and can reuse from call to call
+  struct Slot
+  {
+    std::span<char> buffer {}; //!< receiving: room for the datagram; sending: the datagram (up to `length`)
+    size_t length {};          //!< bytes received, or to send
+    Address::Raw address {};   //!< the sender, or the destination
+    socklen_t address_size {}; //!< size of `address`; when sending, 0 means the connected peer
+    bool truncated {};         //!< the datagram received was larger than `buffer`, and was cut short
+  };
+
   //! Receive a datagram and the Address of its sender
   void recv( Address& source_address, std::string& payload );
 
@@ -71,6 +94,20 @@ public:
 
   //! Send datagram to the socket's connected address (must call connect() first)
   void send( std::string_view payload );
+
+  //! Receive a datagram into `slot` without throwing: the IOResult's bytes are those stored in
+  //! `slot.buffer` (a longer datagram is cut short and marked truncated)
+  IOResult try_recv( Slot& slot );
+
+  //! Receive up to `slots.size()` datagrams with one [recvmmsg(2)](\ref man2::recvmmsg): wait for the
+  //! first (if the socket is blocking), then take only those already waiting (MSG_WAITFORONE).
+  //! \returns the number of slots filled (0 if a non-blocking socket had nothing waiting)
+  size_t recv_batch( std::span<Slot> slots );
+
+  //! Send the datagrams in `slots` with [sendmmsg(2)](\ref man2::sendmmsg)
+  //! \returns the number sent, from the front (fewer than all if the kernel stopped early, e.g. when a
+  //! non-blocking socket's buffer filled)
+  size_t send_batch( std::span<const Slot> slots );
 };
 
 //! A wrapper around [UDP sockets](\ref man7::udp)
@@ -82,15 +119,55 @@ class UDPSocket : public DatagramSocket
 public:
   //! Default: construct an unbound, unconnected UDP socket
   UDPSocket() : DatagramSocket( AF_INET, SOCK_DGRAM ) {}
+
+  //! Largest buffer send_segments() takes (one IP datagram's worth), and the most segments in it
+  static constexpr size_t kMaxSegmentedBytes = 65000;
+  static constexpr size_t kMaxSegments = 64;
+
+  //! Split every send on this socket into datagrams of `segment_size` bytes ([UDP_SEGMENT](\ref man7::udp));
+  //! 0 turns it off
+  void set_segment_size( uint16_t segment_size );
+
+  //! Let the kernel hand recv_segments() several datagrams from one sender, of one size, as a single
+  //! buffer ([UDP_GRO](\ref man7::udp))
+  void set_gro( bool enabled );
+
+  //! Send `slot` (up to kMaxSegmentedBytes) as datagrams of `segment_size` bytes each (the last may be
+  //! shorter) with one [sendmsg(2)](\ref man2::sendmsg); the kernel, or the NIC, does the splitting.
+  //! \returns the bytes sent (0 if a non-blocking socket's buffer was full)
+  size_t send_segments( const Slot& slot, uint16_t segment_size );
+
+  //! Receive into `slot` a datagram or, after set_gro( true ), a run of coalesced ones
+  //! \returns the size of each datagram in `slot` (the last may be shorter); `slot.length` if only one,
+  //! and 0 if a non-blocking socket had nothing waiting
+  size_t recv_segments( Slot& slot );
 };
 
 //! A wrapper around [TCP sockets](\ref man7::tcp)
 class TCPSocket : public Socket
 {
+public:
+  //! Counters for write_zerocopy()
+  struct ZeroCopyStats
+  {
+    uint64_t zerocopy_sends {}; //!< sends with MSG_ZEROCOPY
+    uint64_t copied_sends {};   //!< writes that took the ordinary, copying path instead
+    uint64_t completions {};    //!< MSG_ZEROCOPY sends the kernel has finished with
+    uint64_t kernel_copied {};  //!< of those, the ones where the kernel copied the data after all
+  };
+
 private:
   //! \brief Construct from FileDescriptor (used by accept())
   //! \param[in] fd is the FileDescriptor from which to construct
-  explicit TCPSocket( FileDescriptor&& fd ) : Socket( std::move( fd ), AF_INET, SOCK_STREAM ) {}
+  explicit TCPSocket( FileDescriptor&& fd ) : Socket( std::move( fd ), AF_INET, SOCK_STREAM, IPPROTO_TCP ) {}
+
+  // MSG_ZEROCOPY state: each send that succeeds is numbered by the kernel from 0; its Buffers are held
+  // (in order) until the error queue reports that number complete
+  bool zerocopy_ {};
+  bool fall_back_if_copied_ {};
+  uint32_t next_sequence_ {};
+  std::deque<std::pair<uint32_t, std::vector<Buffer>>> in_flight_ {};
+  ZeroCopyStats zerocopy_stats_ {};
 
 public:
   //! Default: construct an unbound, unconnected TCP socket
@@ -101,6 +178,58 @@ public:
 
   //! Accept a new incoming connection
   TCPSocket accept();
+
+  //! Accept a new incoming connection into `connection` without throwing on a failed (or, for a
+  //! non-blocking listener, would-block) [accept(2)](\ref man2::accept)
+  IOResult try_accept( std::optional<TCPSocket>& connection );
+
+  //! Writes smaller than this are copied even when zero-copy is on: pinning pages and reaping the
+  //! completion costs more than copying a few kilobytes
+  static constexpr size_t kZeroCopyMinimum = 16384;
+
+  //! Let write_zerocopy() send without copying ([SO_ZEROCOPY](\ref man7::socket)). If
+  //! `fall_back_if_copied`, it goes back to copying once the kernel reports it had to copy anyway
+  //! (as it does when the peer is on this host), since the attempt then only adds cost.
+  void set_zerocopy( bool fall_back_if_copied = true );
+
+  //! Write `buffers` as FileDescriptor::write() does but, once set_zerocopy() is on, with
+  //! [MSG_ZEROCOPY](\ref man2::sendmsg): the kernel sends from the Buffers themselves, so they are
+  //! held (not copied) until reap_completions() sees the send complete. Small writes, and writes when
+  //! the kernel is out of memory for pinning pages (ENOBUFS), are copied.
+  //! \returns the number of bytes written
+  size_t write_zerocopy( const std::vector<Buffer>& buffers );
+
+  //! Read completions from the error queue (without blocking) and release the Buffers of finished
+  //! sends; the socket polls as readable-with-error (POLLERR) when some are waiting
+  //! \returns the number of sends completed
+  size_t reap_completions();
+
+  //! Number of MSG_ZEROCOPY sends whose Buffers are still held
+  size_t zerocopy_in_flight() const { return in_flight_.size(); }
+
+  const ZeroCopyStats& zerocopy_stats() const { return zerocopy_stats_; }
+};
+
+//! A wrapper around [Unix-domain stream sockets](\ref man7::unix)
+class LocalStreamSocket : public Socket
+{
+private:
+  //! \brief Construct from FileDescriptor (used by accept())
+  //! \param[in] fd is the FileDescriptor from which to construct
+  explicit LocalStreamSocket( FileDescriptor&& fd ) : Socket( std::move( fd ), AF_UNIX, SOCK_STREAM ) {}
+
+public:
+  //! Default: construct an unbound, unconnected Unix-domain stream socket
+  LocalStreamSocket() : Socket( AF_UNIX, SOCK_STREAM ) {}
+
+  //! Mark a socket as listening for incoming connections
+  void listen( int backlog = 16 );
+
+  //! Accept a new incoming connection
+  LocalStreamSocket accept();
+
+  //! Accept a new incoming connection into `connection`, as TCPSocket::try_accept()
+  IOResult try_accept( std::optional<LocalStreamSocket>& connection );
 };
 
 //! A wrapper around [packet sockets](\ref man7:packet)
@@ -110,4 +239,12 @@ public:
   PacketSocket( const int type, const int protocol ) : DatagramSocket( AF_PACKET, type, protocol ) {}
 
   void set_promiscuous();
+
+  //! Choose the layout of memory-mapped ring frames (e.g. TPACKET_V3); must precede set_rx_ring()/set_tx_ring()
+  void set_packet_version( int version );
+
+  //! Set up the receive and transmit rings ([PACKET_RX_RING and PACKET_TX_RING](\ref man7::packet)), to be
+  //! mapped with mmap(2): the receive ring first, then the transmit ring
+  void set_rx_ring( const tpacket_req3& request );
+  void set_tx_ring( const tpacket_req3& request );
 };
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+// A bounded, lock-free queue for exactly one producer thread and one consumer thread.
+// Capacity must be a power of two. Neither end ever blocks or allocates: a full ring refuses the push.
+template<class T, size_t Capacity>
+class SpscRing
+{
+  static_assert( Capacity > 0 and ( Capacity & ( Capacity - 1 ) ) == 0, "capacity must be a power of two" );
+
+public:
+  static constexpr size_t capacity = Capacity;
+
+  // Producer: append `value`, or return false if the ring is full
+  bool try_push( const T& value )
+  {
+    const uint64_t tail = tail_.load( std::memory_order_relaxed );
+    if ( tail - cached_head_ == Capacity ) {
+      cached_head_ = head_.load( std::memory_order_acquire );
+      if ( tail - cached_head_ == Capacity ) {
+        return false;
+      }
+    }
+    slots_[tail & ( Capacity - 1 )] = value;
+    tail_.store( tail + 1, std::memory_order_release );
+    return true;
+  }
+
+  // Consumer: remove the oldest value, if any
+  std::optional<T> try_pop()
+  {
+    const uint64_t head = head_.load( std::memory_order_relaxed );
+    if ( head == cached_tail_ ) {
+      cached_tail_ = tail_.load( std::memory_order_acquire );
+      if ( head == cached_tail_ ) {
+        return std::nullopt;
+      }
+    }
+    T value = slots_[head & ( Capacity - 1 )];
+    head_.store( head + 1, std::memory_order_release );
+    return value;
+  }
+
+  // Approximate number of queued values (exact when called by either end while the other is idle)
+  size_t size() const { return tail_.load( std::memory_order_acquire ) - head_.load( std::memory_order_acquire ); }
+  bool empty() const { return size() == 0; }
+
+private:
+  std::array<T, Capacity> slots_ {};
+
+  // Each end's position on its own cache line, with its cached copy of the other end's
+  alignas( 64 ) std::atomic<uint64_t> tail_ { 0 }; // written by the producer
+  uint64_t cached_head_ {};
+  alignas( 64 ) std::atomic<uint64_t> head_ { 0 }; // written by the consumer
+  uint64_t cached_tail_ {};
+};
@@ -0,0 +1,207 @@
+#include "trace_ring.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+constexpr array<char, 8> dump_magic { 'S', 'R', 'T', 'R', 'A', 'C', 'E', '1' };
+
+// Precedes each thread's events in a dump
+struct DumpHeader
+{
+  array<char, 8> magic;
+  uint64_t thread;
+  uint64_t origin_ticks; // a (ticks, ns) pair taken when the ring was created...
+  uint64_t origin_ns;
+  uint64_t dump_ticks; // ...and another taken at dump time, to calibrate the tick rate
+  uint64_t dump_ns;
+  uint64_t count; // number of TraceEvents that follow
+};
+
+uint64_t now_ns()
+{
+  timespec ts {};
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return static_cast<uint64_t>( ts.tv_sec ) * 1'000'000'000 + ts.tv_nsec;
+}
+
+// Every live thread's ring, so that a dump (possibly from a signal handler) can find them without locking
+constexpr size_t max_rings = 256;
+array<atomic<TraceRing*>, max_rings> rings {};
+atomic<uint64_t> next_thread { 0 };
+int crash_dump_fd = -1;
+
+// write(2) all of `len` bytes, giving up quietly on error (we may be crashing)
+void write_all( int fd, const void* data, size_t len )
+{
+  const auto* bytes = static_cast<const char*>( data );
+  while ( len > 0 ) {
+    const ssize_t written = ::write( fd, bytes, len );
+    if ( written <= 0 ) {
+      return;
+    }
+    bytes += written;
+    len -= written;
+  }
+}
+
+double ticks_per_ns( uint64_t origin_ticks, uint64_t origin_ns, uint64_t later_ticks, uint64_t later_ns )
+{
+  if ( later_ns == origin_ns ) {
+    return 1.0;
+  }
+  return static_cast<double>( later_ticks - origin_ticks ) / static_cast<double>( later_ns - origin_ns );
+}
+
+void crash_handler( int signal_number )
+{
+  write_trace_dump( crash_dump_fd );
+  ::raise( signal_number ); // the handler was installed with SA_RESETHAND, so this one is fatal
+}
+
+} // namespace
+
+TraceRing::TraceRing()
+  : thread_( next_thread.fetch_add( 1, memory_order_relaxed ) )
+  , origin_ticks_( trace_clock() )
+  , origin_ns_( now_ns() )
+  , owner_( this_thread::get_id() )
+{
+  for ( auto& slot : rings ) {
+    TraceRing* expected = nullptr;
+    if ( slot.compare_exchange_strong( expected, this ) ) {
+      return;
+    }
+  }
+  // more threads than slots: this ring still records, but will not appear in dumps
+}
+
+TraceRing::~TraceRing()
+{
+  for ( auto& slot : rings ) {
+    TraceRing* expected = this;
+    if ( slot.compare_exchange_strong( expected, nullptr ) ) {
+      return;
+    }
+  }
+}
+
+vector<TraceEvent> TraceRing::last( size_t n ) const
+{
+  const uint64_t end = next_.load( memory_order_acquire );
+  n = min<uint64_t>( { n, end, capacity } );
+  vector<TraceEvent> out;
+  out.reserve( n );
+  for ( uint64_t i = end - n; i < end; i++ ) {
+    out.push_back( events_[i % capacity] );
+  }
+
+  // from another thread, the owner may have recorded on over the oldest of those while they were copied, and
+  // may be part way through one more: leave those out
+  atomic_thread_fence( memory_order_acquire );
+  const uint64_t in_flight = this_thread::get_id() == owner_ ? 0 : 1;
+  const uint64_t overwriting = next_.load( memory_order_relaxed ) + in_flight;
+  const uint64_t oldest_intact = overwriting > capacity ? overwriting - capacity : 0;
+  const uint64_t overwritten = oldest_intact > end - n ? min<uint64_t>( oldest_intact - ( end - n ), n ) : 0;
+  out.erase( out.begin(), out.begin() + static_cast<ptrdiff_t>( overwritten ) );
+  return out;
+}
+
+TraceSection TraceRing::snapshot( size_t n ) const
+{
+  return { thread_, ticks_per_ns( origin_ticks_, origin_ns_, trace_clock(), now_ns() ), last( n ) };
+}
+
+void TraceRing::write_to( int fd ) const
+{
+  const uint64_t end = next_.load( memory_order_acquire );
+  const uint64_t count = min<uint64_t>( end, capacity );
+  const DumpHeader header { dump_magic, thread_, origin_ticks_, origin_ns_, trace_clock(), now_ns(), count };
+  write_all( fd, &header, sizeof( header ) );
+
+  // oldest first: the ring may wrap, so this is up to two contiguous runs
+  const uint64_t first = ( end - count ) % capacity;
+  const uint64_t run = min( count, capacity - first );
+  write_all( fd, &events_[first], run * sizeof( TraceEvent ) );
+  write_all( fd, events_.data(), ( count - run ) * sizeof( TraceEvent ) );
+}
+
+TraceRing& this_thread_trace_ring()
+{
+  thread_local TraceRing ring;
+  return ring;
+}
+
+vector<TraceSection> collect_trace( size_t n )
+{
+  vector<TraceSection> sections;
+  for ( const auto& slot : rings ) {
+    const TraceRing* ring = slot.load();
+    if ( ring ) {
+      sections.push_back( ring->snapshot( n ) );
+    }
+  }
+  return sections;
+}
+
+void write_trace_dump( int fd )
+{
+  for ( const auto& slot : rings ) {
+    const TraceRing* ring = slot.load();
+    if ( ring ) {
+      ring->write_to( fd );
+    }
+  }
+}
+
+void install_trace_crash_handler( const string& path )
+{
+  crash_dump_fd = CheckSystemCall( "open " + path,
+                                   ::open( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 ) ); // NOLINT
+
+  struct sigaction action
+  {};
+  action.sa_handler = crash_handler;
+  action.sa_flags = SA_RESETHAND; // NOLINT(*-signed-bitwise)
+  sigemptyset( &action.sa_mask );
+  for ( const int signal_number : { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT } ) {
+    CheckSystemCall( "sigaction", sigaction( signal_number, &action, nullptr ) );
+  }
+}
+
+vector<TraceSection> read_trace_dump( istream& in )
+{
+  vector<TraceSection> sections;
+  DumpHeader header {};
+  while ( in.read( reinterpret_cast<char*>( &header ), sizeof( header ) ) ) { // NOLINT(*-reinterpret-cast)
+    if ( header.magic != dump_magic ) {
+      throw runtime_error( "not a trace dump (bad magic)" );
+    }
+    if ( header.count > TraceRing::capacity ) {
+      throw runtime_error( "trace dump section is too long" );
+    }
+
+    TraceSection section;
+    section.thread = header.thread;
+    section.ticks_per_ns = ticks_per_ns( header.origin_ticks, header.origin_ns, header.dump_ticks, header.dump_ns );
+    section.events.resize( header.count );
+    if ( not in.read( reinterpret_cast<char*>( section.events.data() ), // NOLINT(*-reinterpret-cast)
+                      static_cast<streamsize>( header.count * sizeof( TraceEvent ) ) ) ) {
+      throw runtime_error( "trace dump is truncated" );
+    }
+    sections.push_back( move( section ) );
+  }
+  return sections;
+}
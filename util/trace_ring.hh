@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <istream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+
+// A timestamp that is as cheap as possible to take: the CPU's time-stamp counter where there is one,
+// otherwise nanoseconds on the monotonic clock. Trace dumps carry what is needed to convert to nanoseconds.
+inline uint64_t trace_clock()
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+  return __rdtsc();
+#else
+  timespec ts {};
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return static_cast<uint64_t>( ts.tv_sec ) * 1'000'000'000 + ts.tv_nsec;
+#endif
+}
+
+// One compact (16-byte) trace record. The meaning of `type`, `detail` and `value` belongs to the caller.
+struct TraceEvent
+{
+  uint64_t timestamp; // trace_clock() ticks
+  uint32_t value;
+  uint16_t source;
+  uint8_t type;
+  uint8_t detail;
+};
+
+static_assert( sizeof( TraceEvent ) == 16 );
+static_assert( std::atomic<uint64_t>::is_always_lock_free ); // read from a signal handler
+
+// One thread's events, from a live ring or read back from a dump
+struct TraceSection
+{
+  uint64_t thread {};
+  double ticks_per_ns {}; // to convert TraceEvent::timestamp to nanoseconds
+  std::vector<TraceEvent> events {};
+};
+
+// A fixed-size ring of the most recent TraceEvents recorded by one thread.
+// Recording never allocates, locks or makes a system call.
+class TraceRing
+{
+public:
+  static constexpr size_t capacity = 4096;
+
+  TraceRing();
+  ~TraceRing();
+
+  void record( uint8_t type, uint16_t source, uint8_t detail, uint32_t value )
+  {
+    const uint64_t next = next_.load( std::memory_order_relaxed ); // only this thread stores
+    events_[next % capacity] = { trace_clock(), value, source, type, detail };
+    next_.store( next + 1, std::memory_order_release );
+  }
+
+  // Number of events ever recorded (the ring holds the last min(recorded(), capacity))
+  uint64_t recorded() const { return next_.load( std::memory_order_acquire ); }
+
+  // The last `n` events, oldest first. From another thread while this one records, fewer: those overwritten
+  // before they could be copied are left out.
+  std::vector<TraceEvent> last( size_t n ) const;
+
+  // The last `n` events with what is needed to interpret their timestamps
+  TraceSection snapshot( size_t n = capacity ) const;
+
+  // Write this ring in the dump format (see write_trace_dump); async-signal-safe
+  void write_to( int fd ) const;
+
+  TraceRing( const TraceRing& other ) = delete;
+  TraceRing& operator=( const TraceRing& other ) = delete;
+  TraceRing( TraceRing&& other ) = delete;
+  TraceRing& operator=( TraceRing&& other ) = delete;
+
+private:
+  std::array<TraceEvent, capacity> events_ {};
+  // Published with release after each event is written, and read with acquire by other threads and the crash
+  // handler, so they see every event up to it complete
+  std::atomic<uint64_t> next_ { 0 };
+  uint64_t thread_ {};
+  uint64_t origin_ticks_;
+  uint64_t origin_ns_;
+  std::thread::id owner_; // the thread that records
+};
+
+// The calling thread's ring, created (and registered for dumps) on first use
+TraceRing& this_thread_trace_ring();
+
+// The last `n` events of every live thread's ring
+std::vector<TraceSection> collect_trace( size_t n = TraceRing::capacity );
+
+// Write every live thread's ring to `fd`, one section per thread. Async-signal-safe.
+void write_trace_dump( int fd );
+
+// Arrange for a fatal signal (SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT) to write a trace dump to `path`
+// before the process dies. The file is opened now, so nothing is allocated when the signal arrives.
+void install_trace_crash_handler( const std::string& path );
+
+// Parse a dump written by write_trace_dump(); throws std::runtime_error if it is malformed
+std::vector<TraceSection> read_trace_dump( std::istream& in );